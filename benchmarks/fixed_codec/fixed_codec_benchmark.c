@@ -0,0 +1,191 @@
+/*
+ * Compare the fixed-layout encoders and decoders generated by proto/generate_fixed_codec.py with
+ * pb_encode_ex() and pb_decode() on the messages the device exchanges with the host. Every encoded
+ * message is compared byte for byte with the output of nanopb, the benchmark fails on any difference.
+ */
+// For clock_gettime()
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include <pb_encode.h>
+#include <pb_decode.h>
+#include <main.pb.h>
+#include <main.fixed.h>
+
+// Number of messages encoded/decoded per measurement
+#define NUM_OF_ITERATIONS  1000000U
+
+// Number of distinct messages cycled through, so that the values are not constant
+#define NUM_OF_MESSAGES  256U
+
+static DeviceToHostMessage one_off_msgs[NUM_OF_MESSAGES];
+static HostToDeviceMessage set_msgs[NUM_OF_MESSAGES];
+
+// Accumulated into so that the compiler can't drop the work being measured
+static volatile uint32_t sink;
+
+static uint64_t time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void init_messages(void)
+{
+  srand(1);
+  for (uint32_t i = 0; i < NUM_OF_MESSAGES; i++)
+  {
+    // Mix of small, large and negative values, negative values take 10 bytes on the wire
+    int32_t val[8];
+    for (int j = 0; j < 8; j++)
+    {
+      int32_t r = rand();
+      val[j] = (j % 3 == 0) ? -(r % 32768) : (j % 3 == 1) ? (r % 128) : r;
+    }
+    DeviceToHostMessage msg = DeviceToHostMessage_init_zero;
+    msg.which_payload = DeviceToHostMessage_one_off_sampler_data_msg_tag;
+    msg.payload.one_off_sampler_data_msg = (OneOffSamplerDataMessage) {val[0], val[1], val[2], val[3], val[4], val[5], val[6], val[7]};
+    one_off_msgs[i] = msg;
+
+    HostToDeviceMessage set_msg = HostToDeviceMessage_init_zero;
+    set_msg.which_payload = HostToDeviceMessage_set_periodic_sampler_msg_tag;
+    SetPeriodicSamplerMessage* set = &set_msg.payload.set_periodic_sampler_msg;
+    set->sampling_period = 20 + (int32_t) (i * 7U);
+    set->has_sampling_clock = (i & 1U) != 0U;
+    set->sampling_clock = SamplingClock_SAMPLING_CLOCK_PWM;
+    set->has_frames_per_block = true;
+    set->frames_per_block = 1U + i;
+    set->has_frame_format = (i & 2U) != 0U;
+    set->frame_format = FrameFormat_FRAME_FORMAT_PACKED_INT16;
+    set->has_channel_mask = true;
+    set->channel_mask = i;
+    set_msgs[i] = set_msg;
+  }
+}
+
+// Field by field, the structs have padding which neither decoder initialises
+static bool set_periodic_sampler_msg_equal(const SetPeriodicSamplerMessage* a, const SetPeriodicSamplerMessage* b)
+{
+  return a->sampling_period == b->sampling_period &&
+         a->has_sampling_clock == b->has_sampling_clock && a->sampling_clock == b->sampling_clock &&
+         a->has_frames_per_block == b->has_frames_per_block && a->frames_per_block == b->frames_per_block &&
+         a->has_frame_format == b->has_frame_format && a->frame_format == b->frame_format &&
+         a->has_channel_mask == b->has_channel_mask && a->channel_mask == b->channel_mask &&
+         a->has_data_interface == b->has_data_interface && a->data_interface == b->data_interface;
+}
+
+// Check that the fixed encoders produce the same bytes as nanopb and that both decoders agree
+static int check_wire_compatibility(void)
+{
+  for (uint32_t i = 0; i < NUM_OF_MESSAGES; i++)
+  {
+    uint8_t pb_buf[128];
+    uint8_t fixed_buf[DeviceToHostMessage_FIXED_DELIMITED_MAX_SIZE];
+    pb_ostream_t stream = pb_ostream_from_buffer(pb_buf, sizeof(pb_buf));
+    if (!pb_encode_ex(&stream, DeviceToHostMessage_fields, &one_off_msgs[i], PB_ENCODE_DELIMITED))
+    {
+      printf("ERROR : pb_encode_ex() failed : %s\n", PB_GET_ERROR(&stream));
+      return 1;
+    }
+    size_t fixed_size = DeviceToHostMessage_encode_fixed_delimited(fixed_buf, &one_off_msgs[i]);
+    if (fixed_size != stream.bytes_written || memcmp(pb_buf, fixed_buf, fixed_size) != 0)
+    {
+      printf("ERROR : DeviceToHostMessage %" PRIu32 " is encoded differently, %zu bytes vs %zu bytes.\n", i, fixed_size, stream.bytes_written);
+      return 1;
+    }
+
+    uint8_t set_buf[HostToDeviceMessage_FIXED_MAX_SIZE];
+    stream = pb_ostream_from_buffer(pb_buf, sizeof(pb_buf));
+    if (!pb_encode(&stream, HostToDeviceMessage_fields, &set_msgs[i]))
+    {
+      printf("ERROR : pb_encode() failed : %s\n", PB_GET_ERROR(&stream));
+      return 1;
+    }
+    fixed_size = HostToDeviceMessage_encode_fixed(set_buf, &set_msgs[i]);
+    if (fixed_size != stream.bytes_written || memcmp(pb_buf, set_buf, fixed_size) != 0)
+    {
+      printf("ERROR : HostToDeviceMessage %" PRIu32 " is encoded differently, %zu bytes vs %zu bytes.\n", i, fixed_size, stream.bytes_written);
+      return 1;
+    }
+    HostToDeviceMessage pb_decoded = HostToDeviceMessage_init_zero;
+    HostToDeviceMessage fixed_decoded = HostToDeviceMessage_init_zero;
+    pb_istream_t istream = pb_istream_from_buffer(set_buf, fixed_size);
+    if (!pb_decode(&istream, HostToDeviceMessage_fields, &pb_decoded) ||
+        !HostToDeviceMessage_decode_fixed(set_buf, fixed_size, &fixed_decoded) ||
+        pb_decoded.which_payload != fixed_decoded.which_payload ||
+        !set_periodic_sampler_msg_equal(&pb_decoded.payload.set_periodic_sampler_msg, &fixed_decoded.payload.set_periodic_sampler_msg))
+    {
+      printf("ERROR : HostToDeviceMessage %" PRIu32 " is decoded differently.\n", i);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void report(const char* name, uint64_t elapsed_ns)
+{
+  printf("%-48s %8.1f ns/msg\n", name, (double) elapsed_ns / NUM_OF_ITERATIONS);
+}
+
+int main(void)
+{
+  init_messages();
+  if (check_wire_compatibility() != 0)
+  {
+    return 1;
+  }
+  printf("Wire output identical to nanopb for %u messages.\n\n", NUM_OF_MESSAGES);
+
+  uint8_t buf[128];
+  uint64_t start = time_ns();
+  for (uint32_t i = 0; i < NUM_OF_ITERATIONS; i++)
+  {
+    pb_ostream_t stream = pb_ostream_from_buffer(buf, sizeof(buf));
+    pb_encode_ex(&stream, DeviceToHostMessage_fields, &one_off_msgs[i % NUM_OF_MESSAGES], PB_ENCODE_DELIMITED);
+    sink += (uint32_t) stream.bytes_written;
+  }
+  report("OneOffSamplerData encode, pb_encode_ex()", time_ns() - start);
+
+  start = time_ns();
+  for (uint32_t i = 0; i < NUM_OF_ITERATIONS; i++)
+  {
+    sink += (uint32_t) DeviceToHostMessage_encode_fixed_delimited(buf, &one_off_msgs[i % NUM_OF_MESSAGES]);
+  }
+  report("OneOffSamplerData encode, fixed", time_ns() - start);
+
+  // Encode the set messages once, the decoders are measured on the same bytes
+  static uint8_t set_bufs[NUM_OF_MESSAGES][HostToDeviceMessage_FIXED_MAX_SIZE];
+  static size_t set_sizes[NUM_OF_MESSAGES];
+  for (uint32_t i = 0; i < NUM_OF_MESSAGES; i++)
+  {
+    set_sizes[i] = HostToDeviceMessage_encode_fixed(set_bufs[i], &set_msgs[i]);
+  }
+
+  start = time_ns();
+  for (uint32_t i = 0; i < NUM_OF_ITERATIONS; i++)
+  {
+    HostToDeviceMessage msg = HostToDeviceMessage_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(set_bufs[i % NUM_OF_MESSAGES], set_sizes[i % NUM_OF_MESSAGES]);
+    pb_decode(&stream, HostToDeviceMessage_fields, &msg);
+    sink += (uint32_t) msg.payload.set_periodic_sampler_msg.frames_per_block;
+  }
+  report("SetPeriodicSampler decode, pb_decode()", time_ns() - start);
+
+  start = time_ns();
+  for (uint32_t i = 0; i < NUM_OF_ITERATIONS; i++)
+  {
+    HostToDeviceMessage msg;
+    HostToDeviceMessage_decode_fixed(set_bufs[i % NUM_OF_MESSAGES], set_sizes[i % NUM_OF_MESSAGES], &msg);
+    sink += (uint32_t) msg.payload.set_periodic_sampler_msg.frames_per_block;
+  }
+  report("SetPeriodicSampler decode, fixed", time_ns() - start);
+
+  return 0;
+}
@@ -84,9 +84,18 @@
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
+#define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
+/* Run time in microseconds from the free running 64-bit timer of the RP2040, which needs no setup, doesn't
+ * wrap and is shared by both cores. */
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+extern uint64_t time_us_64(void);
+#endif
+#define configRUN_TIME_COUNTER_TYPE             uint64_t
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()        time_us_64()
 
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
@@ -117,19 +117,30 @@
 #endif
 
 //------------- CLASS -------------//
-#define CFG_TUD_CDC               1
+#define CFG_TUD_CDC               2
 #define CFG_TUD_MSC               0
 #define CFG_TUD_HID               0
 #define CFG_TUD_MIDI              0
-#define CFG_TUD_VENDOR            0
+#define CFG_TUD_VENDOR            1
 
 // CDC FIFO size of TX and RX
 #define CFG_TUD_CDC_RX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : 1024)
+// A build may take a larger tx fifo, e.g. to measure its effect with host_src/python_host_scripts/egress_benchmark.py
+#ifndef CFG_TUD_CDC_TX_BUFSIZE
 #define CFG_TUD_CDC_TX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : 1024)
+#endif
 
 // CDC Endpoint transfer buffer size, more is faster
 #define CFG_TUD_CDC_EP_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : 1024)
 
+// Vendor FIFO size of TX and RX, the TX FIFO carries the sample stream so it is made large
+// enough to keep the bulk IN endpoint busy, the RX FIFO is unused
+#define CFG_TUD_VENDOR_RX_BUFSIZE   64
+#define CFG_TUD_VENDOR_TX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 4096 : 2048)
+
+// Vendor Endpoint size, bulk endpoints are limited to 64 bytes at full speed
+#define CFG_TUD_VENDOR_EPSIZE       (TUD_OPT_HIGH_SPEED ? 512 : 64)
+
 #ifdef __cplusplus
  }
 #endif
@@ -0,0 +1,103 @@
+#include "aggregator.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Clear the statistics for a new window
+static void aggregator_start_window(struct aggregator* aggregator)
+{
+  aggregator->num_of_frames = 0;
+  for (uint8_t c = 0; c < aggregator->num_of_channels; c++)
+  {
+    aggregator->min[c] = INT32_MAX;
+    aggregator->max[c] = INT32_MIN;
+    aggregator->sum[c] = 0;
+    aggregator->sum_sq[c] = 0;
+  }
+}
+
+bool aggregator_init(struct aggregator* aggregator, uint32_t window_frames, uint8_t num_of_channels)
+{
+  if (window_frames == 0U || window_frames > AGGREGATOR_MAX_WINDOW ||
+      num_of_channels == 0U || num_of_channels > AGGREGATOR_MAX_CHANNELS)
+  {
+    return false;
+  }
+  memset(aggregator, 0, sizeof(*aggregator));
+  aggregator->window_frames = window_frames;
+  aggregator->num_of_channels = num_of_channels;
+  aggregator_start_window(aggregator);
+  return true;
+}
+
+// Integer square root, rounded down
+static uint64_t isqrt64(uint64_t value)
+{
+  uint64_t root = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+bool aggregator_push(struct aggregator* aggregator, const int32_t* input, struct aggregatorStats* output)
+{
+  for (uint8_t c = 0; c < aggregator->num_of_channels; c++)
+  {
+    int32_t value = input[c];
+    if (value < aggregator->min[c])
+    {
+      aggregator->min[c] = value;
+    }
+    if (value > aggregator->max[c])
+    {
+      aggregator->max[c] = value;
+    }
+    aggregator->sum[c] += value;
+    uint64_t square = (uint64_t) ((int64_t) value * value);
+    aggregator->sum_sq[c] = (aggregator->sum_sq[c] > UINT64_MAX - square) ? UINT64_MAX : aggregator->sum_sq[c] + square;
+  }
+  aggregator->num_of_frames++;
+  if (aggregator->num_of_frames < aggregator->window_frames)
+  {
+    return false;
+  }
+
+  // The divisions only run once per window, the quotient and remainder are scaled separately so that the
+  // fractional bits don't overflow the sums
+  int64_t num_of_frames = aggregator->num_of_frames;
+  for (uint8_t c = 0; c < aggregator->num_of_channels; c++)
+  {
+    int64_t sum = aggregator->sum[c];
+    int64_t mean = (sum / num_of_frames) * (1 << AGGREGATOR_FRACTION_BITS) +
+                   ((sum % num_of_frames) * (1 << AGGREGATOR_FRACTION_BITS)) / num_of_frames;
+    uint64_t sum_sq = aggregator->sum_sq[c];
+    // Mean square with twice the fractional bits, its square root has AGGREGATOR_FRACTION_BITS
+    uint64_t quotient = sum_sq / (uint64_t) num_of_frames;
+    uint64_t mean_sq = (quotient >= (UINT64_MAX >> (2U * AGGREGATOR_FRACTION_BITS))) ? UINT64_MAX :
+                       (quotient << (2U * AGGREGATOR_FRACTION_BITS)) +
+                       ((sum_sq % (uint64_t) num_of_frames) << (2U * AGGREGATOR_FRACTION_BITS)) / (uint64_t) num_of_frames;
+    // A saturated sum of squares only bounds the RMS from below, so it saturates too
+    uint64_t rms = (sum_sq == UINT64_MAX) ? UINT64_MAX : isqrt64(mean_sq);
+    output[c].min = aggregator->min[c];
+    output[c].max = aggregator->max[c];
+    output[c].mean = (mean > INT32_MAX) ? INT32_MAX : ((mean < INT32_MIN) ? INT32_MIN : (int32_t) mean);
+    output[c].rms = (rms > UINT32_MAX) ? UINT32_MAX : (uint32_t) rms;
+  }
+  aggregator_start_window(aggregator);
+  return true;
+}
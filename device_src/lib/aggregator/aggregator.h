@@ -0,0 +1,68 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Per-channel statistics over consecutive windows of frames, all in fixed point:
+ *
+ * The running minimum, maximum, sum and sum of squares of every channel are kept as the frames come in, only
+ * compares, adds and a multiplication per value. Once a window is complete a record of struct aggregatorStats
+ * per channel is produced and the sums start over. Mean and RMS are in units of the input with
+ * AGGREGATOR_FRACTION_BITS fractional bits.
+ *
+ * The sums are kept in 64 bits. The sum of squares holds AGGREGATOR_MAX_WINDOW squares of values up to 2^16 in
+ * magnitude, e.g. ADC codes, but only four of values near 2^31, so it saturates rather than wrapping around.
+ * The RMS of a window whose sum of squares has saturated is UINT32_MAX, as is any RMS of 2^24 or more, which
+ * doesn't fit with the fractional bits.
+ */
+#define AGGREGATOR_MAX_CHANNELS   8U
+#define AGGREGATOR_FRACTION_BITS  8U
+#define AGGREGATOR_MAX_WINDOW     (1UL << 31)
+
+// Statistics of a channel over a window, the record sent to the host is one of these per channel,
+// little-endian and back to back
+struct aggregatorStats
+{
+  int32_t min;
+  int32_t max;
+  int32_t mean;
+  uint32_t rms;
+};
+
+struct aggregator
+{
+  uint32_t window_frames;
+  uint8_t num_of_channels;
+  // Frames of the current window so far
+  uint32_t num_of_frames;
+  int32_t min[AGGREGATOR_MAX_CHANNELS];
+  int32_t max[AGGREGATOR_MAX_CHANNELS];
+  int64_t sum[AGGREGATOR_MAX_CHANNELS];
+  uint64_t sum_sq[AGGREGATOR_MAX_CHANNELS];
+};
+
+// Function prototypes
+/**
+ * @brief Set up an aggregator and start the first window
+ *
+ * @param aggregator The aggregator
+ * @param window_frames The number of frames per window, 1 up to AGGREGATOR_MAX_WINDOW
+ * @param num_of_channels The number of values per frame, up to AGGREGATOR_MAX_CHANNELS
+ * @return true if the aggregator has been set up, false if the arguments are invalid
+ */
+bool aggregator_init(struct aggregator* aggregator, uint32_t window_frames, uint8_t num_of_channels);
+
+/**
+ * @brief Add a frame to the current window
+ *
+ * @param aggregator The aggregator
+ * @param input The frame, num_of_channels values
+ * @param output The record of the window, num_of_channels entries, only written when the window is complete
+ * @return true if the window is complete and a record has been produced, the next frame starts a new window
+ */
+bool aggregator_push(struct aggregator* aggregator, const int32_t* input, struct aggregatorStats* output);
+
+
+#endif /* AGGREGATOR_H */
@@ -0,0 +1,108 @@
+#include "decimator.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Compensating low-pass FIR at the CIC output rate, Q15, symmetric with unity DC gain
+// Least-squares design, passband up to 0.2 of the CIC output rate with the inverse of the sinc^3 droop,
+// stopband from 0.3 of the CIC output rate, only the first half and the centre tap are stored
+static const int16_t decimator_fir_taps[DECIMATOR_FIR_NUM_OF_TAPS / 2U + 1U] =
+{
+  38, 119, 52, -228, -223, 364, 543, -503, -1097, 604, 2071, -562, -4069, -177, 10877, 17150,
+};
+
+bool decimator_init(struct decimator* decimator, uint32_t ratio, uint8_t num_of_channels)
+{
+  if (ratio < DECIMATOR_FIR_RATIO || ratio > DECIMATOR_MAX_RATIO || (ratio % DECIMATOR_FIR_RATIO) != 0U ||
+      num_of_channels == 0U || num_of_channels > DECIMATOR_MAX_CHANNELS)
+  {
+    return false;
+  }
+  memset(decimator, 0, sizeof(*decimator));
+  decimator->cic_ratio = ratio / DECIMATOR_FIR_RATIO;
+  decimator->cic_gain = 1;
+  for (uint32_t i = 0; i < DECIMATOR_CIC_ORDER; i++)
+  {
+    decimator->cic_gain *= (int64_t) decimator->cic_ratio;
+  }
+  decimator->num_of_channels = num_of_channels;
+  return true;
+}
+
+// Run the combs on the integrator output, at the CIC output rate, and remove the gain of the CIC
+static int32_t cic_output(struct decimatorChannel* channel, int64_t gain)
+{
+  uint64_t value = channel->integrators[DECIMATOR_CIC_ORDER - 1U];
+  for (uint32_t i = 0; i < DECIMATOR_CIC_ORDER; i++)
+  {
+    uint64_t delayed = channel->comb_delays[i];
+    channel->comb_delays[i] = value;
+    value -= delayed;
+  }
+  // Only the wrap around of the integrators is modular, the comb output fits into an int64_t
+  return (int32_t) ((int64_t) value / gain);
+}
+
+// Apply the FIR to the last DECIMATOR_FIR_NUM_OF_TAPS values, starting with the oldest one
+static int32_t fir_output(const int32_t* history)
+{
+  int64_t acc = 0;
+  for (uint32_t i = 0; i < DECIMATOR_FIR_NUM_OF_TAPS / 2U; i++)
+  {
+    // Symmetric taps, so pairs of values share a multiplication
+    acc += ((int64_t) history[i] + history[DECIMATOR_FIR_NUM_OF_TAPS - 1U - i]) * decimator_fir_taps[i];
+  }
+  acc += (int64_t) history[DECIMATOR_FIR_NUM_OF_TAPS / 2U] * decimator_fir_taps[DECIMATOR_FIR_NUM_OF_TAPS / 2U];
+  // Round to nearest
+  acc += (int64_t) 1 << 14;
+  acc >>= 15;
+  if (acc > INT32_MAX)
+  {
+    return INT32_MAX;
+  }else if (acc < INT32_MIN)
+  {
+    return INT32_MIN;
+  }
+  return (int32_t) acc;
+}
+
+bool decimator_push(struct decimator* decimator, const int32_t* input, int32_t* output)
+{
+  for (uint8_t c = 0; c < decimator->num_of_channels; c++)
+  {
+    struct decimatorChannel* channel = &decimator->channels[c];
+    uint64_t value = (uint64_t) (int64_t) input[c];
+    for (uint32_t i = 0; i < DECIMATOR_CIC_ORDER; i++)
+    {
+      channel->integrators[i] += value;
+      value = channel->integrators[i];
+    }
+  }
+  if (++decimator->cic_phase < decimator->cic_ratio)
+  {
+    return false;
+  }
+  decimator->cic_phase = 0;
+
+  uint32_t index = decimator->fir_index;
+  for (uint8_t c = 0; c < decimator->num_of_channels; c++)
+  {
+    struct decimatorChannel* channel = &decimator->channels[c];
+    int32_t value = cic_output(channel, decimator->cic_gain);
+    channel->fir_history[index] = value;
+    channel->fir_history[index + DECIMATOR_FIR_NUM_OF_TAPS] = value;
+  }
+  // The oldest value moves on by one, the window starting there ends with the value just written
+  decimator->fir_index = (index + 1U == DECIMATOR_FIR_NUM_OF_TAPS) ? 0U : index + 1U;
+  if (++decimator->fir_phase < DECIMATOR_FIR_RATIO)
+  {
+    return false;
+  }
+  decimator->fir_phase = 0;
+
+  for (uint8_t c = 0; c < decimator->num_of_channels; c++)
+  {
+    output[c] = fir_output(&decimator->channels[c].fir_history[decimator->fir_index]);
+  }
+  return true;
+}
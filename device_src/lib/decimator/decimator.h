@@ -0,0 +1,73 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Per-channel decimation filter chain, all in fixed point:
+ *
+ *   input -> CIC, order DECIMATOR_CIC_ORDER, decimates by ratio / DECIMATOR_FIR_RATIO
+ *         -> FIR, DECIMATOR_FIR_NUM_OF_TAPS Q15 taps, decimates by DECIMATOR_FIR_RATIO -> output
+ *
+ * The CIC only takes adds and subtracts per input value, its integrators wrap around in 64 bits, which
+ * holds a 32-bit input plus the bit growth of the largest ratio. Its output is divided by its gain, so the
+ * output is in the units of the input. The FIR runs at the lower rate, it compensates the sinc^3 droop of
+ * the CIC up to 0.4 times the output rate and attenuates by about 60 dB what would alias into that band.
+ * The compensation assumes a CIC ratio of 4 or more, below that the top of the band is slightly boosted.
+ * Averaging over ratio input values lowers the noise of the output.
+ */
+#define DECIMATOR_MAX_CHANNELS     8U
+#define DECIMATOR_CIC_ORDER        3U
+#define DECIMATOR_CIC_MAX_RATIO    128U
+#define DECIMATOR_FIR_NUM_OF_TAPS  31U
+#define DECIMATOR_FIR_RATIO        2U
+// The ratio has to be a multiple of DECIMATOR_FIR_RATIO
+#define DECIMATOR_MAX_RATIO        (DECIMATOR_CIC_MAX_RATIO * DECIMATOR_FIR_RATIO)
+
+struct decimatorChannel
+{
+  uint64_t integrators[DECIMATOR_CIC_ORDER];
+  uint64_t comb_delays[DECIMATOR_CIC_ORDER];
+  // FIR input history, every value is written twice, DECIMATOR_FIR_NUM_OF_TAPS apart, so that the last
+  // DECIMATOR_FIR_NUM_OF_TAPS values are always contiguous
+  int32_t fir_history[2U * DECIMATOR_FIR_NUM_OF_TAPS];
+};
+
+struct decimator
+{
+  uint32_t cic_ratio;
+  int64_t cic_gain;
+  uint8_t num_of_channels;
+  // Input values since the last CIC output and CIC outputs since the last FIR output
+  uint32_t cic_phase;
+  uint32_t fir_phase;
+  // Position of the oldest value in the FIR history
+  uint32_t fir_index;
+  struct decimatorChannel channels[DECIMATOR_MAX_CHANNELS];
+};
+
+// Function prototypes
+/**
+ * @brief Set up a decimator and clear its state
+ *
+ * @param decimator The decimator
+ * @param ratio The number of input frames per output frame, a multiple of DECIMATOR_FIR_RATIO up to
+ *              DECIMATOR_MAX_RATIO
+ * @param num_of_channels The number of values per frame, up to DECIMATOR_MAX_CHANNELS
+ * @return true if the decimator has been set up, false if the arguments are invalid
+ */
+bool decimator_init(struct decimator* decimator, uint32_t ratio, uint8_t num_of_channels);
+
+/**
+ * @brief Push an input frame through the filter chain
+ *
+ * @param decimator The decimator
+ * @param input The input frame, num_of_channels values
+ * @param output The output frame, num_of_channels values, only written when an output frame is produced
+ * @return true if an output frame has been produced, i.e. once every ratio input frames
+ */
+bool decimator_push(struct decimator* decimator, const int32_t* input, int32_t* output);
+
+
+#endif /* DECIMATOR_H */
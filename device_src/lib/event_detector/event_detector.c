@@ -0,0 +1,103 @@
+#include "event_detector.h"
+
+#include <stddef.h>
+#include <string.h>
+
+bool event_detector_init(struct eventDetector* detector, uint8_t num_of_channels)
+{
+  if (num_of_channels == 0U || num_of_channels > EVENT_DETECTOR_MAX_CHANNELS)
+  {
+    return false;
+  }
+  memset(detector, 0, sizeof(*detector));
+  detector->num_of_channels = num_of_channels;
+  return true;
+}
+
+bool event_detector_set_channel(struct eventDetector* detector, uint8_t channel, uint8_t polarity, int32_t threshold, uint32_t hysteresis)
+{
+  if (channel >= detector->num_of_channels || polarity > EVENT_POLARITY_ABSOLUTE ||
+      (polarity == EVENT_POLARITY_ABSOLUTE && threshold < 0))
+  {
+    return false;
+  }
+  struct eventDetectorChannel* c = &detector->channels[channel];
+  memset(c, 0, sizeof(*c));
+  c->polarity = polarity;
+  c->threshold = threshold;
+  c->hysteresis = hysteresis;
+  return true;
+}
+
+bool event_detector_enabled(const struct eventDetector* detector)
+{
+  for (uint8_t c = 0; c < detector->num_of_channels; c++)
+  {
+    if (detector->channels[c].polarity != EVENT_POLARITY_NONE)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint8_t event_detector_push(struct eventDetector* detector, const int32_t* input, uint32_t timestamp_us, struct eventRecord* output)
+{
+  uint8_t num_of_records = 0;
+  for (uint8_t c = 0; c < detector->num_of_channels; c++)
+  {
+    struct eventDetectorChannel* channel = &detector->channels[c];
+    int32_t value = input[c];
+    // The level is how far the value is in the direction of the polarity, so the detection below only looks
+    // above the threshold, in 64 bits so that neither the magnitude nor the hysteresis overflow
+    int64_t level;
+    int64_t threshold = channel->threshold;
+    switch (channel->polarity)
+    {
+      case EVENT_POLARITY_ABOVE:
+        level = value;
+        break;
+      case EVENT_POLARITY_BELOW:
+        level = -(int64_t) value;
+        threshold = -threshold;
+        break;
+      case EVENT_POLARITY_ABSOLUTE:
+        level = (value < 0) ? -(int64_t) value : value;
+        break;
+      default:
+        continue;
+    }
+
+    if (!channel->in_event)
+    {
+      if (level > threshold)
+      {
+        channel->in_event = true;
+        channel->peak_level = level;
+        channel->peak_value = value;
+        channel->start_timestamp_us = timestamp_us;
+        channel->peak_timestamp_us = timestamp_us;
+      }
+      continue;
+    }
+    if (level > channel->peak_level)
+    {
+      channel->peak_level = level;
+      channel->peak_value = value;
+      channel->peak_timestamp_us = timestamp_us;
+    }
+    if (level < threshold - (int64_t) channel->hysteresis)
+    {
+      struct eventRecord* record = &output[num_of_records++];
+      record->start_timestamp_us = channel->start_timestamp_us;
+      record->duration_us = timestamp_us - channel->start_timestamp_us;
+      record->peak_value = channel->peak_value;
+      record->peak_offset_us = channel->peak_timestamp_us - channel->start_timestamp_us;
+      record->channel = c;
+      record->polarity = channel->polarity;
+      record->reserved = 0;
+      channel->in_event = false;
+    }
+  }
+  return num_of_records;
+}
@@ -0,0 +1,101 @@
+#ifndef EVENT_DETECTOR_H
+#define EVENT_DETECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Per-channel event detection with hysteresis, a compare or two per value:
+ *
+ * An event starts when a value goes past the threshold of its channel, in the direction given by the
+ * polarity, and ends when a value is back by more than the hysteresis, so that noise around the threshold
+ * doesn't split an event up. While an event lasts its peak, the value furthest past the threshold, is kept.
+ * Once it ends a struct eventRecord is produced, an event still going on when sampling stops is never reported.
+ *
+ * Every channel is set up on its own, the ones left at EVENT_POLARITY_NONE are ignored.
+ */
+#define EVENT_DETECTOR_MAX_CHANNELS   8U
+
+// Same values as EventPolarity in main.proto
+enum eventPolarity
+{
+  EVENT_POLARITY_NONE = 0,      // Channel ignored
+  EVENT_POLARITY_ABOVE = 1,     // From a value above the threshold until one below threshold - hysteresis
+  EVENT_POLARITY_BELOW = 2,     // From a value below the threshold until one above threshold + hysteresis
+  EVENT_POLARITY_ABSOLUTE = 3,  // ABOVE on the magnitude of the values, e.g. overload in both directions
+};
+
+// An event, the record sent to the host, little-endian, records of different channels are back to back
+struct eventRecord
+{
+  uint32_t start_timestamp_us;  // Device time of the first value past the threshold
+  uint32_t duration_us;         // Until the first value back past the hysteresis
+  int32_t peak_value;           // Signed, for EVENT_POLARITY_ABSOLUTE as well
+  uint32_t peak_offset_us;      // Time from the start to the peak
+  uint8_t channel;              // Index of the value in the frame
+  uint8_t polarity;
+  uint16_t reserved;
+};
+
+struct eventDetectorChannel
+{
+  uint8_t polarity;
+  int32_t threshold;
+  uint32_t hysteresis;
+  // State of the current event
+  bool in_event;
+  int64_t peak_level;
+  int32_t peak_value;
+  uint32_t start_timestamp_us;
+  uint32_t peak_timestamp_us;
+};
+
+struct eventDetector
+{
+  uint8_t num_of_channels;
+  struct eventDetectorChannel channels[EVENT_DETECTOR_MAX_CHANNELS];
+};
+
+// Function prototypes
+/**
+ * @brief Set up an event detector with every channel ignored
+ *
+ * @param detector The event detector
+ * @param num_of_channels The number of values per frame, up to EVENT_DETECTOR_MAX_CHANNELS
+ * @return true if the event detector has been set up, false if the arguments are invalid
+ */
+bool event_detector_init(struct eventDetector* detector, uint8_t num_of_channels);
+
+/**
+ * @brief Set up the detection on a channel, any event in progress on it is dropped
+ *
+ * @param detector The event detector
+ * @param channel The channel, below num_of_channels
+ * @param polarity One of enum eventPolarity, EVENT_POLARITY_NONE to ignore the channel
+ * @param threshold The level an event starts past
+ * @param hysteresis How far back past the threshold a value has to be for the event to end
+ * @return true if the channel has been set up, false if the arguments are invalid
+ */
+bool event_detector_set_channel(struct eventDetector* detector, uint8_t channel, uint8_t polarity, int32_t threshold, uint32_t hysteresis);
+
+/**
+ * @brief Whether any channel is watched
+ *
+ * @param detector The event detector
+ * @return true if at least one channel isn't EVENT_POLARITY_NONE
+ */
+bool event_detector_enabled(const struct eventDetector* detector);
+
+/**
+ * @brief Run the detection on a frame
+ *
+ * @param detector The event detector
+ * @param input The frame, num_of_channels values
+ * @param timestamp_us The device time of the frame
+ * @param output The records of the events which ended with this frame, up to num_of_channels entries
+ * @return The number of records written to output
+ */
+uint8_t event_detector_push(struct eventDetector* detector, const int32_t* input, uint32_t timestamp_us, struct eventRecord* output);
+
+
+#endif /* EVENT_DETECTOR_H */
@@ -0,0 +1,36 @@
+#include "metrics.h"
+
+#include <stddef.h>
+#include <string.h>
+
+void metrics_histogram_init(struct metricsHistogram* histogram, uint32_t origin, uint32_t bin_width)
+{
+  memset(histogram, 0, sizeof(*histogram));
+  histogram->origin = origin;
+  histogram->bin_width = (bin_width > 0U) ? bin_width : 1U;
+  histogram->min = UINT32_MAX;
+}
+
+void metrics_histogram_add(struct metricsHistogram* histogram, uint32_t value)
+{
+  uint32_t bin = 0;
+  if (value >= histogram->origin)
+  {
+    bin = (value - histogram->origin) / histogram->bin_width;
+    if (bin >= METRICS_HISTOGRAM_NUM_OF_BINS)
+    {
+      bin = METRICS_HISTOGRAM_NUM_OF_BINS - 1U;
+    }
+  }
+  histogram->bins[bin]++;
+  histogram->count++;
+  histogram->sum += value;
+  if (value < histogram->min)
+  {
+    histogram->min = value;
+  }
+  if (value > histogram->max)
+  {
+    histogram->max = value;
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Histograms cheap enough to be kept in interrupt context:
+ *
+ * A histogram has METRICS_HISTOGRAM_NUM_OF_BINS bins of bin_width starting at origin, the first bin also
+ * counts the values below origin and the last one the values past the end, so nothing is lost. Adding a value
+ * takes a division, which the RP2040 does in hardware, and a few compares. Count, minimum, maximum and sum
+ * are kept along, the sum in 64 bits so that it doesn't wrap in practice.
+ *
+ * A histogram is only written by one core, reads from the other core may see a value added halfway, which
+ * is fine for reporting.
+ */
+#define METRICS_HISTOGRAM_NUM_OF_BINS  16U
+
+struct metricsHistogram
+{
+  uint32_t origin;
+  uint32_t bin_width;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t bins[METRICS_HISTOGRAM_NUM_OF_BINS];
+};
+
+// Function prototypes
+/**
+ * @brief Set up a histogram and clear it
+ *
+ * @param histogram The histogram
+ * @param origin The lower edge of the first bin
+ * @param bin_width The width of every bin, 0 is taken as 1
+ */
+void metrics_histogram_init(struct metricsHistogram* histogram, uint32_t origin, uint32_t bin_width);
+
+/**
+ * @brief Add a value to a histogram
+ *
+ * @param histogram The histogram
+ * @param value The value
+ */
+void metrics_histogram_add(struct metricsHistogram* histogram, uint32_t value);
+
+
+#endif /* METRICS_H */
@@ -0,0 +1,142 @@
+#include "sample_codec.h"
+
+#include <stddef.h>
+
+// Bits of output buffered by the bit writer, never more than 7 in between two values
+struct bitWriter
+{
+  uint8_t* dst;
+  uint32_t bits;
+  uint32_t num_of_bits;
+};
+
+static uint32_t get_value_le(const uint8_t* buf, uint8_t value_size)
+{
+  uint32_t value = (uint32_t) buf[0] | ((uint32_t) buf[1] << 8);
+  if (value_size == 4U)
+  {
+    value |= ((uint32_t) buf[2] << 16) | ((uint32_t) buf[3] << 24);
+  }
+  return value;
+}
+
+static void put_value_le(uint8_t* buf, uint32_t value, uint8_t value_size)
+{
+  for (uint8_t i = 0; i < value_size; i++)
+  {
+    buf[i] = (uint8_t) (value >> (8U * i));
+  }
+}
+
+// Difference to the previous value modulo 2^(8 * value_size), zigzag encoded
+static uint32_t zigzag_delta(uint32_t value, uint32_t previous, uint8_t value_size)
+{
+  uint32_t delta = value - previous;
+  if (value_size == 2U)
+  {
+    // Sign extend, so that a wrap around of the 16-bit value is a small delta as well
+    delta = (uint32_t) (int32_t) (int16_t) delta;
+  }
+  return (delta << 1) ^ (uint32_t) ((int32_t) delta >> 31);
+}
+
+// Number of bits up to and including the highest set one, done with a loop rather than __builtin_clz()
+// which the Cortex-M0+ has no instruction for, it only runs once per channel
+static uint8_t bit_width(uint32_t value)
+{
+  uint8_t width = 0;
+  while (value != 0U)
+  {
+    value >>= 1;
+    width++;
+  }
+  return width;
+}
+
+// value has at most width bits, values wider than 16 bits are written in two halves so that
+// the buffered bits always fit into 32 bits
+static void put_bits(struct bitWriter* writer, uint32_t value, uint8_t width)
+{
+  if (width > 16U)
+  {
+    put_bits(writer, value & 0xFFFFU, 16U);
+    value >>= 16;
+    width -= 16U;
+  }
+  writer->bits |= value << writer->num_of_bits;
+  writer->num_of_bits += width;
+  while (writer->num_of_bits >= 8U)
+  {
+    *writer->dst++ = (uint8_t) writer->bits;
+    writer->bits >>= 8;
+    writer->num_of_bits -= 8U;
+  }
+}
+
+static void flush_bits(struct bitWriter* writer)
+{
+  if (writer->num_of_bits > 0U)
+  {
+    *writer->dst++ = (uint8_t) writer->bits;
+  }
+  writer->bits = 0;
+  writer->num_of_bits = 0;
+}
+
+uint32_t sample_codec_encode(uint8_t* dst, uint32_t dst_size, const uint8_t* frames, uint32_t num_of_frames,
+                             uint8_t num_of_channels, uint8_t value_size)
+{
+  if (num_of_frames == 0U || num_of_frames > UINT16_MAX || num_of_channels == 0U ||
+      (value_size != 2U && value_size != 4U) || dst_size < SAMPLE_CODEC_HEADER_SIZE)
+  {
+    return 0;
+  }
+  uint32_t frame_size = (uint32_t) num_of_channels * value_size;
+
+  dst[0] = (uint8_t) num_of_frames;
+  dst[1] = (uint8_t) (num_of_frames >> 8);
+  dst[2] = num_of_channels;
+  dst[3] = value_size;
+  uint32_t encoded_size = SAMPLE_CODEC_HEADER_SIZE;
+
+  for (uint8_t channel = 0; channel < num_of_channels; channel++)
+  {
+    const uint8_t* src = &frames[(uint32_t) channel * value_size];
+
+    // First pass for the bit width, ORing the deltas together gives the same highest bit as their maximum
+    uint32_t first = get_value_le(src, value_size);
+    uint32_t previous = first;
+    uint32_t deltas_or = 0;
+    for (uint32_t i = 1; i < num_of_frames; i++)
+    {
+      uint32_t value = get_value_le(&src[i * frame_size], value_size);
+      deltas_or |= zigzag_delta(value, previous, value_size);
+      previous = value;
+    }
+    uint8_t width = bit_width(deltas_or);
+
+    uint32_t channel_size = value_size + 1U + ((num_of_frames - 1U) * width + 7U) / 8U;
+    if (encoded_size + channel_size > dst_size)
+    {
+      return 0;
+    }
+    put_value_le(&dst[encoded_size], first, value_size);
+    dst[encoded_size + value_size] = width;
+
+    // Second pass to pack the deltas
+    struct bitWriter writer = {.dst = &dst[encoded_size + value_size + 1U], .bits = 0, .num_of_bits = 0};
+    if (width > 0U)
+    {
+      previous = first;
+      for (uint32_t i = 1; i < num_of_frames; i++)
+      {
+        uint32_t value = get_value_le(&src[i * frame_size], value_size);
+        put_bits(&writer, zigzag_delta(value, previous, value_size), width);
+        previous = value;
+      }
+      flush_bits(&writer);
+    }
+    encoded_size += channel_size;
+  }
+  return encoded_size;
+}
@@ -0,0 +1,45 @@
+#ifndef SAMPLE_CODEC_H
+#define SAMPLE_CODEC_H
+
+#include <stdint.h>
+
+/*
+ * Compressed block of sample frames, every field is little-endian:
+ *
+ *   num_of_frames     2 bytes
+ *   num_of_channels   1 byte, number of values per frame
+ *   value_size        1 byte, size of a value in bytes, 2 or 4
+ *   then per channel, in the order of the values in the frame:
+ *     first value     value_size bytes, as in the frame
+ *     bit width       1 byte, 0 to 8 * value_size
+ *     deltas          (num_of_frames - 1) * bit width bits, least significant bit first, padded to a byte
+ *
+ * Each delta is the difference to the previous value of the channel modulo 2^(8 * value_size), zigzag
+ * encoded so that small negative deltas take as few bits as small positive ones. The bit width is the
+ * smallest one which holds every delta of the channel in the block, i.e. frame-of-reference packing with
+ * the previous value as the reference. Slowly changing signals, e.g. load cells, take a few bits per value
+ * rather than 16 or 32.
+ *
+ * Only integer adds, shifts and ORs per value, so it is cheap enough for the Cortex-M0+.
+ */
+#define SAMPLE_CODEC_HEADER_SIZE  4U
+
+// Function prototypes
+/**
+ * @brief Compress a block of sample frames
+ *
+ * The frames are read byte by byte, so they don't have to be aligned.
+ *
+ * @param dst The buffer for the compressed block
+ * @param dst_size The size of dst in bytes, the encoder gives up as soon as the compressed block doesn't fit
+ * @param frames The frames, back to back, num_of_channels values of value_size bytes each
+ * @param num_of_frames The number of frames, 1 to UINT16_MAX
+ * @param num_of_channels The number of values per frame
+ * @param value_size The size of a value in bytes, 2 or 4
+ * @return The size of the compressed block in bytes, 0 if it doesn't fit into dst or the arguments are invalid
+ */
+uint32_t sample_codec_encode(uint8_t* dst, uint32_t dst_size, const uint8_t* frames, uint32_t num_of_frames,
+                             uint8_t num_of_channels, uint8_t value_size);
+
+
+#endif /* SAMPLE_CODEC_H */
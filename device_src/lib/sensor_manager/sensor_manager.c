@@ -1,6 +1,10 @@
 #include "sensor_manager.h"
 #include "ad7606b.h"
 
+// State of the test pattern sensor, only touched by the sampler
+static uint32_t test_pattern_counter = 0;
+static uint32_t test_pattern_lfsr = TEST_PATTERN_LFSR_SEED;
+
 void adc_sample_func(int32_t* dest_buf, uint8_t* elementsTransferred, uint8_t active_adc_chan)
 {
   ad7606b_sample(dest_buf, elementsTransferred, active_adc_chan);
@@ -14,8 +18,28 @@ sensor_sample_func get_sensor_sample_func(const struct Sensor* sensor)
     case MBA500_LOAD_CELL_SENSOR:
       return NULL; // Return NULL as it uses the ADC to sample
       break;
+    case TEST_PATTERN_SENSOR:
+      return test_pattern_sample_func;
+      break;
     default:
       return ((void *) 0);
   }
 
 }
+
+void test_pattern_sample_func(int32_t* dest_buf, uint8_t* elementsTransferred)
+{
+  dest_buf[*elementsTransferred] = (int32_t) test_pattern_counter;
+  dest_buf[*elementsTransferred + 1] = (int32_t) test_pattern_lfsr;
+  *elementsTransferred += TEST_PATTERN_NUM_OF_VALUES;
+
+  test_pattern_counter++;
+  // Galois form, a shift and a conditional xor per sample
+  test_pattern_lfsr = (test_pattern_lfsr >> 1) ^ ((test_pattern_lfsr & 1U) ? TEST_PATTERN_LFSR_TAPS : 0U);
+}
+
+void test_pattern_reset(void)
+{
+  test_pattern_counter = 0;
+  test_pattern_lfsr = TEST_PATTERN_LFSR_SEED;
+}
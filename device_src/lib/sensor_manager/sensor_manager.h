@@ -7,7 +7,8 @@
 // Enum to represent different types of sensors
 enum sensorFamily
 {
-  MBA500_LOAD_CELL_SENSOR
+  MBA500_LOAD_CELL_SENSOR,
+  TEST_PATTERN_SENSOR // Synthetic sensor for checking the data path end to end, see test_pattern_sample_func()
 };
 
 // Struct to describe a sensor
@@ -31,6 +32,14 @@ struct connectedSensors
 // A pointer which points to the sample function of a particular sensor
 typedef void (*sensor_sample_func)(int32_t* dest_buf, uint8_t* elementsTransferred);
 
+// Values appended by the test pattern sensor per sample, a 32-bit counter followed by a 32-bit LFSR
+#define TEST_PATTERN_NUM_OF_VALUES  2
+
+// Taps of the Galois LFSR of the test pattern sensor, x^32 + x^22 + x^2 + x + 1, which is maximal length
+// so it only repeats after 2^32 - 1 samples, and its initial state
+#define TEST_PATTERN_LFSR_TAPS      0x80200003U
+#define TEST_PATTERN_LFSR_SEED      0xACE1ACE1U
+
 // Function prototypes
 
 /**
@@ -50,5 +59,20 @@ void adc_sample_func(int32_t* dest_buf, uint8_t* elementsTransferred, uint8_t ac
  */
 sensor_sample_func get_sensor_sample_func(const struct Sensor* sensor);
 
+/**
+ * @brief Sample the test pattern sensor, which appends the sample counter and the state of the LFSR, then
+ * advances both, so that the host can tell exactly which sample it has received without the ADC being involved
+ *
+ * @param dest_buf A pointer to the starting address of the destination buffer
+ * @param elementsTransferred The number of existing elements in the destination buffer, incremented by TEST_PATTERN_NUM_OF_VALUES
+ */
+void test_pattern_sample_func(int32_t* dest_buf, uint8_t* elementsTransferred);
+
+/**
+ * @brief Restart the test pattern from sample 0, i.e. a counter of 0 and an LFSR at TEST_PATTERN_LFSR_SEED, called
+ * before a stream starts
+ */
+void test_pattern_reset(void);
+
 
 #endif /* SENSOR_MANAGER_h */
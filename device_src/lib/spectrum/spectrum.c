@@ -0,0 +1,259 @@
+#include "spectrum.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Length of a full turn in the sine table, the largest complex FFT takes SPECTRUM_MAX_SIZE / 2 points and
+// the split step turns by 2 * pi / SPECTRUM_MAX_SIZE, so this is the finest angle ever needed
+#define SPECTRUM_TURN   SPECTRUM_MAX_SIZE
+
+// First quarter of sin(2 * pi * i / SPECTRUM_TURN), Q15, the other quarters follow by symmetry
+static const int16_t spectrum_sine_table[SPECTRUM_TURN / 4U + 1U] =
+{
+  0, 402, 804, 1206, 1608, 2009, 2410, 2811, 3212, 3612, 4011, 4410, 4808, 5205, 5602, 5998,
+  6393, 6786, 7179, 7571, 7962, 8351, 8739, 9126, 9512, 9896, 10278, 10659, 11039, 11417, 11793, 12167,
+  12539, 12910, 13279, 13645, 14010, 14372, 14732, 15090, 15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869,
+  18204, 18537, 18868, 19195, 19519, 19841, 20159, 20475, 20787, 21096, 21403, 21705, 22005, 22301, 22594, 22884,
+  23170, 23452, 23731, 24007, 24279, 24547, 24811, 25072, 25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019,
+  27245, 27466, 27683, 27896, 28105, 28310, 28510, 28706, 28898, 29085, 29268, 29447, 29621, 29791, 29956, 30117,
+  30273, 30424, 30571, 30714, 30852, 30985, 31113, 31237, 31356, 31470, 31580, 31685, 31785, 31880, 31971, 32057,
+  32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567, 32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765,
+  32767,
+};
+
+// sin(2 * pi * index / SPECTRUM_TURN), Q15
+static int32_t sine_q15(uint32_t index)
+{
+  const uint32_t quarter = SPECTRUM_TURN / 4U;
+  index %= SPECTRUM_TURN;
+  uint32_t offset = index % quarter;
+  switch (index / quarter)
+  {
+    case 0:
+      return spectrum_sine_table[offset];
+    case 1:
+      return spectrum_sine_table[quarter - offset];
+    case 2:
+      return -spectrum_sine_table[offset];
+    default:
+      return -spectrum_sine_table[quarter - offset];
+  }
+}
+
+// cos(2 * pi * index / SPECTRUM_TURN), Q15
+static int32_t cosine_q15(uint32_t index)
+{
+  return sine_q15(index + SPECTRUM_TURN / 4U);
+}
+
+bool spectrum_init(struct spectrum* spectrum, uint32_t fft_size, uint8_t num_of_channels, uint8_t num_of_peaks)
+{
+  if (fft_size < SPECTRUM_MIN_SIZE || fft_size > SPECTRUM_MAX_SIZE || (fft_size & (fft_size - 1U)) != 0U ||
+      num_of_channels == 0U || num_of_channels > SPECTRUM_MAX_CHANNELS || num_of_peaks > SPECTRUM_MAX_PEAKS)
+  {
+    return false;
+  }
+  memset(spectrum, 0, sizeof(*spectrum));
+  spectrum->fft_size = fft_size;
+  spectrum->num_of_channels = num_of_channels;
+  spectrum->num_of_peaks = num_of_peaks;
+  return true;
+}
+
+bool spectrum_push(struct spectrum* spectrum, const int32_t* input)
+{
+  if (spectrum->num_of_frames == 0U)
+  {
+    memset(spectrum->clipped, 0, sizeof(spectrum->clipped));
+  }
+  for (uint8_t c = 0; c < spectrum->num_of_channels; c++)
+  {
+    int32_t value = input[c];
+    if (value > INT16_MAX || value < INT16_MIN)
+    {
+      // At most SPECTRUM_MAX_SIZE per window, so the count can't overflow
+      spectrum->clipped[c]++;
+      value = (value > INT16_MAX) ? INT16_MAX : INT16_MIN;
+    }
+    spectrum->input[c][spectrum->num_of_frames] = (int16_t) value;
+  }
+  spectrum->num_of_frames++;
+  if (spectrum->num_of_frames < spectrum->fft_size)
+  {
+    return false;
+  }
+  spectrum->num_of_frames = 0;
+  return true;
+}
+
+// In-place radix-2 decimation in time FFT of num_of_points complex values, scaled by 1 / num_of_points
+// Halving every stage keeps the magnitude of the values at most that of the largest input, so inputs of at
+// most 2^14 per part can't overflow, and every product is a 16 by 16 bits multiplication
+static void complex_fft(int16_t* values, uint32_t num_of_points)
+{
+  // Bit reversed order
+  for (uint32_t i = 1, j = 0; i < num_of_points; i++)
+  {
+    uint32_t bit = num_of_points >> 1;
+    for (; (j & bit) != 0U; bit >>= 1)
+    {
+      j ^= bit;
+    }
+    j |= bit;
+    if (i < j)
+    {
+      int16_t re = values[2U * i];
+      int16_t im = values[2U * i + 1U];
+      values[2U * i] = values[2U * j];
+      values[2U * i + 1U] = values[2U * j + 1U];
+      values[2U * j] = re;
+      values[2U * j + 1U] = im;
+    }
+  }
+
+  for (uint32_t length = 2; length <= num_of_points; length <<= 1)
+  {
+    uint32_t half = length >> 1;
+    uint32_t step = SPECTRUM_TURN / length;
+    for (uint32_t k = 0; k < half; k++)
+    {
+      // exp(-j * 2 * pi * k / length)
+      int32_t cosine = cosine_q15(k * step);
+      int32_t sine = sine_q15(k * step);
+      for (uint32_t i = k; i < num_of_points; i += length)
+      {
+        int16_t* a = &values[2U * i];
+        int16_t* b = &values[2U * (i + half)];
+        int32_t t_re = ((int32_t) b[0] * cosine + (int32_t) b[1] * sine) >> 15;
+        int32_t t_im = ((int32_t) b[1] * cosine - (int32_t) b[0] * sine) >> 15;
+        int32_t a_re = a[0];
+        int32_t a_im = a[1];
+        // Rounded halving
+        a[0] = (int16_t) ((a_re + t_re + 1) >> 1);
+        a[1] = (int16_t) ((a_im + t_im + 1) >> 1);
+        b[0] = (int16_t) ((a_re - t_re + 1) >> 1);
+        b[1] = (int16_t) ((a_im - t_im + 1) >> 1);
+      }
+    }
+  }
+}
+
+// Integer square root, rounded down
+static uint32_t isqrt32(uint32_t value)
+{
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Magnitudes of bins 0 to fft_size / 2 of a channel
+static void transform(struct spectrum* spectrum, uint8_t channel)
+{
+  const int16_t* input = spectrum->input[channel];
+  int16_t* work = spectrum->work;
+  uint32_t fft_size = spectrum->fft_size;
+  uint32_t num_of_points = fft_size / 2U;
+  uint32_t window_step = SPECTRUM_TURN / fft_size;
+
+  // Hann window, Q15, the extra shift halves the values so that they fit into the FFT headroom
+  // The even values are the real parts and the odd ones the imaginary parts, as a real FFT of fft_size
+  // values is a complex FFT of fft_size / 2 values followed by a split step
+  for (uint32_t n = 0; n < fft_size; n++)
+  {
+    int32_t window = (32768 - cosine_q15(n * window_step)) >> 1;
+    work[n] = (int16_t) (((int32_t) input[n] * window) >> 16);
+  }
+  complex_fft(work, num_of_points);
+
+  // Split the spectrum of the even and odd values, Z[k] = E[k] + j * O[k], and combine them
+  // X[k] = E[k] + exp(-j * 2 * pi * k / fft_size) * O[k]
+  for (uint32_t k = 0; k <= num_of_points; k++)
+  {
+    uint32_t mirror = (num_of_points - k) % num_of_points;
+    int32_t a = work[2U * (k % num_of_points)];
+    int32_t b = work[2U * (k % num_of_points) + 1U];
+    int32_t c = work[2U * mirror];
+    int32_t d = work[2U * mirror + 1U];
+    int32_t even_re = (a + c) >> 1;
+    int32_t even_im = (b - d) >> 1;
+    int32_t odd_re = (b + d) >> 1;
+    int32_t odd_im = (c - a) >> 1;
+    int32_t cosine = cosine_q15(k * window_step);
+    int32_t sine = sine_q15(k * window_step);
+    int32_t re = even_re + ((odd_re * cosine + odd_im * sine) >> 15);
+    int32_t im = even_im + ((odd_im * cosine - odd_re * sine) >> 15);
+    spectrum->magnitudes[k] = (uint16_t) isqrt32((uint32_t) (re * re) + (uint32_t) (im * im));
+  }
+}
+
+static uint8_t* put_uint16(uint8_t* buffer, uint16_t value)
+{
+  buffer[0] = (uint8_t) value;
+  buffer[1] = (uint8_t) (value >> 8);
+  return buffer + 2;
+}
+
+uint32_t spectrum_record(struct spectrum* spectrum, uint8_t channel, uint8_t* record)
+{
+  transform(spectrum, channel);
+  uint32_t num_of_bins = spectrum->fft_size / 2U + 1U;
+  const uint16_t* magnitudes = spectrum->magnitudes;
+
+  uint8_t* p = put_uint16(record, (uint16_t) spectrum->fft_size);
+  *p++ = channel;
+  *p++ = spectrum->num_of_peaks;
+  p = put_uint16(p, spectrum->clipped[channel]);
+  if (spectrum->num_of_peaks == 0U)
+  {
+    for (uint32_t k = 0; k < num_of_bins; k++)
+    {
+      p = put_uint16(p, magnitudes[k]);
+    }
+    return (uint32_t) (p - record);
+  }
+
+  // Strongest local maxima, sorted by insertion as there are only a few of them
+  uint16_t peak_bins[SPECTRUM_MAX_PEAKS] = {0};
+  uint16_t peak_magnitudes[SPECTRUM_MAX_PEAKS] = {0};
+  uint8_t num_of_peaks = spectrum->num_of_peaks;
+  for (uint32_t k = 1; k < num_of_bins; k++)
+  {
+    uint16_t magnitude = magnitudes[k];
+    if (magnitude == 0U || magnitude <= magnitudes[k - 1U] ||
+        (k + 1U < num_of_bins && magnitude < magnitudes[k + 1U]) ||
+        magnitude <= peak_magnitudes[num_of_peaks - 1U])
+    {
+      continue;
+    }
+    uint32_t i = num_of_peaks - 1U;
+    for (; i > 0U && peak_magnitudes[i - 1U] < magnitude; i--)
+    {
+      peak_bins[i] = peak_bins[i - 1U];
+      peak_magnitudes[i] = peak_magnitudes[i - 1U];
+    }
+    peak_bins[i] = (uint16_t) k;
+    peak_magnitudes[i] = magnitude;
+  }
+  for (uint32_t i = 0; i < num_of_peaks; i++)
+  {
+    p = put_uint16(p, peak_bins[i]);
+    p = put_uint16(p, peak_magnitudes[i]);
+  }
+  return (uint32_t) (p - record);
+}
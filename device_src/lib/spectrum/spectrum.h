@@ -0,0 +1,84 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Per-channel magnitude spectrum over consecutive windows of fft_size frames, all in fixed point:
+ *
+ *   input -> Hann window -> real FFT, as a complex radix-2 FFT of fft_size / 2 points plus a split step
+ *         -> magnitude of bins 0 to fft_size / 2
+ *
+ * The values are 16-bit, larger ones are clamped and counted in the record of their window. The complex FFT runs on int16 values with Q15 twiddles, so
+ * every multiplication is a single 32-bit one, and halves every stage so that nothing overflows. The
+ * magnitudes are those of the true transform divided by fft_size, a sine of amplitude A peaks at about A / 4.
+ *
+ * A record is produced per channel and window, every field is little-endian:
+ *
+ *   fft_size       2 bytes
+ *   channel        1 byte, index of the value in the frame
+ *   num_of_peaks   1 byte, 0 for all the bins
+ *   clipped        2 bytes, values of the channel in the window which were clamped to 16 bits
+ *   bins           num_of_peaks = 0 : fft_size / 2 + 1 magnitudes of 2 bytes, from DC up to half the rate
+ *                  otherwise : num_of_peaks pairs of a 2 bytes bin and a 2 bytes magnitude, the strongest
+ *                  local maxima above DC first, unused pairs are 0
+ */
+#define SPECTRUM_MIN_SIZE             16U
+#define SPECTRUM_MAX_SIZE             512U
+#define SPECTRUM_MAX_CHANNELS         8U
+#define SPECTRUM_MAX_PEAKS            32U
+#define SPECTRUM_RECORD_HEADER_SIZE   6U
+#define SPECTRUM_RECORD_MAX_SIZE      (SPECTRUM_RECORD_HEADER_SIZE + (SPECTRUM_MAX_SIZE / 2U + 1U) * sizeof(uint16_t))
+
+struct spectrum
+{
+  uint32_t fft_size;
+  uint8_t num_of_channels;
+  uint8_t num_of_peaks;
+  // Frames of the current window so far
+  uint32_t num_of_frames;
+  // Values of each channel clamped to 16 bits in the current window
+  uint16_t clipped[SPECTRUM_MAX_CHANNELS];
+  int16_t input[SPECTRUM_MAX_CHANNELS][SPECTRUM_MAX_SIZE];
+  // fft_size / 2 complex values, real and imaginary parts interleaved
+  int16_t work[SPECTRUM_MAX_SIZE];
+  uint16_t magnitudes[SPECTRUM_MAX_SIZE / 2U + 1U];
+};
+
+// Function prototypes
+/**
+ * @brief Set up a spectrum and start the first window
+ *
+ * @param spectrum The spectrum
+ * @param fft_size The number of frames per window, a power of two from SPECTRUM_MIN_SIZE to SPECTRUM_MAX_SIZE
+ * @param num_of_channels The number of values per frame, up to SPECTRUM_MAX_CHANNELS
+ * @param num_of_peaks The number of peaks per record, up to SPECTRUM_MAX_PEAKS, 0 for all the bins
+ * @return true if the spectrum has been set up, false if the arguments are invalid
+ */
+bool spectrum_init(struct spectrum* spectrum, uint32_t fft_size, uint8_t num_of_channels, uint8_t num_of_peaks);
+
+/**
+ * @brief Add a frame to the current window
+ *
+ * Values beyond 16 bits are clamped, and counted in the clipped field of the records of the window.
+ *
+ * @param spectrum The spectrum
+ * @param input The frame, num_of_channels values
+ * @return true if the window is complete, its records have to be taken with spectrum_record() before the
+ *         next frame is added, which starts a new window
+ */
+bool spectrum_push(struct spectrum* spectrum, const int32_t* input);
+
+/**
+ * @brief Transform a channel of the complete window and write its record
+ *
+ * @param spectrum The spectrum
+ * @param channel The channel, below num_of_channels
+ * @param record The record buffer, at least SPECTRUM_RECORD_MAX_SIZE bytes
+ * @return The size of the record in bytes
+ */
+uint32_t spectrum_record(struct spectrum* spectrum, uint8_t channel, uint8_t* record);
+
+
+#endif /* SPECTRUM_H */
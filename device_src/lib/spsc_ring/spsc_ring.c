@@ -0,0 +1,68 @@
+#include "spsc_ring.h"
+
+#include <stddef.h>
+
+bool spsc_ring_init(struct spscRing* ring, void* storage, uint32_t slot_size, uint32_t num_of_slots)
+{
+  if (num_of_slots == 0U || (num_of_slots & (num_of_slots - 1U)) != 0U)
+  {
+    return false;
+  }
+  ring->slots = (uint8_t*) storage;
+  ring->slot_size = slot_size;
+  ring->mask = num_of_slots - 1U;
+  atomic_init(&ring->head, 0U);
+  atomic_init(&ring->tail, 0U);
+  return true;
+}
+
+void* spsc_ring_reserve(struct spscRing* ring)
+{
+  // The producer owns head, only the consumer's tail has to be acquired
+  uint32_t head = (uint32_t) atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint32_t tail = (uint32_t) atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail > ring->mask)
+  {
+    return NULL;
+  }
+  return &ring->slots[(head & ring->mask) * ring->slot_size];
+}
+
+void spsc_ring_commit(struct spscRing* ring)
+{
+  uint32_t head = (uint32_t) atomic_load_explicit(&ring->head, memory_order_relaxed);
+  // Publish the contents of the slot before the new head
+  atomic_store_explicit(&ring->head, head + 1U, memory_order_release);
+}
+
+const void* spsc_ring_peek(struct spscRing* ring)
+{
+  // The consumer owns tail, only the producer's head has to be acquired
+  uint32_t tail = (uint32_t) atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint32_t head = (uint32_t) atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (head == tail)
+  {
+    return NULL;
+  }
+  return &ring->slots[(tail & ring->mask) * ring->slot_size];
+}
+
+void spsc_ring_release(struct spscRing* ring)
+{
+  uint32_t tail = (uint32_t) atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  // Finish reading the slot before handing it back to the producer
+  atomic_store_explicit(&ring->tail, tail + 1U, memory_order_release);
+}
+
+void spsc_ring_discard(struct spscRing* ring)
+{
+  uint32_t head = (uint32_t) atomic_load_explicit(&ring->head, memory_order_acquire);
+  atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
+
+uint32_t spsc_ring_count(const struct spscRing* ring)
+{
+  uint32_t tail = (uint32_t) atomic_load_explicit(&ring->tail, memory_order_acquire);
+  uint32_t head = (uint32_t) atomic_load_explicit(&ring->head, memory_order_acquire);
+  return head - tail;
+}
@@ -0,0 +1,84 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Alignment of the producer and consumer indices, keeps them on separate cache lines on hosts with a
+// data cache, the RP2040 has none so this only costs a few bytes of padding
+#ifndef SPSC_RING_CACHE_LINE_SIZE
+#define SPSC_RING_CACHE_LINE_SIZE  32
+#endif
+
+/*
+ * A lock-free single-producer/single-consumer ring of fixed size slots.
+ *
+ * The producer reserves a slot, fills it in place and commits it. The consumer peeks at the oldest
+ * committed slot, reads it in place and releases it. Neither side copies data or enters a critical
+ * section, the indices are published with release/acquire ordering which is sufficient across the two
+ * RP2040 cores as well as across threads on a host. The producer and the consumer may each be a task
+ * or an interrupt handler, but there must only be one of each at any time.
+ */
+struct spscRing
+{
+  // Number of slots committed by the producer, free running, only written by the producer
+  _Alignas(SPSC_RING_CACHE_LINE_SIZE) atomic_uint_fast32_t head;
+  // Number of slots released by the consumer, free running, only written by the consumer
+  _Alignas(SPSC_RING_CACHE_LINE_SIZE) atomic_uint_fast32_t tail;
+  // Read-only after spsc_ring_init()
+  _Alignas(SPSC_RING_CACHE_LINE_SIZE) uint8_t* slots;
+  uint32_t slot_size;
+  uint32_t mask;
+};
+
+// Function prototypes
+/**
+ * @brief Initialise an empty ring over caller provided storage
+ *
+ * @param ring The ring to initialise
+ * @param storage The storage for the slots, at least slot_size * num_of_slots bytes
+ * @param slot_size The size of a slot in bytes
+ * @param num_of_slots The number of slots, it has to be a power of two
+ * @return true if the ring has been initialised, false if num_of_slots is not a power of two
+ */
+bool spsc_ring_init(struct spscRing* ring, void* storage, uint32_t slot_size, uint32_t num_of_slots);
+
+/**
+ * @brief Reserve the next free slot, producer only
+ *
+ * Calling it again before spsc_ring_commit() returns the same slot.
+ *
+ * @return The slot to fill in, NULL if the ring is full
+ */
+void* spsc_ring_reserve(struct spscRing* ring);
+
+/**
+ * @brief Commit the slot returned by spsc_ring_reserve() and make it visible to the consumer, producer only
+ */
+void spsc_ring_commit(struct spscRing* ring);
+
+/**
+ * @brief Get the oldest committed slot without removing it, consumer only
+ *
+ * @return The slot to read, NULL if the ring is empty
+ */
+const void* spsc_ring_peek(struct spscRing* ring);
+
+/**
+ * @brief Release the slot returned by spsc_ring_peek() back to the producer, consumer only
+ */
+void spsc_ring_release(struct spscRing* ring);
+
+/**
+ * @brief Release every committed slot at once, consumer only
+ */
+void spsc_ring_discard(struct spscRing* ring);
+
+/**
+ * @brief Get the number of committed slots which have not been released yet, it may be called from either side
+ */
+uint32_t spsc_ring_count(const struct spscRing* ring);
+
+
+#endif /* SPSC_RING_H */
@@ -0,0 +1,86 @@
+#ifndef STREAM_FRAME_H
+#define STREAM_FRAME_H
+
+#include <stdint.h>
+
+/*
+ * Frames of the sample stream, every field is little-endian:
+ *
+ *   sync          2 bytes, STREAM_FRAME_SYNC_0 then STREAM_FRAME_SYNC_1
+ *   type          1 byte, see enum streamFrameType
+ *   length        2 bytes, size of the payload in bytes
+ *   sequence      4 bytes, for data frames the index of the first sample frame in the payload, frames dropped
+ *                 by the device still take an index so that the host sees them as a gap
+ *   timestamp     4 bytes, device time in us, the low 32 bits of time_us_64(), for data frames the time the
+ *                 first sample frame was sampled at
+ *   payload       length bytes
+ *   crc           2 bytes, CRC-16/CCITT-FALSE over type, length, sequence, timestamp and payload
+ *
+ * The host looks for the sync bytes and checks the CRC, so it can resynchronise after corrupted or
+ * lost bytes no matter how USB splits or merges the frames.
+ */
+#define STREAM_FRAME_SYNC_0   0xA5U
+#define STREAM_FRAME_SYNC_1   0x5AU
+
+#define STREAM_FRAME_HEADER_SIZE  13U
+#define STREAM_FRAME_CRC_SIZE     2U
+#define STREAM_FRAME_OVERHEAD     (STREAM_FRAME_HEADER_SIZE + STREAM_FRAME_CRC_SIZE)
+
+// Longest payload the host accepts, a longer length field is treated as corruption
+#define STREAM_FRAME_MAX_PAYLOAD_SIZE  4096U
+
+enum streamFrameType
+{
+  STREAM_FRAME_TYPE_DATA = 0x01,      // Sample frames, in the frame format of the periodic sampler
+  STREAM_FRAME_TYPE_MESSAGE = 0x02,   // A DeviceToHostMessage, without the length prefix
+  STREAM_FRAME_TYPE_EOS = 0x03,       // End of stream, empty, the sequence is the number of sample frames produced
+  STREAM_FRAME_TYPE_DELTA = 0x04,     // Sample frames compressed into a block, see sample_codec.h
+  STREAM_FRAME_TYPE_AGGREGATE = 0x05, // Statistics records of windows of sample frames, see aggregator.h, the
+                                      // sequence is the index of the first record
+  STREAM_FRAME_TYPE_SPECTRUM = 0x06,  // Spectrum records, one per channel and window, see spectrum.h, the
+                                      // sequence is the index of the first record
+  STREAM_FRAME_TYPE_EVENT = 0x07,     // Event records, see event_detector.h, the sequence is the index of the
+                                      // first record
+};
+
+// Function prototypes
+/**
+ * @brief Write the header of a frame, the payload follows at frame + STREAM_FRAME_HEADER_SIZE
+ *
+ * @param frame The frame buffer, at least STREAM_FRAME_OVERHEAD + payload_size bytes
+ * @param type The frame type, see enum streamFrameType
+ * @param payload_size The size of the payload in bytes
+ * @param sequence The sequence number
+ * @param timestamp_us The timestamp in us
+ */
+void stream_frame_write_header(uint8_t* frame, uint8_t type, uint16_t payload_size, uint32_t sequence, uint32_t timestamp_us);
+
+/**
+ * @brief Append the CRC to a frame whose header and payload have been written
+ *
+ * It is kept separate from stream_frame_write_header() so that the CRC of a large payload can be
+ * computed outside of interrupt context.
+ *
+ * @return The size of the whole frame in bytes
+ */
+uint32_t stream_frame_seal(uint8_t* frame);
+
+/**
+ * @brief Encode a whole frame, i.e. header, a copy of the payload and the CRC
+ *
+ * @param frame The frame buffer
+ * @param frame_buf_size The size of the frame buffer in bytes
+ * @return The size of the frame in bytes, 0 if it doesn't fit into the frame buffer
+ */
+uint32_t stream_frame_encode(uint8_t* frame, uint32_t frame_buf_size, uint8_t type, uint32_t sequence, uint32_t timestamp_us,
+                             const void* payload, uint16_t payload_size);
+
+/**
+ * @brief Update a CRC-16/CCITT-FALSE, i.e. polynomial 0x1021, initial value 0xFFFF, not reflected
+ *
+ * @param crc The CRC so far, 0xFFFF to start a new one
+ */
+uint16_t stream_frame_crc16(uint16_t crc, const uint8_t* buf, uint32_t size);
+
+
+#endif /* STREAM_FRAME_H */
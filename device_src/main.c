@@ -9,9 +9,18 @@
 
 #include <stdio.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include "ad7606b.h"
 #include "sensor_manager.h"
+#include "spsc_ring.h"
+#include "stream_frame.h"
+#include "sample_codec.h"
+#include "decimator.h"
+#include "aggregator.h"
+#include "spectrum.h"
+#include "event_detector.h"
+#include "metrics.h"
 
 #include <SEGGER_RTT.h>
 
@@ -25,6 +34,7 @@
 #include <pb_decode.h>
 #include <pb_common.h>
 #include <main.pb.h>
+#include <main.fixed.h>
 
 // Default task stack size
 #define STACK_SIZE         128*4
@@ -41,18 +51,99 @@
 #define CDC_INGRESS_STACK_SIZE      256*2
 
 // Stack size for the cdc engress task
-// It has to be greater than the size of the msg_buf in task
-// Right now uint8_t msg_buf[256], so it has to be greater than 256
 #define CDC_EGRESS_STACK_SIZE      256*2
 
 // Stack size for the periodic sampler task
 #define PERIODIC_SAMPLER_STACK_SIZE     256
 
+// Stack size for the decimator task
+#define DECIMATOR_STACK_SIZE     256*2
+
 // Egress msg buffer size in bytes
 // #define EGRESS_MSG_BUF_SIZE  256*10
 
-// Egress stream buffer size in bytes
-#define EGRESS_STREAM_BUF_SIZE 256*10
+// Maximum number of frames batched into a sample block before it is handed to the egress path,
+// a block is also handed over early once it can't take another frame
+#define SAMPLE_BLOCK_MAX_FRAMES   256
+
+// Maximum size of a frame produced by the periodic sampler in bytes, one int32_t per channel
+#define SAMPLE_FRAME_MAX_SIZE   (8 * sizeof(int32_t))
+
+// Maximum size of a sample block in bytes
+#define SAMPLE_BLOCK_MAX_BYTES  (32 * SAMPLE_FRAME_MAX_SIZE)
+
+// A partially filled sample block is handed to the egress path once its first frame is older than this
+#define SAMPLE_BLOCK_FLUSH_TIMEOUT_US  10000U
+
+// Number of sample blocks in the egress ring, it has to be a power of two
+#define EGRESS_RING_NUM_OF_BLOCKS  8
+
+// Number of sample blocks in the ring between the periodic sampler and decimator_task_c0, it has to be a power of two
+#define DECIMATOR_RING_NUM_OF_BLOCKS  4
+
+// cdc_egress_task_c1 is woken up once this many blocks are pending in the egress ring
+#define EGRESS_TRIGGER_LEVEL  2
+
+// Fewer pending blocks than EGRESS_TRIGGER_LEVEL are sent once the oldest has been pending for this long
+#define EGRESS_DEADLINE_MS    5
+
+// ADC backend used by the periodic sampler, one of
+// AD7606B_BACKEND_BLOCKING : periodic_sampler_cb() converts and reads out the ADC in a blocking manner
+// AD7606B_BACKEND_DMA      : periodic_sampler_cb() only starts a conversion, the readout is done with DMA
+//                            on the falling edge of BUSY and handed to the egress path in adc_frame_cb()
+// AD7606B_BACKEND_PIO      : a PIO state machine paces the conversions and reads them out, no timer is used
+#define PERIODIC_SAMPLER_ADC_BACKEND AD7606B_BACKEND_DMA
+
+// PIO block used by the PIO ADC backend, pio0 is used by the CYW43 driver
+#define ADC_PIO_BLOCK   pio1
+
+// CDC port which carries the host-to-device messages and their replies
+#define CDC_ITF_CONTROL  0
+
+// CDC port which carries the sample stream, so messages never queue behind sample data
+#define CDC_ITF_DATA     1
+
+// Maximum time periodic_sampler_task_c1 waits for cdc_egress_task_c1 to drain the egress ring on stop,
+// the rest of the stream is discarded after that, e.g. when the host isn't reading the data port
+#define EGRESS_FINISH_TIMEOUT_MS  1000
+
+// Notification value sent to periodic_sampler_task_c1 to stop the periodic sampler without
+// acknowledging cdc_ingress_task_c0, e.g. when the host has disconnected
+#define PERIODIC_SAMPLER_NOTIF_DISCONNECT  UINT32_MAX
+
+// Notification value sent to periodic_sampler_task_c1 by the periodic sampler interrupts once the post-trigger
+// window of a capture is complete
+#define PERIODIC_SAMPLER_NOTIF_CAPTURE_DONE  (UINT32_MAX - 1U)
+
+// Notification value sent to periodic_sampler_task_c1 to run the burst capture in burst_capture_config
+#define PERIODIC_SAMPLER_NOTIF_BURST_CAPTURE  (UINT32_MAX - 2U)
+
+// Shortest sampling period the host asks for, when capturing, the decimator and aggregator settings are
+// rejected when no sampling period gives them a frame to work on
+#define PERIODIC_SAMPLER_MIN_PERIOD_US  2U
+
+// Size of the capture buffer in bytes, it is allocated from the FreeRTOS heap, which the task stacks only use
+// about 16 KB of
+#define CAPTURE_BUF_SIZE  (96 * 1024)
+
+// Maximum time periodic_sampler_task_c1 waits for room in the egress ring while uploading a capture, the rest
+// of the capture is discarded after that
+#define CAPTURE_UPLOAD_TIMEOUT_MS  1000
+
+// Longest stretch a burst capture reads frames for with the interrupts of core 1 disabled, a full buffer takes
+// about 80 ms with eight channels and 170 ms with two, so it is read in chunks of this length
+#define BURST_CAPTURE_CHUNK_US  1000U
+
+// Maximum time cdc_ingress_task_c0 waits for room in the tx fifo of the control port for a message which
+// doesn't fit at once, e.g. a StatsMessage, the rest of the message is dropped after that
+#define CONTROL_WRITE_TIMEOUT_MS  100
+
+// Number of tasks whose run time is reported in a StatsMessage, the application tasks, the idle tasks and
+// the timer task
+#define STATS_MAX_TASKS  12
+
+// Size of the buffer a StatsMessage is encoded into, it fits the tx fifo of the control port
+#define STATS_MSG_MAX_SIZE  1024
 
 // USB device task handle
 TaskHandle_t usbd_handle_c0 = NULL;
@@ -63,14 +154,165 @@ TaskHandle_t cdc_egress_handle_c1 = NULL;
 // CDC ingress task handle
 TaskHandle_t cdc_ingress_handle_c0 = NULL;
 
+// Decimator task handle
+TaskHandle_t decimator_handle_c0 = NULL;
+
 // Periodic sampler task handle
 TaskHandle_t periodic_sampler_handle_c1 = NULL;
 
 // Egress msg buffer handle
 // MessageBufferHandle_t egress_msg_buf_handle = NULL;
 
-// Egress stream buffer handle
-StreamBufferHandle_t egress_stream_buf_handle = NULL;
+// Largest prefix of a DeviceToHostMessage carrying a SampleBatchMessage, i.e. everything in front of the samples
+// 3 bytes for the tag and length of the oneof member, 5 uint32 fields of up to 6 bytes each and 3 bytes for the
+// tag and length of the samples
+#define SAMPLE_BATCH_MAX_PREFIX_SIZE  36
+
+// Space in front of the sample frames of a block for the headers cdc_egress_task_c1 puts there
+#define EGRESS_BLOCK_HEADROOM  (STREAM_FRAME_HEADER_SIZE + SAMPLE_BATCH_MAX_PREFIX_SIZE)
+
+// A sample block, filled in place by the periodic sampler interrupts and sent in place by cdc_egress_task_c1
+// The sample frames start at buf[EGRESS_BLOCK_HEADROOM], the consumer writes the headers into the headroom right
+// in front of them, so buf[frame_offset] holds a whole stream frame, see stream_frame.h
+struct egressBlock
+{
+  // Stream frame type of the payload, STREAM_FRAME_TYPE_DATA for sample frames, which get the configured stream
+  // encoding, any other payload is sent as it is
+  uint8_t payload_type;
+  // Number of payload bytes, index and device time of the first frame, written by the producer
+  uint32_t payload_size;
+  uint32_t first_frame_index;
+  uint32_t first_frame_timestamp_us;
+  // Start and size of the sealed stream frame, written by the consumer before it starts sending the block
+  uint32_t frame_offset;
+  uint32_t num_of_bytes;
+  uint8_t buf[EGRESS_BLOCK_HEADROOM + SAMPLE_BLOCK_MAX_BYTES + STREAM_FRAME_CRC_SIZE];
+};
+
+// Egress ring, the periodic sampler interrupts on core 1 produce blocks and cdc_egress_task_c1 consumes them
+struct spscRing egress_ring;
+struct egressBlock egress_ring_blocks[EGRESS_RING_NUM_OF_BLOCKS];
+
+// USB interface which carries the sample stream, configured in start_periodic_sampler()
+DataInterface egress_data_interface = DataInterface_DATA_INTERFACE_CDC;
+
+// Encoding of the blocks of the sample stream and the sampling period reported in SampleBatchMessage,
+// configured in start_periodic_sampler()
+StreamEncoding egress_stream_encoding = StreamEncoding_STREAM_ENCODING_RAW;
+uint32_t egress_sampling_period_us = 0;
+
+// Compressed block, written by cdc_egress_task_c1 before it is copied back over the frames of the block
+uint8_t egress_codec_buf[SAMPLE_BLOCK_MAX_BYTES];
+
+// Set by periodic_sampler_task_c1 to ask cdc_egress_task_c1 to discard every pending block, cleared once done
+volatile bool egress_discard_request = 0;
+
+// Set by periodic_sampler_task_c1 to ask cdc_egress_task_c1 to send every pending block followed by the
+// EOS frame, cleared once done
+volatile bool egress_finish_request = 0;
+
+// Decimator ring, when decimating the periodic sampler interrupts on core 1 produce blocks into it and
+// decimator_task_c0 filters them into the egress ring
+struct spscRing decimator_ring;
+struct egressBlock decimator_ring_blocks[DECIMATOR_RING_NUM_OF_BLOCKS];
+
+// Decimation configured by the host, it is taken into account by the next start_periodic_sampler()
+SetDecimatorMessage decimator_config = SetDecimatorMessage_init_default;
+
+// Filter chain run by decimator_task_c0, set up in start_periodic_sampler()
+// decimator_active is set whenever decimator_task_c0 sits between the periodic sampler and the egress ring,
+// i.e. when aggregating, taking spectra or detecting events as well
+struct decimator decimator;
+bool decimator_active = 0;
+uint32_t decimator_input_period_us = 0;
+
+// Aggregation configured by the host, it is taken into account by the next start_periodic_sampler()
+SetAggregatorMessage aggregator_config = SetAggregatorMessage_init_default;
+
+// Statistics run by decimator_task_c0 instead of the filter chain, set up in start_periodic_sampler(),
+// and the device time of the first frame of the current window
+struct aggregator aggregator;
+bool aggregator_active = 0;
+uint32_t aggregator_window_timestamp_us = 0;
+
+// Spectrum configured by the host, it is taken into account by the next start_periodic_sampler()
+SetSpectrumMessage spectrum_config = SetSpectrumMessage_init_default;
+
+// Spectrum run by decimator_task_c0 instead of the filter chain, set up in start_periodic_sampler(), the
+// device time of the first frame of the current window and the record being put into the egress ring
+// A record with every bin of the largest FFT has to fit into a sample block
+struct spectrum spectrum;
+bool spectrum_active = 0;
+uint32_t spectrum_window_timestamp_us = 0;
+uint8_t spectrum_record_buf[SPECTRUM_RECORD_MAX_SIZE];
+
+// Event detection configured by the host per channel, indexed by the value in the frame, all channels start
+// at EVENT_POLARITY_NONE, it is taken into account by the next start_periodic_sampler()
+SetEventDetectorMessage event_detector_config[EVENT_DETECTOR_MAX_CHANNELS];
+
+// Event detection run by decimator_task_c0 instead of the filter chain, set up in start_periodic_sampler()
+struct eventDetector event_detector;
+bool event_detector_active = 0;
+
+// Index of the frame expected at the start of the next block in the decimator ring, and the number of
+// times frames dropped by the periodic sampler left a gap in the decimator input
+uint32_t decimator_next_input_index = 0;
+uint32_t decimator_input_gaps = 0;
+
+// Time decimator_task_c0 spent on the blocks of the periodic sampler and the number of frames in them, and
+// the time cdc_egress_task_c1 spent encoding and writing blocks, for the CPU cost per frame of each path
+uint32_t decimator_busy_us = 0;
+uint32_t decimator_input_frames = 0;
+uint32_t egress_busy_us = 0;
+
+// Set by periodic_sampler_task_c1 to ask decimator_task_c0 to discard every pending block, or to filter
+// every pending block and commit its partial block, cleared once done
+volatile bool decimator_discard_request = 0;
+volatile bool decimator_finish_request = 0;
+
+// States of a capture, it is ARMED until the trigger frame, TRIGGERED until the post-trigger window is complete
+// and DONE until periodic_sampler_task_c1 has uploaded it
+enum captureState
+{
+  CAPTURE_STATE_IDLE,
+  CAPTURE_STATE_ARMED,
+  CAPTURE_STATE_TRIGGERED,
+  CAPTURE_STATE_DONE
+};
+
+// Capture of a window around a trigger, the periodic sampler interrupts write every frame into a ring of frames
+// in buf, overwriting the oldest, so the sampling rate doesn't depend on the USB throughput
+struct capture
+{
+  uint8_t* buf;
+  uint32_t frame_size;
+  // Number of frames buf holds, the slot the next frame goes into and the number of frames written, up to capacity
+  uint32_t capacity;
+  uint32_t write_slot;
+  uint32_t num_of_frames;
+  uint32_t pre_trigger_frames;
+  uint32_t post_trigger_frames;
+  // Trigger condition, copied from capture_config when armed
+  CaptureTrigger trigger;
+  uint32_t trigger_channel;
+  int32_t threshold;
+  int32_t previous_value;
+  // Slot and device time of the trigger frame, its value and the frames still to be written after it
+  uint32_t trigger_slot;
+  uint32_t trigger_timestamp_us;
+  int32_t trigger_value;
+  uint32_t frames_remaining;
+  // Time the frames of a burst capture took, 0 for a triggered capture
+  uint32_t duration_us;
+  volatile enum captureState state;
+};
+struct capture capture;
+
+// Capture configured by the host, it is taken into account by the next start_periodic_sampler()
+SetCaptureMessage capture_config = SetCaptureMessage_init_default;
+
+// Burst capture requested by the host, written by core 0 before periodic_sampler_task_c1 is notified
+ExecuteBurstCaptureMessage burst_capture_config = ExecuteBurstCaptureMessage_init_default;
 
 // Repeating timer for periodic sampler
 repeating_timer_t periodic_sampler_timer;
@@ -83,10 +325,38 @@ static void cdc_ingress_task_c0(void *param);
 // Core 1 tasks
 static void cdc_egress_task_c1(void *param);
 static void periodic_sampler_task_c1(void *param);
+static void decimator_task_c0(void *param);
 
 // Local callback functions
 static bool execute_sampler(struct connectedSensors connected_sensors, bool operating_mode, uint8_t adc_chan_no, int32_t* dest_buf, uint8_t* elemenetsTransferred);
 static bool periodic_sampler_cb(struct repeating_timer *t);
+static void adc_frame_cb(const uint16_t* frame, uint8_t num_of_words);
+static bool start_periodic_sampler(alarm_pool_t *alarm_pool, const SetPeriodicSamplerMessage* config);
+static void stop_periodic_sampler(void);
+static void egress_sample_from_isr(const void* frame, size_t frame_size, uint32_t timestamp_us);
+static void handle_adc_frame(const uint16_t* frame, uint8_t num_of_words, uint32_t timestamp_us);
+static void encode_egress_block(struct egressBlock* block);
+static uint32_t encode_sample_batch_prefix(uint8_t* buf, const struct egressBlock* block);
+static uint32_t egress_write_available(void);
+static uint32_t egress_write(const void* buf, uint32_t bufsize);
+static void egress_write_flush(void);
+static void egress_write_clear(void);
+static void egress_write_all(const uint8_t* buf, uint32_t bufsize);
+static uint8_t sample_frame_num_of_values(void);
+static uint8_t sample_frame_value_size(void);
+static void decimate_block(const struct egressBlock* block);
+static void end_egress_stream(bool finish);
+static bool arm_capture(const SetCaptureMessage* config);
+static void capture_frame_from_isr(const void* frame, size_t frame_size);
+static bool upload_capture(void);
+static bool run_burst_capture(const ExecuteBurstCaptureMessage* config);
+static void record_sample_timestamp(uint32_t timestamp_us);
+static void report_sample_jitter(void);
+static void report_pipeline_cost(void);
+static uint32_t encode_stats_msg(uint8_t* buf, uint32_t bufsize, bool include_tasks);
+static bool control_write_all(const uint8_t* buf, uint32_t bufsize);
+static bool send_ack(pb_size_t which_payload, bool ack);
+static bool stream_processing_valid(const SetPeriodicSamplerMessage* config);
 
 // TinyUSB callback functions
 void tud_mount_cb(void);
@@ -96,6 +366,9 @@ void tud_resume_cb(void);
 void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts);
 void tud_cdc_rx_cb(uint8_t itf);
 void tud_cdc_tx_complete_cb(uint8_t itf);
+void tud_vendor_tx_cb(uint8_t itf, uint32_t sent_bytes);
+// Weak as the TinyUSB of pico-sdk 1.5.1 doesn't have it yet, see egress_write_clear()
+bool tud_vendor_n_write_clear(uint8_t itf) __attribute__((weak));
 
 // Nanopb callback functions
 bool nanopb_cb_host_to_device_msg_decode(pb_istream_t *stream, const pb_field_t *field, void **arg);
@@ -103,6 +376,8 @@ bool nanopb_cb_encode_string(pb_ostream_t *stream, const pb_field_t *field, void
 bool nanopb_cb_encode_fixed32(pb_ostream_t *stream, const pb_field_t *field, void * const *arg);
 bool nanopb_cb_encode_fixed64(pb_ostream_t *stream, const pb_field_t *field, void * const *arg);
 bool nanopb_cb_encode_repeatedstring(pb_ostream_t *stream, const pb_field_t *field, void * const *arg);
+bool nanopb_cb_encode_histogram_bins(pb_ostream_t *stream, const pb_field_t *field, void * const *arg);
+bool nanopb_cb_encode_task_stats(pb_ostream_t *stream, const pb_field_t *field, void * const *arg);
 bool nanopb_cb_print_int32(pb_istream_t *stream, const pb_field_t *field, void **arg);
 bool nanopb_cb_print_string(pb_istream_t *stream, const pb_field_t *field, void **arg);
 
@@ -115,12 +390,126 @@ bool cdc_term_connected = 0;
 // For keeping track of whether a periodic sampler is active
 bool active_periodic_sampler = 0;
 
-// For keeping track of the element sent in periodic_sampler_cd(), used for testing
-uint32_t sampler_counter = 0;
+// Set by cdc_ingress_task_c0 when it hands a burst capture over to periodic_sampler_task_c1, and cleared by the
+// latter once it has been uploaded, the notifications meanwhile would overwrite PERIODIC_SAMPLER_NOTIF_BURST_CAPTURE
+volatile bool burst_capture_pending = 0;
+
+// For keeping track of whether the periodic sampler is paced by periodic_sampler_timer
+bool periodic_sampler_timer_active = 0;
+
+// ADC backend used by the periodic sampler
+enum ad7606bBackend periodic_sampler_adc_backend = PERIODIC_SAMPLER_ADC_BACKEND;
+
+// Configuration of the periodic sampler, written by core 0 before periodic_sampler_task_c1 is notified
+SetPeriodicSamplerMessage periodic_sampler_config = SetPeriodicSamplerMessage_init_default;
+
+// Inter-sample interval statistics, used to report the jitter of the sampling clock
+struct samplerIntervalStats
+{
+  uint32_t last_timestamp_us;
+  uint32_t num_of_intervals;
+  uint32_t min_interval_us;
+  uint32_t max_interval_us;
+  uint64_t sum_interval_us;
+  uint64_t sum_sq_interval_us;
+};
+struct samplerIntervalStats sampler_interval_stats;
+bool sampler_interval_stats_started = 0;
+
+// Histograms of the inter-sample interval and of the time a frame takes to handle in interrupt context, and
+// the number of samples taken more than half a period late, set up in start_periodic_sampler(), only
+// written by the periodic sampler interrupts on core 1
+struct metricsHistogram sample_interval_histogram;
+struct metricsHistogram sampler_isr_histogram;
+uint32_t late_samples = 0;
+uint32_t late_sample_threshold_us = UINT32_MAX;
+
+// Sampling period of the current or last periodic sampler
+uint32_t periodic_sampler_period_us = 0;
+
+// Run time of every task at the previous GetStatsMessage, for the loads over the interval since then
+struct taskRunTime
+{
+  UBaseType_t task_number;
+  configRUN_TIME_COUNTER_TYPE run_time;
+};
+struct taskRunTime stats_previous_run_times[STATS_MAX_TASKS];
+UBaseType_t stats_num_of_previous_run_times = 0;
+// Snapshot being taken, only copied over the previous one once every task has been looked up in it, as the
+// order of the tasks changes from one call of uxTaskGetSystemState() to the next
+struct taskRunTime stats_run_times[STATS_MAX_TASKS];
+uint64_t stats_previous_timestamp_us = 0;
+TaskStatus_t stats_task_status[STATS_MAX_TASKS];
+TaskStatsMessage stats_tasks[STATS_MAX_TASKS];
+uint8_t stats_msg_buf[STATS_MSG_MAX_SIZE];
+
+// Layout of the frames produced by the periodic sampler, configured in start_periodic_sampler()
+FrameFormat sample_frame_format = FrameFormat_FRAME_FORMAT_INT32;
+
+// ADC channels carried in a frame, bit n = channel n
+uint8_t adc_channel_mask = 0;
+
+// Number of words read out of the ADC per conversion, up to and including the last channel in adc_channel_mask
+uint8_t adc_num_of_words = 0;
+
+// Block of frames being accumulated by a producer of a ring, frames are written straight into a block
+// reserved in the ring, which is committed as a whole once it is complete
+struct sampleBlock
+{
+  struct spscRing* ring;
+  // Task which consumes the ring, woken up as blocks are committed
+  TaskHandle_t consumer;
+  struct egressBlock* block;
+  uint32_t num_of_frames;
+  uint32_t frames_per_block;
+  uint32_t first_frame_timestamp_us;
+  uint32_t first_frame_index;
+  // Index of the next frame, dropped frames included, the host finds drops as gaps in the sequence
+  // numbers of the stream frames
+  uint32_t frame_index;
+  // Number of frames dropped because the ring was full
+  uint32_t frame_drops;
+  // Most blocks pending in the ring right after a commit
+  uint32_t ring_high_water;
+  // Most blocks the producer leaves pending in the ring, up to the number of slots of the ring
+  uint32_t ring_depth;
+  // Stream frame type of the blocks, STREAM_FRAME_TYPE_DATA unless the frames are records of some kind
+  uint8_t payload_type;
+};
+
+// Frames of the periodic sampler interrupts, they go to the egress ring, or to the decimator ring when decimating
+struct sampleBlock sample_block;
+
+// Frames of decimator_task_c0, they go to the egress ring
+struct sampleBlock decimated_block;
+
+// The one of the above which produces the egress ring, set up in start_periodic_sampler()
+struct sampleBlock* egress_producer = &sample_block;
+
+// Function prototypes of the sample block helpers, they need the struct
+static void reset_sample_block(struct sampleBlock* sample_block, struct spscRing* ring, TaskHandle_t consumer, uint32_t frames_per_block);
+static void commit_sample_block(struct sampleBlock* sample_block);
+static bool append_sample_frame(struct sampleBlock* sample_block, const void* frame, size_t frame_size, uint32_t timestamp_us);
+
+// Number of times cdc_egress_task_c1 had a pending block but the tx cdc fifo was full
+uint32_t egress_stalls = 0;
+
+// Number of times egress_write() took only part of the remaining bytes of a block
+uint32_t egress_partial_writes = 0;
+
+// Size of the sample frames before and after compression, for the compression ratio of STREAM_ENCODING_DELTA
+uint32_t egress_raw_bytes = 0;
+uint32_t egress_encoded_bytes = 0;
 
 // Initialise an array which stores sample function pointers
 sensor_sample_func sensor_sample_func_array[8];
 
+// Synthetic sensor streamed instead of the connected sensors when the host asks for the test pattern, whether it is
+// set up in start_periodic_sampler()
+struct Sensor test_pattern_sensor = {8, "Test_pattern", TEST_PATTERN_SENSOR, false, 0};
+sensor_sample_func test_pattern_sensor_sample_func = NULL;
+bool test_pattern_active = 0;
+
 // Initialise a connectedSensors struct
 struct connectedSensors connected_sensors;
 
@@ -149,6 +538,14 @@ int main()
   // Reset the ADC
   ad7606b_init();
   ad7606b_reset();
+  // Claim the DMA channels for reading out the ADC in the periodic sampler
+  ad7606b_dma_init();
+  // Load the PIO acquisition program, fall back to the DMA backend if the PIO is not available
+  if (!ad7606b_pio_init(ADC_PIO_BLOCK) && periodic_sampler_adc_backend == AD7606B_BACKEND_PIO)
+  {
+    SEGGER_RTT_printf(0, "ERROR : Failed to load PIO acquisition program, using DMA backend.\n");
+    periodic_sampler_adc_backend = AD7606B_BACKEND_DMA;
+  }
 
   // Initialise TinyUSB stack
   tusb_init();
@@ -186,9 +583,29 @@ int main()
   uxCoreAffinityMask = ((1<<1));
   vTaskCoreAffinitySet(periodic_sampler_handle_c1, uxCoreAffinityMask);
 
-  // Create a stream buffer to store egress messages
-  egress_stream_buf_handle = xStreamBufferCreate(EGRESS_STREAM_BUF_SIZE, 64);
-  assert (egress_stream_buf_handle != NULL);
+  // Create a task on core 0 to decimate the periodic sampler output while core 1 samples
+  // It has a lower priority than the usb tasks, so filtering never holds up the USB stack
+  assert(xTaskCreate(decimator_task_c0, "decimator_c0", DECIMATOR_STACK_SIZE, NULL, configMAX_PRIORITIES-2, &(decimator_handle_c0)) == pdPASS);
+  assert(decimator_handle_c0 != NULL);
+  // Configure the decimator task affinity mask, it can only run on core 0
+  uxCoreAffinityMask = ((1<<0));
+  vTaskCoreAffinitySet(decimator_handle_c0, uxCoreAffinityMask);
+
+  // Initialise the ring which carries sample blocks to the egress task
+  bool egress_ring_initialised = spsc_ring_init(&egress_ring, egress_ring_blocks, sizeof(struct egressBlock), EGRESS_RING_NUM_OF_BLOCKS);
+  assert(egress_ring_initialised);
+  sample_block.ring_depth = EGRESS_RING_NUM_OF_BLOCKS;
+
+  // Initialise the ring which carries sample blocks to the decimator task
+  bool decimator_ring_initialised = spsc_ring_init(&decimator_ring, decimator_ring_blocks, sizeof(struct egressBlock), DECIMATOR_RING_NUM_OF_BLOCKS);
+  assert(decimator_ring_initialised);
+
+  // Allocate the capture buffer once the task stacks have been, capture mode is unavailable without it
+  capture.buf = pvPortMalloc(CAPTURE_BUF_SIZE);
+  if (capture.buf == NULL)
+  {
+    SEGGER_RTT_printf(0, "ERROR : Failed to allocate the capture buffer.\n");
+  }
 
 
   /*
@@ -207,6 +624,7 @@ int main()
     num_of_adc_chan += connected_sensors.sensor_array[i]->useADC;
     sensor_sample_func_array[i] = get_sensor_sample_func(connected_sensors.sensor_array[i]);
   }
+  test_pattern_sensor_sample_func = get_sensor_sample_func(&test_pattern_sensor);
 
   // Initialise HostToDeviceMessage structure
   // HostToDeviceMessage msg = HostToDeviceMessage_init_zero;
@@ -297,9 +715,15 @@ void tud_resume_cb(void)
 // Invoked when cdc line state changed, e.g. connected/disconnected
 void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
 {
-  (void) itf;
   (void) rts;
 
+  // The session follows the control port, the data port may be opened and closed by the host at will
+  if (itf != CDC_ITF_CONTROL)
+  {
+    SEGGER_RTT_printf(0, "cdc data port %s!\n", dtr ? "connected" : "disconnected");
+    return;
+  }
+
   if (dtr)
   {
     // Terminal connected
@@ -310,21 +734,11 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
     // Terminal disconnected
     cdc_term_connected = 0;
     SEGGER_RTT_printf(0, "cdc term disconnected!\n\n");
-    // If periodic sampler is active, stop it
+    // If periodic sampler is active, ask core 1 to stop it, as the ADC backend interrupts are
+    // registered on core 1
     if (active_periodic_sampler)
     {
-      if (cancel_repeating_timer(&(periodic_sampler_timer)))
-      {
-        active_periodic_sampler = 0;
-        SEGGER_RTT_printf(0, "Cancelled periodic sampler.\n");
-        printf("Cancelled periodic sampler.\n");
-        // Reset sampler_counter for next callback
-        sampler_counter = 0;
-      }else
-      {
-        SEGGER_RTT_printf(0, "ERROR : Failed to cancel periodic sampler.\n");
-        printf("ERROR : Failed to cancel periodic sampler.\n");
-      }
+      xTaskNotify(periodic_sampler_handle_c1, PERIODIC_SAMPLER_NOTIF_DISCONNECT, eSetValueWithOverwrite);
     }
   }
 
@@ -333,13 +747,44 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
 // Invoked when cdc received new data
 void tud_cdc_rx_cb(uint8_t itf)
 {
-  (void) itf;
+  // Nothing is expected from the host on the data port
+  if (itf != CDC_ITF_CONTROL)
+  {
+    tud_cdc_n_read_flush(itf);
+    return;
+  }
 
   // Wake up cdc_ingress_task_c0 to process incoming data
   vTaskResume(cdc_ingress_handle_c0);
 
 }
 
+// Invoked when a cdc transfer to the host has completed, so the tx cdc fifo has room again
+void tud_cdc_tx_complete_cb(uint8_t itf)
+{
+  // Resume cdc_egress_task_c1 if it is waiting for room in the tx fifo of the data port
+  if (itf == CDC_ITF_DATA && cdc_egress_handle_c1 != NULL)
+  {
+    xTaskNotifyGive(cdc_egress_handle_c1);
+  }
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB vendor callbacks
+//--------------------------------------------------------------------+
+// Invoked when a vendor bulk IN transfer to the host has completed, so the tx vendor fifo has room again
+void tud_vendor_tx_cb(uint8_t itf, uint32_t sent_bytes)
+{
+  (void) itf;
+  (void) sent_bytes;
+
+  // Resume cdc_egress_task_c1 if it is waiting for room in the tx vendor fifo
+  if (cdc_egress_handle_c1 != NULL)
+  {
+    xTaskNotifyGive(cdc_egress_handle_c1);
+  }
+}
+
 //--------------------------------------------------------------------+
 // Nanopb callback functions
 //--------------------------------------------------------------------+
@@ -351,32 +796,53 @@ void tud_cdc_rx_cb(uint8_t itf)
  */
 bool nanopb_cb_host_to_device_msg_decode(pb_istream_t *stream, const pb_field_t *field, void **arg)
 {
-  /* Print the prefix field before the submessages.
-   * This also demonstrates how to access the top level message fields
-   * from callbacks.
-   */
-  HostToDeviceMessage *topmsg = field->message;
-
+  // Print the name of the submessage before it is decoded, the top level message is field->message and the
+  // submessage field->pData, should a callback of the submessage have to be set up here
   if (field->tag == HostToDeviceMessage_stop_periodic_sampler_msg_tag)
   {
     SEGGER_RTT_printf(0, "Got stop_periodic_sampler_msg.\n");
     // printf("Got stop_periodic_sampler_msg.\n");
-    StopPeriodicSamplerMessage *msg = (StopPeriodicSamplerMessage*)field->pData;
-    // msg->str1.funcs.decode = nanopb_cb_print_string;
-    // msg->str1.arg = "str1 : %s \n";
   }
   else if (field->tag == HostToDeviceMessage_set_periodic_sampler_msg_tag)
   {
     SEGGER_RTT_printf(0, "Got set_periodic_sampler_msg.\n");
     // printf("Got set_periodic_sampler_msg.\n");
-    SetPeriodicSamplerMessage *msg = (SetPeriodicSamplerMessage*)field->pData;
-    // msg2->str1.funcs.decode = nanopb_cb_print_string;
-    // msg2->str1.arg = "str1 : %s\n";
   }
   else if (field->tag == HostToDeviceMessage_execute_one_off_sampler_msg_tag)
   {
     SEGGER_RTT_printf(0, "Got execute_one_off_sampler_msg.\n");
-    ExecuteOneOffSamplerMessage *msg = (ExecuteOneOffSamplerMessage*)field->pData;
+  }
+  else if (field->tag == HostToDeviceMessage_set_decimator_msg_tag)
+  {
+    SEGGER_RTT_printf(0, "Got set_decimator_msg.\n");
+  }
+  else if (field->tag == HostToDeviceMessage_set_capture_msg_tag)
+  {
+    SEGGER_RTT_printf(0, "Got set_capture_msg.\n");
+  }
+  else if (field->tag == HostToDeviceMessage_execute_burst_capture_msg_tag)
+  {
+    SEGGER_RTT_printf(0, "Got execute_burst_capture_msg.\n");
+  }
+  else if (field->tag == HostToDeviceMessage_set_aggregator_msg_tag)
+  {
+    SEGGER_RTT_printf(0, "Got set_aggregator_msg.\n");
+  }
+  else if (field->tag == HostToDeviceMessage_set_spectrum_msg_tag)
+  {
+    SEGGER_RTT_printf(0, "Got set_spectrum_msg.\n");
+  }
+  else if (field->tag == HostToDeviceMessage_set_event_detector_msg_tag)
+  {
+    SEGGER_RTT_printf(0, "Got set_event_detector_msg.\n");
+  }
+  else if (field->tag == HostToDeviceMessage_get_stats_msg_tag)
+  {
+    SEGGER_RTT_printf(0, "Got get_stats_msg.\n");
+  }
+  else if (field->tag == HostToDeviceMessage_get_device_time_msg_tag)
+  {
+    // Not printed, the host measures the round trip
   }
   else
   {
@@ -454,6 +920,44 @@ bool nanopb_cb_encode_repeatedstring(pb_ostream_t *stream, const pb_field_t *fie
   return true;
 }
 
+// Callback to encode the bins of a struct metricsHistogram as a packed repeated uint32
+bool nanopb_cb_encode_histogram_bins(pb_ostream_t *stream, const pb_field_t *field, void * const *arg)
+{
+  const struct metricsHistogram* histogram = (const struct metricsHistogram*) (*arg);
+
+  // The length of the packed values comes first
+  pb_ostream_t sizing_stream = PB_OSTREAM_SIZING;
+  for (uint32_t i = 0; i < METRICS_HISTOGRAM_NUM_OF_BINS; i++)
+  {
+    pb_encode_varint(&sizing_stream, histogram->bins[i]);
+  }
+  if (!pb_encode_tag(stream, PB_WT_STRING, field->tag) || !pb_encode_varint(stream, sizing_stream.bytes_written))
+    return false;
+
+  for (uint32_t i = 0; i < METRICS_HISTOGRAM_NUM_OF_BINS; i++)
+  {
+    if (!pb_encode_varint(stream, histogram->bins[i]))
+      return false;
+  }
+  return true;
+}
+
+// Callback to encode the first arg entries of stats_tasks as a repeated TaskStatsMessage
+bool nanopb_cb_encode_task_stats(pb_ostream_t *stream, const pb_field_t *field, void * const *arg)
+{
+  uint32_t num_of_tasks = (uint32_t) (uintptr_t) (*arg);
+
+  for (uint32_t i = 0; i < num_of_tasks; i++)
+  {
+    if (!pb_encode_tag_for_field(stream, field))
+      return false;
+
+    if (!pb_encode_submessage(stream, TaskStatsMessage_fields, &stats_tasks[i]))
+      return false;
+  }
+  return true;
+}
+
 /* nanopb decode callbacks */
 // Callback to print nanopb int32
 bool nanopb_cb_print_int32(pb_istream_t *stream, const pb_field_t *field, void **arg)
@@ -502,6 +1006,165 @@ static void usb_device_task_c0(void *param)
   }
 }
 
+//--------------------------------------------------------------------+
+// Decimator task (Core 0)
+//--------------------------------------------------------------------+
+static void decimator_task_c0(void *param)
+{
+  while (true)
+  {
+    if (decimator_discard_request)
+    {
+      spsc_ring_discard(&decimator_ring);
+      // A reserved block which has not been committed is simply reused by the next reservation
+      decimated_block.block = NULL;
+      decimated_block.num_of_frames = 0;
+      decimator_finish_request = 0;
+      decimator_discard_request = 0;
+    }
+
+    const struct egressBlock* block = (const struct egressBlock*) spsc_ring_peek(&decimator_ring);
+    if (block == NULL)
+    {
+      if (decimator_finish_request)
+      {
+        // Everything committed before the stop has been filtered, hand the partial block over
+        commit_sample_block(&decimated_block);
+        xTaskNotifyGive(cdc_egress_handle_c1);
+        decimator_finish_request = 0;
+        continue;
+      }
+      // Sleep until the periodic sampler commits a block or a request comes in
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    uint32_t start_us = time_us_32();
+    decimate_block(block);
+    decimator_busy_us += time_us_32() - start_us;
+    spsc_ring_release(&decimator_ring);
+  }
+}
+
+// Push the frames of a block of the periodic sampler through the filter chain and put the decimated frames,
+// which have the same format, into the egress ring, or through the event detector, the spectrum or the
+// aggregator and put their records there
+static void decimate_block(const struct egressBlock* block)
+{
+  uint8_t num_of_values = sample_frame_num_of_values();
+  uint8_t value_size = sample_frame_value_size();
+  uint32_t frame_size = (uint32_t) num_of_values * value_size;
+  uint32_t num_of_frames = block->payload_size / frame_size;
+  const uint8_t* frames = &block->buf[EGRESS_BLOCK_HEADROOM];
+
+  // Frames dropped by the periodic sampler are missing from the input, the filter simply carries on
+  if (block->first_frame_index != decimator_next_input_index)
+  {
+    decimator_input_gaps++;
+  }
+  decimator_next_input_index = block->first_frame_index + num_of_frames;
+  decimator_input_frames += num_of_frames;
+
+  for (uint32_t i = 0; i < num_of_frames; i++)
+  {
+    int32_t input[DECIMATOR_MAX_CHANNELS];
+    int32_t output[DECIMATOR_MAX_CHANNELS];
+    const uint8_t* frame = &frames[i * frame_size];
+    uint32_t timestamp_us = block->first_frame_timestamp_us + i * decimator_input_period_us;
+    if (value_size == sizeof(uint16_t))
+    {
+      // The raw ADC codes are two's complement
+      for (uint8_t c = 0; c < num_of_values; c++)
+      {
+        input[c] = (int16_t) ((uint16_t) frame[2U * c] | ((uint16_t) frame[2U * c + 1U] << 8));
+      }
+    }else
+    {
+      memcpy(input, frame, frame_size);
+    }
+    if (event_detector_active)
+    {
+      // A record per event once it has ended, timestamped with its start
+      struct eventRecord records[EVENT_DETECTOR_MAX_CHANNELS];
+      uint8_t num_of_records = event_detector_push(&event_detector, input, timestamp_us, records);
+      for (uint8_t r = 0; r < num_of_records; r++)
+      {
+        if (append_sample_frame(&decimated_block, &records[r], sizeof(records[r]), records[r].start_timestamp_us))
+        {
+          xTaskNotifyGive(cdc_egress_handle_c1);
+        }
+      }
+      continue;
+    }
+    if (spectrum_active)
+    {
+      // A record per channel and window instead of the frames, timestamped with the first frame of the window
+      if (spectrum.num_of_frames == 0U)
+      {
+        spectrum_window_timestamp_us = timestamp_us;
+      }
+      if (!spectrum_push(&spectrum, input))
+      {
+        continue;
+      }
+      for (uint8_t c = 0; c < num_of_values; c++)
+      {
+        uint32_t record_size = spectrum_record(&spectrum, c, spectrum_record_buf);
+        if (append_sample_frame(&decimated_block, spectrum_record_buf, record_size, spectrum_window_timestamp_us))
+        {
+          xTaskNotifyGive(cdc_egress_handle_c1);
+        }
+      }
+      continue;
+    }
+    if (aggregator_active)
+    {
+      // A record per window instead of the frames, timestamped with the first frame of the window
+      struct aggregatorStats record[AGGREGATOR_MAX_CHANNELS];
+      if (aggregator.num_of_frames == 0U)
+      {
+        aggregator_window_timestamp_us = timestamp_us;
+      }
+      if (aggregator_push(&aggregator, input, record) &&
+          append_sample_frame(&decimated_block, record, num_of_values * sizeof(struct aggregatorStats), aggregator_window_timestamp_us))
+      {
+        xTaskNotifyGive(cdc_egress_handle_c1);
+      }
+      continue;
+    }
+    if (!decimator_push(&decimator, input, output))
+    {
+      continue;
+    }
+
+    uint8_t decimated_frame[SAMPLE_FRAME_MAX_SIZE];
+    if (value_size == sizeof(uint16_t))
+    {
+      for (uint8_t c = 0; c < num_of_values; c++)
+      {
+        int32_t value = (output[c] > INT16_MAX) ? INT16_MAX : ((output[c] < INT16_MIN) ? INT16_MIN : output[c]);
+        uint16_t code = (uint16_t) (int16_t) value;
+        memcpy(&decimated_frame[2U * c], &code, sizeof(code));
+      }
+    }else
+    {
+      memcpy(decimated_frame, output, frame_size);
+    }
+    // Timestamped with the input frame which completed the output frame
+    if (append_sample_frame(&decimated_block, decimated_frame, frame_size, timestamp_us))
+    {
+      xTaskNotifyGive(cdc_egress_handle_c1);
+    }
+  }
+
+  if (event_detector_active && decimated_block.num_of_frames > 0U)
+  {
+    // Events are far apart, so rather than waiting for more to fill the block, hand them over along with the
+    // block they ended in
+    commit_sample_block(&decimated_block);
+    xTaskNotifyGive(cdc_egress_handle_c1);
+  }
+}
+
 //--------------------------------------------------------------------+
 // Periodic sampler task (Core 1)
 //--------------------------------------------------------------------+
@@ -513,50 +1176,53 @@ static void periodic_sampler_task_c1(void *param)
   {
 
     uint32_t notificationvalue = ulTaskNotifyTake( pdTRUE, portMAX_DELAY);
-    if (notificationvalue == 0U)
+    if (notificationvalue == 0U || notificationvalue == PERIODIC_SAMPLER_NOTIF_DISCONNECT)
     {
       if (active_periodic_sampler)
       {
-        // Cancel any repeating timer
-        if (cancel_repeating_timer(&(periodic_sampler_timer)))
-        {
-          active_periodic_sampler = 0;
-          SEGGER_RTT_printf(0, "Cancelled periodic sampler.\n");
-          // Reset the egress_msg_buf to ensure that nothing can get pulled into tx cdc fifo
-          // assert(xMessageBufferReset(egress_msg_buf_handle) == pdPASS);
-          // Reset the egress_stream_buf to ensure that nothing can get pulled into tx cdc fifo
-          assert(xStreamBufferReset(egress_stream_buf_handle) == pdPASS);
-          // Flush the tx cdc fifo to ensure nothing gets sent
-          tud_cdc_write_clear();
-          // Notify cdc_ingress_task_c0 that periodic sampler has been cancelled, hence
-          // core 0 can send EOS sequence safety
-          xTaskNotify(cdc_ingress_handle_c0, 1U, eSetValueWithOverwrite);
-
-          // printf("Cancelled periodic sampler.\n");
-        }
+        stop_periodic_sampler();
+        SEGGER_RTT_printf(0, "Cancelled periodic sampler.\n");
+        // A capture which hasn't been uploaded yet is dropped
+        capture.state = CAPTURE_STATE_IDLE;
+        end_egress_stream(notificationvalue == 0U);
+      }
+      // Notify cdc_ingress_task_c0 that periodic sampler has been cancelled, hence
+      // core 0 can acknowledge the stop message
+      if (notificationvalue == 0U)
+      {
+        xTaskNotify(cdc_ingress_handle_c0, 1U, eSetValueWithOverwrite);
+      }
+    }else if (notificationvalue == PERIODIC_SAMPLER_NOTIF_CAPTURE_DONE)
+    {
+      // The capture window is complete, stop sampling and send it, the stream ends with it
+      if (active_periodic_sampler)
+      {
+        stop_periodic_sampler();
+        SEGGER_RTT_printf(0, "Capture complete, uploading it.\n");
+        end_egress_stream(upload_capture());
+        capture.state = CAPTURE_STATE_IDLE;
+      }
+    }else if (notificationvalue == PERIODIC_SAMPLER_NOTIF_BURST_CAPTURE)
+    {
+      // Nothing else is sampled meanwhile, cdc_ingress_task_c0 only asks for it when the periodic sampler is stopped
+      if (!active_periodic_sampler && run_burst_capture(&burst_capture_config))
+      {
+        end_egress_stream(upload_capture());
       }
+      capture.state = CAPTURE_STATE_IDLE;
+      burst_capture_pending = 0;
     }else
     {
-        // Convert the unsigned into signed to be passed in as an argument
-        // Maximum sampling frequency is 25000Hz, this is determined through experimentation.
-        // The upper limit is determined by the execution time of tud_cdc_write()
-        int64_t delay_us = (notificationvalue >= 40U) ? -(int64_t)notificationvalue : -40;
-        // Set up a repeating timer
-        // if delay_us > 0, then this is the delay between one callback ending and the next starting; 
-        // if delay_us < 0, then this is the negative of the time between the starts of the callbacks.
         if (!active_periodic_sampler)
         {
-          // Set up repeating periodic sampler timer
-          if (!alarm_pool_add_repeating_timer_us(alarm_pool, delay_us, periodic_sampler_cb, NULL, &(periodic_sampler_timer)))
+          periodic_sampler_config.sampling_period = (int32_t) notificationvalue;
+          if (!start_periodic_sampler(alarm_pool, &periodic_sampler_config))
           {
             SEGGER_RTT_printf(0, "ERROR : Failed to add periodic sampler.\n");
             // printf("ERROR : Failed to add periodic sampler.\n");
           }else
           {
             active_periodic_sampler = 1;
-
-            SEGGER_RTT_printf(0, "Added periodic sampler repeating timer with samping period = %lld microseconds\n", delay_us);
-            // printf("Added periodic sampler repeating timer with samping period = %lld microseconds\n", delay_us);
           }
         }
     }
@@ -564,138 +1230,1094 @@ static void periodic_sampler_task_c1(void *param)
 
 }
 
-//--------------------------------------------------------------------+
-// CDC egress task (Core 1)
-//--------------------------------------------------------------------+
-static void cdc_egress_task_c1(void *param)
+// End the sample stream once the periodic sampler has been stopped, with finish the rest of the stream is sent
+// followed by the EOS frame, otherwise, or if it isn't read in time, the rest of the stream is discarded
+static void end_egress_stream(bool finish)
 {
-  // bool led_state = 0;
-  int32_t bytes_recv = 0;
-  uint8_t msg_buf[256];
-  while (true)
+  if (finish)
   {
-    bytes_recv = xStreamBufferReceive(egress_stream_buf_handle, msg_buf, sizeof(msg_buf), 0);
-    if (bytes_recv != 0)
+    // Hand the partial block over and ask cdc_egress_task_c1 to send the rest of the stream,
+    // terminated with the EOS frame, the data port isn't shared with messages so nothing is discarded
+    commit_sample_block(&sample_block);
+    TickType_t wait_start = xTaskGetTickCount();
+    if (decimator_active)
+    {
+      // decimator_task_c0 filters what is left and hands its own partial block over first
+      decimator_finish_request = 1;
+      xTaskNotifyGive(decimator_handle_c0);
+      while (decimator_finish_request && (xTaskGetTickCount() - wait_start) < pdMS_TO_TICKS(EGRESS_FINISH_TIMEOUT_MS))
+      {
+        vTaskDelay(1);
+      }
+    }
+    egress_finish_request = 1;
+    xTaskNotifyGive(cdc_egress_handle_c1);
+    while (egress_finish_request && (xTaskGetTickCount() - wait_start) < pdMS_TO_TICKS(EGRESS_FINISH_TIMEOUT_MS))
     {
-      tud_cdc_write(msg_buf, bytes_recv);
+      vTaskDelay(1);
     }
   }
-}
-
-//--------------------------------------------------------------------+
-// CDC ingress task (Core 0)
-//--------------------------------------------------------------------+
-static void cdc_ingress_task_c0(void *param)
-{
-  // Decode HostToDeviceMessage from CDC RX FIFO
-  HostToDeviceMessage msg = HostToDeviceMessage_init_zero;
-  // Set up the decode callbacks for contents in the oneof payload
-  msg.cb_payload.funcs.decode = nanopb_cb_host_to_device_msg_decode;
-
-  // recv buffer, each message has maximum size of 256 bytes
-  uint8_t recv_buf[256];
-  // int32_t recv_bytes = 0;
-  while (true)
+  if (!finish || egress_finish_request)
   {
-    // Since this task is woken up by tud_cdc_rx_cb(), there is guranteed to have content
-    // in CDC RX FIFO
-    // Read the first byte which indicates the msg length
-    int32_t msg_length = tud_cdc_read_char();
-    SEGGER_RTT_printf(0, "Host to Device Message length = %d.\n", msg_length);
-
-    if (msg_length != -1)
+    // The host has gone away or isn't reading the data port, ask cdc_egress_task_c1 to discard the
+    // egress ring, only the consumer of the ring may do so
+    SEGGER_RTT_printf(0, "Discarding the rest of the stream.\n");
+    if (decimator_active)
     {
-      for (int i = 0; i < msg_length; i++)
+      // Stop the decimator from producing into the egress ring first
+      decimator_discard_request = 1;
+      xTaskNotifyGive(decimator_handle_c0);
+      while (decimator_discard_request)
       {
-          recv_buf[i] = tud_cdc_read_char();
+        vTaskDelay(1);
       }
     }
-
-    pb_istream_t stream = pb_istream_from_buffer(recv_buf, msg_length);
-
-    bool status = pb_decode(&stream, HostToDeviceMessage_fields, &msg);
-    if (status)
+    egress_discard_request = 1;
+    xTaskNotifyGive(cdc_egress_handle_c1);
+    while (egress_discard_request)
     {
-      SEGGER_RTT_printf(0, "Host to Device Message decode succeeded.\n");
-      // Check the fields of message after decode and act accordingly
-      if (msg.which_payload == HostToDeviceMessage_stop_periodic_sampler_msg_tag)
-      {
-        // Send task notification to periodic_sampler_task_c1 task to stop periodic sampling
-        xTaskNotify(periodic_sampler_handle_c1, 0U, eSetValueWithOverwrite);
-
-        // Wait for core 1 to indicate that it has stopped the periodic sampler timer and flush egress_msg_buf
-        // before sending the EOS sequence
-        uint32_t notificationvalue = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-
-        if (notificationvalue == 1U)
-        {
-          // Send the EOS sequence
-          uint8_t msg_buf[10];
-          // Send 10 bytes of 255 to indicate end of stream back to host
-          memset(msg_buf, UINT8_MAX, sizeof(msg_buf));
-
-          SEGGER_RTT_printf(0, "TX FIFO available = %" PRIu32 "bytes.\n", tud_cdc_available());
-          // Flush the cdc tx fifo to ensure stop acknowledge can be sent back to host
-          bool cdc_write_cleared = tud_cdc_write_clear();
-          uint32_t bytes_written = tud_cdc_write(msg_buf, sizeof(msg_buf));
-          // When the number of bytes transmitted is small, they will hang around
-          // in the TX FIFO and accumulate before a critical mass is reached for
-          // Tinyusb to send all of them with a bulk transfer, we want to transmit
-          // instantly, so force send with tud_cdc_write_flush()
-          uint32_t bytes_written_after_flush = tud_cdc_write_flush();
-
-          // Make sure the ack message is transmitted
-          SEGGER_RTT_printf(0, "End of stream sequence sent. tud_cdc_write() = %" PRIu32 " bytes.\n", bytes_written);
-          SEGGER_RTT_printf(0, "tud_cdc_write_flush() = %" PRIu32 " bytes.\n", bytes_written_after_flush);
-          assert(bytes_written == sizeof(msg_buf) || bytes_written_after_flush == sizeof(msg_buf));
-          // printf("Ack_stop_periodic_sampler_msg sent. Msg length = %" PRIu32 "\n", bytes_written);
-
-          // Reset the sampler_counter
-          sampler_counter = 0;
-        }else
-        {
-          SEGGER_RTT_printf(0, "ERROR : notificationvalue for stop acknowledge from core 1 is not 1U.\n");
-        }
-
-      }else if (msg.which_payload == HostToDeviceMessage_set_periodic_sampler_msg_tag)
-      {
-        uint8_t msg_buf[32];
-        pb_ostream_t stream;
-        uint32_t notificationvalue = msg.payload.set_periodic_sampler_msg.sampling_period;
-        // Create acknowledge message
-        DeviceToHostMessage msg = DeviceToHostMessage_init_zero;
-        msg.payload.ack_set_periodic_sampler_msg.ack = 1;
-        msg.which_payload = DeviceToHostMessage_ack_set_periodic_sampler_msg_tag;
-        stream = pb_ostream_from_buffer(msg_buf, sizeof(msg_buf));
-        // Send acknowledge message back to host
-        if (!pb_encode_ex(&stream, DeviceToHostMessage_fields, &msg, PB_ENCODE_DELIMITED))
-        {
-          SEGGER_RTT_printf(0, "ERROR : DeviceToHostMessage encode failed.\n");
-          printf("ERROR : DeviceToHostMessage encode failed.\n");
-        }
-        // Flush the cdc tx fifo to ensure that set acknowledge can be sent back to host
-        tud_cdc_write_clear();
-        uint32_t bytes_written = tud_cdc_write(msg_buf, stream.bytes_written);
-        // When the number of bytes transmitted is small, they will hang around
-        // in the TX FIFO and accumulate before a critical mass is reached for
-        // Tinyusb to send all of them with a bulk transfer, we want to transmit
-        // instantly, so force send with tud_cdc_write_flush()
-        bytes_written = tud_cdc_write_flush();
+      vTaskDelay(1);
+    }
+    // Clear the tx fifo of the data interface to ensure nothing else gets sent
+    egress_write_clear();
+  }
+}
 
-        // Make sure the ack message is transmitted
-        assert(bytes_written == stream.bytes_written);
-        SEGGER_RTT_printf(0, "Ack_set_periodic_sampler_msg sent. Msg length = %" PRIu32 "\n", bytes_written);
-        printf("Ack_set_periodic_sampler_msg sent. Msg length = %" PRIu32 "\n", bytes_written);
+// Start the periodic sampler with the selected sampling clock and ADC backend, it has to run on core 1
+// such that the timer and readout interrupts are handled on core 1
+static bool start_periodic_sampler(alarm_pool_t *alarm_pool, const SetPeriodicSamplerMessage* config)
+{
+  uint32_t sampling_period_us = (uint32_t) config->sampling_period;
+  SamplingClock sampling_clock = config->has_sampling_clock ? config->sampling_clock : SamplingClock_SAMPLING_CLOCK_TIMER;
 
-        // Send task notification to periodic_sampler_task_c1 task to set periodic sampler
-        xTaskNotify(periodic_sampler_handle_c1, notificationvalue, eSetValueWithOverwrite);
+  // The PIO backend always brings its own clock, the PWM clock needs the DMA readout
+  enum ad7606bBackend backend = periodic_sampler_adc_backend;
+  if (sampling_clock == SamplingClock_SAMPLING_CLOCK_PIO)
+  {
+    backend = AD7606B_BACKEND_PIO;
+  }else if (sampling_clock == SamplingClock_SAMPLING_CLOCK_PWM)
+  {
+    backend = AD7606B_BACKEND_DMA;
+  }else if (backend == AD7606B_BACKEND_PIO)
+  {
+    sampling_clock = SamplingClock_SAMPLING_CLOCK_PIO;
+  }
+  // Only read out the channels requested by the host, by default the ones used by the connected sensors
+  adc_channel_mask = (uint8_t) ((1U << num_of_adc_chan) - 1U);
+  if (config->has_channel_mask && config->channel_mask != 0U)
+  {
+    adc_channel_mask = (uint8_t) config->channel_mask;
+  }
+  sample_frame_format = config->has_frame_format ? config->frame_format : FrameFormat_FRAME_FORMAT_INT32;
+  // The test pattern leaves the ADC alone, the pattern restarts with every stream
+  test_pattern_active = config->has_test_pattern && config->test_pattern && (test_pattern_sensor_sample_func != NULL);
+  if (test_pattern_active)
+  {
+    adc_channel_mask = 0;
+    test_pattern_reset();
+    SEGGER_RTT_printf(0, "Streaming the test pattern\n");
+  }
+  adc_num_of_words = ad7606b_mask_to_num_of_words(adc_channel_mask);
+  SEGGER_RTT_printf(0, "ADC channel mask = 0x%02X, frame format = %d\n", adc_channel_mask, (int) sample_frame_format);
+
+  // Without any ADC channel there is nothing to pace or read out in hardware
+  if (adc_channel_mask == 0)
+  {
+    backend = AD7606B_BACKEND_BLOCKING;
+    sampling_clock = SamplingClock_SAMPLING_CLOCK_TIMER;
+  }
+  ad7606b_set_backend(backend);
+  memset(&sampler_interval_stats, 0, sizeof(sampler_interval_stats));
+  sampler_interval_stats_started = 0;
+  // The bins of the interval histogram span a period centred on the sampling period, from half a period to one
+  // and a half, in steps of at least 1 us
+  uint32_t interval_bin_width = (sampling_period_us >= METRICS_HISTOGRAM_NUM_OF_BINS) ? sampling_period_us / METRICS_HISTOGRAM_NUM_OF_BINS : 1U;
+  uint32_t interval_half_span = interval_bin_width * (METRICS_HISTOGRAM_NUM_OF_BINS / 2U);
+  uint32_t interval_origin = (sampling_period_us > interval_half_span) ? sampling_period_us - interval_half_span : 0U;
+  metrics_histogram_init(&sample_interval_histogram, interval_origin, interval_bin_width);
+  metrics_histogram_init(&sampler_isr_histogram, 0, 1);
+  late_samples = 0;
+  late_sample_threshold_us = sampling_period_us + sampling_period_us / 2U;
+  periodic_sampler_period_us = sampling_period_us;
+
+  // Capture a window around a trigger instead of streaming when the host has set one up, the frames go
+  // into the capture buffer at the sampling rate, so they are never decimated
+  capture.state = CAPTURE_STATE_IDLE;
+  bool capture_armed = (capture_config.trigger != CaptureTrigger_CAPTURE_TRIGGER_NONE) && arm_capture(&capture_config);
+
+  // Decimate on core 0 when the host asks for a longer output period, the ratio is rounded down to what
+  // the filter chain supports
+  // Aggregate on core 0 instead when the host asks for statistics over windows, the decimator is bypassed then
+  // Take spectra on core 0 ahead of both when the host asks for them, and detect events ahead of all of them
+  // The test pattern is never processed, so that the host gets every sample as it was produced
+  bool streaming = !capture_armed && sampling_period_us > 0U && !test_pattern_active;
+  event_detector_active = streaming && event_detector_init(&event_detector, sample_frame_num_of_values());
+  for (uint8_t c = 0; event_detector_active && c < event_detector.num_of_channels; c++)
+  {
+    const SetEventDetectorMessage* channel_config = &event_detector_config[c];
+    // The values of EventPolarity and enum eventPolarity are the same, the setting has been checked on receipt
+    event_detector_set_channel(&event_detector, c, (uint8_t) channel_config->polarity, channel_config->threshold, channel_config->hysteresis);
+  }
+  event_detector_active = event_detector_active && event_detector_enabled(&event_detector);
+  streaming = streaming && !event_detector_active;
+  spectrum_active = streaming && (spectrum_config.fft_size > 0U) &&
+                    spectrum_init(&spectrum, spectrum_config.fft_size, sample_frame_num_of_values(), (uint8_t) spectrum_config.num_of_peaks);
+  uint32_t window_frames = (streaming && !spectrum_active) ? aggregator_config.window_us / sampling_period_us : 0U;
+  aggregator_active = (window_frames > 0U) && aggregator_init(&aggregator, window_frames, sample_frame_num_of_values());
+  uint32_t decimation_ratio = (streaming && !spectrum_active && !aggregator_active) ? decimator_config.output_period_us / sampling_period_us : 0U;
+  decimation_ratio -= decimation_ratio % DECIMATOR_FIR_RATIO;
+  if (decimation_ratio > DECIMATOR_MAX_RATIO)
+  {
+    decimation_ratio = DECIMATOR_MAX_RATIO;
+  }
+  decimator_active = (decimation_ratio >= DECIMATOR_FIR_RATIO) && decimator_init(&decimator, decimation_ratio, sample_frame_num_of_values());
+  if (!decimator_active)
+  {
+    decimation_ratio = 1U;
+  }
+  if (aggregator_active)
+  {
+    // The records go through decimator_task_c0 like decimated frames, a record per window
+    decimator_active = 1;
+    decimation_ratio = window_frames;
+    SEGGER_RTT_printf(0, "Aggregating windows of %" PRIu32 " frames\n", window_frames);
+  }
+  if (spectrum_active)
+  {
+    // Likewise, a record per channel every fft_size frames
+    decimator_active = 1;
+    decimation_ratio = spectrum.fft_size;
+    SEGGER_RTT_printf(0, "Spectrum over windows of %" PRIu32 " frames, %" PRIu32 " peaks\n", spectrum.fft_size, (uint32_t) spectrum.num_of_peaks);
+  }
+  if (event_detector_active)
+  {
+    // Likewise, a record per event, at no fixed rate
+    decimator_active = 1;
+    SEGGER_RTT_printf(0, "Detecting events\n");
+  }
+  uint32_t output_period_us = sampling_period_us * decimation_ratio;
+  decimator_input_period_us = sampling_period_us;
+  decimator_next_input_index = 0;
+  decimator_input_gaps = 0;
+  decimator_busy_us = 0;
+  decimator_input_frames = 0;
+  egress_busy_us = 0;
+  SEGGER_RTT_printf(0, "Decimation ratio = %" PRIu32 ", output period = %" PRIu32 " us\n", decimation_ratio, output_period_us);
+
+  // Batch frames into blocks, unless a single frame already takes longer than the flush timeout
+  uint32_t frames_per_block = config->has_frames_per_block ? config->frames_per_block : 1U;
+  if (output_period_us >= SAMPLE_BLOCK_FLUSH_TIMEOUT_US)
+  {
+    frames_per_block = 1U;
+  }
+  if (decimator_active)
+  {
+    // The decimator input is only bounded by the block size and the flush timeout
+    reset_sample_block(&sample_block, &decimator_ring, decimator_handle_c0, SAMPLE_BLOCK_MAX_FRAMES);
+    reset_sample_block(&decimated_block, &egress_ring, cdc_egress_handle_c1, frames_per_block);
+    decimated_block.payload_type = event_detector_active ? STREAM_FRAME_TYPE_EVENT :
+                                   (spectrum_active ? STREAM_FRAME_TYPE_SPECTRUM :
+                                   (aggregator_active ? STREAM_FRAME_TYPE_AGGREGATE : STREAM_FRAME_TYPE_DATA));
+    egress_producer = &decimated_block;
+  }else
+  {
+    reset_sample_block(&sample_block, &egress_ring, cdc_egress_handle_c1, frames_per_block);
+    egress_producer = &sample_block;
+  }
+  // The host may leave part of the egress ring unused, e.g. to measure how deep it has to be
+  if (config->has_egress_ring_depth && config->egress_ring_depth > 0U && config->egress_ring_depth < egress_producer->ring_depth)
+  {
+    egress_producer->ring_depth = config->egress_ring_depth;
+  }
+  egress_data_interface = config->has_data_interface ? config->data_interface : DataInterface_DATA_INTERFACE_CDC;
+  egress_stream_encoding = config->has_stream_encoding ? config->stream_encoding : StreamEncoding_STREAM_ENCODING_RAW;
+  egress_sampling_period_us = output_period_us;
+  egress_stalls = 0;
+  egress_partial_writes = 0;
+  egress_raw_bytes = 0;
+  egress_encoded_bytes = 0;
+  SEGGER_RTT_printf(0, "Sample block size = %" PRIu32 " frames, egress ring depth = %" PRIu32 " blocks\n", egress_producer->frames_per_block, egress_producer->ring_depth);
+
+  if (backend == AD7606B_BACKEND_PIO)
+  {
+    // The state machine paces the conversions itself, no timer is needed
+    if (!ad7606b_pio_start(adc_frame_cb, adc_num_of_words, sampling_period_us))
+    {
+      ad7606b_set_backend(AD7606B_BACKEND_BLOCKING);
+      return false;
+    }
+    periodic_sampler_timer_active = 0;
+    SEGGER_RTT_printf(0, "Started PIO ADC backend with sampling period = %" PRIu32 " nanoseconds\n", ad7606b_pio_get_period_ns());
+    return true;
+  }
+
+  if (backend == AD7606B_BACKEND_DMA)
+  {
+    // Register the readout interrupts on core 1, where the conversions are started
+    if (!ad7606b_dma_start(adc_frame_cb, adc_num_of_words))
+    {
+      ad7606b_set_backend(AD7606B_BACKEND_BLOCKING);
+      return false;
+    }
+  }
+
+  if (sampling_clock == SamplingClock_SAMPLING_CLOCK_PWM)
+  {
+    // CONVST is driven by the PWM slice, the data path is triggered by BUSY alone
+    uint32_t period_ns = ad7606b_pwm_start(sampling_period_us);
+    if (period_ns == 0)
+    {
+      ad7606b_dma_stop();
+      ad7606b_set_backend(AD7606B_BACKEND_BLOCKING);
+      return false;
+    }
+    periodic_sampler_timer_active = 0;
+    SEGGER_RTT_printf(0, "Started PWM sampling clock with sampling period = %" PRIu32 " nanoseconds\n", period_ns);
+    return true;
+  }
+
+  // Convert the unsigned into signed to be passed in as an argument
+  // Maximum sampling frequency is 25000Hz, this is determined through experimentation.
+  // The upper limit is determined by the execution time of tud_cdc_write()
+  int64_t delay_us = (sampling_period_us >= 40U) ? -(int64_t)sampling_period_us : -40;
+  // Set up a repeating timer
+  // if delay_us > 0, then this is the delay between one callback ending and the next starting;
+  // if delay_us < 0, then this is the negative of the time between the starts of the callbacks.
+  if (!alarm_pool_add_repeating_timer_us(alarm_pool, delay_us, periodic_sampler_cb, NULL, &(periodic_sampler_timer)))
+  {
+    ad7606b_dma_stop();
+    ad7606b_set_backend(AD7606B_BACKEND_BLOCKING);
+    return false;
+  }
+  periodic_sampler_timer_active = 1;
+  // RTT has no 64-bit conversions, the period fits into 32 bits
+  SEGGER_RTT_printf(0, "Added periodic sampler repeating timer with samping period = %" PRId32 " microseconds\n", (int32_t) delay_us);
+  return true;
+}
+
+// Stop the periodic sampler and whichever ADC backend is running, it has to run on core 1
+static void stop_periodic_sampler(void)
+{
+  // Cancel any repeating timer first so that no further conversion is started
+  if (periodic_sampler_timer_active)
+  {
+    if (!cancel_repeating_timer(&(periodic_sampler_timer)))
+    {
+      SEGGER_RTT_printf(0, "ERROR : Failed to cancel periodic sampler.\n");
+    }
+    periodic_sampler_timer_active = 0;
+  }
+
+  switch (ad7606b_get_backend())
+  {
+    case AD7606B_BACKEND_DMA:
+      // Stop the PWM sampling clock if it is in use, it is harmless otherwise
+      ad7606b_pwm_stop();
+      // Wait for the last readout to finish before the egress path is reset
+      ad7606b_dma_stop();
+      SEGGER_RTT_printf(0, "DMA readout overruns = %" PRIu32 "\n", ad7606b_dma_get_overruns());
+      break;
+    case AD7606B_BACKEND_PIO:
+      ad7606b_pio_stop();
+      SEGGER_RTT_printf(0, "PIO RX FIFO stalls = %" PRIu32 ", missed frames = %" PRIu32 "\n", ad7606b_pio_get_stalls(), ad7606b_pio_get_missed_frames());
+      break;
+    default:
+      break;
+  }
+  ad7606b_set_backend(AD7606B_BACKEND_BLOCKING);
+  active_periodic_sampler = 0;
+  report_sample_jitter();
+  SEGGER_RTT_printf(0, "Dropped frames = %" PRIu32 "\n", sample_block.frame_drops);
+  if (decimator_active)
+  {
+    SEGGER_RTT_printf(0, "Dropped decimated frames = %" PRIu32 ", gaps in the decimator input = %" PRIu32 "\n",
+                      decimated_block.frame_drops, decimator_input_gaps);
+  }
+  SEGGER_RTT_printf(0, "Egress stalls = %" PRIu32 ", partial writes = %" PRIu32 "\n", egress_stalls, egress_partial_writes);
+  report_pipeline_cost();
+  if (egress_encoded_bytes > 0U)
+  {
+    // In hundredths, SEGGER_RTT_printf() has no floating point support
+    uint32_t ratio = (uint32_t) (((uint64_t) egress_raw_bytes * 100U) / egress_encoded_bytes);
+    SEGGER_RTT_printf(0, "Compression : %" PRIu32 " bytes into %" PRIu32 " bytes, ratio = %" PRIu32 ".%02" PRIu32 "\n",
+                      egress_raw_bytes, egress_encoded_bytes, ratio / 100U, ratio % 100U);
+  }
+}
+
+// Report the CPU time per frame of the periodic sampler spent on core 0, in cdc_egress_task_c1 and in the
+// sampler interrupts over RTT, in nanoseconds, for comparing the raw stream with the modes of decimator_task_c0,
+// e.g. event detection
+// The first two are measured with the microsecond timer around whole blocks, interrupts taken meanwhile included
+static void report_pipeline_cost(void)
+{
+  uint32_t num_of_frames = sample_block.frame_index;
+  if (num_of_frames == 0U)
+  {
+    return;
+  }
+  if (decimator_active && decimator_input_frames > 0U)
+  {
+    SEGGER_RTT_printf(0, "Core 0 : %" PRIu32 " frames in %" PRIu32 " us, %" PRIu32 " ns per frame\n", decimator_input_frames,
+                      decimator_busy_us, (uint32_t) (((uint64_t) decimator_busy_us * 1000U) / decimator_input_frames));
+  }
+  SEGGER_RTT_printf(0, "Egress : %" PRIu32 " us, %" PRIu32 " ns per sampled frame, %" PRIu32 " frames or records sent\n", egress_busy_us,
+                    (uint32_t) (((uint64_t) egress_busy_us * 1000U) / num_of_frames), egress_producer->frame_index);
+  // The sampler interrupts of core 1 come on top, the same for the raw stream and every kind of processing
+  if (sampler_isr_histogram.count > 0U)
+  {
+    SEGGER_RTT_printf(0, "Sampler interrupts : %" PRIu32 " us, %" PRIu32 " ns per sampled frame, at most %" PRIu32 " us\n",
+                      (uint32_t) sampler_isr_histogram.sum, (uint32_t) ((sampler_isr_histogram.sum * 1000U) / sampler_isr_histogram.count),
+                      sampler_isr_histogram.max);
+  }
+}
+
+// Record the time at which a sample has been taken, called in interrupt context
+static void record_sample_timestamp(uint32_t timestamp_us)
+{
+  struct samplerIntervalStats* stats = &sampler_interval_stats;
+  if (!sampler_interval_stats_started)
+  {
+    stats->last_timestamp_us = timestamp_us;
+    stats->min_interval_us = UINT32_MAX;
+    sampler_interval_stats_started = 1;
+    return;
+  }
+  uint32_t interval_us = timestamp_us - stats->last_timestamp_us;
+  stats->last_timestamp_us = timestamp_us;
+  metrics_histogram_add(&sample_interval_histogram, interval_us);
+  if (interval_us > late_sample_threshold_us)
+  {
+    late_samples++;
+  }
+  stats->num_of_intervals++;
+  stats->sum_interval_us += interval_us;
+  stats->sum_sq_interval_us += (uint64_t) interval_us * interval_us;
+  if (interval_us < stats->min_interval_us)
+  {
+    stats->min_interval_us = interval_us;
+  }
+  if (interval_us > stats->max_interval_us)
+  {
+    stats->max_interval_us = interval_us;
+  }
+}
+
+// Integer square root, used to report the RMS jitter without floating point
+static uint64_t isqrt64(uint64_t value)
+{
+  uint64_t root = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// Report the inter-sample interval statistics of the last periodic sampler over RTT
+static void report_sample_jitter(void)
+{
+  const struct samplerIntervalStats* stats = &sampler_interval_stats;
+  if (stats->num_of_intervals == 0)
+  {
+    return;
+  }
+  uint64_t mean_ns = (stats->sum_interval_us * 1000U) / stats->num_of_intervals;
+  uint64_t mean_sq_ns = (stats->sum_sq_interval_us * 1000000U) / stats->num_of_intervals;
+  uint64_t variance_ns = (mean_sq_ns > mean_ns * mean_ns) ? (mean_sq_ns - mean_ns * mean_ns) : 0;
+
+  SEGGER_RTT_printf(0, "Sampling jitter : %" PRIu32 " intervals, mean = %" PRIu32 " ns, min = %" PRIu32 " us, max = %" PRIu32 " us, peak-to-peak = %" PRIu32 " us, rms = %" PRIu32 " ns\n",
+      stats->num_of_intervals, (uint32_t) mean_ns, stats->min_interval_us, stats->max_interval_us,
+      stats->max_interval_us - stats->min_interval_us, (uint32_t) isqrt64(variance_ns));
+}
+
+//--------------------------------------------------------------------+
+// CDC egress task (Core 1)
+//--------------------------------------------------------------------+
+static void cdc_egress_task_c1(void *param)
+{
+  // bool led_state = 0;
+  // Bytes of the oldest block which have already been written into the tx cdc fifo
+  uint32_t bytes_sent = 0;
+  while (true)
+  {
+    if (egress_discard_request)
+    {
+      spsc_ring_discard(&egress_ring);
+      bytes_sent = 0;
+      egress_finish_request = 0;
+      egress_discard_request = 0;
+    }
+
+    uint32_t pending_blocks = spsc_ring_count(&egress_ring);
+    if (pending_blocks == 0U && egress_finish_request)
+    {
+      // Everything committed before the stop has been written, terminate the stream, the sequence of the EOS
+      // frame tells the host how many frames have been produced in total
+      uint8_t eos_frame[STREAM_FRAME_OVERHEAD];
+      uint32_t eos_frame_size = stream_frame_encode(eos_frame, sizeof(eos_frame), STREAM_FRAME_TYPE_EOS,
+                                                    egress_producer->frame_index, time_us_32(), NULL, 0);
+      egress_write_all(eos_frame, eos_frame_size);
+      if (!egress_discard_request)
+      {
+        SEGGER_RTT_printf(0, "End of stream frame sent.\n");
+        egress_finish_request = 0;
+      }
+      continue;
+    }
+    if (pending_blocks == 0U)
+    {
+      // Sleep until the periodic sampler commits a block or a discard is requested
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    if (pending_blocks < EGRESS_TRIGGER_LEVEL && bytes_sent == 0U && !egress_finish_request)
+    {
+      // Give the periodic sampler a chance to reach the trigger level before the deadline
+      TickType_t wait_start = xTaskGetTickCount();
+      while (spsc_ring_count(&egress_ring) < EGRESS_TRIGGER_LEVEL && !egress_discard_request &&
+             (xTaskGetTickCount() - wait_start) < pdMS_TO_TICKS(EGRESS_DEADLINE_MS))
+      {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(EGRESS_DEADLINE_MS) - (xTaskGetTickCount() - wait_start));
+      }
+      // Either the trigger level or the deadline has been reached, send what is pending
+      if (egress_discard_request)
+      {
+        continue;
+      }
+    }
+
+    // Only write what the tx fifo can take, the rest is written once tud_cdc_tx_complete_cb() or
+    // tud_vendor_tx_cb() fires
+    uint32_t fifo_available = egress_write_available();
+    if (fifo_available == 0U)
+    {
+      egress_stalls++;
+      // Push out whatever is in the fifo and wait for the transfer to complete, in case the transfer
+      // completes before the wait the deadline makes sure the task retries
+      egress_write_flush();
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(EGRESS_DEADLINE_MS));
+      continue;
+    }
+
+    // The block is sent in place, it is only released once all of it is in the tx cdc fifo, the consumer owns
+    // it until then so the CRC is appended in place as well, which keeps it out of the sampler interrupts
+    struct egressBlock* block = (struct egressBlock*) spsc_ring_peek(&egress_ring);
+    uint32_t start_us = time_us_32();
+    if (bytes_sent == 0U)
+    {
+      encode_egress_block(block);
+    }
+    uint32_t bytes_remaining = block->num_of_bytes - bytes_sent;
+    uint32_t bytes_to_write = (bytes_remaining < fifo_available) ? bytes_remaining : fifo_available;
+    uint32_t bytes_written = egress_write(&block->buf[block->frame_offset + bytes_sent], bytes_to_write);
+    egress_busy_us += time_us_32() - start_us;
+    if (bytes_written < bytes_remaining)
+    {
+      egress_partial_writes++;
+    }
+    bytes_sent += bytes_written;
+    if (bytes_sent == block->num_of_bytes)
+    {
+      spsc_ring_release(&egress_ring);
+      bytes_sent = 0;
+      // Don't leave a short packet sitting in the fifo once everything pending has been written
+      if (spsc_ring_count(&egress_ring) == 0U)
+      {
+        egress_write_flush();
+      }
+    }
+  }
+}
+
+// Encode everything of a DeviceToHostMessage carrying a SampleBatchMessage which goes in front of the samples of
+// the block, returns the number of bytes written into buf, which has to hold SAMPLE_BATCH_MAX_PREFIX_SIZE bytes
+// The samples field is the last one, so the output is what pb_encode() gives for the whole message
+static uint32_t encode_sample_batch_prefix(uint8_t* buf, const struct egressBlock* block)
+{
+  // The fields of SampleBatchMessage up to the length of the samples, the length of the SampleBatchMessage
+  // is only known after that
+  uint8_t fields_buf[SAMPLE_BATCH_MAX_PREFIX_SIZE];
+  pb_ostream_t stream = pb_ostream_from_buffer(fields_buf, sizeof(fields_buf));
+  pb_encode_tag(&stream, PB_WT_VARINT, SampleBatchMessage_start_timestamp_us_tag);
+  pb_encode_varint(&stream, block->first_frame_timestamp_us);
+  pb_encode_tag(&stream, PB_WT_VARINT, SampleBatchMessage_sampling_period_us_tag);
+  pb_encode_varint(&stream, egress_sampling_period_us);
+  pb_encode_tag(&stream, PB_WT_VARINT, SampleBatchMessage_channel_mask_tag);
+  pb_encode_varint(&stream, adc_channel_mask);
+  pb_encode_tag(&stream, PB_WT_VARINT, SampleBatchMessage_frame_format_tag);
+  pb_encode_varint(&stream, (uint32_t) sample_frame_format);
+  pb_encode_tag(&stream, PB_WT_VARINT, SampleBatchMessage_first_frame_index_tag);
+  pb_encode_varint(&stream, block->first_frame_index);
+  pb_encode_tag(&stream, PB_WT_STRING, SampleBatchMessage_samples_tag);
+  pb_encode_varint(&stream, block->payload_size);
+  uint32_t fields_size = stream.bytes_written;
+
+  stream = pb_ostream_from_buffer(buf, SAMPLE_BATCH_MAX_PREFIX_SIZE);
+  pb_encode_tag(&stream, PB_WT_STRING, DeviceToHostMessage_sample_batch_msg_tag);
+  pb_encode_varint(&stream, fields_size + block->payload_size);
+  pb_write(&stream, fields_buf, fields_size);
+  return stream.bytes_written;
+}
+
+// Put the headers of the configured stream encoding into the headroom of the block and seal the stream frame,
+// the sample frames themselves are never moved
+static void encode_egress_block(struct egressBlock* block)
+{
+  uint32_t payload_offset = EGRESS_BLOCK_HEADROOM;
+  uint32_t payload_size = block->payload_size;
+  uint8_t frame_type = block->payload_type;
+
+  if (frame_type != STREAM_FRAME_TYPE_DATA)
+  {
+    // Not sample frames, e.g. a message of the device sent in-band
+  }else if (egress_stream_encoding == StreamEncoding_STREAM_ENCODING_SAMPLE_BATCH)
+  {
+    uint8_t prefix[SAMPLE_BATCH_MAX_PREFIX_SIZE];
+    uint32_t prefix_size = encode_sample_batch_prefix(prefix, block);
+    payload_offset -= prefix_size;
+    memcpy(&block->buf[payload_offset], prefix, prefix_size);
+    payload_size += prefix_size;
+    frame_type = STREAM_FRAME_TYPE_MESSAGE;
+  }else if (egress_stream_encoding == StreamEncoding_STREAM_ENCODING_DELTA)
+  {
+    uint8_t value_size = sample_frame_value_size();
+    uint8_t num_of_channels = sample_frame_num_of_values();
+    uint32_t frame_size = (uint32_t) value_size * num_of_channels;
+    // Only keep the compressed block if it is smaller, otherwise the frames are sent as they are
+    uint32_t encoded_size = (frame_size == 0U) ? 0U :
+                            sample_codec_encode(egress_codec_buf, block->payload_size - 1U, &block->buf[EGRESS_BLOCK_HEADROOM],
+                                                block->payload_size / frame_size, num_of_channels, value_size);
+    if (encoded_size > 0U)
+    {
+      memcpy(&block->buf[EGRESS_BLOCK_HEADROOM], egress_codec_buf, encoded_size);
+      payload_size = encoded_size;
+      frame_type = STREAM_FRAME_TYPE_DELTA;
+    }
+    egress_raw_bytes += block->payload_size;
+    egress_encoded_bytes += payload_size;
+  }
+
+  block->frame_offset = payload_offset - STREAM_FRAME_HEADER_SIZE;
+  stream_frame_write_header(&block->buf[block->frame_offset], frame_type, (uint16_t) payload_size,
+                            block->first_frame_index, block->first_frame_timestamp_us);
+  block->num_of_bytes = stream_frame_seal(&block->buf[block->frame_offset]);
+}
+
+// Get the number of bytes the tx fifo of the data interface can take
+static uint32_t egress_write_available(void)
+{
+  if (egress_data_interface == DataInterface_DATA_INTERFACE_VENDOR)
+  {
+    return tud_vendor_write_available();
+  }
+  return tud_cdc_n_write_available(CDC_ITF_DATA);
+}
+
+// Write into the tx fifo of the data interface
+static uint32_t egress_write(const void* buf, uint32_t bufsize)
+{
+  if (egress_data_interface == DataInterface_DATA_INTERFACE_VENDOR)
+  {
+    return tud_vendor_write(buf, bufsize);
+  }
+  return tud_cdc_n_write(CDC_ITF_DATA, buf, bufsize);
+}
+
+// Start a transfer with whatever is in the tx fifo of the data interface
+static void egress_write_flush(void)
+{
+  // Both classes only start a transfer by themselves once a full packet is in the fifo, a short tail written
+  // while the endpoint is idle waits for a flush
+  if (egress_data_interface == DataInterface_DATA_INTERFACE_VENDOR)
+  {
+    tud_vendor_write_flush();
+  }else
+  {
+    tud_cdc_n_write_flush(CDC_ITF_DATA);
+  }
+}
+
+// Drop whatever hasn't been sent from the tx fifos of both data interfaces
+static void egress_write_clear(void)
+{
+  tud_cdc_n_write_clear(CDC_ITF_DATA);
+  // Only the releases of TinyUSB after the one of pico-sdk 1.5.1 can clear the vendor tx fifo, with that one
+  // its stale bytes go out ahead of the next stream, which the host parser resynchronises on
+  if (tud_vendor_n_write_clear != NULL)
+  {
+    tud_vendor_n_write_clear(0);
+  }
+}
+
+// Write all of a buffer into the tx fifo of the data interface and start the transfer, waiting for room
+// as needed, it gives up if a discard is requested, cdc_egress_task_c1 only
+static void egress_write_all(const uint8_t* buf, uint32_t bufsize)
+{
+  uint32_t bytes_sent = 0;
+  while (bytes_sent < bufsize && !egress_discard_request)
+  {
+    uint32_t fifo_available = egress_write_available();
+    if (fifo_available == 0U)
+    {
+      egress_write_flush();
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(EGRESS_DEADLINE_MS));
+      continue;
+    }
+    uint32_t bytes_remaining = bufsize - bytes_sent;
+    bytes_sent += egress_write(&buf[bytes_sent], (bytes_remaining < fifo_available) ? bytes_remaining : fifo_available);
+  }
+  egress_write_flush();
+}
+
+// Write all of a buffer into the tx fifo of the control port and start the transfer, waiting for room as
+// needed, returns false if the host hasn't read it within CONTROL_WRITE_TIMEOUT_MS, cdc_ingress_task_c0 only
+static bool control_write_all(const uint8_t* buf, uint32_t bufsize)
+{
+  uint32_t bytes_sent = 0;
+  TickType_t wait_start = xTaskGetTickCount();
+  while (bytes_sent < bufsize)
+  {
+    uint32_t fifo_available = tud_cdc_n_write_available(CDC_ITF_CONTROL);
+    if (fifo_available == 0U)
+    {
+      tud_cdc_n_write_flush(CDC_ITF_CONTROL);
+      if ((xTaskGetTickCount() - wait_start) >= pdMS_TO_TICKS(CONTROL_WRITE_TIMEOUT_MS))
+      {
+        return false;
+      }
+      vTaskDelay(1);
+      continue;
+    }
+    uint32_t bytes_remaining = bufsize - bytes_sent;
+    bytes_sent += tud_cdc_n_write(CDC_ITF_CONTROL, &buf[bytes_sent], (bytes_remaining < fifo_available) ? bytes_remaining : fifo_available);
+  }
+  tud_cdc_n_write_flush(CDC_ITF_CONTROL);
+  return true;
+}
+
+// Acknowledge a host-to-device message, or reject it with ack = false, which_payload is the tag of the
+// Ack*Message, all of which only hold the ack field
+static bool send_ack(pb_size_t which_payload, bool ack)
+{
+  uint8_t msg_buf[DeviceToHostMessage_FIXED_DELIMITED_MAX_SIZE];
+  DeviceToHostMessage msg = DeviceToHostMessage_init_zero;
+  switch (which_payload)
+  {
+    case DeviceToHostMessage_ack_stop_periodic_sampler_msg_tag:
+      msg.payload.ack_stop_periodic_sampler_msg.ack = ack;
+      break;
+    case DeviceToHostMessage_ack_set_periodic_sampler_msg_tag:
+      msg.payload.ack_set_periodic_sampler_msg.ack = ack;
+      break;
+    case DeviceToHostMessage_ack_set_decimator_msg_tag:
+      msg.payload.ack_set_decimator_msg.ack = ack;
+      break;
+    case DeviceToHostMessage_ack_set_capture_msg_tag:
+      msg.payload.ack_set_capture_msg.ack = ack;
+      break;
+    case DeviceToHostMessage_ack_execute_burst_capture_msg_tag:
+      msg.payload.ack_execute_burst_capture_msg.ack = ack;
+      break;
+    case DeviceToHostMessage_ack_set_aggregator_msg_tag:
+      msg.payload.ack_set_aggregator_msg.ack = ack;
+      break;
+    case DeviceToHostMessage_ack_set_spectrum_msg_tag:
+      msg.payload.ack_set_spectrum_msg.ack = ack;
+      break;
+    case DeviceToHostMessage_ack_set_event_detector_msg_tag:
+      msg.payload.ack_set_event_detector_msg.ack = ack;
+      break;
+    default:
+      SEGGER_RTT_printf(0, "ERROR : %" PRIu32 " is not the tag of an ack message.\n", (uint32_t) which_payload);
+      return false;
+  }
+  msg.which_payload = which_payload;
+  // Encoded the same way as pb_encode_ex() with PB_ENCODE_DELIMITED, and flushed straight away rather than
+  // waiting in the TX FIFO for a bulk transfer, the control port never carries sample data to wait behind
+  uint32_t msg_length = DeviceToHostMessage_encode_fixed_delimited(msg_buf, &msg);
+  bool sent = control_write_all(msg_buf, msg_length);
+  SEGGER_RTT_printf(0, "Ack msg %" PRIu32 " (ack = %d) %s. Msg length = %" PRIu32 "\n",
+                    (uint32_t) which_payload, (int) ack, sent ? "sent" : "not sent", msg_length);
+  return sent;
+}
+
+// Check the decimator and aggregator settings against the sampling period of a periodic sampler, in the
+// same order of precedence as start_periodic_sampler(), a window or output period shorter than the sampling
+// period would otherwise silently give the raw stream
+static bool stream_processing_valid(const SetPeriodicSamplerMessage* config)
+{
+  uint32_t sampling_period_us = (uint32_t) config->sampling_period;
+  bool processed = (capture_config.trigger == CaptureTrigger_CAPTURE_TRIGGER_NONE) &&
+                   !(config->has_test_pattern && config->test_pattern && (test_pattern_sensor_sample_func != NULL)) &&
+                   (spectrum_config.fft_size == 0U);
+  if (!processed)
+  {
+    return true;
+  }
+  if (aggregator_config.window_us > 0U)
+  {
+    return (aggregator_config.window_us / sampling_period_us) >= 1U;
+  }
+  if (decimator_config.output_period_us > 0U)
+  {
+    return (decimator_config.output_period_us / sampling_period_us) >= DECIMATOR_FIR_RATIO;
+  }
+  return true;
+}
+
+// Fill in a HistogramMessage from a histogram, the bins are encoded by nanopb_cb_encode_histogram_bins()
+static void fill_histogram_msg(HistogramMessage* msg, const struct metricsHistogram* histogram)
+{
+  msg->origin = histogram->origin;
+  msg->bin_width = histogram->bin_width;
+  msg->count = histogram->count;
+  msg->min = (histogram->count > 0U) ? histogram->min : 0U;
+  msg->max = histogram->max;
+  msg->sum = histogram->sum;
+  msg->bins.funcs.encode = nanopb_cb_encode_histogram_bins;
+  msg->bins.arg = (void*) histogram;
+}
+
+// Cores a task may run on, a single-core kernel such as the one of the host-native build runs every task on
+// core 0
+static UBaseType_t task_core_affinity(const TaskStatus_t* status)
+{
+#if (configNUMBER_OF_CORES > 1) && (configUSE_CORE_AFFINITY == 1)
+  return status->uxCoreAffinityMask;
+#else
+  (void) status;
+  return 1U;
+#endif
+}
+
+// Share of the interval of a run time, in permille
+static uint32_t load_permille(uint64_t run_time_us, uint64_t interval_us)
+{
+  if (interval_us == 0U)
+  {
+    return 0;
+  }
+  uint64_t load = (run_time_us * 1000U) / interval_us;
+  return (load > 1000U) ? 1000U : (uint32_t) load;
+}
+
+// Encode a DeviceToHostMessage carrying a StatsMessage into buf, delimited like every message on the control
+// port, returns its length or 0 if it doesn't fit
+// The loads are over the interval since the previous call, the run time of every task is taken from the
+// FreeRTOS run time stats, the ones of the idle tasks are left out of the core loads as they are what remains,
+// and interrupts count towards the task they interrupted
+static uint32_t encode_stats_msg(uint8_t* buf, uint32_t bufsize, bool include_tasks)
+{
+  DeviceToHostMessage msg = DeviceToHostMessage_init_zero;
+  StatsMessage* stats = &msg.payload.stats_msg;
+  msg.which_payload = DeviceToHostMessage_stats_msg_tag;
+
+  uint64_t now_us = time_us_64();
+  uint64_t interval_us = now_us - stats_previous_timestamp_us;
+  stats_previous_timestamp_us = now_us;
+  stats->uptime_us = now_us;
+  stats->interval_us = (interval_us > UINT32_MAX) ? UINT32_MAX : (uint32_t) interval_us;
+
+  configRUN_TIME_COUNTER_TYPE total_run_time;
+  UBaseType_t num_of_tasks = uxTaskGetSystemState(stats_task_status, STATS_MAX_TASKS, &total_run_time);
+  uint64_t core_run_times[2] = {0, 0};
+  for (UBaseType_t i = 0; i < num_of_tasks; i++)
+  {
+    const TaskStatus_t* status = &stats_task_status[i];
+    configRUN_TIME_COUNTER_TYPE previous_run_time = 0;
+    for (UBaseType_t j = 0; j < stats_num_of_previous_run_times; j++)
+    {
+      if (stats_previous_run_times[j].task_number == status->xTaskNumber)
+      {
+        previous_run_time = stats_previous_run_times[j].run_time;
+        break;
+      }
+    }
+    uint64_t run_time_us = status->ulRunTimeCounter - previous_run_time;
+    bool idle = (status->uxCurrentPriority == tskIDLE_PRIORITY);
+    UBaseType_t core_affinity = task_core_affinity(status);
+    for (uint32_t core = 0; core < 2U; core++)
+    {
+      if (!idle && core_affinity == (1UL << core))
+      {
+        core_run_times[core] += run_time_us;
+      }
+    }
+
+    TaskStatsMessage* task = &stats_tasks[i];
+    memset(task, 0, sizeof(*task));
+    strncpy(task->name, status->pcTaskName, sizeof(task->name) - 1U);
+    task->core_affinity = (uint32_t) core_affinity & 0x3U;
+    task->priority = (uint32_t) status->uxCurrentPriority;
+    task->run_time_us = status->ulRunTimeCounter;
+    task->load_permille = load_permille(run_time_us, interval_us);
+    task->stack_high_water_mark = (uint32_t) status->usStackHighWaterMark;
+
+    stats_run_times[i].task_number = status->xTaskNumber;
+    stats_run_times[i].run_time = status->ulRunTimeCounter;
+  }
+  memcpy(stats_previous_run_times, stats_run_times, num_of_tasks * sizeof(stats_run_times[0]));
+  stats_num_of_previous_run_times = num_of_tasks;
+  stats->core0_load_permille = load_permille(core_run_times[0], interval_us);
+  stats->core1_load_permille = load_permille(core_run_times[1], interval_us);
+  if (include_tasks)
+  {
+    stats->tasks.funcs.encode = nanopb_cb_encode_task_stats;
+    stats->tasks.arg = (void*) (uintptr_t) num_of_tasks;
+  }
+
+  stats->free_heap_bytes = (uint32_t) xPortGetFreeHeapSize();
+  stats->min_free_heap_bytes = (uint32_t) xPortGetMinimumEverFreeHeapSize();
+
+  // Written by core 1 meanwhile, a counter may be a frame or two behind the others
+  stats->sampling = active_periodic_sampler;
+  stats->sampling_period_us = periodic_sampler_period_us;
+  stats->frames_sampled = sample_block.frame_index;
+  stats->dropped_frames = sample_block.frame_drops;
+  stats->dropped_output_frames = decimator_active ? decimated_block.frame_drops : 0U;
+  stats->late_samples = late_samples;
+  stats->adc_overruns = ad7606b_dma_get_overruns() + ad7606b_pio_get_stalls() + ad7606b_pio_get_missed_frames();
+  stats->egress_stalls = egress_stalls;
+  stats->egress_partial_writes = egress_partial_writes;
+  stats->egress_ring_high_water = egress_producer->ring_high_water;
+  stats->egress_ring_size = egress_producer->ring_depth;
+  stats->decimator_ring_high_water = decimator_active ? sample_block.ring_high_water : 0U;
+  stats->decimator_ring_size = DECIMATOR_RING_NUM_OF_BLOCKS;
+  fill_histogram_msg(&stats->sample_interval_us, &sample_interval_histogram);
+  fill_histogram_msg(&stats->sampler_isr_duration_us, &sampler_isr_histogram);
+
+  pb_ostream_t stream = pb_ostream_from_buffer(buf, bufsize);
+  if (!pb_encode_ex(&stream, DeviceToHostMessage_fields, &msg, PB_ENCODE_DELIMITED))
+  {
+    SEGGER_RTT_printf(0, "ERROR : StatsMessage encoding failed : %s\n", PB_GET_ERROR(&stream));
+    return 0;
+  }
+  return stream.bytes_written;
+}
+
+//--------------------------------------------------------------------+
+// CDC ingress task (Core 0)
+//--------------------------------------------------------------------+
+static void cdc_ingress_task_c0(void *param)
+{
+  // Decode HostToDeviceMessage from CDC RX FIFO
+  HostToDeviceMessage msg = HostToDeviceMessage_init_zero;
+  // Set up the decode callbacks for contents in the oneof payload
+  msg.cb_payload.funcs.decode = nanopb_cb_host_to_device_msg_decode;
+
+  // recv buffer, each message has maximum size of 256 bytes
+  uint8_t recv_buf[256];
+  // int32_t recv_bytes = 0;
+  while (true)
+  {
+    // Since this task is woken up by tud_cdc_rx_cb(), there is guranteed to have content
+    // in CDC RX FIFO
+    // Read the varint which indicates the msg length, as written by pb_encode_ex(..., PB_ENCODE_DELIMITED)
+    uint32_t msg_length = 0;
+    bool msg_length_valid = false;
+    for (uint32_t shift = 0; shift < 32U; shift += 7U)
+    {
+      int32_t c = tud_cdc_n_read_char(CDC_ITF_CONTROL);
+      if (c == -1)
+      {
+        break;
+      }
+      msg_length |= (uint32_t) (c & 0x7F) << shift;
+      if ((c & 0x80) == 0)
+      {
+        msg_length_valid = true;
+        break;
+      }
+    }
+    SEGGER_RTT_printf(0, "Host to Device Message length = %" PRIu32 ".\n", msg_length);
+
+    if (!msg_length_valid || msg_length > sizeof(recv_buf))
+    {
+      // Out of sync with the host, drop whatever is left rather than decoding it as messages
+      SEGGER_RTT_printf(0, "ERROR : Invalid Host to Device Message length.\n");
+      tud_cdc_n_read_flush(CDC_ITF_CONTROL);
+      vTaskSuspend(NULL);
+      continue;
+    }
+    for (uint32_t i = 0; i < msg_length; i++)
+    {
+        recv_buf[i] = tud_cdc_n_read_char(CDC_ITF_CONTROL);
+    }
+
+    pb_istream_t stream = pb_istream_from_buffer(recv_buf, msg_length);
+
+    bool status = pb_decode(&stream, HostToDeviceMessage_fields, &msg);
+    if (status)
+    {
+      SEGGER_RTT_printf(0, "Host to Device Message decode succeeded.\n");
+      // Check the fields of message after decode and act accordingly
+      if (msg.which_payload == HostToDeviceMessage_stop_periodic_sampler_msg_tag)
+      {
+        // A burst capture can't be stopped, and the notification would cancel it before core 1 has started it
+        if (burst_capture_pending)
+        {
+          send_ack(DeviceToHostMessage_ack_stop_periodic_sampler_msg_tag, false);
+        }else
+        {
+          // Send task notification to periodic_sampler_task_c1 task to stop periodic sampling
+          xTaskNotify(periodic_sampler_handle_c1, 0U, eSetValueWithOverwrite);
+
+          // Wait for core 1 to indicate that it has stopped the periodic sampler and sent the rest of the stream
+          // before acknowledging
+          uint32_t notificationvalue = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+          if (notificationvalue == 1U)
+          {
+            // The EOS frame has already been sent on the data interface
+            send_ack(DeviceToHostMessage_ack_stop_periodic_sampler_msg_tag, true);
+          }else
+          {
+            SEGGER_RTT_printf(0, "ERROR : notificationvalue for stop acknowledge from core 1 is not 1U.\n");
+          }
+        }
+
+      }else if (msg.which_payload == HostToDeviceMessage_set_periodic_sampler_msg_tag)
+      {
+        uint32_t notificationvalue = msg.payload.set_periodic_sampler_msg.sampling_period;
+        // The decimator and aggregator settings are only checked against a sampling period here, rather than
+        // falling back to the raw stream when the periodic sampler starts
+        // Refused while a burst capture is pending as well, its notification would be overwritten
+        bool valid = (msg.payload.set_periodic_sampler_msg.sampling_period > 0) && stream_processing_valid(&msg.payload.set_periodic_sampler_msg) &&
+                     !burst_capture_pending;
+        if (valid)
+        {
+          // Hand the rest of the configuration over to core 1, the notification only carries the period
+          periodic_sampler_config = msg.payload.set_periodic_sampler_msg;
+        }
+        send_ack(DeviceToHostMessage_ack_set_periodic_sampler_msg_tag, valid);
+
+        if (valid)
+        {
+          // Send task notification to periodic_sampler_task_c1 task to set periodic sampler
+          xTaskNotify(periodic_sampler_handle_c1, notificationvalue, eSetValueWithOverwrite);
+        }
+
+      }else if (msg.which_payload == HostToDeviceMessage_set_decimator_msg_tag)
+      {
+        // Only taken into account by the next set_periodic_sampler_msg, core 1 reads it when starting, the ratio
+        // to the sampling period is checked then
+        const SetDecimatorMessage* config = &msg.payload.set_decimator_msg;
+        bool valid = (config->output_period_us == 0U) || (config->output_period_us >= DECIMATOR_FIR_RATIO * PERIODIC_SAMPLER_MIN_PERIOD_US);
+        if (valid)
+        {
+          decimator_config = *config;
+        }
+        SEGGER_RTT_printf(0, "Decimator output period = %" PRIu32 " us\n", decimator_config.output_period_us);
+        send_ack(DeviceToHostMessage_ack_set_decimator_msg_tag, valid);
+
+      }else if (msg.which_payload == HostToDeviceMessage_set_capture_msg_tag)
+      {
+        // Only taken into account by the next set_periodic_sampler_msg, core 1 reads it when starting
+        capture_config = msg.payload.set_capture_msg;
+        SEGGER_RTT_printf(0, "Capture trigger = %d, threshold = %" PRId32 "\n", (int) capture_config.trigger, capture_config.threshold);
+        send_ack(DeviceToHostMessage_ack_set_capture_msg_tag, true);
+
+      }else if (msg.which_payload == HostToDeviceMessage_set_aggregator_msg_tag)
+      {
+        // Only taken into account by the next set_periodic_sampler_msg, core 1 reads it when starting, the number
+        // of frames per window is checked then
+        const SetAggregatorMessage* config = &msg.payload.set_aggregator_msg;
+        bool valid = (config->window_us == 0U) || (config->window_us >= PERIODIC_SAMPLER_MIN_PERIOD_US);
+        if (valid)
+        {
+          aggregator_config = *config;
+        }
+        SEGGER_RTT_printf(0, "Aggregator window = %" PRIu32 " us\n", aggregator_config.window_us);
+        send_ack(DeviceToHostMessage_ack_set_aggregator_msg_tag, valid);
+
+      }else if (msg.which_payload == HostToDeviceMessage_get_stats_msg_tag)
+      {
+        // Too large for the fixed codec, so it goes through nanopb, and it may take more than one write
+        uint32_t msg_length = encode_stats_msg(stats_msg_buf, sizeof(stats_msg_buf), msg.payload.get_stats_msg.include_tasks);
+        bool sent = (msg_length > 0U) && control_write_all(stats_msg_buf, msg_length);
+        SEGGER_RTT_printf(0, "Stats_msg %s. Msg length = %" PRIu32 "\n", sent ? "sent" : "not sent", msg_length);
+
+      }else if (msg.which_payload == HostToDeviceMessage_get_device_time_msg_tag)
+      {
+        uint8_t msg_buf[DeviceToHostMessage_FIXED_DELIMITED_MAX_SIZE];
+        DeviceToHostMessage msg_reply = DeviceToHostMessage_init_zero;
+        msg_reply.payload.device_time_msg.request_id = msg.payload.get_device_time_msg.request_id;
+        msg_reply.which_payload = DeviceToHostMessage_device_time_msg_tag;
+        // Taken as late as possible, so only the transfer to the host is left in the round trip, it is the
+        // same clock as the timestamps of the stream
+        msg_reply.payload.device_time_msg.device_time_us = time_us_64();
+        uint32_t msg_length = DeviceToHostMessage_encode_fixed_delimited(msg_buf, &msg_reply);
+        bool sent = control_write_all(msg_buf, msg_length);
+        if (!sent)
+        {
+          SEGGER_RTT_printf(0, "ERROR : Device_time_msg not sent.\n");
+        }
+
+      }else if (msg.which_payload == HostToDeviceMessage_set_event_detector_msg_tag)
+      {
+        // Only taken into account by the next set_periodic_sampler_msg, core 1 reads it when starting
+        const SetEventDetectorMessage* config = &msg.payload.set_event_detector_msg;
+        // The same checks as event_detector_set_channel(), which would otherwise leave the channel ignored
+        bool valid = ((uint32_t) config->polarity <= (uint32_t) EventPolarity_EVENT_POLARITY_ABSOLUTE) &&
+                     ((config->polarity != EventPolarity_EVENT_POLARITY_ABSOLUTE) || (config->threshold >= 0));
+        for (uint8_t c = 0; valid && c < EVENT_DETECTOR_MAX_CHANNELS; c++)
+        {
+          if (config->channel_mask & (1UL << c))
+          {
+            event_detector_config[c] = *config;
+          }
+        }
+        SEGGER_RTT_printf(0, "Event detector channel mask = 0x%02" PRIx32 ", polarity = %d, threshold = %" PRId32 ", hysteresis = %" PRIu32 "\n",
+                          config->channel_mask, (int) config->polarity, config->threshold, config->hysteresis);
+        send_ack(DeviceToHostMessage_ack_set_event_detector_msg_tag, valid);
+
+      }else if (msg.which_payload == HostToDeviceMessage_set_spectrum_msg_tag)
+      {
+        // Only taken into account by the next set_periodic_sampler_msg, core 1 reads it when starting
+        SetSpectrumMessage* config = &msg.payload.set_spectrum_msg;
+        bool valid = (config->fft_size == 0U) ||
+                     (config->fft_size >= SPECTRUM_MIN_SIZE && config->fft_size <= SPECTRUM_MAX_SIZE &&
+                      (config->fft_size & (config->fft_size - 1U)) == 0U && config->num_of_peaks <= SPECTRUM_MAX_PEAKS);
+        if (valid)
+        {
+          spectrum_config = *config;
+        }
+        SEGGER_RTT_printf(0, "Spectrum FFT size = %" PRIu32 ", peaks = %" PRIu32 "\n", spectrum_config.fft_size, spectrum_config.num_of_peaks);
+        send_ack(DeviceToHostMessage_ack_set_spectrum_msg_tag, valid);
+
+      }else if (msg.which_payload == HostToDeviceMessage_execute_burst_capture_msg_tag)
+      {
+        // The frames follow on the data port once they have all been captured
+        // A single burst capture at a time, the configuration of the pending one is left as it is
+        bool accepted = !active_periodic_sampler && !burst_capture_pending;
+        if (accepted)
+        {
+          burst_capture_config = msg.payload.execute_burst_capture_msg;
+          burst_capture_pending = 1;
+        }
+        send_ack(DeviceToHostMessage_ack_execute_burst_capture_msg_tag, accepted);
+        if (accepted)
+        {
+          xTaskNotify(periodic_sampler_handle_c1, PERIODIC_SAMPLER_NOTIF_BURST_CAPTURE, eSetValueWithOverwrite);
+        }
 
       }else if (msg.which_payload == HostToDeviceMessage_execute_one_off_sampler_msg_tag)
       {
-        // Buffer to store encoded data
-        uint8_t msg_buf[32];
-        // Stream object
-        pb_ostream_t stream;
+        // Buffer to store encoded data, negative values take 10 bytes each so it has to hold the worst case
+        uint8_t msg_buf[DeviceToHostMessage_FIXED_DELIMITED_MAX_SIZE];
 
         // Sample on Core 0
         int32_t dest_buf[8] = {0};
@@ -715,22 +2337,17 @@ static void cdc_ingress_task_c0(void *param)
         msg.payload.one_off_sampler_data_msg.sensor_val_7 = dest_buf[7];
         msg.which_payload = DeviceToHostMessage_one_off_sampler_data_msg_tag;
 
-        stream = pb_ostream_from_buffer(msg_buf, sizeof(msg_buf));
-
-        // Encode and send one off sampler data message back to host
-        if (!pb_encode_ex(&stream, DeviceToHostMessage_fields, &msg, PB_ENCODE_DELIMITED))
-        {
-          SEGGER_RTT_printf(0, "ERROR : DeviceToHostMessage encode failed.\n");
-          printf("ERROR : DeviceToHostMessage encode failed.\n");
-        }
-        uint32_t bytes_written = tud_cdc_write(msg_buf, stream.bytes_written);
+        // Encode and send one off sampler data message back to host, with straight-line code rather than
+        // pb_encode_ex() which takes ~100 us on the RP2040, the bytes are the same
+        uint32_t msg_length = DeviceToHostMessage_encode_fixed_delimited(msg_buf, &msg);
+        uint32_t bytes_written = tud_cdc_n_write(CDC_ITF_CONTROL, msg_buf, msg_length);
 
         // When the number of bytes transmitted is small, they will hang around
         // in the TX FIFO and accumulate before a critical mass is reached for
         // Tinyusb to send all of them with a bulk transfer, we want to transmit
-        // instantly, so force send with tud_cdc_write_flush()
-        bytes_written = tud_cdc_write_flush();
-        assert(bytes_written = stream.bytes_written);
+        // instantly, so force send with tud_cdc_n_write_flush()
+        tud_cdc_n_write_flush(CDC_ITF_CONTROL);
+        assert(bytes_written == msg_length);
         SEGGER_RTT_printf(0, "one_off_sampler_data_msg sent. Msg length = %" PRIu32 "\n", bytes_written);
       }else
       {
@@ -767,23 +2384,488 @@ static bool execute_sampler(struct connectedSensors connected_sensors, bool oper
   return true;
 
 }
+// Reset a sample block accumulator for a new stream into ring, frames_per_block is clamped to the capacity of a block
+static void reset_sample_block(struct sampleBlock* sample_block, struct spscRing* ring, TaskHandle_t consumer, uint32_t frames_per_block)
+{
+  if (frames_per_block == 0U)
+  {
+    frames_per_block = 1U;
+  }else if (frames_per_block > SAMPLE_BLOCK_MAX_FRAMES)
+  {
+    frames_per_block = SAMPLE_BLOCK_MAX_FRAMES;
+  }
+  sample_block->ring = ring;
+  sample_block->consumer = consumer;
+  sample_block->frames_per_block = frames_per_block;
+  // A reserved block which has not been committed is simply reused by the next reservation
+  sample_block->block = NULL;
+  sample_block->num_of_frames = 0;
+  sample_block->frame_index = 0;
+  sample_block->frame_drops = 0;
+  sample_block->ring_high_water = 0;
+  sample_block->ring_depth = ring->mask + 1U;
+  sample_block->payload_type = STREAM_FRAME_TYPE_DATA;
+}
+
+// Commit the accumulated sample block to its ring, it is called from the producer side of the ring only, e.g.
+// the periodic sampler interrupts, or periodic_sampler_task_c1 once they have been stopped
+static void commit_sample_block(struct sampleBlock* sample_block)
+{
+  if (sample_block->block == NULL || sample_block->num_of_frames == 0U)
+  {
+    return;
+  }
+  sample_block->block->first_frame_index = sample_block->first_frame_index;
+  sample_block->block->first_frame_timestamp_us = sample_block->first_frame_timestamp_us;
+  spsc_ring_commit(sample_block->ring);
+  sample_block->block = NULL;
+  sample_block->num_of_frames = 0;
+  uint32_t pending_blocks = spsc_ring_count(sample_block->ring);
+  if (pending_blocks > sample_block->ring_high_water)
+  {
+    sample_block->ring_high_water = pending_blocks;
+  }
+}
+
+// Put a frame into a sample block, the block is committed once it is full or once its first frame has been
+// waiting for longer than SAMPLE_BLOCK_FLUSH_TIMEOUT_US, timestamp_us is the device time of the frame
+// Returns whether the consumer of the ring has to be woken up, i.e. on the first pending block, which starts
+// its deadline, and on the trigger level
+static bool append_sample_frame(struct sampleBlock* sample_block, const void* frame, size_t frame_size, uint32_t timestamp_us)
+{
+  bool committed = false;
+  if (sample_block->block != NULL && sample_block->block->payload_size + frame_size > SAMPLE_BLOCK_MAX_BYTES)
+  {
+    commit_sample_block(sample_block);
+    committed = true;
+  }
+  if (sample_block->block == NULL)
+  {
+    // Never overwrite a block which has not been consumed yet, nor go beyond the depth, drop the frame instead
+    sample_block->block = (spsc_ring_count(sample_block->ring) < sample_block->ring_depth) ? spsc_ring_reserve(sample_block->ring) : NULL;
+    if (sample_block->block == NULL)
+    {
+      sample_block->frame_index++;
+      sample_block->frame_drops++;
+      return false;
+    }
+    sample_block->block->payload_type = sample_block->payload_type;
+    sample_block->block->payload_size = 0;
+    sample_block->first_frame_timestamp_us = timestamp_us;
+    sample_block->first_frame_index = sample_block->frame_index;
+  }
+  memcpy(&sample_block->block->buf[EGRESS_BLOCK_HEADROOM + sample_block->block->payload_size], frame, frame_size);
+  sample_block->block->payload_size += frame_size;
+  sample_block->num_of_frames++;
+  sample_block->frame_index++;
+
+  if (sample_block->num_of_frames >= sample_block->frames_per_block ||
+      (timestamp_us - sample_block->first_frame_timestamp_us) >= SAMPLE_BLOCK_FLUSH_TIMEOUT_US)
+  {
+    commit_sample_block(sample_block);
+    committed = true;
+  }
+  if (!committed)
+  {
+    return false;
+  }
+  uint32_t pending_blocks = spsc_ring_count(sample_block->ring);
+  return pending_blocks == 1U || pending_blocks == EGRESS_TRIGGER_LEVEL;
+}
+
+// Put a frame of the periodic sampler into the current sample block and wake up the consumer of its ring,
+// i.e. cdc_egress_task_c1 or decimator_task_c0, called in interrupt context
+// timestamp_us is the time the frame was sampled at, the low 32 bits of time_us_64(), so the host can measure
+// the latency of the stream from the timestamps of its blocks
+static void egress_sample_from_isr(const void* frame, size_t frame_size, uint32_t timestamp_us)
+{
+  if (capture.state != CAPTURE_STATE_IDLE)
+  {
+    capture_frame_from_isr(frame, frame_size);
+    return;
+  }
+  if (append_sample_frame(&sample_block, frame, frame_size, timestamp_us))
+  {
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(sample_block.consumer, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+  }
+}
+
+// Arm a capture of frames of the configured format, the window is clamped to the capture buffer and always
+// takes the trigger frame, returns false if there is no capture buffer
+static bool arm_capture(const SetCaptureMessage* config)
+{
+  uint32_t frame_size = (uint32_t) sample_frame_num_of_values() * sample_frame_value_size();
+  if (capture.buf == NULL || frame_size == 0U)
+  {
+    SEGGER_RTT_printf(0, "ERROR : Capture mode is unavailable.\n");
+    return false;
+  }
+  capture.frame_size = frame_size;
+  capture.capacity = CAPTURE_BUF_SIZE / frame_size;
+  capture.pre_trigger_frames = (config->pre_trigger_frames < capture.capacity) ? config->pre_trigger_frames : capture.capacity - 1U;
+  capture.post_trigger_frames = config->post_trigger_frames;
+  if (capture.post_trigger_frames > capture.capacity - capture.pre_trigger_frames)
+  {
+    capture.post_trigger_frames = capture.capacity - capture.pre_trigger_frames;
+  }else if (capture.post_trigger_frames == 0U)
+  {
+    capture.post_trigger_frames = 1U;
+  }
+  capture.trigger = config->trigger;
+  capture.trigger_channel = (config->trigger_channel < sample_frame_num_of_values()) ? config->trigger_channel : 0U;
+  capture.threshold = config->threshold;
+  capture.write_slot = 0;
+  capture.num_of_frames = 0;
+  capture.previous_value = 0;
+  capture.duration_us = 0;
+  capture.state = CAPTURE_STATE_ARMED;
+  SEGGER_RTT_printf(0, "Capture armed : trigger = %d on value %" PRIu32 ", %" PRIu32 " + %" PRIu32 " frames out of %" PRIu32 "\n",
+                    (int) capture.trigger, capture.trigger_channel, capture.pre_trigger_frames, capture.post_trigger_frames, capture.capacity);
+  return true;
+}
+
+// Value of the trigger channel in a frame, the 16-bit codes of the packed format are two's complement
+static int32_t capture_trigger_value(const uint8_t* frame)
+{
+  if (sample_frame_format == FrameFormat_FRAME_FORMAT_PACKED_INT16)
+  {
+    int16_t value;
+    memcpy(&value, &frame[capture.trigger_channel * sizeof(int16_t)], sizeof(value));
+    return value;
+  }
+  int32_t value;
+  memcpy(&value, &frame[capture.trigger_channel * sizeof(int32_t)], sizeof(value));
+  return value;
+}
+
+// Evaluate the trigger condition between two consecutive values of the trigger channel
+static bool capture_triggered(int32_t previous_value, int32_t value)
+{
+  switch (capture.trigger)
+  {
+    case CaptureTrigger_CAPTURE_TRIGGER_RISING:
+      return previous_value < capture.threshold && value >= capture.threshold;
+    case CaptureTrigger_CAPTURE_TRIGGER_FALLING:
+      return previous_value > capture.threshold && value <= capture.threshold;
+    case CaptureTrigger_CAPTURE_TRIGGER_SLOPE:
+    {
+      int64_t delta = (int64_t) value - previous_value;
+      int64_t threshold = (capture.threshold < 0) ? -(int64_t) capture.threshold : capture.threshold;
+      return delta >= threshold || delta <= -threshold;
+    }
+    default:
+      return false;
+  }
+}
+
+// Put a frame of the periodic sampler into the capture buffer and evaluate the trigger, periodic_sampler_task_c1
+// is notified once the post-trigger window is complete, called in interrupt context
+static void capture_frame_from_isr(const void* frame, size_t frame_size)
+{
+  if (capture.state == CAPTURE_STATE_DONE)
+  {
+    return;
+  }
+  uint32_t slot = capture.write_slot;
+  memcpy(&capture.buf[slot * capture.frame_size], frame, frame_size);
+  capture.write_slot = (slot + 1U == capture.capacity) ? 0U : slot + 1U;
+  if (capture.num_of_frames < capture.capacity)
+  {
+    capture.num_of_frames++;
+  }
+
+  if (capture.state == CAPTURE_STATE_ARMED)
+  {
+    int32_t value = capture_trigger_value(frame);
+    // Only once the pre-trigger window is full, so that every capture has the requested shape
+    if (capture.num_of_frames > capture.pre_trigger_frames && capture.num_of_frames > 1U &&
+        capture_triggered(capture.previous_value, value))
+    {
+      capture.trigger_slot = slot;
+      capture.trigger_timestamp_us = time_us_32();
+      capture.trigger_value = value;
+      capture.frames_remaining = capture.post_trigger_frames;
+      capture.state = CAPTURE_STATE_TRIGGERED;
+    }
+    capture.previous_value = value;
+  }
+  if (capture.state == CAPTURE_STATE_TRIGGERED && --capture.frames_remaining == 0U)
+  {
+    capture.state = CAPTURE_STATE_DONE;
+    // A pending stop takes precedence, the capture is dropped then
+    BaseType_t higher_priority_task_woken = pdFALSE;
+    xTaskNotifyFromISR(periodic_sampler_handle_c1, PERIODIC_SAMPLER_NOTIF_CAPTURE_DONE, eSetValueWithoutOverwrite, &higher_priority_task_woken);
+    portYIELD_FROM_ISR(higher_priority_task_woken);
+  }
+}
+
+// Wait until the egress ring has room for another block besides the one being filled, returns false once
+// it hasn't had any for CAPTURE_UPLOAD_TIMEOUT_MS
+static bool wait_for_egress_room(void)
+{
+  TickType_t wait_start = xTaskGetTickCount();
+  while (spsc_ring_count(&egress_ring) >= EGRESS_RING_NUM_OF_BLOCKS - 1U)
+  {
+    if ((xTaskGetTickCount() - wait_start) >= pdMS_TO_TICKS(CAPTURE_UPLOAD_TIMEOUT_MS))
+    {
+      return false;
+    }
+    vTaskDelay(1);
+  }
+  return true;
+}
+
+// Send a completed capture through the egress ring once the periodic sampler has been stopped, a
+// CaptureInfoMessage first, then the window as sample frames numbered from 0, their device time is worked out
+// from the trigger frame, periodic_sampler_task_c1 only
+// Returns false if the host doesn't read the data interface in time
+static bool upload_capture(void)
+{
+  if (capture.state != CAPTURE_STATE_DONE)
+  {
+    return true;
+  }
+  uint32_t num_of_frames = capture.pre_trigger_frames + capture.post_trigger_frames;
+  SEGGER_RTT_printf(0, "Uploading %" PRIu32 " captured frames\n", num_of_frames);
+
+  // The CaptureInfoMessage is a stream frame of its own, the egress ring has room as the sampler has been stopped
+  // before it could commit anything
+  if (!wait_for_egress_room())
+  {
+    return false;
+  }
+  struct egressBlock* block = (struct egressBlock*) spsc_ring_reserve(&egress_ring);
+  DeviceToHostMessage msg = DeviceToHostMessage_init_zero;
+  msg.payload.capture_info_msg.trigger_frame_index = capture.pre_trigger_frames;
+  msg.payload.capture_info_msg.num_of_frames = num_of_frames;
+  msg.payload.capture_info_msg.trigger_timestamp_us = capture.trigger_timestamp_us;
+  msg.payload.capture_info_msg.sampling_period_us = egress_sampling_period_us;
+  msg.payload.capture_info_msg.trigger_value = capture.trigger_value;
+  msg.payload.capture_info_msg.has_duration_us = (capture.duration_us != 0U);
+  msg.payload.capture_info_msg.duration_us = capture.duration_us;
+  msg.which_payload = DeviceToHostMessage_capture_info_msg_tag;
+  block->payload_type = STREAM_FRAME_TYPE_MESSAGE;
+  block->payload_size = DeviceToHostMessage_encode_fixed(&block->buf[EGRESS_BLOCK_HEADROOM], &msg);
+  block->first_frame_index = 0;
+  block->first_frame_timestamp_us = capture.trigger_timestamp_us;
+  spsc_ring_commit(&egress_ring);
+  xTaskNotifyGive(cdc_egress_handle_c1);
+
+  // Latency doesn't matter any more, so the frames go out in full blocks
+  reset_sample_block(&sample_block, &egress_ring, cdc_egress_handle_c1, SAMPLE_BLOCK_MAX_FRAMES);
+  uint32_t slot = (capture.trigger_slot + capture.capacity - capture.pre_trigger_frames) % capture.capacity;
+  for (uint32_t i = 0; i < num_of_frames; i++)
+  {
+    if (!wait_for_egress_room())
+    {
+      return false;
+    }
+    uint32_t timestamp_us = capture.trigger_timestamp_us + (i - capture.pre_trigger_frames) * egress_sampling_period_us;
+    if (append_sample_frame(&sample_block, &capture.buf[slot * capture.frame_size], capture.frame_size, timestamp_us))
+    {
+      xTaskNotifyGive(cdc_egress_handle_c1);
+    }
+    slot = (slot + 1U == capture.capacity) ? 0U : slot + 1U;
+  }
+  return true;
+}
+
+// Capture frames back to back at the conversion rate of the ADC into the capture buffer, then leave them there
+// for upload_capture() as a capture whose trigger is the first frame, periodic_sampler_task_c1 only
+// The interrupts of core 1 are disabled while a chunk of BURST_CAPTURE_CHUNK_US is read, so that nothing is
+// interleaved with its readouts, the interrupts which came up meanwhile run between the chunks and their few
+// micro-seconds are part of duration_us, core 0 and the USB stack keep running
+// The channel mask and the frame format of the burst are its own, those of the periodic sampler are left as they are
+static bool run_burst_capture(const ExecuteBurstCaptureMessage* config)
+{
+  uint8_t channel_mask = (uint8_t) ((config->channel_mask != 0U) ? config->channel_mask : ((1U << num_of_adc_chan) - 1U));
+  uint8_t num_of_words = ad7606b_mask_to_num_of_words(channel_mask);
+  if (capture.buf == NULL || num_of_words == 0U)
+  {
+    SEGGER_RTT_printf(0, "ERROR : Burst capture is unavailable.\n");
+    return false;
+  }
+  // The frames are read out up to the last channel in the mask and only packed afterwards
+  uint32_t num_of_frames = CAPTURE_BUF_SIZE / (num_of_words * sizeof(uint16_t));
+  if (config->num_of_frames < num_of_frames)
+  {
+    num_of_frames = config->num_of_frames;
+  }
+  if (num_of_frames == 0U)
+  {
+    return false;
+  }
+
+  uint16_t* frames = (uint16_t*) capture.buf;
+  ad7606b_set_backend(AD7606B_BACKEND_BLOCKING);
+  uint32_t start_us = time_us_32();
+  uint32_t i = 0;
+  while (i < num_of_frames)
+  {
+    uint32_t irq_status = save_and_disable_interrupts();
+    uint32_t chunk_start_us = time_us_32();
+    do
+    {
+      ad7606b_read_frame(&frames[i * num_of_words], num_of_words);
+      i++;
+    } while (i < num_of_frames && (time_us_32() - chunk_start_us) < BURST_CAPTURE_CHUNK_US);
+    restore_interrupts(irq_status);
+  }
+  uint32_t duration_us = time_us_32() - start_us;
+
+  // Pack the frames down to the channels in the mask in place, no value moves towards the end of the buffer
+  uint8_t num_of_values = (uint8_t) __builtin_popcount(channel_mask);
+  if (num_of_values != num_of_words)
+  {
+    uint32_t packed_index = 0;
+    for (uint32_t j = 0; j < num_of_frames * num_of_words; j++)
+    {
+      if (channel_mask & (1U << (j % num_of_words)))
+      {
+        frames[packed_index++] = frames[j];
+      }
+    }
+  }
+
+  // The whole buffer is one window starting at the trigger frame
+  capture.frame_size = num_of_values * sizeof(uint16_t);
+  capture.capacity = num_of_frames;
+  capture.pre_trigger_frames = 0;
+  capture.post_trigger_frames = num_of_frames;
+  capture.trigger_slot = 0;
+  capture.trigger_timestamp_us = start_us;
+  capture.trigger_value = 0;
+  capture.duration_us = (duration_us != 0U) ? duration_us : 1U;
+  capture.state = CAPTURE_STATE_DONE;
+
+  // Sent as plain data frames on the data CDC port
+  egress_data_interface = DataInterface_DATA_INTERFACE_CDC;
+  egress_stream_encoding = StreamEncoding_STREAM_ENCODING_RAW;
+  egress_sampling_period_us = capture.duration_us / num_of_frames;
+  egress_producer = &sample_block;
+  decimator_active = 0;
+  aggregator_active = 0;
+  spectrum_active = 0;
+  event_detector_active = 0;
+  egress_stalls = 0;
+  egress_partial_writes = 0;
+  egress_raw_bytes = 0;
+  egress_encoded_bytes = 0;
+  // In frames per second, SEGGER_RTT_printf() has no floating point support
+  SEGGER_RTT_printf(0, "Burst capture : %" PRIu32 " frames of %" PRIu32 " channels in %" PRIu32 " us, %" PRIu32 " frames/s\n",
+                    num_of_frames, (uint32_t) num_of_values, capture.duration_us,
+                    (uint32_t) (((uint64_t) num_of_frames * 1000000U) / capture.duration_us));
+  return true;
+}
+
+// Number of values in a frame of the periodic sampler and their size in bytes, see handle_adc_frame()
+// The test pattern always has eight values, whatever the format
+static uint8_t sample_frame_num_of_values(void)
+{
+  return (sample_frame_format == FrameFormat_FRAME_FORMAT_PACKED_INT16 && !test_pattern_active) ? (uint8_t) __builtin_popcount(adc_channel_mask) : 8U;
+}
+
+static uint8_t sample_frame_value_size(void)
+{
+  return (sample_frame_format == FrameFormat_FRAME_FORMAT_PACKED_INT16) ? sizeof(uint16_t) : sizeof(int32_t);
+}
+
+// Turn a frame read out of the ADC into a frame of the configured format and hand it to the egress path,
+// timestamp_us is the time of the conversion
+static void handle_adc_frame(const uint16_t* frame, uint8_t num_of_words, uint32_t timestamp_us)
+{
+  if (sample_frame_format == FrameFormat_FRAME_FORMAT_PACKED_INT16)
+  {
+    // Only the channels in the mask, as the raw 16-bit codes
+    uint16_t packed_buf[AD7606B_NUM_OF_CHAN];
+    uint8_t elementsTransferred = 0;
+    for (int i = 0; i < num_of_words; i++)
+    {
+      if (adc_channel_mask & (1U << i))
+      {
+        packed_buf[elementsTransferred] = frame[i];
+        elementsTransferred++;
+      }
+    }
+    egress_sample_from_isr(packed_buf, elementsTransferred * sizeof(uint16_t), timestamp_us);
+    return;
+  }
+
+  int32_t dest_buf[8] = {0};
+  uint8_t elementsTransferred = 0;
+
+  // Sign extend the two's complement codes into the int32_t destination buffer, same layout as ad7606b_sample()
+  for (int i = 0; i < num_of_words; i++)
+  {
+    if (adc_channel_mask & (1U << i))
+    {
+      dest_buf[elementsTransferred] = (int32_t) (int16_t) frame[i];
+      elementsTransferred++;
+    }
+  }
+
+  // Sample the other sensors, the ADC has already been read out
+  execute_sampler(connected_sensors, false, 0, dest_buf, &elementsTransferred);
+
+  egress_sample_from_isr(dest_buf, sizeof(dest_buf), timestamp_us);
+}
+
+// Callback executed from the DMA completion interrupt of the DMA or PIO backend once the ADC has been read out
+static void adc_frame_cb(const uint16_t* frame, uint8_t num_of_words)
+{
+  uint32_t start_us = time_us_32();
+  // The falling edge of BUSY with the DMA backend, the end of the readout with the PIO backend
+  uint32_t sample_timestamp_us = ad7606b_get_frame_timestamp_us();
+  record_sample_timestamp(sample_timestamp_us);
+  handle_adc_frame(frame, num_of_words, sample_timestamp_us);
+  metrics_histogram_add(&sampler_isr_histogram, time_us_32() - start_us);
+}
+
 // Callback executed when the repeating periodic sampler timer expires
 static bool periodic_sampler_cb(struct repeating_timer *t)
 {
 
   // SEGGER_RTT_printf(0,"Time = %" PRIu64 "\n", get_absolute_time());
   // SEGGER_RTT_printf(0, "Executed periodic_sampler_cb()\n");
+  if (ad7606b_get_backend() == AD7606B_BACKEND_DMA)
+  {
+    // Only start the conversion, the readout is done by DMA on the falling edge of BUSY
+    // and the sample is handed to the egress path from adc_frame_cb()
+    ad7606b_convert();
+    return true;
+  }
+  uint32_t start_us = time_us_32();
+  record_sample_timestamp(start_us);
+  if (adc_channel_mask != 0)
+  {
+    // Read out up to the last active channel and go through the same path as the DMA and PIO backends
+    uint16_t frame[AD7606B_NUM_OF_CHAN];
+    ad7606b_read_frame(frame, adc_num_of_words);
+    handle_adc_frame(frame, adc_num_of_words, start_us);
+    metrics_histogram_add(&sampler_isr_histogram, time_us_32() - start_us);
+    return true;
+  }
   int32_t dest_buf[8] = {0};
   uint8_t elementsTransferred = 0;
 
+  if (test_pattern_active)
+  {
+    // Only the test pattern sensor, the rest of the frame stays zero, packed frames are its first half, which
+    // holds the same bytes as the counter and the LFSR state on the little-endian RP2040
+    test_pattern_sensor_sample_func(dest_buf, &elementsTransferred);
+    egress_sample_from_isr(dest_buf, (size_t) sample_frame_num_of_values() * sample_frame_value_size(), start_us);
+    metrics_histogram_add(&sampler_isr_histogram, time_us_32() - start_us);
+    return true;
+  }
+
   // Execute the sampler
   execute_sampler(connected_sensors, false, num_of_adc_chan, dest_buf, &elementsTransferred);
 
   // Put content into egress stream buffer such that it can be transmitted to host
-  uint32_t bytes_written = xStreamBufferSendFromISR(egress_stream_buf_handle, &dest_buf, sizeof(dest_buf), NULL);
-
-  // Check that every byte is written into stream buffer
-  assert(bytes_written == sizeof(dest_buf));
+  egress_sample_from_isr(dest_buf, sizeof(dest_buf), start_us);
+  metrics_histogram_add(&sampler_isr_histogram, time_us_32() - start_us);
   // At high sampling frequency, executing the following printing code in an interrupt is not ideal as they will take time
   // Better to comment them out
   /* if (bytes_written != sizeof(dest_buf))
@@ -804,33 +2886,4 @@ static bool periodic_sampler_cb(struct repeating_timer *t)
   SEGGER_RTT_printf(0, "\n");
   */
   return true;
-    /* uint16_t msg_buf[24];
-    // Printf for now
-    // SEGGER_RTT_printf(0, "Periodic sampling executing, start timestamp = %" PRIu64 "\n", time_us_64());
-    // printf("Periodic sampling executed, timestamp = %" PRIu64 "\n", time_us_64());
-
-    // char msg_buf[13]="Hello World!\n";
-
-    // Copy data into the msg_buf according to current value of sampler_counter
-    for (int i = 0; i < 24; i++)
-    {
-        msg_buf[i] = (uint16_t)(sampler_counter + i);
-    }
-    // Increment the sampler_counter for the next callback
-    sampler_counter += 24;
-
-    // Put content into egress_msg_buf for sending back to host
-    // uint32_t bytes_written = xMessageBufferSendFromISR(egress_msg_buf_handle, &msg_buf, sizeof(msg_buf), 0);
-    // Put content into egress_stream_buf for sending back to host
-    uint32_t bytes_written = xStreamBufferSendFromISR(egress_stream_buf_handle, &msg_buf, sizeof(msg_buf), NULL);
-    if (bytes_written != sizeof(msg_buf))
-    {
-        SEGGER_RTT_printf(0, "ERROR : bytes dropped due to full egress stream buf. TX FIFO avail = %" PRIu32 "bytes.\n", tud_cdc_write_available());
-    }
-    // Check that the entire msg has been written into MessageBuffer
-    assert(bytes_written == sizeof(msg_buf));
-    // SEGGER_RTT_printf(0, "Wrote %d bytes to device in periodic_sampler_cb().\n", bytes_written);
-    // SEGGER_RTT_printf(0, "Periodic sampling executed, end timestamp = %" PRIu64 "\n", time_us_64());
-    // printf("Wrote %d bytes to device in periodic_sampler_cb().\n", bytes_written);
-    // assert(xMessageBufferSendFromISR(egress_msg_buf_handle, msg_buf, sizeof(msg_buf), 0) != 0); */
 }
@@ -0,0 +1,58 @@
+/*
+ * PIO acquisition backend of the AD7606B in the host-native build, the PIO blocks are not modelled so it is
+ * never available and main.c falls back to the DMA backend.
+ */
+#include <stddef.h>
+
+#include "ad7606b_pio.h"
+
+// PIO blocks declared by the stand-in hardware/pio.h
+pio_hw_t posix_pio_blocks[2] = {{0}, {1}};
+
+bool ad7606b_pio_init(PIO pio)
+{
+  (void) pio;
+  return false;
+}
+
+bool ad7606b_pio_start(ad7606b_frame_cb frame_cb, uint8_t num_of_words, uint32_t period_us)
+{
+  (void) frame_cb;
+  (void) num_of_words;
+  (void) period_us;
+  return false;
+}
+
+void ad7606b_pio_stop(void)
+{
+}
+
+bool ad7606b_pio_is_active(void)
+{
+  return false;
+}
+
+const uint16_t* ad7606b_pio_get_latest_frame(void)
+{
+  return NULL;
+}
+
+uint32_t ad7606b_pio_get_frame_timestamp_us(void)
+{
+  return 0;
+}
+
+uint32_t ad7606b_pio_get_period_ns(void)
+{
+  return 0;
+}
+
+uint32_t ad7606b_pio_get_stalls(void)
+{
+  return 0;
+}
+
+uint32_t ad7606b_pio_get_missed_frames(void)
+{
+  return 0;
+}
@@ -0,0 +1,414 @@
+#include "ad7606b_sim.h"
+#include "posix_hardware.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define AD7606B_SIM_NUM_OF_CHAN   8
+#define AD7606B_SIM_WORD_BITS     16
+#define AD7606B_SIM_MAX_OS_RATIO  256
+
+struct ad7606bSim
+{
+  bool initialised;
+  uint64_t start_ns;
+  uint16_t os_ratio;
+  struct ad7606bSimWaveform waveforms[AD7606B_SIM_NUM_OF_CHAN];
+  // State of the noise generator of each channel
+  uint32_t noise_state[AD7606B_SIM_NUM_OF_CHAN];
+
+  bool convst;
+  bool reset;
+  uint64_t reset_start_ns;
+  // Conversions are ignored until then, after a full reset
+  uint64_t ready_ns;
+
+  // Conversion in progress, its results are latched when BUSY falls
+  bool converting;
+  uint64_t busy_end_ns;
+  int16_t pending[AD7606B_SIM_NUM_OF_CHAN];
+
+  // Results being shifted out, and the index of the next bit on DOUTA
+  int16_t results[AD7606B_SIM_NUM_OF_CHAN];
+  bool results_valid;
+  uint32_t bit_index;
+
+  // Number of conversions started and completed
+  uint32_t started;
+  uint32_t completed;
+};
+
+static struct ad7606bSim sim;
+
+static void sim_configure_from_env(void);
+
+static void sim_init(void)
+{
+  if (sim.initialised)
+  {
+    return;
+  }
+  sim.initialised = true;
+  sim.start_ns = posix_time_ns();
+  sim.os_ratio = AD7606B_SIM_DEFAULT_OS_RATIO;
+  for (uint8_t c = 0; c < AD7606B_SIM_NUM_OF_CHAN; c++)
+  {
+    sim.waveforms[c] = (struct ad7606bSimWaveform) {.type = AD7606B_SIM_RAMP, .amplitude = c + 1U};
+    sim.noise_state[c] = 0x9E3779B9U * (c + 1U);
+  }
+  sim_configure_from_env();
+}
+
+// Parse "<channel>=<waveform>;..." from DAS_ADC_WAVEFORMS and the ratio from DAS_ADC_OVERSAMPLING
+static void sim_configure_from_env(void)
+{
+  const char* os_ratio = getenv("DAS_ADC_OVERSAMPLING");
+  if (os_ratio != NULL && !ad7606b_sim_set_oversampling((uint16_t) strtoul(os_ratio, NULL, 10)))
+  {
+    fprintf(stderr, "AD7606B sim : unsupported oversampling ratio '%s'\n", os_ratio);
+  }
+
+  const char* env = getenv("DAS_ADC_WAVEFORMS");
+  if (env == NULL)
+  {
+    return;
+  }
+  char* specs = strdup(env);
+  char* save_ptr = NULL;
+  for (char* spec = strtok_r(specs, ";", &save_ptr); spec != NULL; spec = strtok_r(NULL, ";", &save_ptr))
+  {
+    char* waveform_spec = strchr(spec, '=');
+    struct ad7606bSimWaveform waveform;
+    if (waveform_spec == NULL || !ad7606b_sim_parse_waveform(waveform_spec + 1, &waveform))
+    {
+      fprintf(stderr, "AD7606B sim : ignoring waveform '%s'\n", spec);
+      continue;
+    }
+    *waveform_spec = '\0';
+    if (strcmp(spec, "*") == 0)
+    {
+      for (uint8_t c = 0; c < AD7606B_SIM_NUM_OF_CHAN; c++)
+      {
+        // Every channel gets its own copy of the codes of a file
+        struct ad7606bSimWaveform copy = waveform;
+        if (waveform.codes != NULL)
+        {
+          copy.codes = malloc(waveform.num_of_codes * sizeof(int16_t));
+          memcpy(copy.codes, waveform.codes, waveform.num_of_codes * sizeof(int16_t));
+        }
+        ad7606b_sim_set_waveform(c, &copy);
+      }
+      free(waveform.codes);
+    }else
+    {
+      char* end = NULL;
+      unsigned long channel = strtoul(spec, &end, 10);
+      if (end == spec || *end != '\0' || channel >= AD7606B_SIM_NUM_OF_CHAN)
+      {
+        fprintf(stderr, "AD7606B sim : ignoring waveform of channel '%s'\n", spec);
+        free(waveform.codes);
+        continue;
+      }
+      ad7606b_sim_set_waveform((uint8_t) channel, &waveform);
+    }
+  }
+  free(specs);
+}
+
+static bool sim_load_codes(const char* path, struct ad7606bSimWaveform* waveform)
+{
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+  {
+    perror(path);
+    return false;
+  }
+  uint32_t capacity = 1024;
+  waveform->codes = malloc(capacity * sizeof(int16_t));
+  waveform->num_of_codes = 0;
+  long code;
+  while (fscanf(file, "%ld", &code) == 1)
+  {
+    if (waveform->num_of_codes == capacity)
+    {
+      capacity *= 2U;
+      waveform->codes = realloc(waveform->codes, capacity * sizeof(int16_t));
+    }
+    waveform->codes[waveform->num_of_codes++] = (int16_t) ((code < INT16_MIN) ? INT16_MIN : (code > INT16_MAX) ? INT16_MAX : code);
+  }
+  fclose(file);
+  if (waveform->num_of_codes == 0)
+  {
+    fprintf(stderr, "AD7606B sim : no codes in %s\n", path);
+    free(waveform->codes);
+    waveform->codes = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool ad7606b_sim_parse_waveform(const char* spec, struct ad7606bSimWaveform* waveform)
+{
+  memset(waveform, 0, sizeof(*waveform));
+  if (strncmp(spec, "file:", 5) == 0)
+  {
+    waveform->type = AD7606B_SIM_FILE;
+    return sim_load_codes(spec + 5, waveform);
+  }
+
+  // The name and up to 3 numeric parameters, the missing ones keep their defaults
+  char name[8] = {0};
+  double params[3];
+  int num_of_params = 0;
+  const char* p = spec;
+  size_t name_len = strcspn(p, ":");
+  if (name_len >= sizeof(name))
+  {
+    return false;
+  }
+  memcpy(name, p, name_len);
+  p += name_len;
+  while (*p == ':' && num_of_params < 3)
+  {
+    char* end = NULL;
+    params[num_of_params] = strtod(p + 1, &end);
+    if (end == p + 1)
+    {
+      return false;
+    }
+    num_of_params++;
+    p = end;
+  }
+  if (*p != '\0')
+  {
+    return false;
+  }
+
+  if (strcmp(name, "ramp") == 0)
+  {
+    waveform->type = AD7606B_SIM_RAMP;
+    waveform->amplitude = (num_of_params > 0) ? params[0] : 1.0;
+    waveform->offset = (num_of_params > 1) ? params[1] : 0.0;
+  }else if (strcmp(name, "sine") == 0)
+  {
+    waveform->type = AD7606B_SIM_SINE;
+    waveform->amplitude = (num_of_params > 0) ? params[0] : 16384.0;
+    waveform->frequency_hz = (num_of_params > 1) ? params[1] : 50.0;
+    waveform->offset = (num_of_params > 2) ? params[2] : 0.0;
+  }else if (strcmp(name, "noise") == 0)
+  {
+    waveform->type = AD7606B_SIM_NOISE;
+    waveform->amplitude = (num_of_params > 0) ? params[0] : 100.0;
+    waveform->offset = (num_of_params > 1) ? params[1] : 0.0;
+  }else if (strcmp(name, "step") == 0)
+  {
+    waveform->type = AD7606B_SIM_STEP;
+    waveform->amplitude = (num_of_params > 0) ? params[0] : 16384.0;
+    waveform->step_time_us = (num_of_params > 1) ? (uint64_t) params[1] : 1000000U;
+    waveform->offset = (num_of_params > 2) ? params[2] : 0.0;
+  }else
+  {
+    return false;
+  }
+  return true;
+}
+
+void ad7606b_sim_set_waveform(uint8_t channel, const struct ad7606bSimWaveform* waveform)
+{
+  sim_init();
+  if (channel >= AD7606B_SIM_NUM_OF_CHAN)
+  {
+    return;
+  }
+  free(sim.waveforms[channel].codes);
+  sim.waveforms[channel] = *waveform;
+}
+
+bool ad7606b_sim_set_oversampling(uint16_t ratio)
+{
+  sim_init();
+  // Powers of 2 only
+  if (ratio == 0 || ratio > AD7606B_SIM_MAX_OS_RATIO || (ratio & (ratio - 1U)) != 0)
+  {
+    return false;
+  }
+  sim.os_ratio = ratio;
+  return true;
+}
+
+uint32_t ad7606b_sim_get_conversion_time_ns(void)
+{
+  sim_init();
+  return (sim.os_ratio == 1U) ? AD7606B_SIM_T_CONV_NS : (uint32_t) sim.os_ratio * AD7606B_SIM_T_OS_CYCLE_NS;
+}
+
+// Standard normal sample from the sum of 4 uniform ones, plenty for a noise floor
+static double sim_noise(uint8_t channel)
+{
+  double sum = 0.0;
+  for (int i = 0; i < 4; i++)
+  {
+    // xorshift32
+    uint32_t x = sim.noise_state[channel];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim.noise_state[channel] = x;
+    sum += (double) x / 4294967296.0;
+  }
+  // The sum of 4 uniform samples has a mean of 2 and a variance of 1/3
+  return (sum - 2.0) * 1.7320508075688772;
+}
+
+// Value of the waveform of a channel for the conversion started at sample_ns, before quantisation
+static double sim_waveform_value(uint8_t channel, uint64_t sample_ns)
+{
+  const struct ad7606bSimWaveform* waveform = &sim.waveforms[channel];
+  double t = (double) (sample_ns - sim.start_ns) * 1e-9;
+  switch (waveform->type)
+  {
+    case AD7606B_SIM_RAMP:
+      // Wraps like the 16-bit code it ends up as
+      return (double) (int16_t) (uint16_t) (int64_t) (waveform->offset + waveform->amplitude * sim.started);
+    case AD7606B_SIM_SINE:
+      return waveform->offset + waveform->amplitude * sin(2.0 * M_PI * waveform->frequency_hz * t);
+    case AD7606B_SIM_NOISE:
+      return waveform->offset + waveform->amplitude * sim_noise(channel);
+    case AD7606B_SIM_STEP:
+      return waveform->offset + ((sample_ns - sim.start_ns >= waveform->step_time_us * 1000U) ? waveform->amplitude : 0.0);
+    case AD7606B_SIM_FILE:
+      return waveform->codes[sim.started % waveform->num_of_codes];
+  }
+  return 0.0;
+}
+
+static int16_t sim_quantise(double value)
+{
+  value = round(value);
+  if (value < INT16_MIN)
+  {
+    return INT16_MIN;
+  }
+  if (value > INT16_MAX)
+  {
+    return INT16_MAX;
+  }
+  return (int16_t) value;
+}
+
+// Latch the results once BUSY has fallen
+static void sim_update(uint64_t now_ns)
+{
+  if (sim.converting && now_ns >= sim.busy_end_ns)
+  {
+    sim.converting = false;
+    memcpy(sim.results, sim.pending, sizeof(sim.results));
+    sim.results_valid = true;
+    sim.bit_index = 0;
+    sim.completed++;
+  }
+}
+
+static void sim_start_conversion(uint64_t now_ns)
+{
+  uint32_t conversion_time_ns = ad7606b_sim_get_conversion_time_ns();
+  // One sample per oversampling cycle, the result is their mean as with the digital filter of the ADC
+  for (uint8_t c = 0; c < AD7606B_SIM_NUM_OF_CHAN; c++)
+  {
+    double sum = 0.0;
+    for (uint16_t i = 0; i < sim.os_ratio; i++)
+    {
+      sum += sim_waveform_value(c, now_ns + (uint64_t) i * AD7606B_SIM_T_OS_CYCLE_NS);
+    }
+    sim.pending[c] = sim_quantise(sum / sim.os_ratio);
+  }
+  sim.converting = true;
+  sim.busy_end_ns = now_ns + conversion_time_ns;
+  sim.started++;
+}
+
+void ad7606b_sim_set_convst(bool level)
+{
+  sim_init();
+  uint64_t now_ns = posix_time_ns();
+  sim_update(now_ns);
+  // A conversion starts on the rising edge, unless one is in progress or the ADC is in reset
+  if (level && !sim.convst && !sim.converting && !sim.reset && now_ns >= sim.ready_ns)
+  {
+    sim_start_conversion(now_ns);
+  }
+  sim.convst = level;
+}
+
+void ad7606b_sim_set_reset(bool level)
+{
+  sim_init();
+  uint64_t now_ns = posix_time_ns();
+  sim_update(now_ns);
+  if (level && !sim.reset)
+  {
+    sim.reset_start_ns = now_ns;
+    // The conversion in progress is aborted
+    sim.converting = false;
+  }else if (!level && sim.reset)
+  {
+    memset(sim.results, 0, sizeof(sim.results));
+    sim.results_valid = false;
+    sim.bit_index = 0;
+    if (now_ns - sim.reset_start_ns >= AD7606B_SIM_T_FULL_RESET_NS)
+    {
+      sim.ready_ns = now_ns + AD7606B_SIM_T_DEVICE_SETUP_NS;
+    }
+  }
+  sim.reset = level;
+}
+
+bool ad7606b_sim_get_busy(void)
+{
+  sim_init();
+  sim_update(posix_time_ns());
+  return sim.converting;
+}
+
+uint64_t ad7606b_sim_get_busy_end_ns(void)
+{
+  sim_init();
+  sim_update(posix_time_ns());
+  return sim.converting ? sim.busy_end_ns : 0U;
+}
+
+bool ad7606b_sim_get_frstdata(void)
+{
+  sim_init();
+  sim_update(posix_time_ns());
+  return sim.results_valid && sim.bit_index < AD7606B_SIM_WORD_BITS;
+}
+
+uint16_t ad7606b_sim_shift_out(uint8_t num_of_bits)
+{
+  sim_init();
+  sim_update(posix_time_ns());
+  uint16_t bits = 0;
+  for (uint8_t i = 0; i < num_of_bits; i++)
+  {
+    uint32_t word = sim.bit_index / AD7606B_SIM_WORD_BITS;
+    uint32_t bit = AD7606B_SIM_WORD_BITS - 1U - (sim.bit_index % AD7606B_SIM_WORD_BITS);
+    // DOUTA is low past the last channel
+    uint16_t code = (word < AD7606B_SIM_NUM_OF_CHAN) ? (uint16_t) sim.results[word] : 0U;
+    bits = (uint16_t) ((bits << 1) | ((code >> bit) & 1U));
+    if (word < AD7606B_SIM_NUM_OF_CHAN)
+    {
+      sim.bit_index++;
+    }
+  }
+  return bits;
+}
+
+uint32_t ad7606b_sim_get_conversion_count(void)
+{
+  sim_init();
+  sim_update(posix_time_ns());
+  return sim.completed;
+}
@@ -0,0 +1,133 @@
+#ifndef AD7606B_SIM_H
+#define AD7606B_SIM_H
+
+/*
+ * Behavioural model of the AD7606B for the host-native build. It sits behind the pins and the SPI controller
+ * modelled in posix_hardware.c, so the driver in sensor_drivers/ad7606b runs unchanged on top of it.
+ *
+ * - A rising edge of CONVST starts a conversion unless one is in progress, BUSY is high for the conversion
+ *   time, which grows with the oversampling ratio, and the results are latched on its falling edge. Each
+ *   result is the mean of one sample of the waveform of its channel per oversampling cycle.
+ * - The results are shifted out on DOUTA MSB first, V1 to V8, in two's complement, and zeros after V8.
+ *   Until BUSY falls the results of the previous conversion are shifted out.
+ * - FRSTDATA is high while V1 is being shifted out.
+ * - A RESET pulse of 3 us or more is a full reset, the conversions are ignored until the device setup time has
+ *   passed after it. A shorter pulse is a partial reset, which aborts the conversion and clears the results.
+ *
+ * The waveforms and the oversampling ratio are taken from the environment when the model is first used :
+ *   DAS_ADC_OVERSAMPLING  1, 2, 4, 8, 16, 32, 64, 128 or 256, 4 by default as on the board
+ *   DAS_ADC_WAVEFORMS     <channel>=<waveform>[;<channel>=<waveform>...], the channel is 0 to 7 or * for all
+ * where a waveform is one of, with amplitudes in codes :
+ *   ramp[:<step per conversion>[:<offset>]]
+ *   sine[:<amplitude>[:<frequency in Hz>[:<offset>]]]
+ *   noise[:<standard deviation>[:<offset>]]
+ *   step[:<height>[:<time in us>[:<offset>]]]
+ *   file:<path>            one code per line, replayed a line per conversion and looped
+ * By default channel n is a ramp which steps by n+1 codes per conversion, so gaps in the stream show.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define AD7606B_SIM_T_CONV_NS           1700    // Conversion time without oversampling
+#define AD7606B_SIM_T_OS_CYCLE_NS       1000    // Time per oversampling cycle, 4 us with a ratio of 4
+#define AD7606B_SIM_T_FULL_RESET_NS     3000    // Shortest RESET pulse which is a full reset
+#define AD7606B_SIM_T_DEVICE_SETUP_NS   253000  // Time from a full reset until conversions are accepted
+#define AD7606B_SIM_DEFAULT_OS_RATIO    4
+
+enum ad7606bSimWaveformType
+{
+  AD7606B_SIM_RAMP,   // offset + amplitude per conversion, wrapping in 16 bits
+  AD7606B_SIM_SINE,   // offset + amplitude * sin(2 pi frequency t)
+  AD7606B_SIM_NOISE,  // Gaussian noise with a standard deviation of amplitude around offset
+  AD7606B_SIM_STEP,   // offset until step_time_us, offset + amplitude from then on
+  AD7606B_SIM_FILE    // The codes of a file, one per conversion
+};
+
+struct ad7606bSimWaveform
+{
+  enum ad7606bSimWaveformType type;
+  double amplitude;
+  double offset;
+  double frequency_hz;
+  // Time of the step, from the first use of the model
+  uint64_t step_time_us;
+  // Codes replayed by AD7606B_SIM_FILE, owned by the model
+  int16_t* codes;
+  uint32_t num_of_codes;
+};
+
+// Function prototypes
+/**
+ * @brief Set the waveform of a channel
+ *
+ * @param channel The channel, 0 to 7
+ * @param waveform The waveform, its codes are taken over by the model
+ */
+void ad7606b_sim_set_waveform(uint8_t channel, const struct ad7606bSimWaveform* waveform);
+
+/**
+ * @brief Parse a waveform as written in DAS_ADC_WAVEFORMS
+ *
+ * @param spec The waveform, e.g. "sine:8000:50"
+ * @param waveform The parsed waveform, a file is loaded into its codes
+ * @return true if the waveform has been parsed
+ */
+bool ad7606b_sim_parse_waveform(const char* spec, struct ad7606bSimWaveform* waveform);
+
+/**
+ * @brief Set the oversampling ratio, as the OS pins do
+ *
+ * @param ratio The ratio, a power of 2 up to 256
+ * @return true if the ratio is supported
+ */
+bool ad7606b_sim_set_oversampling(uint16_t ratio);
+
+/**
+ * @brief Get the BUSY time of a conversion with the current oversampling ratio
+ *
+ * @return The time in nano-seconds
+ */
+uint32_t ad7606b_sim_get_conversion_time_ns(void);
+
+/**
+ * @brief Drive the CONVST pin
+ */
+void ad7606b_sim_set_convst(bool level);
+
+/**
+ * @brief Drive the RESET pin
+ */
+void ad7606b_sim_set_reset(bool level);
+
+/**
+ * @brief Get the level of the BUSY pin
+ */
+bool ad7606b_sim_get_busy(void);
+
+/**
+ * @brief Get the time at which BUSY falls
+ *
+ * @return The time in nano-seconds from posix_time_ns(), 0 if no conversion is in progress
+ */
+uint64_t ad7606b_sim_get_busy_end_ns(void);
+
+/**
+ * @brief Get the level of the FRSTDATA pin
+ */
+bool ad7606b_sim_get_frstdata(void);
+
+/**
+ * @brief Shift bits out of DOUTA, one SCLK per bit
+ *
+ * @param num_of_bits The number of bits, at most 16
+ * @return The bits, the first one shifted out in the most significant position
+ */
+uint16_t ad7606b_sim_shift_out(uint8_t num_of_bits);
+
+/**
+ * @brief Get the number of conversions which have completed since the model was first used
+ */
+uint32_t ad7606b_sim_get_conversion_count(void);
+
+#endif /* AD7606B_SIM_H */
@@ -0,0 +1,24 @@
+#ifndef POSIX_SEGGER_RTT_H
+#define POSIX_SEGGER_RTT_H
+
+/*
+ * Stand-in for SEGGER RTT in the host-native build, what the device prints over RTT goes to stderr, see
+ * posix_rtt.c.
+ */
+
+// Function prototypes
+/**
+ * @brief Initialise RTT, nothing to do on the host
+ */
+void SEGGER_RTT_Init(void);
+
+/**
+ * @brief Print a formatted string to stderr, as the device prints it into an RTT up-buffer
+ *
+ * @param BufferIndex The RTT up-buffer, ignored
+ * @param sFormat The format string, as for printf(), checked against the arguments as the host types
+ * @return The number of characters printed, or a negative value on failure
+ */
+int SEGGER_RTT_printf(unsigned BufferIndex, const char* sFormat, ...) __attribute__((format(printf, 2, 3)));
+
+#endif /* POSIX_SEGGER_RTT_H */
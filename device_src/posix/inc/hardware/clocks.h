@@ -0,0 +1,38 @@
+#ifndef POSIX_CLOCKS_H
+#define POSIX_CLOCKS_H
+
+/*
+ * Stand-in for hardware/clocks.h in the host-native build, the clocks run at the frequencies the sdk sets up
+ * on the device, so the dividers the drivers compute come out the same.
+ */
+
+#include "pico/types.h"
+
+#define POSIX_CLK_SYS_HZ    125000000U
+#define POSIX_CLK_PERI_HZ   125000000U
+
+enum clock_index
+{
+  clk_gpout0 = 0,
+  clk_gpout1,
+  clk_gpout2,
+  clk_gpout3,
+  clk_ref,
+  clk_sys,
+  clk_peri,
+  clk_usb,
+  clk_adc,
+  clk_rtc,
+  CLK_COUNT
+};
+
+// Function prototypes
+/**
+ * @brief Get the frequency of a clock
+ *
+ * @param clk_index The clock
+ * @return The frequency in Hz
+ */
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+#endif /* POSIX_CLOCKS_H */
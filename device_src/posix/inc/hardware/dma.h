@@ -0,0 +1,135 @@
+#ifndef POSIX_DMA_H
+#define POSIX_DMA_H
+
+/*
+ * Stand-in for hardware/dma.h in the host-native build. The DMA channels are modelled by posix_hardware.c,
+ * a transfer paced by the DREQ of a SPI controller moves a word whenever the controller can take or give one,
+ * so a readout takes as long as it does on the device, and a transfer without a DREQ completes at once.
+ */
+
+#include "pico/types.h"
+
+#define NUM_DMA_CHANNELS  12
+#define DREQ_SPI0_TX      16
+#define DREQ_SPI0_RX      17
+#define DREQ_SPI1_TX      18
+#define DREQ_SPI1_RX      19
+#define DREQ_FORCE        0x3f
+
+enum dma_channel_transfer_size
+{
+  DMA_SIZE_8 = 0,
+  DMA_SIZE_16 = 1,
+  DMA_SIZE_32 = 2
+};
+
+// Configuration of a channel, kept as separate fields rather than packed into a CTRL register
+typedef struct
+{
+  enum dma_channel_transfer_size size;
+  bool read_increment;
+  bool write_increment;
+  uint dreq;
+} dma_channel_config;
+
+// Function prototypes
+/**
+ * @brief Claim a free channel
+ *
+ * @param required If true, panic if no channel is free
+ * @return The channel, -1 if none is free
+ */
+int dma_claim_unused_channel(bool required);
+
+/**
+ * @brief Get the default configuration of a channel, 32-bit transfers with the read address incremented
+ *
+ * @param channel The channel
+ * @return The configuration
+ */
+dma_channel_config dma_channel_get_default_config(uint channel);
+
+/**
+ * @brief Set the size of each transfer
+ */
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size);
+
+/**
+ * @brief Set whether the read address is incremented after each transfer
+ */
+void channel_config_set_read_increment(dma_channel_config* c, bool incr);
+
+/**
+ * @brief Set whether the write address is incremented after each transfer
+ */
+void channel_config_set_write_increment(dma_channel_config* c, bool incr);
+
+/**
+ * @brief Set the DREQ which paces the transfers
+ */
+void channel_config_set_dreq(dma_channel_config* c, uint dreq);
+
+/**
+ * @brief Configure a channel
+ *
+ * @param channel The channel
+ * @param config The configuration
+ * @param write_addr The initial write address
+ * @param read_addr The initial read address
+ * @param transfer_count The number of transfers
+ * @param trigger true to start the channel straight away
+ */
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint transfer_count, bool trigger);
+
+/**
+ * @brief Set the read address of a channel
+ */
+void dma_channel_set_read_addr(uint channel, const volatile void* read_addr, bool trigger);
+
+/**
+ * @brief Set the write address of a channel
+ */
+void dma_channel_set_write_addr(uint channel, volatile void* write_addr, bool trigger);
+
+/**
+ * @brief Set the number of transfers of a channel
+ */
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+
+/**
+ * @brief Start several channels at once
+ *
+ * @param chan_mask The bitmask of channels to start
+ */
+void dma_start_channel_mask(uint32_t chan_mask);
+
+/**
+ * @brief Check whether a channel still has transfers to do
+ */
+bool dma_channel_is_busy(uint channel);
+
+/**
+ * @brief Wait for a channel to finish its transfers
+ */
+void dma_channel_wait_for_finish_blocking(uint channel);
+
+/**
+ * @brief Check whether a channel has raised DMA_IRQ_0 or DMA_IRQ_1
+ *
+ * @param irq_index 0 for DMA_IRQ_0, 1 for DMA_IRQ_1
+ * @param channel The channel
+ */
+bool dma_irqn_get_channel_status(uint irq_index, uint channel);
+
+/**
+ * @brief Acknowledge the interrupt a channel has raised on DMA_IRQ_0 or DMA_IRQ_1
+ */
+void dma_irqn_acknowledge_channel(uint irq_index, uint channel);
+
+/**
+ * @brief Enable or disable the interrupt of a channel on DMA_IRQ_0 or DMA_IRQ_1
+ */
+void dma_irqn_set_channel_enabled(uint irq_index, uint channel, bool enabled);
+
+#endif /* POSIX_DMA_H */
@@ -0,0 +1,120 @@
+#ifndef POSIX_GPIO_H
+#define POSIX_GPIO_H
+
+/*
+ * Stand-in for hardware/gpio.h in the host-native build, the pins are modelled by posix_hardware.c, which
+ * wires the pins of the AD7606B in board_config.h to the simulated ADC. Only the part of the API used by the
+ * AD7606B driver is provided, with the signatures of the sdk.
+ */
+
+#include "pico/types.h"
+#include "hardware/irq.h"
+
+#define GPIO_OUT  1
+#define GPIO_IN   0
+
+enum gpio_function
+{
+  GPIO_FUNC_XIP = 0,
+  GPIO_FUNC_SPI = 1,
+  GPIO_FUNC_UART = 2,
+  GPIO_FUNC_I2C = 3,
+  GPIO_FUNC_PWM = 4,
+  GPIO_FUNC_SIO = 5,
+  GPIO_FUNC_PIO0 = 6,
+  GPIO_FUNC_PIO1 = 7,
+  GPIO_FUNC_GPCK = 8,
+  GPIO_FUNC_USB = 9,
+  GPIO_FUNC_NULL = 0x1f,
+};
+
+enum gpio_irq_level
+{
+  GPIO_IRQ_LEVEL_LOW = 0x1u,
+  GPIO_IRQ_LEVEL_HIGH = 0x2u,
+  GPIO_IRQ_EDGE_FALL = 0x4u,
+  GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+// Function prototypes
+/**
+ * @brief Hand a pin to the SIO as an input driven low, as the sdk does
+ *
+ * @param gpio The pin
+ */
+void gpio_init(uint gpio);
+
+/**
+ * @brief Select the peripheral which drives a pin
+ *
+ * @param gpio The pin
+ * @param fn The function of the pin
+ */
+void gpio_set_function(uint gpio, enum gpio_function fn);
+
+/**
+ * @brief Set the direction of a pin driven by the SIO
+ *
+ * @param gpio The pin
+ * @param out true for an output, false for an input
+ */
+void gpio_set_dir(uint gpio, bool out);
+
+/**
+ * @brief Drive an output pin, the edge is passed on to whatever the board connects to the pin
+ *
+ * @param gpio The pin
+ * @param value The level to drive
+ */
+void gpio_put(uint gpio, bool value);
+
+/**
+ * @brief Get the level of a pin
+ *
+ * @param gpio The pin
+ * @return The level of the pin
+ */
+bool gpio_get(uint gpio);
+
+/**
+ * @brief Get the latched interrupt events of a pin
+ *
+ * @param gpio The pin
+ * @return The mask of enum gpio_irq_level events latched since they were last acknowledged
+ */
+uint32_t gpio_get_irq_event_mask(uint gpio);
+
+/**
+ * @brief Acknowledge latched edge events of a pin
+ *
+ * @param gpio The pin
+ * @param events The mask of enum gpio_irq_level events to acknowledge
+ */
+void gpio_acknowledge_irq(uint gpio, uint32_t events);
+
+/**
+ * @brief Enable or disable the interrupt events of a pin on IO_IRQ_BANK0
+ *
+ * @param gpio The pin
+ * @param events The mask of enum gpio_irq_level events
+ * @param enabled true to enable the events
+ */
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+
+/**
+ * @brief Add a raw handler for the interrupt events of a pin, it is a shared handler on IO_IRQ_BANK0
+ *
+ * @param gpio The pin
+ * @param handler The handler, it has to check and acknowledge the events itself
+ */
+void gpio_add_raw_irq_handler(uint gpio, irq_handler_t handler);
+
+/**
+ * @brief Remove a raw handler added with gpio_add_raw_irq_handler()
+ *
+ * @param gpio The pin
+ * @param handler The handler
+ */
+void gpio_remove_raw_irq_handler(uint gpio, irq_handler_t handler);
+
+#endif /* POSIX_GPIO_H */
@@ -0,0 +1,47 @@
+#ifndef POSIX_IRQ_H
+#define POSIX_IRQ_H
+
+/*
+ * Stand-in for hardware/irq.h in the host-native build. The interrupts of the modelled peripherals are raised
+ * by posix_hardware.c from the register access or the pin edge which causes them, and their handlers are run
+ * there and then, in the context which made that access.
+ */
+
+#include "pico/types.h"
+
+#define DMA_IRQ_0       11
+#define DMA_IRQ_1       12
+#define IO_IRQ_BANK0    13
+#define NUM_IRQS        32
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY  0x80
+
+typedef void (*irq_handler_t)(void);
+
+// Function prototypes
+/**
+ * @brief Enable or disable an interrupt
+ *
+ * @param num The interrupt number
+ * @param enabled true to enable the interrupt
+ */
+void irq_set_enabled(uint num, bool enabled);
+
+/**
+ * @brief Add a shared handler to an interrupt
+ *
+ * @param num The interrupt number
+ * @param handler The handler
+ * @param order_priority Ignored, the shared handlers are run in the order they were added
+ */
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority);
+
+/**
+ * @brief Remove a handler from an interrupt
+ *
+ * @param num The interrupt number
+ * @param handler The handler
+ */
+void irq_remove_handler(uint num, irq_handler_t handler);
+
+#endif /* POSIX_IRQ_H */
@@ -0,0 +1,21 @@
+#ifndef POSIX_PIO_H
+#define POSIX_PIO_H
+
+/*
+ * Stand-in for hardware/pio.h in the host-native build, only the PIO blocks themselves are declared so that
+ * ad7606b_pio.h can be used, the PIO blocks are not modelled, see ad7606b_pio_stub.c.
+ */
+
+typedef struct
+{
+  int index;
+} pio_hw_t;
+
+typedef pio_hw_t* PIO;
+
+extern pio_hw_t posix_pio_blocks[2];
+
+#define pio0  (&posix_pio_blocks[0])
+#define pio1  (&posix_pio_blocks[1])
+
+#endif /* POSIX_PIO_H */
@@ -0,0 +1,61 @@
+#ifndef POSIX_PWM_H
+#define POSIX_PWM_H
+
+/*
+ * Stand-in for hardware/pwm.h in the host-native build. The PWM slices are modelled by posix_hardware.c, the
+ * rising edge of a slice which drives CONVST starts a conversion of the simulated AD7606B every period. The
+ * periods are paced by a hardware alarm, so the conversions come with the tick granularity of posix_alarm.c.
+ */
+
+#include "pico/types.h"
+
+#define NUM_PWM_SLICES  8
+
+// Configuration of a slice, the divider is an integer one
+typedef struct
+{
+  uint32_t clkdiv;
+  uint32_t wrap;
+} pwm_config;
+
+// Function prototypes
+/**
+ * @brief Get the slice which drives a pin
+ */
+uint pwm_gpio_to_slice_num(uint gpio);
+
+/**
+ * @brief Get the default configuration of a slice, a divider of 1 and a wrap of 0xffff
+ */
+pwm_config pwm_get_default_config(void);
+
+/**
+ * @brief Set the integer clock divider of a configuration
+ */
+void pwm_config_set_clkdiv_int(pwm_config* c, uint div);
+
+/**
+ * @brief Set the value at which the counter of a configuration wraps
+ */
+void pwm_config_set_wrap(pwm_config* c, uint16_t wrap);
+
+/**
+ * @brief Configure a slice
+ *
+ * @param slice_num The slice
+ * @param c The configuration
+ * @param start true to start the slice straight away
+ */
+void pwm_init(uint slice_num, pwm_config* c, bool start);
+
+/**
+ * @brief Set the counter value below which a pin is driven high
+ */
+void pwm_set_gpio_level(uint gpio, uint16_t level);
+
+/**
+ * @brief Start or stop a slice
+ */
+void pwm_set_enabled(uint slice_num, bool enabled);
+
+#endif /* POSIX_PWM_H */
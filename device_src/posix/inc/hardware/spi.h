@@ -0,0 +1,86 @@
+#ifndef POSIX_SPI_H
+#define POSIX_SPI_H
+
+/*
+ * Stand-in for hardware/spi.h in the host-native build. The SPI controllers are modelled by posix_hardware.c,
+ * a frame takes as long to shift as it does at the baud rate the controller achieves on the device, and spi1
+ * is wired to the simulated AD7606B as on the board.
+ */
+
+#include "pico/types.h"
+
+// Data register of a controller, the DMA channels of the driver read from and write to it
+typedef struct
+{
+  volatile uint32_t dr;
+} spi_hw_t;
+
+typedef struct spi_inst spi_inst_t;
+
+extern spi_hw_t posix_spi_hw[2];
+
+#define spi0  ((spi_inst_t*) &posix_spi_hw[0])
+#define spi1  ((spi_inst_t*) &posix_spi_hw[1])
+
+#define spi_get_hw(spi)   ((spi_hw_t*) (spi))
+
+typedef enum
+{
+  SPI_CPHA_0 = 0,
+  SPI_CPHA_1 = 1
+} spi_cpha_t;
+
+typedef enum
+{
+  SPI_CPOL_0 = 0,
+  SPI_CPOL_1 = 1
+} spi_cpol_t;
+
+typedef enum
+{
+  SPI_LSB_FIRST = 0,
+  SPI_MSB_FIRST = 1
+} spi_order_t;
+
+// Function prototypes
+/**
+ * @brief Initialise a controller as a master
+ *
+ * @param spi The controller
+ * @param baudrate The requested SCLK frequency in Hz
+ * @return The SCLK frequency achieved from clk_peri, as computed by the sdk
+ */
+uint spi_init(spi_inst_t* spi, uint baudrate);
+
+/**
+ * @brief Set the frame format of a controller
+ *
+ * @param spi The controller
+ * @param data_bits The number of bits per frame, 4 to 16
+ * @param cpol The clock polarity
+ * @param cpha The clock phase
+ * @param order The bit order, only MSB first is supported by the PL022 and the SDK
+ */
+void spi_set_format(spi_inst_t* spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+
+/**
+ * @brief Read frames of up to 16 bits in a blocking manner, repeated_tx_data is clocked out meanwhile
+ *
+ * @param spi The controller
+ * @param repeated_tx_data The frame clocked out for every frame read
+ * @param dst The frames read
+ * @param len The number of frames to read
+ * @return The number of frames read
+ */
+int spi_read16_blocking(spi_inst_t* spi, uint16_t repeated_tx_data, uint16_t* dst, size_t len);
+
+/**
+ * @brief Get the DREQ of a controller, which paces the DMA channels reading from or writing to it
+ *
+ * @param spi The controller
+ * @param is_tx true for the TX DREQ, false for the RX DREQ
+ * @return The DREQ number
+ */
+uint spi_get_dreq(spi_inst_t* spi, bool is_tx);
+
+#endif /* POSIX_SPI_H */
@@ -0,0 +1,18 @@
+#ifndef POSIX_CYW43_ARCH_H
+#define POSIX_CYW43_ARCH_H
+
+/*
+ * Stand-in for the CYW43 architecture of the Pico W in the host-native build, there is no wireless chip and
+ * its LED is not simulated.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CYW43_WL_GPIO_LED_PIN  0
+
+#define cyw43_arch_init()                       (0)
+#define cyw43_arch_deinit()                     ((void) 0)
+#define cyw43_arch_gpio_put(wl_gpio, value)     ((void) (wl_gpio), (void) (value))
+
+#endif /* POSIX_CYW43_ARCH_H */
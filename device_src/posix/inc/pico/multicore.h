@@ -0,0 +1,9 @@
+#ifndef POSIX_MULTICORE_H
+#define POSIX_MULTICORE_H
+
+/*
+ * Stand-in for pico/multicore.h in the host-native build, the second core is only used through FreeRTOS,
+ * which runs every task on the one core of the POSIX port.
+ */
+
+#endif /* POSIX_MULTICORE_H */
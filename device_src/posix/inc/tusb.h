@@ -0,0 +1,166 @@
+#ifndef POSIX_TUSB_H
+#define POSIX_TUSB_H
+
+/*
+ * Stand-in for the device stack of TinyUSB in the host-native build, each CDC interface is a pseudo-terminal
+ * which the host opens like the CDC port of the device, see posix_cdc.c. Only the part of the API used by
+ * main.c is provided, with the same semantics : writes go into a tx fifo of CFG_TUD_CDC_TX_BUFSIZE bytes
+ * which a flush, or tud_task(), hands over to the pseudo-terminal, and the callbacks are invoked from
+ * tud_task(). The vendor interface has no pseudo-terminal of its own, its tx fifo goes out through the one of
+ * the data port, and as with TinyUSB a short tail only goes out on a flush or along with more data.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Settings of tusb_config.h which only exist with the real stack
+#define OPT_OS_FREERTOS           2
+#define OPT_MODE_DEFAULT_SPEED    0
+#define CFG_TUSB_MCU              0
+#define TUD_OPT_HIGH_SPEED        0
+
+#include "tusb_config.h"
+
+// Default paths of the links to the pseudo-terminals of the CDC interfaces, overridden with the environment
+// variables DAS_CONTROL_PORT and DAS_DATA_PORT
+#define POSIX_CDC_CONTROL_LINK    "/tmp/das_control"
+#define POSIX_CDC_DATA_LINK       "/tmp/das_data"
+
+// Function prototypes
+/**
+ * @brief Open a pseudo-terminal per CDC interface and link it to its path, called once before the scheduler starts
+ *
+ * @return true if all the pseudo-terminals have been opened
+ */
+bool tusb_init(void);
+
+/**
+ * @brief Initialise the device stack on a root hub port, nothing is left to do after tusb_init()
+ *
+ * @param rhport The root hub port, ignored
+ * @return true
+ */
+bool tud_init(uint8_t rhport);
+
+/**
+ * @brief Move data between the fifos and the pseudo-terminals and invoke the callbacks, waits for a tick when idle
+ */
+void tud_task(void);
+
+/**
+ * @brief Check whether the device is mounted, always true once the pseudo-terminals are open
+ *
+ * @return true if the device is mounted
+ */
+bool tud_mounted(void);
+
+/**
+ * @brief Get the number of bytes in the rx fifo of a CDC interface
+ *
+ * @param itf The CDC interface
+ * @return The number of bytes which can be read
+ */
+uint32_t tud_cdc_n_available(uint8_t itf);
+
+/**
+ * @brief Read a byte from the rx fifo of a CDC interface
+ *
+ * @param itf The CDC interface
+ * @return The byte, or -1 if the rx fifo is empty
+ */
+int32_t tud_cdc_n_read_char(uint8_t itf);
+
+/**
+ * @brief Drop everything in the rx fifo of a CDC interface
+ *
+ * @param itf The CDC interface
+ */
+void tud_cdc_n_read_flush(uint8_t itf);
+
+/**
+ * @brief Write into the tx fifo of a CDC interface, as much as fits
+ *
+ * @param itf The CDC interface
+ * @param buffer The bytes to write
+ * @param bufsize The number of bytes to write
+ * @return The number of bytes written
+ */
+uint32_t tud_cdc_n_write(uint8_t itf, const void* buffer, uint32_t bufsize);
+
+/**
+ * @brief Hand the tx fifo of a CDC interface over to its pseudo-terminal
+ *
+ * @param itf The CDC interface
+ * @return The number of bytes handed over
+ */
+uint32_t tud_cdc_n_write_flush(uint8_t itf);
+
+/**
+ * @brief Get the room left in the tx fifo of a CDC interface
+ *
+ * @param itf The CDC interface
+ * @return The number of bytes which can be written
+ */
+uint32_t tud_cdc_n_write_available(uint8_t itf);
+
+/**
+ * @brief Drop everything in the tx fifo of a CDC interface which has not been handed over yet
+ *
+ * @param itf The CDC interface
+ * @return true
+ */
+bool tud_cdc_n_write_clear(uint8_t itf);
+
+/**
+ * @brief tud_cdc_n_write() on the first CDC interface
+ */
+uint32_t tud_cdc_write(const void* buffer, uint32_t bufsize);
+
+/**
+ * @brief tud_cdc_n_write_available() on the first CDC interface
+ */
+uint32_t tud_cdc_write_available(void);
+
+/**
+ * @brief Write into the tx fifo of the vendor interface, which is the one of the data port
+ *
+ * @param buffer The bytes to write
+ * @param bufsize The number of bytes to write
+ * @return The number of bytes written
+ */
+uint32_t tud_vendor_write(const void* buffer, uint32_t bufsize);
+
+/**
+ * @brief Get the room left in the tx fifo of the vendor interface
+ *
+ * @return The number of bytes which can be written
+ */
+uint32_t tud_vendor_write_available(void);
+
+/**
+ * @brief Start a transfer with whatever is in the tx fifo of the vendor interface, a write only starts one once
+ * CFG_TUD_VENDOR_EPSIZE bytes are in the fifo
+ *
+ * @return The number of bytes handed over
+ */
+uint32_t tud_vendor_write_flush(void);
+
+/**
+ * @brief Drop everything in the tx fifo of the vendor interface which has not been handed over yet
+ *
+ * @param itf The vendor interface, there is only one
+ * @return true
+ */
+bool tud_vendor_n_write_clear(uint8_t itf);
+
+// Callbacks implemented by the application, as with TinyUSB
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb(void);
+void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts);
+void tud_cdc_rx_cb(uint8_t itf);
+void tud_cdc_tx_complete_cb(uint8_t itf);
+void tud_vendor_tx_cb(uint8_t itf, uint32_t sent_bytes);
+
+#endif /* POSIX_TUSB_H */
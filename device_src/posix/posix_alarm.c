@@ -0,0 +1,202 @@
+/*
+ * Hardware alarms and interrupt masking of the host-native build. The host platform of the sdk has weak
+ * definitions of them which panic, or which only suit a single thread, so they are overridden here to run the
+ * alarm pools main.c creates on top of FreeRTOS.
+ * The alarm interrupt is emulated by the "alarm" task, at the highest priority, which invokes the callbacks
+ * with the scheduler suspended, so they run to completion like an interrupt handler does. Masking interrupts
+ * suspends the scheduler too, so nothing is interleaved with a masked section either.
+ * The alarm task waits in ticks, so an alarm fires up to a tick late and the alarms of a repeating timer
+ * which fall in the same tick fire back to back, the number of alarms over time is still right.
+ */
+#include "pico/stdlib.h"
+#include "hardware/timer.h"
+#include "hardware/sync.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define POSIX_NUM_OF_ALARMS       4
+#define POSIX_ALARM_STACK_SIZE    configMINIMAL_STACK_SIZE
+
+struct posixAlarm
+{
+  bool claimed;
+  bool armed;
+  uint64_t target_us;
+  hardware_alarm_callback_t callback;
+};
+
+static struct posixAlarm alarms[POSIX_NUM_OF_ALARMS];
+static TaskHandle_t alarm_handle = NULL;
+
+// Suspending the scheduler before it has been started would keep it from starting
+static bool scheduler_started(void)
+{
+  return xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+}
+
+static void alarm_task(void* param)
+{
+  (void) param;
+  while (true)
+  {
+    // Find the earliest alarm, and fire it once it is due
+    uint64_t now_us = time_us_64();
+    uint64_t earliest_us = UINT64_MAX;
+    int due_alarm = -1;
+    taskENTER_CRITICAL();
+    for (int i = 0; i < POSIX_NUM_OF_ALARMS; i++)
+    {
+      if (alarms[i].armed && alarms[i].target_us < earliest_us)
+      {
+        earliest_us = alarms[i].target_us;
+        due_alarm = i;
+      }
+    }
+    hardware_alarm_callback_t callback = NULL;
+    if (due_alarm >= 0 && earliest_us <= now_us)
+    {
+      alarms[due_alarm].armed = false;
+      callback = alarms[due_alarm].callback;
+    }
+    taskEXIT_CRITICAL();
+
+    if (callback != NULL)
+    {
+      vTaskSuspendAll();
+      callback((uint) due_alarm);
+      xTaskResumeAll();
+    }else if (due_alarm >= 0)
+    {
+      // Wait for the alarm, or for an alarm to be set meanwhile
+      TickType_t ticks = (TickType_t) ((earliest_us - now_us) / (1000000U / configTICK_RATE_HZ));
+      ulTaskNotifyTake(pdTRUE, (ticks > 0U) ? ticks : 1U);
+    }else
+    {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+  }
+}
+
+void hardware_alarm_claim(uint alarm_num)
+{
+  taskENTER_CRITICAL();
+  hard_assert(!alarms[alarm_num].claimed);
+  alarms[alarm_num].claimed = true;
+  taskEXIT_CRITICAL();
+}
+
+int hardware_alarm_claim_unused(bool required)
+{
+  int alarm_num = -1;
+  taskENTER_CRITICAL();
+  for (int i = 0; i < POSIX_NUM_OF_ALARMS; i++)
+  {
+    if (!alarms[i].claimed)
+    {
+      alarms[i].claimed = true;
+      alarm_num = i;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL();
+  if (required && alarm_num < 0)
+  {
+    panic("No alarms available");
+  }
+  return alarm_num;
+}
+
+void hardware_alarm_unclaim(uint alarm_num)
+{
+  taskENTER_CRITICAL();
+  alarms[alarm_num].claimed = false;
+  alarms[alarm_num].armed = false;
+  taskEXIT_CRITICAL();
+}
+
+bool hardware_alarm_is_claimed(uint alarm_num)
+{
+  return alarms[alarm_num].claimed;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback)
+{
+  // The alarm task stands in for the interrupt, it is created along with the first handler
+  if (alarm_handle == NULL && callback != NULL)
+  {
+    assert(xTaskCreate(alarm_task, "alarm", POSIX_ALARM_STACK_SIZE, NULL, configMAX_PRIORITIES-1, &alarm_handle) == pdPASS);
+  }
+  taskENTER_CRITICAL();
+  alarms[alarm_num].callback = callback;
+  if (callback == NULL)
+  {
+    alarms[alarm_num].armed = false;
+  }
+  taskEXIT_CRITICAL();
+}
+
+// Same as on the device, a target which has already passed is missed and the alarm is left disarmed
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t target)
+{
+  uint64_t target_us = to_us_since_boot(target);
+  bool missed = (target_us <= time_us_64());
+  taskENTER_CRITICAL();
+  alarms[alarm_num].target_us = target_us;
+  alarms[alarm_num].armed = !missed;
+  taskEXIT_CRITICAL();
+  if (!missed && alarm_handle != NULL)
+  {
+    xTaskNotifyGive(alarm_handle);
+  }
+  return missed;
+}
+
+void hardware_alarm_cancel(uint alarm_num)
+{
+  taskENTER_CRITICAL();
+  alarms[alarm_num].armed = false;
+  taskEXIT_CRITICAL();
+}
+
+void hardware_alarm_force_irq(uint alarm_num)
+{
+  taskENTER_CRITICAL();
+  alarms[alarm_num].target_us = time_us_64();
+  alarms[alarm_num].armed = true;
+  taskEXIT_CRITICAL();
+  if (alarm_handle != NULL)
+  {
+    xTaskNotifyGive(alarm_handle);
+  }
+}
+
+uint32_t save_and_disable_interrupts(void)
+{
+  if (scheduler_started())
+  {
+    vTaskSuspendAll();
+  }
+  return 0;
+}
+
+void restore_interrupts(uint32_t status)
+{
+  (void) status;
+  if (scheduler_started())
+  {
+    xTaskResumeAll();
+  }
+}
+
+uint32_t spin_lock_blocking(spin_lock_t* lock)
+{
+  (void) lock;
+  return save_and_disable_interrupts();
+}
+
+void spin_unlock(spin_lock_t* lock, uint32_t saved_irq)
+{
+  (void) lock;
+  restore_interrupts(saved_irq);
+}
@@ -0,0 +1,408 @@
+/*
+ * Stand-in for the CDC and vendor interfaces of TinyUSB in the host-native build, see tusb.h. Every CDC
+ * interface is the master side of a pseudo-terminal, the host opens the slave side, which is linked to a
+ * fixed path, in place of the CDC port of the device. Whether the host has the port open stands in for
+ * DTR, so tud_cdc_line_state_cb() is invoked as the host connects and disconnects. The vendor interface has
+ * a tx fifo of its own, which goes out through the pseudo-terminal of the data port.
+ * The fifos are shared by the tasks writing into them and tud_task(), so they are only touched in critical
+ * sections, the callbacks are invoked outside of them.
+ */
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "tusb.h"
+
+// Index of the CDC interface the vendor interface writes through, the data port
+#define POSIX_CDC_VENDOR_ITF  1
+
+// A byte fifo, the indices wrap at its size
+struct posixFifo
+{
+  uint8_t* buf;
+  uint32_t size;
+  uint32_t head;
+  uint32_t count;
+};
+
+struct posixCdc
+{
+  // Master side of the pseudo-terminal, -1 if it couldn't be opened
+  int master_fd;
+  // Whether the host has the slave side open
+  bool connected;
+  uint8_t rx_buf[CFG_TUD_CDC_RX_BUFSIZE];
+  uint8_t tx_buf[CFG_TUD_CDC_TX_BUFSIZE];
+  struct posixFifo rx_fifo;
+  struct posixFifo tx_fifo;
+  // Bytes handed over since the last completion callback
+  uint32_t tx_sent;
+};
+
+// As with TinyUSB, a transfer is started once a write leaves CFG_TUD_VENDOR_EPSIZE bytes in the tx fifo or on a
+// flush, and every transfer completion starts the next one until the fifo is empty, so a short tail written
+// while no transfer is going on stays in the fifo until more is written or it is flushed
+struct posixVendor
+{
+  uint8_t tx_buf[CFG_TUD_VENDOR_TX_BUFSIZE];
+  struct posixFifo tx_fifo;
+  // Whether a transfer is going on, tud_task() carries on with the fifo meanwhile
+  bool tx_active;
+  // Bytes handed over since the last completion callback
+  uint32_t tx_sent;
+};
+
+static struct posixCdc cdc_itfs[CFG_TUD_CDC];
+static struct posixVendor vendor_itf;
+static bool cdc_mounted = false;
+
+static void fifo_init(struct posixFifo* fifo, uint8_t* buf, uint32_t size)
+{
+  fifo->buf = buf;
+  fifo->size = size;
+  fifo->head = 0;
+  fifo->count = 0;
+}
+
+static uint32_t fifo_write(struct posixFifo* fifo, const uint8_t* data, uint32_t len)
+{
+  uint32_t room = fifo->size - fifo->count;
+  if (len > room)
+  {
+    len = room;
+  }
+  for (uint32_t i = 0; i < len; i++)
+  {
+    fifo->buf[(fifo->head + fifo->count + i) % fifo->size] = data[i];
+  }
+  fifo->count += len;
+  return len;
+}
+
+// Length of the oldest contiguous run of bytes in the fifo
+static uint32_t fifo_linear_count(const struct posixFifo* fifo)
+{
+  uint32_t to_end = fifo->size - fifo->head;
+  return (fifo->count < to_end) ? fifo->count : to_end;
+}
+
+static void fifo_advance(struct posixFifo* fifo, uint32_t len)
+{
+  fifo->head = (fifo->head + len) % fifo->size;
+  fifo->count -= len;
+}
+
+static bool cdc_open_pty(struct posixCdc* cdc, const char* link_path)
+{
+  cdc->master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (cdc->master_fd < 0 || grantpt(cdc->master_fd) != 0 || unlockpt(cdc->master_fd) != 0)
+  {
+    perror("posix_openpt");
+    return false;
+  }
+  char slave_name[64];
+  if (ptsname_r(cdc->master_fd, slave_name, sizeof(slave_name)) != 0)
+  {
+    perror("ptsname_r");
+    return false;
+  }
+
+  // Raw mode, so the stream and the messages go through the line discipline unchanged, the settings stay
+  // with the pseudo-terminal as the host opens and closes it
+  int slave_fd = open(slave_name, O_RDWR | O_NOCTTY);
+  if (slave_fd >= 0)
+  {
+    struct termios tio;
+    if (tcgetattr(slave_fd, &tio) == 0)
+    {
+      cfmakeraw(&tio);
+      tcsetattr(slave_fd, TCSANOW, &tio);
+    }
+    close(slave_fd);
+  }
+
+  unlink(link_path);
+  if (symlink(slave_name, link_path) != 0)
+  {
+    perror("symlink");
+    printf("CDC port %s\n", slave_name);
+  }else
+  {
+    printf("CDC port %s -> %s\n", link_path, slave_name);
+  }
+  return true;
+}
+
+bool tusb_init(void)
+{
+  const char* link_paths[2] = {getenv("DAS_CONTROL_PORT"), getenv("DAS_DATA_PORT")};
+  const char* default_link_paths[2] = {POSIX_CDC_CONTROL_LINK, POSIX_CDC_DATA_LINK};
+
+  bool opened = true;
+  for (uint32_t i = 0; i < CFG_TUD_CDC; i++)
+  {
+    struct posixCdc* cdc = &cdc_itfs[i];
+    fifo_init(&cdc->rx_fifo, cdc->rx_buf, sizeof(cdc->rx_buf));
+    fifo_init(&cdc->tx_fifo, cdc->tx_buf, sizeof(cdc->tx_buf));
+    cdc->connected = false;
+    cdc->tx_sent = 0;
+    const char* link_path = (i < 2U && link_paths[i] != NULL) ? link_paths[i] : default_link_paths[i < 2U ? i : 1U];
+    opened = cdc_open_pty(cdc, link_path) && opened;
+  }
+  fifo_init(&vendor_itf.tx_fifo, vendor_itf.tx_buf, sizeof(vendor_itf.tx_buf));
+  vendor_itf.tx_active = false;
+  vendor_itf.tx_sent = 0;
+  fflush(stdout);
+  return opened;
+}
+
+bool tud_init(uint8_t rhport)
+{
+  (void) rhport;
+  return true;
+}
+
+bool tud_mounted(void)
+{
+  return cdc_mounted;
+}
+
+// Write a tx fifo into the pseudo-terminal of a CDC interface as far as it takes it, in a critical section,
+// returns the number of bytes handed over
+// Nothing reads a pseudo-terminal the host hasn't opened, so the bytes are dropped then, as they are when the
+// host isn't reading the CDC port of the device
+static uint32_t cdc_push_fifo(const struct posixCdc* cdc, struct posixFifo* fifo)
+{
+  uint32_t sent = 0;
+  while (fifo->count > 0U)
+  {
+    uint32_t len = fifo_linear_count(fifo);
+    ssize_t written = len;
+    if (cdc->connected && cdc->master_fd >= 0)
+    {
+      written = write(cdc->master_fd, &fifo->buf[fifo->head], len);
+      if (written <= 0)
+      {
+        // EAGAIN once the pseudo-terminal is full, the rest goes in a later tud_task()
+        break;
+      }
+    }
+    fifo_advance(fifo, (uint32_t) written);
+    sent += (uint32_t) written;
+  }
+  return sent;
+}
+
+static void cdc_push_tx(struct posixCdc* cdc)
+{
+  cdc->tx_sent += cdc_push_fifo(cdc, &cdc->tx_fifo);
+}
+
+// Carry on with the transfers of the vendor interface, in a critical section, they end once the fifo is empty
+static void vendor_push_tx(void)
+{
+  if (vendor_itf.tx_active)
+  {
+    vendor_itf.tx_sent += cdc_push_fifo(&cdc_itfs[POSIX_CDC_VENDOR_ITF], &vendor_itf.tx_fifo);
+    vendor_itf.tx_active = (vendor_itf.tx_fifo.count > 0U);
+  }
+}
+
+void tud_task(void)
+{
+  if (!cdc_mounted)
+  {
+    cdc_mounted = true;
+    tud_mount_cb();
+  }
+
+  for (uint8_t itf = 0; itf < CFG_TUD_CDC; itf++)
+  {
+    struct posixCdc* cdc = &cdc_itfs[itf];
+    if (cdc->master_fd < 0)
+    {
+      continue;
+    }
+
+    // The master side hangs up while the host doesn't have the slave side open
+    struct pollfd pfd = {.fd = cdc->master_fd, .events = POLLIN};
+    bool connected = (poll(&pfd, 1, 0) >= 0) && !(pfd.revents & POLLHUP);
+    bool line_state_changed = (connected != cdc->connected);
+    bool received = false;
+    uint32_t sent = 0;
+    uint32_t vendor_sent = 0;
+
+    taskENTER_CRITICAL();
+    cdc->connected = connected;
+    if (connected && (pfd.revents & POLLIN))
+    {
+      static uint8_t buf[CFG_TUD_CDC_RX_BUFSIZE];
+      uint32_t room = cdc->rx_fifo.size - cdc->rx_fifo.count;
+      ssize_t len = (room > 0U) ? read(cdc->master_fd, buf, room) : 0;
+      if (len > 0)
+      {
+        fifo_write(&cdc->rx_fifo, buf, (uint32_t) len);
+        received = true;
+      }
+    }
+    cdc_push_tx(cdc);
+    sent = cdc->tx_sent;
+    cdc->tx_sent = 0;
+    if (itf == POSIX_CDC_VENDOR_ITF)
+    {
+      vendor_push_tx();
+      vendor_sent = vendor_itf.tx_sent;
+      vendor_itf.tx_sent = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    if (line_state_changed)
+    {
+      tud_cdc_line_state_cb(itf, connected, connected);
+    }
+    if (received)
+    {
+      tud_cdc_rx_cb(itf);
+    }
+    if (vendor_sent > 0U)
+    {
+      tud_vendor_tx_cb(0, vendor_sent);
+    }
+    if (sent > 0U)
+    {
+      tud_cdc_tx_complete_cb(itf);
+    }
+  }
+
+  // Give the lower priority tasks a go, the device stack is as busy as the bus allows on the device
+  vTaskDelay(1);
+}
+
+uint32_t tud_cdc_n_available(uint8_t itf)
+{
+  taskENTER_CRITICAL();
+  uint32_t count = cdc_itfs[itf].rx_fifo.count;
+  taskEXIT_CRITICAL();
+  return count;
+}
+
+int32_t tud_cdc_n_read_char(uint8_t itf)
+{
+  struct posixFifo* fifo = &cdc_itfs[itf].rx_fifo;
+  int32_t c = -1;
+  taskENTER_CRITICAL();
+  if (fifo->count > 0U)
+  {
+    c = fifo->buf[fifo->head];
+    fifo_advance(fifo, 1);
+  }
+  taskEXIT_CRITICAL();
+  return c;
+}
+
+void tud_cdc_n_read_flush(uint8_t itf)
+{
+  taskENTER_CRITICAL();
+  cdc_itfs[itf].rx_fifo.head = 0;
+  cdc_itfs[itf].rx_fifo.count = 0;
+  taskEXIT_CRITICAL();
+}
+
+uint32_t tud_cdc_n_write(uint8_t itf, const void* buffer, uint32_t bufsize)
+{
+  taskENTER_CRITICAL();
+  uint32_t written = fifo_write(&cdc_itfs[itf].tx_fifo, buffer, bufsize);
+  taskEXIT_CRITICAL();
+  return written;
+}
+
+uint32_t tud_cdc_n_write_flush(uint8_t itf)
+{
+  struct posixCdc* cdc = &cdc_itfs[itf];
+  taskENTER_CRITICAL();
+  uint32_t count = cdc->tx_fifo.count;
+  cdc_push_tx(cdc);
+  count -= cdc->tx_fifo.count;
+  taskEXIT_CRITICAL();
+  return count;
+}
+
+uint32_t tud_cdc_n_write_available(uint8_t itf)
+{
+  taskENTER_CRITICAL();
+  uint32_t room = cdc_itfs[itf].tx_fifo.size - cdc_itfs[itf].tx_fifo.count;
+  taskEXIT_CRITICAL();
+  return room;
+}
+
+bool tud_cdc_n_write_clear(uint8_t itf)
+{
+  taskENTER_CRITICAL();
+  cdc_itfs[itf].tx_fifo.head = 0;
+  cdc_itfs[itf].tx_fifo.count = 0;
+  taskEXIT_CRITICAL();
+  return true;
+}
+
+uint32_t tud_cdc_write(const void* buffer, uint32_t bufsize)
+{
+  return tud_cdc_n_write(0, buffer, bufsize);
+}
+
+uint32_t tud_cdc_write_available(void)
+{
+  return tud_cdc_n_write_available(0);
+}
+
+uint32_t tud_vendor_write(const void* buffer, uint32_t bufsize)
+{
+  taskENTER_CRITICAL();
+  uint32_t written = fifo_write(&vendor_itf.tx_fifo, buffer, bufsize);
+  bool full_packet = (vendor_itf.tx_fifo.count >= CFG_TUD_VENDOR_EPSIZE);
+  taskEXIT_CRITICAL();
+  // A full packet starts a transfer
+  if (full_packet)
+  {
+    tud_vendor_write_flush();
+  }
+  return written;
+}
+
+uint32_t tud_vendor_write_flush(void)
+{
+  taskENTER_CRITICAL();
+  uint32_t count = vendor_itf.tx_fifo.count;
+  vendor_itf.tx_active = (count > 0U);
+  vendor_push_tx();
+  count -= vendor_itf.tx_fifo.count;
+  taskEXIT_CRITICAL();
+  return count;
+}
+
+uint32_t tud_vendor_write_available(void)
+{
+  taskENTER_CRITICAL();
+  uint32_t room = vendor_itf.tx_fifo.size - vendor_itf.tx_fifo.count;
+  taskEXIT_CRITICAL();
+  return room;
+}
+
+bool tud_vendor_n_write_clear(uint8_t itf)
+{
+  (void) itf;
+  taskENTER_CRITICAL();
+  vendor_itf.tx_fifo.head = 0;
+  vendor_itf.tx_fifo.count = 0;
+  vendor_itf.tx_active = false;
+  taskEXIT_CRITICAL();
+  return true;
+}
@@ -0,0 +1,720 @@
+/*
+ * Peripherals of the RP2040 used by the AD7606B driver, modelled for the host-native build : the pins, the SPI
+ * controllers, the DMA channels, the PWM slices and their interrupts. The pins of board_config.h are wired to
+ * the simulated AD7606B, so the driver drives it exactly as it drives the real one.
+ * Delays are waited out where the hardware takes them : BUSY stays high for the conversion time, and a frame
+ * on a SPI controller takes as long as it does at the baud rate of the controller. There is no hardware
+ * running alongside the CPU though, so an interrupt is raised from the access which causes it :
+ * - with the falling edge of BUSY enabled on IO_IRQ_BANK0, the edge which starts a conversion waits out the
+ *   conversion and raises it,
+ * - a DMA transfer paced by a SPI controller runs to completion once its channel is started, and raises
+ *   DMA_IRQ_0 or DMA_IRQ_1 as it completes.
+ * The handlers run in the context of that access, which is the emulated alarm interrupt of posix_alarm.c for
+ * the periodic sampler, so the time the ADC and the DMA take counts towards the sampler interrupt here.
+ */
+#include <time.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "hardware/timer.h"
+
+#include "board_config.h"
+#include "ad7606b_sim.h"
+#include "posix_hardware.h"
+
+#define POSIX_NUM_OF_GPIOS              32
+#define POSIX_MAX_SHARED_IRQ_HANDLERS   4
+#define POSIX_SPI_FIFO_DEPTH            8
+
+struct posixGpio
+{
+  enum gpio_function function;
+  bool out;
+  bool level;
+  uint32_t irq_enabled;
+  uint32_t irq_events;
+};
+
+struct posixSpi
+{
+  uint baudrate;
+  uint data_bits;
+  // Time at which the frame being shifted ends
+  uint64_t busy_end_ns;
+  // RX FIFO, the DMA channels are the only ones to use it
+  uint16_t rx_fifo[POSIX_SPI_FIFO_DEPTH];
+  uint32_t rx_head;
+  uint32_t rx_count;
+};
+
+struct posixDmaChannel
+{
+  bool claimed;
+  bool busy;
+  dma_channel_config config;
+  const volatile uint8_t* read_addr;
+  volatile uint8_t* write_addr;
+  uint32_t trans_count;
+};
+
+struct posixPwmSlice
+{
+  pwm_config config;
+  uint16_t level;
+  bool enabled;
+  // Hardware alarm which paces the periods, -1 if none is claimed
+  int alarm_num;
+  uint64_t next_period_ns;
+};
+
+spi_hw_t posix_spi_hw[2];
+
+static struct posixGpio gpios[POSIX_NUM_OF_GPIOS];
+static struct posixSpi spis[2];
+static struct posixDmaChannel dma_channels[NUM_DMA_CHANNELS];
+static uint32_t dma_irq_enabled[2];
+static uint32_t dma_irq_status[2];
+static struct posixPwmSlice pwm_slices[NUM_PWM_SLICES];
+static irq_handler_t irq_handlers[NUM_IRQS][POSIX_MAX_SHARED_IRQ_HANDLERS];
+static bool irq_enabled[NUM_IRQS];
+
+uint64_t posix_time_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000U + (uint64_t) ts.tv_nsec;
+}
+
+void posix_wait_until_ns(uint64_t time_ns)
+{
+  while (posix_time_ns() < time_ns)
+  {
+    tight_loop_contents();
+  }
+}
+
+//--------------------------------------------------------------------+
+// Interrupts
+//--------------------------------------------------------------------+
+static void irq_raise(uint num)
+{
+  if (!irq_enabled[num])
+  {
+    return;
+  }
+  for (uint32_t i = 0; i < POSIX_MAX_SHARED_IRQ_HANDLERS; i++)
+  {
+    irq_handler_t handler = irq_handlers[num][i];
+    if (handler != NULL)
+    {
+      handler();
+    }
+  }
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+  irq_enabled[num] = enabled;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority)
+{
+  (void) order_priority;
+  for (uint32_t i = 0; i < POSIX_MAX_SHARED_IRQ_HANDLERS; i++)
+  {
+    if (irq_handlers[num][i] == NULL)
+    {
+      irq_handlers[num][i] = handler;
+      return;
+    }
+  }
+  panic("No more shared handlers for IRQ %u", num);
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler)
+{
+  for (uint32_t i = 0; i < POSIX_MAX_SHARED_IRQ_HANDLERS; i++)
+  {
+    if (irq_handlers[num][i] == handler)
+    {
+      irq_handlers[num][i] = NULL;
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// Pins
+//--------------------------------------------------------------------+
+// Level of a pin as driven by the board, the outputs of the AD7606B
+static bool gpio_input_level(uint gpio)
+{
+  switch (gpio)
+  {
+    case ADC_BUSY_PIN:
+      return ad7606b_sim_get_busy();
+    case SPI1_TX_PIN:
+      return ad7606b_sim_get_frstdata();
+    default:
+      return gpios[gpio].level;
+  }
+}
+
+// Latch the edges of an input since its level was last seen, and raise IO_IRQ_BANK0 for the enabled ones
+static void gpio_update_input(uint gpio)
+{
+  struct posixGpio* pin = &gpios[gpio];
+  bool level = gpio_input_level(gpio);
+  if (level != pin->level)
+  {
+    pin->irq_events |= level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+    pin->level = level;
+  }
+  if (pin->irq_events & pin->irq_enabled)
+  {
+    irq_raise(IO_IRQ_BANK0);
+  }
+}
+
+// Pass an edge of CONVST on to the ADC, a conversion it starts is waited out when its end has to raise an
+// interrupt, as there is nothing else to notice the falling edge of BUSY
+static void gpio_drive_convst(bool level)
+{
+  ad7606b_sim_set_convst(level);
+  gpio_update_input(ADC_BUSY_PIN);
+  if (gpios[ADC_BUSY_PIN].irq_enabled & GPIO_IRQ_EDGE_FALL)
+  {
+    uint64_t busy_end_ns = ad7606b_sim_get_busy_end_ns();
+    if (busy_end_ns != 0U)
+    {
+      posix_wait_until_ns(busy_end_ns);
+      gpio_update_input(ADC_BUSY_PIN);
+    }
+  }
+}
+
+// Level driven onto a pin by the peripheral its function selects
+static void gpio_drive(uint gpio, bool level)
+{
+  switch (gpio)
+  {
+    case ADC_CONVST_PIN:
+      gpio_drive_convst(level);
+      break;
+    case ADC_RESET_PIN:
+      ad7606b_sim_set_reset(level);
+      break;
+    default:
+      break;
+  }
+  gpios[gpio].level = level;
+}
+
+void gpio_init(uint gpio)
+{
+  gpio_set_dir(gpio, GPIO_IN);
+  gpio_put(gpio, 0);
+  gpio_set_function(gpio, GPIO_FUNC_SIO);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+  gpios[gpio].function = fn;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+  gpios[gpio].out = out;
+}
+
+void gpio_put(uint gpio, bool value)
+{
+  // Only a pin driven by the SIO as an output passes its level on to the board
+  struct posixGpio* pin = &gpios[gpio];
+  if (pin->out && pin->function == GPIO_FUNC_SIO && pin->level != value)
+  {
+    gpio_drive(gpio, value);
+  }
+}
+
+bool gpio_get(uint gpio)
+{
+  if (gpios[gpio].out)
+  {
+    return gpios[gpio].level;
+  }
+  gpio_update_input(gpio);
+  return gpios[gpio].level;
+}
+
+uint32_t gpio_get_irq_event_mask(uint gpio)
+{
+  return gpios[gpio].irq_events & gpios[gpio].irq_enabled;
+}
+
+void gpio_acknowledge_irq(uint gpio, uint32_t events)
+{
+  gpios[gpio].irq_events &= ~events;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled)
+{
+  if (enabled)
+  {
+    gpios[gpio].irq_enabled |= events;
+  }else
+  {
+    gpios[gpio].irq_enabled &= ~events;
+  }
+}
+
+void gpio_add_raw_irq_handler(uint gpio, irq_handler_t handler)
+{
+  (void) gpio;
+  irq_add_shared_handler(IO_IRQ_BANK0, handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+}
+
+void gpio_remove_raw_irq_handler(uint gpio, irq_handler_t handler)
+{
+  (void) gpio;
+  irq_remove_handler(IO_IRQ_BANK0, handler);
+}
+
+//--------------------------------------------------------------------+
+// SPI
+//--------------------------------------------------------------------+
+static uint32_t spi_index(spi_inst_t* spi)
+{
+  return (spi_get_hw(spi) == &posix_spi_hw[0]) ? 0U : 1U;
+}
+
+// Shift a frame out and one in, once the frame before it has been shifted
+static uint16_t spi_transfer(uint32_t index, uint16_t tx)
+{
+  (void) tx;
+  struct posixSpi* controller = &spis[index];
+  uint64_t start_ns = posix_time_ns();
+  if (controller->busy_end_ns > start_ns)
+  {
+    start_ns = controller->busy_end_ns;
+  }
+  controller->busy_end_ns = start_ns + ((uint64_t) controller->data_bits * 1000000000U) / controller->baudrate;
+  posix_wait_until_ns(controller->busy_end_ns);
+
+  // DOUTA of the AD7606B is wired to the RX pin of SPI1, DIN is not connected
+  if (index == 1U && gpios[SPI1_RX_PIN].function == GPIO_FUNC_SPI)
+  {
+    return ad7606b_sim_shift_out((uint8_t) controller->data_bits);
+  }
+  return 0;
+}
+
+uint spi_init(spi_inst_t* spi, uint baudrate)
+{
+  struct posixSpi* controller = &spis[spi_index(spi)];
+  // Same prescaler and post-divider search as the sdk
+  uint32_t freq_in = clock_get_hz(clk_peri);
+  uint32_t prescale;
+  uint32_t postdiv;
+  for (prescale = 2; prescale <= 254; prescale += 2)
+  {
+    if (freq_in < (prescale + 2) * 256 * (uint64_t) baudrate)
+    {
+      break;
+    }
+  }
+  for (postdiv = 256; postdiv > 1; --postdiv)
+  {
+    if (freq_in / (prescale * (postdiv - 1)) > baudrate)
+    {
+      break;
+    }
+  }
+  controller->baudrate = freq_in / (prescale * postdiv);
+  controller->data_bits = 8;
+  controller->busy_end_ns = 0;
+  controller->rx_head = 0;
+  controller->rx_count = 0;
+  return controller->baudrate;
+}
+
+void spi_set_format(spi_inst_t* spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order)
+{
+  (void) cpol;
+  (void) cpha;
+  hard_assert(data_bits >= 4 && data_bits <= 16);
+  hard_assert(order == SPI_MSB_FIRST);
+  spis[spi_index(spi)].data_bits = data_bits;
+}
+
+int spi_read16_blocking(spi_inst_t* spi, uint16_t repeated_tx_data, uint16_t* dst, size_t len)
+{
+  uint32_t index = spi_index(spi);
+  for (size_t i = 0; i < len; i++)
+  {
+    dst[i] = spi_transfer(index, repeated_tx_data);
+  }
+  return (int) len;
+}
+
+uint spi_get_dreq(spi_inst_t* spi, bool is_tx)
+{
+  return (spi_index(spi) == 0U) ? (is_tx ? DREQ_SPI0_TX : DREQ_SPI0_RX) : (is_tx ? DREQ_SPI1_TX : DREQ_SPI1_RX);
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+static uint32_t dma_read_word(struct posixDmaChannel* channel)
+{
+  uint32_t word;
+  switch (channel->config.size)
+  {
+    case DMA_SIZE_8:
+      word = *(const volatile uint8_t*) channel->read_addr;
+      break;
+    case DMA_SIZE_16:
+      word = *(const volatile uint16_t*) channel->read_addr;
+      break;
+    default:
+      word = *(const volatile uint32_t*) channel->read_addr;
+      break;
+  }
+  if (channel->config.read_increment)
+  {
+    channel->read_addr += 1U << channel->config.size;
+  }
+  return word;
+}
+
+static void dma_write_word(struct posixDmaChannel* channel, uint32_t word)
+{
+  switch (channel->config.size)
+  {
+    case DMA_SIZE_8:
+      *(volatile uint8_t*) channel->write_addr = (uint8_t) word;
+      break;
+    case DMA_SIZE_16:
+      *(volatile uint16_t*) channel->write_addr = (uint16_t) word;
+      break;
+    default:
+      *(volatile uint32_t*) channel->write_addr = word;
+      break;
+  }
+  if (channel->config.write_increment)
+  {
+    channel->write_addr += 1U << channel->config.size;
+  }
+}
+
+// Do one transfer of a channel if its DREQ allows it
+static bool dma_step(struct posixDmaChannel* channel)
+{
+  uint dreq = channel->config.dreq;
+  if (dreq == DREQ_SPI0_TX || dreq == DREQ_SPI1_TX)
+  {
+    // The frame written into the data register is shifted straight away, its received frame goes into the
+    // RX FIFO, which has to have room for it
+    struct posixSpi* controller = &spis[(dreq == DREQ_SPI0_TX) ? 0 : 1];
+    if (controller->rx_count == POSIX_SPI_FIFO_DEPTH)
+    {
+      return false;
+    }
+    uint16_t rx = spi_transfer((dreq == DREQ_SPI0_TX) ? 0U : 1U, (uint16_t) dma_read_word(channel));
+    controller->rx_fifo[(controller->rx_head + controller->rx_count) % POSIX_SPI_FIFO_DEPTH] = rx;
+    controller->rx_count++;
+  }else if (dreq == DREQ_SPI0_RX || dreq == DREQ_SPI1_RX)
+  {
+    struct posixSpi* controller = &spis[(dreq == DREQ_SPI0_RX) ? 0 : 1];
+    if (controller->rx_count == 0U)
+    {
+      return false;
+    }
+    dma_write_word(channel, controller->rx_fifo[controller->rx_head]);
+    controller->rx_head = (controller->rx_head + 1U) % POSIX_SPI_FIFO_DEPTH;
+    controller->rx_count--;
+  }else
+  {
+    dma_write_word(channel, dma_read_word(channel));
+  }
+  channel->trans_count--;
+  return true;
+}
+
+// Run the busy channels until none of them can make progress, then raise the interrupts of the channels which
+// completed meanwhile
+static void dma_run(void)
+{
+  uint32_t completed = 0;
+  bool progress = true;
+  while (progress)
+  {
+    progress = false;
+    for (uint32_t i = 0; i < NUM_DMA_CHANNELS; i++)
+    {
+      struct posixDmaChannel* channel = &dma_channels[i];
+      if (!channel->busy)
+      {
+        continue;
+      }
+      if (channel->trans_count > 0U && dma_step(channel))
+      {
+        progress = true;
+      }
+      if (channel->trans_count == 0U)
+      {
+        channel->busy = false;
+        completed |= 1U << i;
+      }
+    }
+  }
+
+  for (uint32_t irq_index = 0; irq_index < 2U; irq_index++)
+  {
+    uint32_t raised = completed & dma_irq_enabled[irq_index];
+    if (raised != 0U)
+    {
+      dma_irq_status[irq_index] |= raised;
+      irq_raise(DMA_IRQ_0 + irq_index);
+    }
+  }
+}
+
+int dma_claim_unused_channel(bool required)
+{
+  for (uint32_t i = 0; i < NUM_DMA_CHANNELS; i++)
+  {
+    if (!dma_channels[i].claimed)
+    {
+      dma_channels[i].claimed = true;
+      return (int) i;
+    }
+  }
+  if (required)
+  {
+    panic("No DMA channels are available");
+  }
+  return -1;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+  (void) channel;
+  return (dma_channel_config) {.size = DMA_SIZE_32, .read_increment = true, .write_increment = false, .dreq = DREQ_FORCE};
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size)
+{
+  c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config* c, bool incr)
+{
+  c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config* c, bool incr)
+{
+  c->write_increment = incr;
+}
+
+void channel_config_set_dreq(dma_channel_config* c, uint dreq)
+{
+  c->dreq = dreq;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint transfer_count, bool trigger)
+{
+  dma_channels[channel].config = *config;
+  dma_channel_set_read_addr(channel, read_addr, false);
+  dma_channel_set_write_addr(channel, write_addr, false);
+  dma_channel_set_trans_count(channel, transfer_count, trigger);
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void* read_addr, bool trigger)
+{
+  dma_channels[channel].read_addr = read_addr;
+  if (trigger)
+  {
+    dma_start_channel_mask(1U << channel);
+  }
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void* write_addr, bool trigger)
+{
+  dma_channels[channel].write_addr = write_addr;
+  if (trigger)
+  {
+    dma_start_channel_mask(1U << channel);
+  }
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger)
+{
+  dma_channels[channel].trans_count = trans_count;
+  if (trigger)
+  {
+    dma_start_channel_mask(1U << channel);
+  }
+}
+
+void dma_start_channel_mask(uint32_t chan_mask)
+{
+  for (uint32_t i = 0; i < NUM_DMA_CHANNELS; i++)
+  {
+    if (chan_mask & (1U << i))
+    {
+      dma_channels[i].busy = true;
+    }
+  }
+  dma_run();
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+  return dma_channels[channel].busy;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel)
+{
+  // A channel which is still busy once dma_run() has returned is starved of its DREQ for good
+  hard_assert(!dma_channels[channel].busy);
+}
+
+bool dma_irqn_get_channel_status(uint irq_index, uint channel)
+{
+  return (dma_irq_status[irq_index] & (1U << channel)) != 0U;
+}
+
+void dma_irqn_acknowledge_channel(uint irq_index, uint channel)
+{
+  dma_irq_status[irq_index] &= ~(1U << channel);
+}
+
+void dma_irqn_set_channel_enabled(uint irq_index, uint channel, bool enabled)
+{
+  if (enabled)
+  {
+    dma_irq_enabled[irq_index] |= 1U << channel;
+  }else
+  {
+    dma_irq_enabled[irq_index] &= ~(1U << channel);
+  }
+}
+
+//--------------------------------------------------------------------+
+// PWM
+//--------------------------------------------------------------------+
+static uint64_t pwm_period_ns(const struct posixPwmSlice* slice)
+{
+  return ((uint64_t) (slice->config.wrap + 1U) * slice->config.clkdiv * 1000000000U) / clock_get_hz(clk_sys);
+}
+
+// One period of a slice, its channel drives the pin high from the wrap for level counts
+static void pwm_period(uint slice_num)
+{
+  uint gpio = ADC_CONVST_PIN;
+  if (pwm_gpio_to_slice_num(gpio) != slice_num || gpios[gpio].function != GPIO_FUNC_PWM)
+  {
+    return;
+  }
+  if (pwm_slices[slice_num].level > 0U)
+  {
+    gpio_drive(gpio, 1);
+  }
+  gpio_drive(gpio, 0);
+}
+
+// Alarm callback pacing the periods of the enabled slices, the periods missed meanwhile are caught up
+static void pwm_alarm_cb(uint alarm_num)
+{
+  for (uint slice_num = 0; slice_num < NUM_PWM_SLICES; slice_num++)
+  {
+    struct posixPwmSlice* slice = &pwm_slices[slice_num];
+    if (!slice->enabled || slice->alarm_num != (int) alarm_num)
+    {
+      continue;
+    }
+    uint64_t period_ns = pwm_period_ns(slice);
+    do
+    {
+      pwm_period(slice_num);
+      slice->next_period_ns += period_ns;
+    } while (slice->enabled && hardware_alarm_set_target(alarm_num, from_us_since_boot(slice->next_period_ns / 1000U)));
+  }
+}
+
+uint pwm_gpio_to_slice_num(uint gpio)
+{
+  return (gpio >> 1U) & 7U;
+}
+
+pwm_config pwm_get_default_config(void)
+{
+  return (pwm_config) {.clkdiv = 1, .wrap = 0xffff};
+}
+
+void pwm_config_set_clkdiv_int(pwm_config* c, uint div)
+{
+  c->clkdiv = div;
+}
+
+void pwm_config_set_wrap(pwm_config* c, uint16_t wrap)
+{
+  c->wrap = wrap;
+}
+
+void pwm_init(uint slice_num, pwm_config* c, bool start)
+{
+  pwm_slices[slice_num].config = *c;
+  pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_gpio_level(uint gpio, uint16_t level)
+{
+  pwm_slices[pwm_gpio_to_slice_num(gpio)].level = level;
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled)
+{
+  struct posixPwmSlice* slice = &pwm_slices[slice_num];
+  if (enabled == slice->enabled)
+  {
+    return;
+  }
+  slice->enabled = enabled;
+  if (!enabled)
+  {
+    if (slice->alarm_num >= 0)
+    {
+      hardware_alarm_cancel((uint) slice->alarm_num);
+      hardware_alarm_set_callback((uint) slice->alarm_num, NULL);
+      hardware_alarm_unclaim((uint) slice->alarm_num);
+      slice->alarm_num = -1;
+    }
+    return;
+  }
+
+  slice->alarm_num = hardware_alarm_claim_unused(true);
+  hardware_alarm_set_callback((uint) slice->alarm_num, pwm_alarm_cb);
+  // The counter starts from 0, so the first rising edge is a period away
+  slice->next_period_ns = time_us_64() * 1000U + pwm_period_ns(slice);
+  while (slice->enabled && hardware_alarm_set_target((uint) slice->alarm_num, from_us_since_boot(slice->next_period_ns / 1000U)))
+  {
+    pwm_period(slice_num);
+    slice->next_period_ns += pwm_period_ns(slice);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Clocks
+//--------------------------------------------------------------------+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+  return (clk_index == clk_peri) ? POSIX_CLK_PERI_HZ : POSIX_CLK_SYS_HZ;
+}
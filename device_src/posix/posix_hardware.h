@@ -0,0 +1,26 @@
+#ifndef POSIX_HARDWARE_H
+#define POSIX_HARDWARE_H
+
+/*
+ * Time base of the peripherals modelled in posix_hardware.c and of the simulated AD7606B, the delays they
+ * model are waited out on the monotonic clock.
+ */
+
+#include <stdint.h>
+
+// Function prototypes
+/**
+ * @brief Get the time of the monotonic clock
+ *
+ * @return The time in nano-seconds
+ */
+uint64_t posix_time_ns(void);
+
+/**
+ * @brief Spin until a time of the monotonic clock, as the hardware takes the time without yielding
+ *
+ * @param time_ns The time in nano-seconds from posix_time_ns()
+ */
+void posix_wait_until_ns(uint64_t time_ns);
+
+#endif /* POSIX_HARDWARE_H */
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Build device_main_posix and run its tests, start it, and run host_src/python_host_scripts/posix_smoke_test.py
+# over its pseudo-terminals, which streams the test pattern and checks the replies and the stream. The exit status is
+# that of the smoke test, so it can gate a CI-like run :
+#   device_src/posix/smoke_test.sh [build directory, build_posix by default]
+# The firmware log goes to smoke_test_device.log in the build directory.
+set -e
+
+REPO_ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+BUILD_DIR=${1:-$REPO_ROOT/build_posix}
+CONTROL_PORT=/tmp/das_control
+DATA_PORT=/tmp/das_data
+
+cmake -S "$REPO_ROOT/device_src/posix" -B "$BUILD_DIR"
+cmake --build "$BUILD_DIR" -j
+# The AD7606B driver over the simulated ADC first, see test_ad7606b_sim.c
+ctest --test-dir "$BUILD_DIR" --output-on-failure
+
+# Links left over by an earlier run would be taken for those of this one
+rm -f "$CONTROL_PORT" "$DATA_PORT"
+# A bipolar sine on channel 0 of the simulated ADC, its amplitude is ADC_SINE_AMPLITUDE of posix_smoke_test.py
+DAS_ADC_WAVEFORMS="0=sine:20000:50" "$BUILD_DIR/device_main_posix" > "$BUILD_DIR/smoke_test_device.log" 2>&1 &
+DEVICE_PID=$!
+trap 'kill $DEVICE_PID 2>/dev/null || true' EXIT
+
+# The pseudo-terminals are linked once the scheduler has started the USB task
+tries=0
+while [ ! -e "$CONTROL_PORT" ] || [ ! -e "$DATA_PORT" ]; do
+  tries=$((tries + 1))
+  if [ $tries -gt 100 ] || ! kill -0 $DEVICE_PID 2>/dev/null; then
+    echo "device_main_posix didn't open its ports, see $BUILD_DIR/smoke_test_device.log"
+    exit 1
+  fi
+  sleep 0.1
+done
+
+cd "$REPO_ROOT/host_src/python_host_scripts"
+python3 posix_smoke_test.py "$CONTROL_PORT" "$DATA_PORT"
+
+# The firmware has to have survived the session
+if ! kill -0 $DEVICE_PID 2>/dev/null; then
+  echo "device_main_posix exited during the smoke test, see $BUILD_DIR/smoke_test_device.log"
+  exit 1
+fi
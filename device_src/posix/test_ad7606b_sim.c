@@ -0,0 +1,335 @@
+/*
+ * Test of the AD7606B driver over the simulated ADC, the driver, the modelled peripherals of posix_hardware.c
+ * and ad7606b_sim.c are built as they are for device_main_posix. Every channel is a ramp, so the code read out
+ * of a conversion tells which conversion it comes from.
+ */
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/spi.h"
+
+#include "board_config.h"
+#include "ad7606b.h"
+#include "ad7606b_sim.h"
+#include "posix_hardware.h"
+#include "test_check.h"
+
+#define NUM_OF_DMA_FRAMES  32U
+
+// Frames handed to the DMA frame callback, and what the callback saw of the pins and the driver
+struct dmaFrame
+{
+  uint16_t words[AD7606B_NUM_OF_CHAN];
+  uint8_t num_of_words;
+  const uint16_t* buffer;
+  uint32_t timestamp_us;
+  bool busy;
+};
+
+static struct dmaFrame dma_frames[NUM_OF_DMA_FRAMES];
+static uint32_t num_of_dma_frames = 0;
+
+static void dma_frame_cb(const uint16_t* frame, uint8_t num_of_words)
+{
+  if (num_of_dma_frames < NUM_OF_DMA_FRAMES)
+  {
+    struct dmaFrame* record = &dma_frames[num_of_dma_frames];
+    for (uint8_t i = 0; i < num_of_words; i++)
+    {
+      record->words[i] = frame[i];
+    }
+    record->num_of_words = num_of_words;
+    record->buffer = frame;
+    record->timestamp_us = ad7606b_get_frame_timestamp_us();
+    record->busy = gpio_get(ADC_BUSY_PIN);
+  }
+  num_of_dma_frames++;
+}
+
+// Offset and step of the ramp of a channel, negative on half of them for the two's complement codes
+static int32_t ramp_offset(uint8_t channel)
+{
+  return (channel % 2U) ? -1000 * (int32_t) channel : 1000 * (int32_t) channel;
+}
+
+static uint32_t ramp_step(uint8_t channel)
+{
+  return 7U * channel + 1U;
+}
+
+// Code of a channel in the results of a conversion, the conversions are counted from the first use of the model
+static uint16_t expected_code(uint8_t channel, uint32_t conversion)
+{
+  return (uint16_t) (ramp_offset(channel) + (int64_t) ramp_step(channel) * conversion);
+}
+
+// Value ad7606b_sample() hands out for that code, sign extended
+static int32_t expected_value(uint8_t channel, uint32_t conversion)
+{
+  return (int16_t) expected_code(channel, conversion);
+}
+
+static void set_ramps(void)
+{
+  for (uint8_t c = 0; c < AD7606B_NUM_OF_CHAN; c++)
+  {
+    struct ad7606bSimWaveform waveform = {.type = AD7606B_SIM_RAMP, .amplitude = ramp_step(c), .offset = ramp_offset(c)};
+    ad7606b_sim_set_waveform(c, &waveform);
+  }
+}
+
+// Time a frame of num_of_words takes to be shifted out at most at the SCLK frequency of the driver
+static uint64_t min_readout_ns(uint8_t num_of_words)
+{
+  return ((uint64_t) num_of_words * ADC_SPI_DATA_BITS * 1000000000U) / (SPI1_SCLK_FREQ);
+}
+
+static void test_parse_waveform(void)
+{
+  struct ad7606bSimWaveform waveform;
+  CHECK(ad7606b_sim_parse_waveform("ramp:3:-5", &waveform));
+  CHECK(waveform.type == AD7606B_SIM_RAMP && waveform.amplitude == 3.0 && waveform.offset == -5.0);
+  CHECK(ad7606b_sim_parse_waveform("sine:8000:50", &waveform));
+  CHECK(waveform.type == AD7606B_SIM_SINE && waveform.amplitude == 8000.0 && waveform.frequency_hz == 50.0 && waveform.offset == 0.0);
+  CHECK(ad7606b_sim_parse_waveform("step", &waveform));
+  CHECK(waveform.type == AD7606B_SIM_STEP && waveform.step_time_us == 1000000U);
+  CHECK(!ad7606b_sim_parse_waveform("square:1", &waveform));
+  CHECK(!ad7606b_sim_parse_waveform("ramp:1x", &waveform));
+  CHECK(!ad7606b_sim_set_oversampling(0));
+  CHECK(!ad7606b_sim_set_oversampling(3));
+  CHECK(!ad7606b_sim_set_oversampling(512));
+}
+
+// BUSY rises with CONVST and falls after the conversion time, a CONVST edge while it is high is ignored, and
+// the results of the previous conversion are shifted out until it falls, FRSTDATA marks the first word
+static void test_busy_sequencing(void)
+{
+  uint16_t frame[AD7606B_NUM_OF_CHAN];
+  // The longest conversion, so there is time to look at the ADC while it converts
+  CHECK(ad7606b_sim_set_oversampling(256));
+  ad7606b_read_frame(frame, 1);
+  uint32_t conversion = ad7606b_sim_get_conversion_count();
+
+  uint64_t start_ns = posix_time_ns();
+  ad7606b_convert();
+  uint64_t busy_end_ns = ad7606b_sim_get_busy_end_ns();
+  CHECK(busy_end_ns >= start_ns + ad7606b_sim_get_conversion_time_ns());
+  ad7606b_convert();
+  bool busy = gpio_get(ADC_BUSY_PIN);
+  uint16_t word;
+  spi_read16_blocking(ADC_SPI_CHANNEL, 0, &word, 1);
+  // Only if it all came before the end of the conversion, the host may have descheduled the test meanwhile
+  if (posix_time_ns() < busy_end_ns)
+  {
+    CHECK(busy);
+    // The second edge is ignored, the conversion in progress carries on
+    CHECK_EQ(ad7606b_sim_get_busy_end_ns(), busy_end_ns);
+    CHECK_EQ(word, expected_code(1, conversion - 1U));
+  }else
+  {
+    printf("Descheduled past the end of the conversion, its checks are skipped\n");
+    while (gpio_get(ADC_BUSY_PIN));
+    conversion = ad7606b_sim_get_conversion_count() - 1U;
+  }
+
+  posix_wait_until_ns(busy_end_ns);
+  CHECK(!gpio_get(ADC_BUSY_PIN));
+  CHECK_EQ(ad7606b_sim_get_conversion_count(), conversion + 1U);
+  CHECK(gpio_get(SPI1_TX_PIN));
+  spi_read16_blocking(ADC_SPI_CHANNEL, 0, &word, 1);
+  CHECK(!gpio_get(SPI1_TX_PIN));
+  CHECK_EQ(word, expected_code(0, conversion));
+  spi_read16_blocking(ADC_SPI_CHANNEL, 0, frame, AD7606B_NUM_OF_CHAN);
+  for (uint8_t c = 1; c < AD7606B_NUM_OF_CHAN; c++)
+  {
+    CHECK_EQ(frame[c - 1U], expected_code(c, conversion));
+  }
+  // DOUTA is low past V8
+  CHECK_EQ(frame[AD7606B_NUM_OF_CHAN - 1U], 0);
+  CHECK(ad7606b_sim_set_oversampling(AD7606B_SIM_DEFAULT_OS_RATIO));
+}
+
+// A blocking frame takes the conversion and the readout, and holds the codes of that conversion, the time
+// grows with the oversampling ratio
+static void test_blocking_readout(void)
+{
+  const uint16_t os_ratios[] = {1, 4, 64};
+  for (uint32_t r = 0; r < sizeof(os_ratios) / sizeof(os_ratios[0]); r++)
+  {
+    CHECK(ad7606b_sim_set_oversampling(os_ratios[r]));
+    uint32_t conversion_time_ns = ad7606b_sim_get_conversion_time_ns();
+    CHECK_EQ(conversion_time_ns, (os_ratios[r] == 1U) ? AD7606B_SIM_T_CONV_NS : os_ratios[r] * AD7606B_SIM_T_OS_CYCLE_NS);
+    for (uint8_t num_of_words = 1; num_of_words <= AD7606B_NUM_OF_CHAN; num_of_words++)
+    {
+      uint16_t frame[AD7606B_NUM_OF_CHAN] = {0};
+      uint32_t conversion = ad7606b_sim_get_conversion_count();
+      uint64_t start_ns = posix_time_ns();
+      ad7606b_read_frame(frame, num_of_words);
+      uint64_t elapsed_ns = posix_time_ns() - start_ns;
+      CHECK(elapsed_ns >= conversion_time_ns + min_readout_ns(num_of_words));
+      CHECK_EQ(ad7606b_sim_get_conversion_count(), conversion + 1U);
+      for (uint8_t c = 0; c < AD7606B_NUM_OF_CHAN; c++)
+      {
+        // The channels which aren't read out aren't written either
+        CHECK_EQ(frame[c], (c < num_of_words) ? expected_code(c, conversion) : 0U);
+      }
+    }
+  }
+  CHECK(ad7606b_sim_set_oversampling(AD7606B_SIM_DEFAULT_OS_RATIO));
+
+  // ad7606b_sample() appends the active channels to what is already in the buffer
+  int32_t dest_buf[2 * AD7606B_NUM_OF_CHAN];
+  uint8_t elements = 3;
+  uint32_t conversion = ad7606b_sim_get_conversion_count();
+  ad7606b_sample(dest_buf, &elements, 5);
+  CHECK_EQ(elements, 8);
+  for (uint8_t c = 0; c < 5U; c++)
+  {
+    CHECK_EQ(dest_buf[3U + c], expected_value(c, conversion));
+  }
+
+  // Negative codes come out negative, full scale both ways
+  const int32_t levels[] = {INT16_MIN, -1, 0, 1, INT16_MAX};
+  for (uint8_t c = 0; c < sizeof(levels) / sizeof(levels[0]); c++)
+  {
+    struct ad7606bSimWaveform waveform = {.type = AD7606B_SIM_RAMP, .amplitude = 0, .offset = levels[c]};
+    ad7606b_sim_set_waveform(c, &waveform);
+  }
+  elements = 0;
+  ad7606b_sample(dest_buf, &elements, 5);
+  for (uint8_t c = 0; c < sizeof(levels) / sizeof(levels[0]); c++)
+  {
+    CHECK_EQ(dest_buf[c], levels[c]);
+  }
+  set_ramps();
+}
+
+// A frame per conversion is read out with DMA once BUSY has fallen, into the ping-pong buffers in turn, and
+// is timestamped at the falling edge of BUSY
+static void test_dma_readout(void)
+{
+  ad7606b_dma_init();
+  CHECK(!ad7606b_dma_start(dma_frame_cb, 0));
+  CHECK(!ad7606b_dma_start(dma_frame_cb, AD7606B_NUM_OF_CHAN + 1U));
+  CHECK(ad7606b_dma_start(dma_frame_cb, AD7606B_NUM_OF_CHAN));
+  ad7606b_set_backend(AD7606B_BACKEND_DMA);
+
+  num_of_dma_frames = 0;
+  uint32_t first_conversion = ad7606b_sim_get_conversion_count();
+  uint32_t start_us[NUM_OF_DMA_FRAMES];
+  uint32_t end_us[NUM_OF_DMA_FRAMES];
+  for (uint32_t i = 0; i < NUM_OF_DMA_FRAMES; i++)
+  {
+    start_us[i] = time_us_32();
+    ad7606b_convert();
+    end_us[i] = time_us_32();
+    CHECK_EQ(num_of_dma_frames, i + 1U);
+  }
+  CHECK_EQ(ad7606b_sim_get_conversion_count(), first_conversion + NUM_OF_DMA_FRAMES);
+  CHECK_EQ(ad7606b_dma_get_overruns(), 0);
+
+  for (uint32_t i = 0; i < NUM_OF_DMA_FRAMES; i++)
+  {
+    const struct dmaFrame* record = &dma_frames[i];
+    CHECK_EQ(record->num_of_words, AD7606B_NUM_OF_CHAN);
+    CHECK(!record->busy);
+    for (uint8_t c = 0; c < AD7606B_NUM_OF_CHAN; c++)
+    {
+      CHECK_EQ(record->words[c], expected_code(c, first_conversion + i));
+    }
+    // The edge comes a conversion time after CONVST, before the readout ends
+    CHECK(record->timestamp_us - start_us[i] >= AD7606B_CONV_TIME_NS / 1000U - 1U);
+    CHECK(record->timestamp_us - start_us[i] <= end_us[i] - start_us[i]);
+    if (i > 0U)
+    {
+      CHECK(record->buffer != dma_frames[i - 1U].buffer);
+    }
+  }
+  CHECK(dma_frames[0].buffer == dma_frames[2].buffer);
+
+  // The running backend hands out its latest frame without starting a conversion
+  int32_t dest_buf[AD7606B_NUM_OF_CHAN];
+  uint8_t elements = 0;
+  ad7606b_sample(dest_buf, &elements, AD7606B_NUM_OF_CHAN);
+  CHECK_EQ(ad7606b_sim_get_conversion_count(), first_conversion + NUM_OF_DMA_FRAMES);
+  CHECK_EQ(elements, AD7606B_NUM_OF_CHAN);
+  CHECK_EQ(dest_buf[AD7606B_NUM_OF_CHAN - 1U], expected_value(AD7606B_NUM_OF_CHAN - 1U, first_conversion + NUM_OF_DMA_FRAMES - 1U));
+
+  // Restarted with fewer words, only those are clocked out, the rest stay in the ADC
+  CHECK(ad7606b_dma_start(dma_frame_cb, 3));
+  num_of_dma_frames = 0;
+  uint32_t conversion = ad7606b_sim_get_conversion_count();
+  ad7606b_convert();
+  CHECK_EQ(num_of_dma_frames, 1);
+  CHECK_EQ(dma_frames[0].num_of_words, 3);
+  CHECK_EQ(dma_frames[0].words[2], expected_code(2, conversion));
+  uint16_t word;
+  spi_read16_blocking(ADC_SPI_CHANNEL, 0, &word, 1);
+  CHECK_EQ(word, expected_code(3, conversion));
+
+  // Stopped, the conversions aren't read out any more and ad7606b_sample() converts by itself again
+  ad7606b_dma_stop();
+  num_of_dma_frames = 0;
+  ad7606b_convert();
+  posix_wait_until_ns(ad7606b_sim_get_busy_end_ns());
+  CHECK_EQ(num_of_dma_frames, 0);
+  conversion = ad7606b_sim_get_conversion_count();
+  elements = 0;
+  ad7606b_sample(dest_buf, &elements, 2);
+  CHECK_EQ(dest_buf[1], expected_value(1, conversion));
+  ad7606b_set_backend(AD7606B_BACKEND_BLOCKING);
+}
+
+// A RESET pulse of 3 us or more clears the results and holds off the conversions for the device setup time,
+// a shorter one only clears the results
+static void test_reset(void)
+{
+  uint16_t frame[AD7606B_NUM_OF_CHAN];
+  ad7606b_read_frame(frame, AD7606B_NUM_OF_CHAN);
+  gpio_put(ADC_RESET_PIN, 1);
+  gpio_put(ADC_RESET_PIN, 0);
+  spi_read16_blocking(ADC_SPI_CHANNEL, 0, frame, 1);
+  CHECK_EQ(frame[0], 0);
+  uint32_t conversion = ad7606b_sim_get_conversion_count();
+  ad7606b_read_frame(frame, 2);
+  CHECK_EQ(frame[1], expected_code(1, conversion));
+
+  gpio_put(ADC_RESET_PIN, 1);
+  sleep_us(AD7606B_SIM_T_FULL_RESET_NS / 1000U + 1U);
+  uint64_t reset_end_ns = posix_time_ns();
+  gpio_put(ADC_RESET_PIN, 0);
+  uint64_t ready_ns = posix_time_ns() + AD7606B_SIM_T_DEVICE_SETUP_NS;
+  ad7606b_convert();
+  // Only held off within the setup time, the host may have descheduled the test past it
+  if (posix_time_ns() < reset_end_ns + AD7606B_SIM_T_DEVICE_SETUP_NS)
+  {
+    CHECK(!gpio_get(ADC_BUSY_PIN));
+    CHECK_EQ(ad7606b_sim_get_conversion_count(), conversion + 1U);
+  }
+  posix_wait_until_ns(ready_ns);
+  while (gpio_get(ADC_BUSY_PIN));
+  conversion = ad7606b_sim_get_conversion_count();
+  ad7606b_read_frame(frame, 1);
+  CHECK_EQ(ad7606b_sim_get_conversion_count(), conversion + 1U);
+  CHECK_EQ(frame[0], expected_code(0, conversion));
+}
+
+int main(void)
+{
+  // The waveforms and the oversampling ratio are set here, not taken from the environment
+  unsetenv("DAS_ADC_WAVEFORMS");
+  unsetenv("DAS_ADC_OVERSAMPLING");
+  ad7606b_init();
+  ad7606b_reset();
+  // The 1 us pulse can stretch into a full reset on a loaded host, which holds off the conversions for a while
+  posix_wait_until_ns(posix_time_ns() + AD7606B_SIM_T_DEVICE_SETUP_NS);
+  set_ramps();
+
+  test_parse_waveform();
+  test_busy_sequencing();
+  test_blocking_readout();
+  test_dma_readout();
+  test_reset();
+  return TEST_RESULT();
+}
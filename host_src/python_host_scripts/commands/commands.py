@@ -5,8 +5,10 @@ import asyncio
 import logging
 import serial_asyncio
 from typing import Optional
-from message_handler.message_handler import prepare_set_periodic_sampler_msg, prepare_stop_periodic_sampler_msg, prepare_execute_one_off_sampler_msg
+from message_handler.message_handler import prepare_set_periodic_sampler_msg, prepare_set_decimator_msg, prepare_set_capture_msg, prepare_execute_burst_capture_msg, prepare_set_aggregator_msg, prepare_set_spectrum_msg, prepare_set_event_detector_msg, prepare_get_stats_msg, prepare_get_device_time_msg, prepare_stop_periodic_sampler_msg, prepare_execute_one_off_sampler_msg, SAMPLING_CLOCKS, FRAME_FORMATS, DATA_INTERFACES, STREAM_ENCODINGS, MAX_FRAMES_PER_BLOCK, MAX_DECIMATION_RATIO, CAPTURE_TRIGGERS, EVENT_POLARITIES, MIN_SAMPLING_PERIOD, MIN_CAPTURE_SAMPLING_PERIOD, SPECTRUM_FFT_SIZES, MAX_SPECTRUM_PEAKS
 from communications.protocol import IngressProtocol
+from communications.vendor_reader import VendorBulkReader
+from communications.latency import LatencyMonitor
 
 # Access the logger from the parent script
 logger = logging.getLogger(__name__)
@@ -23,12 +25,20 @@ class Command(metaclass=abc.ABCMeta):
     # Class property shared amongst all subclasses
     # If a subclass modifies this class attribute, the change will be visible to other instances of the same subclass as well as instances of its parent class and other subclasses
     async_transport: Optional[asyncio.Transport] = None
+    # Transport of the data CDC port which carries the sample stream, messages go through async_transport
+    data_transport: Optional[asyncio.Transport] = None
     # Current interface used
     interface: str = "Unconnected" # Default is 'Unconnected'
     # Whether it is in streaming mode
     streaming: bool = False
     # Whether data logger has been configured
     configured: bool = False
+    # Reader of the vendor bulk endpoint, only set while streaming over the vendor interface
+    vendor_reader: Optional[VendorBulkReader] = None
+    # Whether the next periodic sampling captures a window around a trigger instead of streaming
+    capture_armed: bool = False
+    # Latency measurement started by 'measure_latency', shared by the protocols of every transport
+    latency_monitor: Optional[LatencyMonitor] = None
 
     @classmethod
     @abc.abstractmethod
@@ -47,6 +57,10 @@ class Command(metaclass=abc.ABCMeta):
     def set_async_transport(transport: Optional[asyncio.Transport]) -> None:
         Command.async_transport = transport 
 
+    @staticmethod
+    def set_data_transport(transport: Optional[asyncio.Transport]) -> None:
+        Command.data_transport = transport
+
     @staticmethod
     def set_interface(interface: str) -> None:
         Command.interface = interface
@@ -59,6 +73,20 @@ class Command(metaclass=abc.ABCMeta):
     def set_configured(configured: bool) -> None:
         Command.configured = configured
 
+    @staticmethod
+    def set_capture_armed(capture_armed: bool) -> None:
+        Command.capture_armed = capture_armed
+
+    @staticmethod
+    def set_latency_monitor(latency_monitor: Optional[LatencyMonitor]) -> None:
+        Command.latency_monitor = latency_monitor
+
+    @staticmethod
+    def stop_vendor_reader() -> None:
+        if Command.vendor_reader is not None:
+            Command.vendor_reader.stop()
+            Command.vendor_reader = None
+
 class UsbConnectCommand(Command):
     command_name = "usb_connect"
     command_info = "Connect to the data logger via USB."
@@ -78,6 +106,16 @@ class UsbConnectCommand(Command):
                  )
             cls.set_async_transport(serial_transport)
             logger.debug(f"Set async transport to '{cls.async_transport}'.")
+            if command_args.data_port is not None:
+                # The data CDC port never carries messages, so its protocol stays in streaming mode
+                data_transport, data_protocol = await serial_asyncio.create_serial_connection(
+                     loop = asyncio.get_event_loop(),
+                     protocol_factory = lambda: IngressProtocol(stream_only=True),
+                     url = command_args.data_port,
+                     baudrate = 115200
+                     )
+                cls.set_data_transport(data_transport)
+                logger.debug(f"Set data transport to '{cls.data_transport}'.")
             cls.set_interface("USB")
             logger.debug(f"Set interface to '{cls.interface}'.")
         else:
@@ -87,7 +125,8 @@ class UsbConnectCommand(Command):
     @classmethod
     def get_argument_parser(cls) -> argparse.ArgumentParser:
         parser = super().get_argument_parser()
-        parser.add_argument("port", type=str, help="USB port of the device. E.g. '/dev/cu.usbmodem1201'.")
+        parser.add_argument("port", type=str, help="USB port of the device which carries the messages, i.e. the 1st CDC port. E.g. '/dev/cu.usbmodem1201'.")
+        parser.add_argument("data_port", type=str, nargs="?", default=None, help="USB port of the device which carries the sample stream, i.e. the 2nd CDC port. E.g. '/dev/cu.usbmodem1203'. Only required when streaming over CDC.")
         # Update the usage part of the 'help' message according to the arguments specific to a command
         usage_parts = [cls.command_name]
         usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
@@ -104,7 +143,28 @@ class SetPeriodicSamplingCommand(Command):
         try:
             print(f"'{cls.command_name}' executed.")
             if cls.async_transport is not None:
-                msg = prepare_set_periodic_sampler_msg(sampling_period=command_args.sampling_period)
+                msg = prepare_set_periodic_sampler_msg(sampling_period=command_args.sampling_period, sampling_clock=command_args.sampling_clock, frames_per_block=command_args.frames_per_block, frame_format=command_args.frame_format, channel_mask=command_args.channel_mask, data_interface=command_args.data_interface, stream_encoding=command_args.stream_encoding, capture=cls.capture_armed, test_pattern=command_args.test_pattern)
+                # The test pattern always has eight values, in either frame format
+                layout_mask = 0xFF if command_args.test_pattern else command_args.channel_mask
+                if command_args.data_interface == "vendor":
+                    # The stream arrives on the vendor bulk endpoint, parse it with a protocol of its own
+                    # which stays in streaming mode, messages keep going through the CDC protocol
+                    stream_protocol = IngressProtocol(stream_only=True)
+                    stream_protocol.set_frame_layout(frame_format=command_args.frame_format, channel_mask=layout_mask)
+                    stream_protocol.set_test_pattern(command_args.test_pattern)
+                    stream_protocol.set_latency_monitor(cls.latency_monitor)
+                    cls.stop_vendor_reader()
+                    Command.vendor_reader = VendorBulkReader(asyncio.get_event_loop(), stream_protocol.data_received)
+                    Command.vendor_reader.start()
+                else:
+                    if cls.data_transport is None:
+                        print(f"Invalid operation : The stream is sent on the data CDC port, please reconnect with 'usb_connect [port] [data_port]' first.")
+                        logger.error("Command.data_transport has not been set, so the stream cannot be received over CDC.")
+                        return
+                    # Tell the ingress protocol of the data port how to split the stream into frames
+                    cls.data_transport.get_protocol().set_frame_layout(frame_format=command_args.frame_format, channel_mask=layout_mask)
+                    cls.data_transport.get_protocol().set_test_pattern(command_args.test_pattern)
+                    cls.data_transport.get_protocol().set_latency_monitor(cls.latency_monitor)
                 # Transport from async context is required for communicating with the underlying async low-level event loop to write to serial/TCP
                 logger.debug(f"Writing set periodic sampling msg with transport '{type(cls.async_transport)}'.")
                 cls.async_transport.write(msg)
@@ -119,7 +179,360 @@ class SetPeriodicSamplingCommand(Command):
     @classmethod
     def get_argument_parser(cls) -> argparse.ArgumentParser:
         parser = super().get_argument_parser()
-        parser.add_argument("sampling_period", type=int, help="Sampling period of the periodic sampler in micro-seconds. Min = 20.")
+        parser.add_argument("sampling_period", type=int, help=f"Sampling period of the periodic sampler in micro-seconds. Min = {MIN_SAMPLING_PERIOD}, or {MIN_CAPTURE_SAMPLING_PERIOD} when a capture has been set up with 'set_capture', with the 'pwm' or 'pio' sampling clock.")
+        parser.add_argument("--sampling_clock", type=str, choices=list(SAMPLING_CLOCKS), default="timer", help="Clock pacing the ADC conversions. 'timer' = software repeating timer, 'pwm' = PWM slice driving CONVST, 'pio' = PIO state machine.")
+        parser.add_argument("--frames_per_block", type=int, default=16, help=f"Number of frames the device batches into a block before sending it. Min = 1, max = {MAX_FRAMES_PER_BLOCK}.")
+        parser.add_argument("--frame_format", type=str, choices=list(FRAME_FORMATS), default="int32", help="Layout of the streamed frames. 'int32' = eight 4 bytes values per frame, 'packed16' = one 2 bytes ADC code per channel in the channel mask.")
+        parser.add_argument("--data_interface", type=str, choices=list(DATA_INTERFACES), default="cdc", help="USB interface carrying the sample stream. 'cdc' = data CDC port given to 'usb_connect', 'vendor' = bulk IN endpoint of the vendor interface, read with libusb.")
+        parser.add_argument("--stream_encoding", type=str, choices=list(STREAM_ENCODINGS), default="raw", help="Encoding of the sent blocks. 'raw' = the frames as they are, 'sample_batch' = a SampleBatchMessage per block, which also carries the timestamp, sampling period and frame layout, 'delta' = blocks compressed with per-channel delta and bit-packing.")
+        parser.add_argument("--channel_mask", type=lambda x: int(x, 0), default=0, help="ADC channels to read out, bit n = channel n. E.g. 0x03 for channels 0 and 1. 0 = channels used by the connected sensors.")
+        parser.add_argument("--test_pattern", action="store_true", help="Stream a sample counter and an LFSR sequence instead of the sensors, in 'packed16' frames as the first half of the 'int32' ones, and check that every sample arrives in order, intact and only once. The result is printed when the sampling is stopped.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class SetDecimationCommand(Command):
+    command_name = "set_decimation"
+    command_info = "Set the output period of the on-device decimation filter, used by the next periodic sampling."
+    command_is_async = False
+
+    @classmethod
+    def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.streaming:
+                print(f"Invalid operation : The decimation is set up when the periodic sampler starts, please stop it first.")
+                logger.error("Command.streaming is True, so set decimator msg cannot be issued.")
+                return
+            if cls.async_transport is not None:
+                msg = prepare_set_decimator_msg(output_period=command_args.output_period)
+                logger.debug(f"Writing set decimator msg with transport '{type(cls.async_transport)}'.")
+                cls.async_transport.write(msg)
+            else:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("output_period", type=int, help=f"Period of the frames sent to the host in micro-seconds, e.g. 1000 for 1 kHz. The ratio to the sampling period is rounded down to an even number, up to {MAX_DECIMATION_RATIO}. 0 = no decimation.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class SetAggregationCommand(Command):
+    command_name = "set_aggregation"
+    command_info = "Receive the min, max, mean and RMS of every channel over windows instead of the samples, used by the next periodic sampling."
+    command_is_async = False
+
+    @classmethod
+    def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.streaming:
+                print(f"Invalid operation : The aggregation is set up when the periodic sampler starts, please stop it first.")
+                logger.error("Command.streaming is True, so set aggregator msg cannot be issued.")
+                return
+            if cls.async_transport is not None:
+                msg = prepare_set_aggregator_msg(window=command_args.window)
+                logger.debug(f"Writing set aggregator msg with transport '{type(cls.async_transport)}'.")
+                cls.async_transport.write(msg)
+            else:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("window", type=int, help="Length of a window in micro-seconds, e.g. 1000000 for a record per second. It takes precedence over 'set_decimation'. 0 = no aggregation.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class SetSpectrumCommand(Command):
+    command_name = "set_spectrum"
+    command_info = "Receive the magnitude spectrum of every channel over windows instead of the samples, used by the next periodic sampling."
+    command_is_async = False
+
+    @classmethod
+    def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.streaming:
+                print(f"Invalid operation : The spectrum is set up when the periodic sampler starts, please stop it first.")
+                logger.error("Command.streaming is True, so set spectrum msg cannot be issued.")
+                return
+            if cls.async_transport is not None:
+                msg = prepare_set_spectrum_msg(fft_size=command_args.fft_size, num_of_peaks=command_args.peaks)
+                if msg is None:
+                    print(f"Invalid operation : The FFT size must be 0 or one of {SPECTRUM_FFT_SIZES}, and the peaks from 0 to {MAX_SPECTRUM_PEAKS}.")
+                    return
+                logger.debug(f"Writing set spectrum msg with transport '{type(cls.async_transport)}'.")
+                cls.async_transport.write(msg)
+            else:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("fft_size", type=int, help=f"Samples per window, one of {SPECTRUM_FFT_SIZES}, a record per channel and window with fft_size / 2 + 1 bins. It takes precedence over 'set_aggregation' and 'set_decimation'. 0 = no spectrum.")
+        parser.add_argument("--peaks", type=int, default=0, help=f"Only send the strongest peaks of each record, up to {MAX_SPECTRUM_PEAKS}. 0 = every bin.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class SetEventDetectionCommand(Command):
+    command_name = "set_event_detection"
+    command_info = "Receive a record per threshold event of the selected channels instead of the samples, used by the next periodic sampling. Other channels keep their setting."
+    command_is_async = False
+
+    @classmethod
+    def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.streaming:
+                print(f"Invalid operation : The event detection is set up when the periodic sampler starts, please stop it first.")
+                logger.error("Command.streaming is True, so set event detector msg cannot be issued.")
+                return
+            if cls.async_transport is not None:
+                msg = prepare_set_event_detector_msg(channel_mask=command_args.channel_mask, polarity=command_args.polarity, threshold=command_args.threshold, hysteresis=command_args.hysteresis)
+                if msg is None:
+                    return
+                logger.debug(f"Writing set event detector msg with transport '{type(cls.async_transport)}'.")
+                cls.async_transport.write(msg)
+            else:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("channel_mask", type=lambda value: int(value, 0), help="Values of the frame to set up, bit n = value n, e.g. 0x03 for the first two.")
+        parser.add_argument("polarity", type=str, choices=list(EVENT_POLARITIES), help="'above' / 'below' = an event lasts while the value is above / below the threshold, 'absolute' = while its magnitude is above the threshold, e.g. for overloads, 'none' = no events on these channels.")
+        parser.add_argument("--threshold", type=int, default=0, help="Level an event starts past, the 'packed16' codes are compared as signed 16-bit values.")
+        parser.add_argument("--hysteresis", type=int, default=0, help="How far back past the threshold the value has to go for the event to end.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class SetCaptureCommand(Command):
+    command_name = "set_capture"
+    command_info = "Capture a window around a trigger into device memory instead of streaming, used by the next periodic sampling. The window is sent once it is complete."
+    command_is_async = False
+
+    @classmethod
+    def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.streaming:
+                print(f"Invalid operation : The capture is set up when the periodic sampler starts, please stop it first.")
+                logger.error("Command.streaming is True, so set capture msg cannot be issued.")
+                return
+            if cls.async_transport is not None:
+                msg = prepare_set_capture_msg(trigger=command_args.trigger, trigger_channel=command_args.trigger_channel, threshold=command_args.threshold, pre_trigger_frames=command_args.pre_trigger_frames, post_trigger_frames=command_args.post_trigger_frames)
+                if msg is None:
+                    return
+                logger.debug(f"Writing set capture msg with transport '{type(cls.async_transport)}'.")
+                cls.async_transport.write(msg)
+                cls.set_capture_armed(command_args.trigger != "none")
+            else:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("trigger", type=str, choices=list(CAPTURE_TRIGGERS), help="Trigger condition. 'rising' / 'falling' = the value crosses the threshold upwards / downwards, 'slope' = the value changes by at least the threshold from one frame to the next, 'none' = stream continuously again.")
+        parser.add_argument("--trigger_channel", type=int, default=0, help="Index of the trigger value in a frame, e.g. 1 for the second channel of the channel mask with the 'packed16' frame format.")
+        parser.add_argument("--threshold", type=int, default=0, help="Threshold of the trigger, the 'packed16' codes are compared as signed 16-bit values.")
+        parser.add_argument("--pre_trigger_frames", type=int, default=1000, help="Frames kept in front of the trigger frame.")
+        parser.add_argument("--post_trigger_frames", type=int, default=1000, help="Frames from the trigger frame on. The device clamps the window to its capture buffer of 96 KB.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class BurstCaptureCommand(Command):
+    command_name = "burst_capture"
+    command_info = "Capture frames back to back at the conversion rate of the ADC into device memory, then receive them."
+    command_is_async = False
+
+    @classmethod
+    def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.streaming:
+                print(f"Invalid operation : The device can't capture while the periodic sampler runs, please stop it first.")
+                logger.error("Command.streaming is True, so execute burst capture msg cannot be issued.")
+                return
+            if cls.async_transport is None:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+                return
+            if cls.data_transport is None:
+                print(f"Invalid operation : The frames are sent on the data CDC port, please reconnect with 'usb_connect [port] [data_port]' first.")
+                logger.error("Command.data_transport has not been set, so the frames cannot be received.")
+                return
+            msg = prepare_execute_burst_capture_msg(num_of_frames=command_args.num_of_frames, channel_mask=command_args.channel_mask)
+            if msg is None:
+                return
+            # The frames are always in the packed 16-bit format
+            cls.data_transport.get_protocol().set_frame_layout(frame_format="packed16", channel_mask=command_args.channel_mask)
+            cls.data_transport.get_protocol().set_test_pattern(False)
+            logger.debug(f"Writing execute burst capture msg with transport '{type(cls.async_transport)}'.")
+            cls.async_transport.write(msg)
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("num_of_frames", type=int, help="Number of frames to capture, the device clamps it to its capture buffer of 96 KB.")
+        parser.add_argument("--channel_mask", type=lambda x: int(x, 0), default=0x03, help="ADC channels to capture, bit n = channel n. E.g. 0x03 for channels 0 and 1.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class StatsCommand(Command):
+    command_name = "stats"
+    command_info = "Query the runtime counters of the data logger, the CPU loads are over the time since the previous query. Allowed while streaming."
+    command_is_async = False
+
+    @classmethod
+    def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            # The stats come back on the control port, so they don't disturb the stream on the data port
+            if cls.async_transport is not None:
+                msg = prepare_get_stats_msg(include_tasks=command_args.tasks)
+                logger.debug(f"Writing get stats msg with transport '{type(cls.async_transport)}'.")
+                cls.async_transport.write(msg)
+            else:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("--tasks", action="store_true", help="Also list the run time, load and stack high water mark of every FreeRTOS task.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+# Send a burst of GetDeviceTime requests on the control port, the replies are matched to them by the protocol
+# of the control port, which has to share the clock of the latency monitor
+async def sync_device_clock(transport: asyncio.Transport, latency_monitor: LatencyMonitor, num_of_requests: int, interval_ms: float, reply_timeout_ms: float = 200) -> bool:
+    for _ in range(num_of_requests):
+        msg = prepare_get_device_time_msg(request_id=latency_monitor.clock.request())
+        transport.write(msg)
+        # Spaced out so that a reply doesn't queue up behind the previous one and stretch its round trip
+        await asyncio.sleep(interval_ms / 1e3)
+    # Wait for the last replies before closing the burst
+    waited_ms = 0
+    while latency_monitor.clock.pending and waited_ms < reply_timeout_ms:
+        await asyncio.sleep(0.01)
+        waited_ms += 10
+    return latency_monitor.clock.end_burst()
+
+class MeasureLatencyCommand(Command):
+    command_name = "measure_latency"
+    command_info = "Synchronise with the device clock and measure the latency of the sample frames received from now on, run 'set_periodic_sampling' next and 'latency_report' once done. Allowed while streaming."
+    command_is_async = True
+
+    @classmethod
+    async def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.async_transport is None:
+                print(f"Invalid operation : Please connect to a connectivity interface first.")
+                logger.error("Command.async_transport has not been set to any type of Transport.")
+                return
+            latency_monitor = LatencyMonitor()
+            cls.set_latency_monitor(latency_monitor)
+            # The device time comes back on the control port, the stream on the data port, or with the messages
+            cls.async_transport.get_protocol().set_latency_monitor(latency_monitor)
+            if cls.data_transport is not None:
+                cls.data_transport.get_protocol().set_latency_monitor(latency_monitor)
+            if await sync_device_clock(cls.async_transport, latency_monitor, command_args.requests, command_args.interval_ms):
+                print(latency_monitor.clock.summary())
+            else:
+                print(f"No reply from the device to the device time requests, is its firmware up to date ?")
+                logger.error("No device time reply received, the latency cannot be measured.")
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("--requests", type=int, default=32, help="Device time requests in the burst, the one with the shortest round trip sets the clock offset. Default : 32.")
+        parser.add_argument("--interval_ms", type=float, default=5, help="Time between the requests of the burst in milli-seconds. Default : 5.")
+        # Update the usage part of the 'help' message according to the arguments specific to a command
+        usage_parts = [cls.command_name]
+        usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
+        parser.usage = ' '.join(usage_parts)
+        return parser
+
+class LatencyReportCommand(Command):
+    command_name = "latency_report"
+    command_info = "Synchronise with the device clock again, for its drift, then print the latency histogram and the jitter of the sample frames received since 'measure_latency'."
+    command_is_async = True
+
+    @classmethod
+    async def execute(cls, command_args: argparse.Namespace, state: dict) -> None:
+        try:
+            print(f"'{cls.command_name}' executed.")
+            if cls.latency_monitor is None or cls.async_transport is None:
+                print(f"Invalid operation : Please start the measurement with 'measure_latency' first.")
+                logger.error("Command.latency_monitor has not been set.")
+                return
+            if not await sync_device_clock(cls.async_transport, cls.latency_monitor, command_args.requests, command_args.interval_ms):
+                logger.warning("No device time reply received, the report relies on the earlier bursts only.")
+            print(cls.latency_monitor.report(bin_us=command_args.bin_us))
+            print("")
+            if command_args.csv is not None and len(cls.latency_monitor) > 0:
+                cls.latency_monitor.write_csv(command_args.csv)
+                logger.info(f"Latency of every block written to '{command_args.csv}'.")
+            if command_args.reset:
+                cls.latency_monitor.reset()
+        except Exception as e:
+            logger.exception(f"Exception in execute() : {e}")
+
+    @classmethod
+    def get_argument_parser(cls) -> argparse.ArgumentParser:
+        parser = super().get_argument_parser()
+        parser.add_argument("--requests", type=int, default=32, help="Device time requests in the burst. Default : 32.")
+        parser.add_argument("--interval_ms", type=float, default=5, help="Time between the requests of the burst in milli-seconds. Default : 5.")
+        parser.add_argument("--bin_us", type=int, default=None, help="Width of the bins of the latency histogram in micro-seconds. Default : about 20 bins over the latencies.")
+        parser.add_argument("--csv", type=str, default=None, help="Write the arrival time, device timestamp, number of frames and latency of every block to this CSV file.")
+        parser.add_argument("--reset", action="store_true", help="Forget the recorded blocks after the report, the clock synchronisation is kept.")
         # Update the usage part of the 'help' message according to the arguments specific to a command
         usage_parts = [cls.command_name]
         usage_parts.extend([f"[{arg.dest}]" for arg in parser._actions[1:]])
@@ -140,6 +553,7 @@ class StopPeriodicSamplingCommand(Command):
                 # Transport from async context is required for communicating with the underlying async low-level event loop to write to serial/TCP
                 logger.debug(f"Writing stop periodic sampling msg with transport '{type(cls.async_transport)}'.")
                 cls.async_transport.write(msg)
+                cls.stop_vendor_reader()
                 cls.set_streaming(False)
                 logger.debug(f"Set streaming to '{cls.streaming}'.")
             else:
@@ -205,6 +619,11 @@ class DisconnectCommand(Command):
         try:
             print(f"'{cls.command_name}' executed.")
             if cls.async_transport is not None:
+                cls.stop_vendor_reader()
+                if cls.data_transport is not None:
+                    logger.debug(f"Closing data transport '{type(cls.data_transport)}'.")
+                    cls.data_transport.close()
+                    cls.set_data_transport(None)
                 logger.debug(f"Closing transport '{type(cls.async_transport)}'.")
                 cls.async_transport.close()
                 if cls.async_transport.is_closing():
@@ -214,6 +633,8 @@ class DisconnectCommand(Command):
                     assert(cls.async_transport == None)
                     cls.set_interface("Unconnected")
                     cls.set_streaming(False)
+                    # The device may not be the same one on the next connection
+                    cls.set_latency_monitor(None)
                     logger.debug(f"Set interface to '{cls.interface}'.")
                     logger.debug(f"Set streaming to '{cls.streaming}'.")
                 else:
@@ -231,6 +652,15 @@ class CommandFactory:
         "usb_connect" : UsbConnectCommand,
         "execute_one_off_sampling" : ExecuteOneOffSamplingCommand,
         "set_periodic_sampling" : SetPeriodicSamplingCommand,
+        "set_decimation" : SetDecimationCommand,
+        "set_aggregation" : SetAggregationCommand,
+        "set_spectrum" : SetSpectrumCommand,
+        "set_event_detection" : SetEventDetectionCommand,
+        "set_capture" : SetCaptureCommand,
+        "burst_capture" : BurstCaptureCommand,
+        "stats" : StatsCommand,
+        "measure_latency" : MeasureLatencyCommand,
+        "latency_report" : LatencyReportCommand,
         "stop_periodic_sampling" : StopPeriodicSamplingCommand,
         "disconnect" : DisconnectCommand,
         # Add more commands as needed
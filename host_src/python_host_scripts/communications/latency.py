@@ -0,0 +1,187 @@
+import csv
+import logging
+import time
+from typing import Optional
+import numpy as np
+
+logger = logging.getLogger(__name__)
+
+# Host time in micro-seconds, monotonic so that it can be compared with the device time
+def host_time_us() -> int:
+    return time.monotonic_ns() // 1000
+
+# Shortest span of host time over which the drift of the device clock is fitted, below it the offset is constant
+MIN_DRIFT_SPAN_US = 1000000
+
+# Estimate the offset of the device clock, i.e. time_us_64() of the device minus host_time_us(), from
+# GetDeviceTime requests and their replies
+# A reply is stamped by the device just before it is sent, so the device time belongs to the middle of the round
+# trip give or take half of it, only the shortest round trip of each burst of requests is kept for that reason
+# With bursts more than MIN_DRIFT_SPAN_US apart, a line through them also follows the drift of the device crystal
+class ClockOffsetEstimator:
+    def __init__(self):
+        self.reset()
+
+    def reset(self) -> None:
+        # Host time each pending request was sent at, by request id
+        self.pending = {}
+        self.next_request_id = 0
+        self.replies = 0
+        # (host time of the middle of the round trip, offset, round trip) of the shortest round trip of each burst
+        self.bursts = []
+        self.burst_best = None
+
+    # Take a request id and the time its request is sent at, call it just before writing the request
+    def request(self) -> int:
+        request_id = self.next_request_id
+        self.next_request_id = (self.next_request_id + 1) & 0xFFFFFFFF
+        self.pending[request_id] = host_time_us()
+        return request_id
+
+    # Reply to a request, arrival_us is the host time its bytes were received at
+    def reply(self, request_id: int, device_time_us: int, arrival_us: int) -> None:
+        sent_us = self.pending.pop(request_id, None)
+        if sent_us is None:
+            logger.warning(f"Device time reply to unknown request {request_id}.")
+            return
+        self.replies += 1
+        round_trip_us = arrival_us - sent_us
+        host_mid_us = sent_us + round_trip_us / 2
+        if self.burst_best is None or round_trip_us < self.burst_best[2]:
+            self.burst_best = (host_mid_us, device_time_us - host_mid_us, round_trip_us)
+
+    # Close the current burst of requests, requests still unanswered are given up on
+    def end_burst(self) -> bool:
+        self.pending.clear()
+        if self.burst_best is None:
+            return False
+        self.bursts.append(self.burst_best)
+        self.burst_best = None
+        return True
+
+    def synchronised(self) -> bool:
+        return len(self.bursts) > 0
+
+    # Drift of the device clock in ppm, 0 until bursts span MIN_DRIFT_SPAN_US
+    def drift_ppm(self) -> float:
+        return self._fit()[1] * 1e6
+
+    # Half the shortest round trip, a bound on the error of the offset where it was measured
+    def uncertainty_us(self) -> float:
+        return min(burst[2] for burst in self.bursts) / 2 if self.bursts else float("nan")
+
+    # Offset of the device clock at the given host time(s)
+    def offset_us(self, host_us):
+        offset, slope, host_ref_us = self._fit()
+        return offset + slope * (np.asarray(host_us, dtype=np.float64) - host_ref_us)
+
+    # Device time at the given host time(s)
+    def device_time_us(self, host_us):
+        return np.asarray(host_us, dtype=np.float64) + self.offset_us(host_us)
+
+    # (offset at host_ref_us, slope, host_ref_us) of the line through the bursts
+    def _fit(self):
+        if not self.bursts:
+            raise ValueError("The device clock hasn't been synchronised, no device time reply received.")
+        host_mid_us = np.array([burst[0] for burst in self.bursts], dtype=np.float64)
+        offset_us = np.array([burst[1] for burst in self.bursts], dtype=np.float64)
+        host_ref_us = host_mid_us[0]
+        if host_mid_us[-1] - host_mid_us[0] < MIN_DRIFT_SPAN_US:
+            # Too close to tell drift from noise, the best round trip of all gives the offset
+            best = min(range(len(self.bursts)), key=lambda i: self.bursts[i][2])
+            return offset_us[best], 0.0, host_ref_us
+        slope, offset = np.polyfit(host_mid_us - host_ref_us, offset_us, 1)
+        return offset, slope, host_ref_us
+
+    def summary(self) -> str:
+        if not self.bursts:
+            return f"Device clock : not synchronised, {self.replies} replies."
+        return f"Device clock : offset = {float(self.offset_us(host_time_us())):.0f} us +/- {self.uncertainty_us():.0f} us, drift = {self.drift_ppm():.2f} ppm, {len(self.bursts)} bursts, {self.replies} replies."
+
+# End-to-end latency of the sample stream, from the device sampling a frame to the host receiving it, and its jitter
+# Every block of frames is recorded with the host time it arrived at and the device timestamp of its first frame,
+# which is the low 32 bits of time_us_64(), the latencies are worked out once the report is asked for, so that
+# the clock offset can be measured again after the stream and the drift taken into account
+class LatencyMonitor:
+    def __init__(self, clock: Optional[ClockOffsetEstimator] = None):
+        self.clock = clock if clock is not None else ClockOffsetEstimator()
+        self.reset()
+
+    # Forget the recorded blocks, the clock keeps its bursts
+    def reset(self) -> None:
+        self.arrival_us = []
+        self.timestamp_us = []
+        self.num_of_frames = []
+
+    def record(self, arrival_us: int, timestamp_us: int, num_of_frames: int) -> None:
+        self.arrival_us.append(arrival_us)
+        self.timestamp_us.append(timestamp_us)
+        self.num_of_frames.append(num_of_frames)
+
+    def __len__(self) -> int:
+        return len(self.arrival_us)
+
+    # Device time between two frames, the median over consecutive blocks, None with less than two blocks
+    def frame_period_us(self) -> Optional[float]:
+        if len(self) < 2:
+            return None
+        timestamp_us = np.array(self.timestamp_us, dtype=np.uint32)
+        spans_us = (timestamp_us[1:] - timestamp_us[:-1]).astype(np.float64)
+        periods_us = spans_us / np.maximum(np.array(self.num_of_frames[:-1], dtype=np.float64), 1)
+        return float(np.median(periods_us))
+
+    # Latency of the first, i.e. oldest, frame of every block in micro-seconds, negative values mean the offset is off
+    def latencies_us(self) -> np.ndarray:
+        arrival_us = np.array(self.arrival_us, dtype=np.int64)
+        # Only the low 32 bits of the device time are sent, the rest comes from the clock offset
+        device_now_us = np.round(self.clock.device_time_us(arrival_us)).astype(np.int64)
+        latencies_us = (device_now_us - np.array(self.timestamp_us, dtype=np.int64)) & 0xFFFFFFFF
+        return np.where(latencies_us >= 1 << 31, latencies_us - (1 << 32), latencies_us)
+
+    # Interarrival jitter of RFC 3550, the smoothed deviation of the host spacing of the blocks from their device
+    # spacing, it doesn't depend on the clock offset
+    def interarrival_jitter_us(self) -> float:
+        jitter_us = 0.0
+        for i in range(1, len(self)):
+            device_span_us = (self.timestamp_us[i] - self.timestamp_us[i - 1]) & 0xFFFFFFFF
+            deviation_us = (self.arrival_us[i] - self.arrival_us[i - 1]) - device_span_us
+            jitter_us += (abs(deviation_us) - jitter_us) / 16
+        return jitter_us
+
+    def write_csv(self, path: str) -> None:
+        latencies_us = self.latencies_us()
+        with open(path, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(["host_arrival_us", "device_timestamp_us", "num_of_frames", "latency_us"])
+            for row in zip(self.arrival_us, self.timestamp_us, self.num_of_frames, latencies_us.tolist()):
+                writer.writerow(row)
+
+    def report(self, bin_us: Optional[int] = None) -> str:
+        lines = [self.clock.summary()]
+        if len(self) == 0:
+            lines.append("No sample blocks recorded.")
+            return "\n".join(lines)
+        latencies_us = self.latencies_us()
+        period_us = self.frame_period_us()
+        lines.append(f"{len(self)} blocks of {sum(self.num_of_frames)} frames, frame period = {f'{period_us:.1f} us' if period_us is not None else 'unknown'}.")
+        percentiles = np.percentile(latencies_us, [50, 90, 99, 99.9])
+        lines.append(f"{'Latency, oldest frame' : <28}min = {latencies_us.min()} us, mean = {latencies_us.mean():.1f} us, p50 = {percentiles[0]:.0f} us, p90 = {percentiles[1]:.0f} us, p99 = {percentiles[2]:.0f} us, p99.9 = {percentiles[3]:.0f} us, max = {latencies_us.max()} us")
+        if period_us is not None:
+            # The newest frame of a block waited the least for the block to fill up
+            newest_us = latencies_us - (np.array(self.num_of_frames) - 1) * period_us
+            lines.append(f"{'Latency, newest frame' : <28}min = {newest_us.min():.0f} us, mean = {newest_us.mean():.1f} us, p99 = {np.percentile(newest_us, 99):.0f} us, max = {newest_us.max():.0f} us")
+        lines.append(f"{'Jitter' : <28}std dev = {latencies_us.std():.1f} us, p99 - p50 = {percentiles[2] - percentiles[0]:.0f} us, interarrival = {self.interarrival_jitter_us():.1f} us")
+        if (latencies_us < 0).any():
+            lines.append(f"{'' : <28}{(latencies_us < 0).sum()} negative latencies, synchronise the clock again, e.g. after the stream")
+        # Histogram of the latency of the oldest frame, about 20 bins unless the width is given
+        if bin_us is None:
+            span_us = max(int(latencies_us.max() - latencies_us.min()), 1)
+            bin_us = next(width for width in (w * 10 ** e for e in range(10) for w in (1, 2, 5)) if width * 20 >= span_us)
+        first_bin_us = int(latencies_us.min() // bin_us) * bin_us
+        counts = np.bincount(((latencies_us - first_bin_us) // bin_us).astype(np.int64))
+        lines.append(f"{'Latency histogram' : <28}{bin_us} us bins")
+        for i, count in enumerate(counts.tolist()):
+            if count > 0:
+                bar = "#" * max(1, round(40 * count / counts.max()))
+                lines.append(f"{'' : <28}{first_bin_us + i * bin_us : >8} us {count : >10} {bar}")
+        return "\n".join(lines)
@@ -3,16 +3,137 @@ import serial_asyncio
 import logging
 import main_pb2
 import datetime
+import numpy as np
+from typing import Optional
+from message_handler.message_handler import decode_varint
+from communications.stream_frame import StreamFrameParser, STREAM_FRAME_TYPE_DATA, STREAM_FRAME_TYPE_MESSAGE, STREAM_FRAME_TYPE_EOS, STREAM_FRAME_TYPE_DELTA, STREAM_FRAME_TYPE_AGGREGATE, STREAM_FRAME_TYPE_SPECTRUM, STREAM_FRAME_TYPE_EVENT
+from communications.sample_codec import decode_sample_codec_block
+from communications.test_pattern import TestPatternVerifier
+from communications.latency import LatencyMonitor, host_time_us
 
 logger = logging.getLogger(__name__)
 
+# Decode packed frames into an array with a row per frame and a column per channel in one go, little-endian
+# as sent by the device
+# 'packed16' frames hold the raw 16-bit ADC code of each channel in the mask, 'int32' frames eight 4 bytes values
+def decode_sample_frames(data, frame_format: str, num_of_channels: int) -> np.ndarray:
+    dtype = np.dtype("<u2") if frame_format == "packed16" else np.dtype("<i4")
+    if num_of_channels == 0:
+        return np.empty((0, 0), dtype=dtype)
+    frame_size = dtype.itemsize * num_of_channels
+    num_of_frames = len(data) // frame_size
+    return np.frombuffer(data, dtype=dtype, count=num_of_frames * num_of_channels).reshape(num_of_frames, num_of_channels)
+
+# Statistics of a channel over a window, see device_src/lib/aggregator/aggregator.h, mean and RMS have
+# AGGREGATE_FRACTION_BITS fractional bits
+AGGREGATE_RECORD_DTYPE = np.dtype([("min", "<i4"), ("max", "<i4"), ("mean", "<i4"), ("rms", "<u4")])
+AGGREGATE_FRACTION_BITS = 8
+
+# Decode the records of an aggregate stream frame into an array with a row per window and a column per channel
+def decode_aggregate_records(data, num_of_channels: int) -> np.ndarray:
+    if num_of_channels == 0:
+        return np.empty((0, 0), dtype=AGGREGATE_RECORD_DTYPE)
+    record_size = AGGREGATE_RECORD_DTYPE.itemsize * num_of_channels
+    num_of_records = len(data) // record_size
+    return np.frombuffer(data, dtype=AGGREGATE_RECORD_DTYPE, count=num_of_records * num_of_channels).reshape(num_of_records, num_of_channels)
+
+# Header of a spectrum record, see device_src/lib/spectrum/spectrum.h, fft_size, channel, num_of_peaks and the
+# number of values of the window clamped to 16 bits
+SPECTRUM_RECORD_HEADER_DTYPE = np.dtype([("fft_size", "<u2"), ("channel", "u1"), ("num_of_peaks", "u1"), ("clipped", "<u2")])
+SPECTRUM_PEAK_DTYPE = np.dtype([("bin", "<u2"), ("magnitude", "<u2")])
+
+# Decode the records of a spectrum stream frame into a list of (channel, fft_size, bins, clipped), bins holds
+# either the magnitude of every bin from DC up to half the rate, or the peaks as (bin, magnitude) pairs
+def decode_spectrum_records(data) -> list:
+    records = []
+    offset = 0
+    while offset + SPECTRUM_RECORD_HEADER_DTYPE.itemsize <= len(data):
+        header = np.frombuffer(data, dtype=SPECTRUM_RECORD_HEADER_DTYPE, count=1, offset=offset)[0]
+        offset += SPECTRUM_RECORD_HEADER_DTYPE.itemsize
+        fft_size = int(header["fft_size"])
+        if header["num_of_peaks"] == 0:
+            bins = np.frombuffer(data, dtype="<u2", count=fft_size // 2 + 1, offset=offset)
+        else:
+            bins = np.frombuffer(data, dtype=SPECTRUM_PEAK_DTYPE, count=int(header["num_of_peaks"]), offset=offset)
+        offset += bins.nbytes
+        records.append((int(header["channel"]), fft_size, bins, int(header["clipped"])))
+    if offset != len(data):
+        raise ValueError(f"{len(data) - offset} trailing bytes after the spectrum records")
+    return records
+
+# An event of a channel, see device_src/lib/event_detector/event_detector.h
+EVENT_RECORD_DTYPE = np.dtype([("start_timestamp_us", "<u4"), ("duration_us", "<u4"), ("peak_value", "<i4"), ("peak_offset_us", "<u4"),
+                               ("channel", "u1"), ("polarity", "u1"), ("reserved", "<u2")])
+
+EVENT_POLARITY_NAMES = {
+    main_pb2.EVENT_POLARITY_ABOVE: "above",
+    main_pb2.EVENT_POLARITY_BELOW: "below",
+    main_pb2.EVENT_POLARITY_ABSOLUTE: "absolute",
+}
+
+# Decode the records of an event stream frame into an array with a row per event
+def decode_event_records(data) -> np.ndarray:
+    return np.frombuffer(data, dtype=EVENT_RECORD_DTYPE, count=len(data) // EVENT_RECORD_DTYPE.itemsize)
+
+# Channels carried by a frame of the given layout, see set_frame_layout()
+def frame_layout_channels(frame_format: str, channel_mask: int) -> list:
+    if frame_format == "packed16":
+        return [i for i in range(8) if channel_mask & (1 << i)]
+    return list(range(8))
+
+FRAME_FORMAT_NAMES = {
+    main_pb2.FRAME_FORMAT_INT32: "int32",
+    main_pb2.FRAME_FORMAT_PACKED_INT16: "packed16",
+}
+
 # Asyncio Ingress Protocol
 class IngressProtocol(asyncio.BufferedProtocol):
-    def __init__(self):
+    def __init__(self, stream_only: bool = False):
         self.transport = None
         self.buffer = bytearray()
+        # Whether the transport only ever carries the sample stream, e.g. the data CDC port, rather than messages
+        self.stream_only = stream_only
         # Indicate whether we are in message/streaming mode of operation
-        self.streaming = False
+        self.streaming = stream_only
+        # Layout of the streamed data frames, see set_frame_layout()
+        self.frame_format = "int32"
+        self.frame_channels = list(range(8))
+        self.frame_size = 32
+        # The stream is made of stream frames, each carrying a block of data frames
+        self.stream_parser = StreamFrameParser(self._stream_frame_received)
+        # Sequence number expected in the next data stream frame, i.e. the index of the next data frame
+        self.expected_sequence = None
+        self.lost_frames = 0
+        # Size of the sent blocks and of the frames they decode to, for the compression ratio of a compressed stream
+        self.encoded_bytes = 0
+        self.decoded_bytes = 0
+        self.compressed_blocks = 0
+        # CaptureInfoMessage of the last captured window
+        self.capture_info = None
+        # Checks the frames instead of printing them while the device streams the test pattern, see set_test_pattern()
+        self.test_pattern_verifier = None
+        # Records the arrival of every block of frames and answers the device time replies, see set_latency_monitor()
+        self.latency_monitor = None
+        # Host time the bytes being processed were received at
+        self.arrival_us = None
+
+    # Set the layout of the streamed data frames, it has to match the set_periodic_sampler_msg sent to the device
+    def set_frame_layout(self, frame_format: str, channel_mask: int):
+        self.frame_format = frame_format
+        # 'packed16' = one 2 bytes ADC code per channel in the mask, in channel order
+        # 'int32' = eight 4 bytes values, the active channels first
+        self.frame_channels = frame_layout_channels(frame_format, channel_mask)
+        self.frame_size = (2 if frame_format == "packed16" else 4) * len(self.frame_channels)
+        logger.debug(f"Frame layout : format = '{self.frame_format}', channels = {self.frame_channels}, size = {self.frame_size} bytes.")
+
+    # Verify the frames of the next streams as the test pattern, it has to match the set_periodic_sampler_msg sent to the device
+    def set_test_pattern(self, enabled: bool):
+        self.test_pattern_verifier = TestPatternVerifier() if enabled else None
+
+    # Measure the latency of the blocks of frames received from now on, the monitor can be shared with the
+    # protocol of another transport, e.g. the data port streams while the control port syncs the clock
+    def set_latency_monitor(self, latency_monitor: Optional[LatencyMonitor]):
+        self.latency_monitor = latency_monitor
 
     # Callback executed when connection is made
     def connection_made(self, transport):
@@ -26,6 +147,7 @@ class IngressProtocol(asyncio.BufferedProtocol):
     # Callback executed when data is received through the transport
     def data_received(self, data):
         logger.debug("Data_received.")
+        self.arrival_us = host_time_us()
         # print(data)
         self.buffer.extend(data)
         self._process_buffer()
@@ -36,62 +158,204 @@ class IngressProtocol(asyncio.BufferedProtocol):
         while len(self.buffer) >= 1:
             # Check if we are in message mode
             if not self.streaming:
-                # Read the first byte to check msg length
-                msg_length = self.buffer[0]
+                # Read the varint in front of the msg to check msg length
+                try:
+                    msg_length, length_size = decode_varint(self.buffer)
+                except ValueError:
+                    logger.error("Invalid message length, discarding the received bytes.")
+                    self.buffer = bytearray()
+                    break
                 logger.debug(f"_process_buffer(): msg_length = {msg_length}")
-                if (msg_length > 0):
-                    msg = self.buffer[1:1+msg_length]
-                    # Resize buffer to discard parsed data
-                    self.buffer = self.buffer[1+msg_length:]
-                    # Decode msg
-                    self._decode_msg(msg_length = msg_length, msg_content = bytes(msg))
-                    # self._msg_received(msg)
-                else:
+                # Wait for the rest of the msg
+                if msg_length is None or len(self.buffer) < length_size + msg_length:
                     break
+                msg = self.buffer[length_size:length_size+msg_length]
+                # Resize buffer to discard parsed data
+                self.buffer = self.buffer[length_size+msg_length:]
+                # Decode msg
+                self._decode_msg(msg_length = msg_length, msg_content = bytes(msg))
             # Else we are in streaming mode
             else:
-                # Print the streamed data
-                # logger.debug(f"Streamed data = {bytes(self.buffer).decode('utf-8')}")
-                # Check if it is and End Of Stream sequence, which is 128 bytes of 255
-                processed_bytes = len(self.buffer)
-                if (processed_bytes == 10):
-                    if all(byte == 255 for byte in self.buffer):
-                        logger.debug(f"End of Stream sequence detected. Going back to message mode.")
-                        # Implement a small wait to wait for any outstanding message to write into self buffer
-                        # time.sleep(0.2)
-                        # Then clear the rubbish streamed data in the self.buffer 
-                        self.buffer = bytearray()
-                        self.streaming = False
-                    else:
-                        logger.error(f"Length of self.buffer is 10 bytes, but it is not an End of Stream sequence.")
-                else:
-                    logger.debug(f"Streamed data = {bytes(self.buffer)}")
-                    # Every data frame is configured to be 32 bytes
-                    # Only parse them if complete frames have been transferred
-                    # First check that the buffer length is a multiple of 32
-                    if len(self.buffer) % 32 == 0:
-                        logger.debug(f"Complete data frame received.")
-                        for i in range(0, len(self.buffer), 32):
-                            data_frame = self.buffer[i:i+32]
-                            logger.debug(f"data_frame = {data_frame}")
-                            # Show current time with millisecond precision
-                            print(f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S.%f')[:-3] : <20}{' - ' : ^3}{'Stream data' : ^20}")
-                            print("-"*50)
-                            # A data frame contains eight 4 bytes values, each channel is represented by 4 bytes
-                            channel_index = 0 # Start the channel index at 0
-                            for j in range(0, 32, 4):
-                                channel_val = int.from_bytes(data_frame[j:j+4], "little")
-                                print(f"{'Channel ' : <10}{channel_index : ^5}{channel_val : ^10}")
-                                channel_index += 1
-                            print("")
-                    else:
-                        logger.debug("Non complete data frame received.")
-
-                # Discard the processed_content in buffer
-                self.buffer = self.buffer[processed_bytes:]
+                # The stream frames are self-delimiting, so the parser takes the bytes as they come
+                stream_bytes = self.buffer
+                self.buffer = bytearray()
+                self.stream_parser.feed(stream_bytes)
+                # Anything left after an EOS stream frame goes back to the message decoder
+                if not self.streaming:
+                    self.buffer = self.stream_parser.buffer
+                    self.stream_parser.reset()
+                    continue
+                break
 
             logger.debug(f"After _process_buffer(): len(self.buffer) = {len(self.buffer)}")
 
+    def _stream_frame_received(self, frame_type: int, sequence: int, timestamp_us: int, payload: memoryview):
+        if frame_type == STREAM_FRAME_TYPE_DATA:
+            # The payload is only valid during the callback, so the frames are copied out of it
+            frames = decode_sample_frames(bytes(payload), self.frame_format, len(self.frame_channels))
+            self.encoded_bytes += len(payload)
+            self.decoded_bytes += frames.nbytes
+            self._check_frame_index(sequence, len(frames))
+            self._samples_received(frames, self.frame_channels, timestamp_us)
+        elif frame_type == STREAM_FRAME_TYPE_DELTA:
+            # Compressed with the same layout as the raw frames, blocks which don't get smaller arrive as data stream frames
+            try:
+                frames = decode_sample_codec_block(bytes(payload))
+            except ValueError as e:
+                logger.error(f"Invalid compressed block : {e}")
+                return
+            self.encoded_bytes += len(payload)
+            self.decoded_bytes += frames.nbytes
+            self.compressed_blocks += 1
+            self._check_frame_index(sequence, len(frames))
+            self._samples_received(frames, self.frame_channels, timestamp_us)
+        elif frame_type == STREAM_FRAME_TYPE_AGGREGATE:
+            # Statistics records instead of frames, the sequence numbers count records
+            records = decode_aggregate_records(bytes(payload), len(self.frame_channels))
+            self._check_frame_index(sequence, len(records))
+            self._aggregates_received(records, self.frame_channels, timestamp_us)
+        elif frame_type == STREAM_FRAME_TYPE_SPECTRUM:
+            # Spectrum records instead of frames, a record per channel and window, the sequence numbers count records
+            try:
+                records = decode_spectrum_records(bytes(payload))
+            except ValueError as e:
+                logger.error(f"Invalid spectrum records : {e}")
+                return
+            self._check_frame_index(sequence, len(records))
+            self._spectra_received(records, self.frame_channels, timestamp_us)
+        elif frame_type == STREAM_FRAME_TYPE_EVENT:
+            # Event records instead of frames, the sequence numbers count records
+            records = decode_event_records(bytes(payload))
+            self._check_frame_index(sequence, len(records))
+            self._events_received(records, self.frame_channels)
+        elif frame_type == STREAM_FRAME_TYPE_MESSAGE:
+            # A message sent in-band, i.e. without waiting for the stream to end
+            self._decode_msg(msg_length = len(payload), msg_content = bytes(payload))
+        elif frame_type == STREAM_FRAME_TYPE_EOS:
+            # The sequence of the EOS frame is the number of data frames produced
+            if self.expected_sequence is not None and sequence != self.expected_sequence:
+                self.lost_frames += (sequence - self.expected_sequence) & 0xFFFFFFFF
+            logger.info(f"End of stream : {sequence} data frames produced, {self.lost_frames} lost, {self.stream_parser.crc_errors} CRC errors, {self.stream_parser.skipped_bytes} bytes skipped.")
+            if self.test_pattern_verifier is not None:
+                # The pattern restarts with the next stream
+                self.test_pattern_verifier.finish(sequence)
+                print(self.test_pattern_verifier.summary())
+                self.test_pattern_verifier.reset()
+            if self.compressed_blocks > 0:
+                logger.info(f"Compression : {self.decoded_bytes} bytes of frames in {self.encoded_bytes} bytes, {self.compressed_blocks} compressed blocks, compression ratio = {self.decoded_bytes / self.encoded_bytes:.2f}.")
+            self.expected_sequence = None
+            self.lost_frames = 0
+            self.encoded_bytes = 0
+            self.decoded_bytes = 0
+            self.compressed_blocks = 0
+            # A stream only transport waits for the next stream, otherwise go back to message mode
+            if not self.stream_only:
+                self.streaming = False
+                self.stream_parser.stop()
+        else:
+            logger.error(f"Unknown stream frame type {frame_type}.")
+
+    # Check the index of the first of a block of data frames against the number of data frames received so far
+    def _check_frame_index(self, first_frame_index: int, num_of_frames: int):
+        # Frames dropped by the device still take an index, so they show up as a gap
+        if self.expected_sequence is not None and first_frame_index != self.expected_sequence:
+            lost_frames = (first_frame_index - self.expected_sequence) & 0xFFFFFFFF
+            self.lost_frames += lost_frames
+            logger.warning(f"Gap in the stream : {lost_frames} data frames lost before data frame {first_frame_index}.")
+        self.expected_sequence = (first_frame_index + num_of_frames) & 0xFFFFFFFF
+
+    # Print a block of data frames, one row per frame and one column per channel in channels,
+    # timestamp_us is the device time of the first one
+    def _samples_received(self, frames: np.ndarray, channels: list, timestamp_us: int):
+        if self.latency_monitor is not None and self.arrival_us is not None:
+            self.latency_monitor.record(self.arrival_us, timestamp_us, len(frames))
+        if self.test_pattern_verifier is not None:
+            # Printing every frame would hold up the stream, the verifier reports once it ends
+            self.test_pattern_verifier.check(frames)
+            return
+        for data_frame in frames:
+            logger.debug(f"data_frame = {data_frame}")
+            # Show current time with millisecond precision
+            print(f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S.%f')[:-3] : <20}{' - ' : ^3}{'Stream data' : ^20}")
+            print("-"*50)
+            for channel_index, channel_val in zip(channels, data_frame.tolist()):
+                print(f"{'Channel ' : <10}{channel_index : ^5}{channel_val : ^10}")
+            print("")
+
+    # Print a block of statistics records, one row per window and one column per channel in channels,
+    # timestamp_us is the device time of the first frame of the first window
+    def _aggregates_received(self, records: np.ndarray, channels: list, timestamp_us: int):
+        scale = 1 << AGGREGATE_FRACTION_BITS
+        for record in records:
+            print(f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S.%f')[:-3] : <20}{' - ' : ^3}{'Window statistics' : ^20}")
+            print("-"*50)
+            for channel_index, stats in zip(channels, record):
+                print(f"{'Channel ' : <10}{channel_index : ^5}min = {stats['min']}, max = {stats['max']}, mean = {stats['mean'] / scale:.3f}, rms = {stats['rms'] / scale:.3f}")
+            print("")
+
+    # Print a block of spectrum records, the channel of a record is the index of the value in the frame,
+    # timestamp_us is the device time of the first frame of the window of the first record
+    # The magnitudes are those of the FFT divided by its size, a sine of amplitude A peaks at about A / 4
+    def _spectra_received(self, records: list, channels: list, timestamp_us: int):
+        for channel, fft_size, bins, clipped in records:
+            channel_index = channels[channel] if channel < len(channels) else channel
+            if clipped > 0:
+                logger.warning(f"Spectrum of channel {channel_index} : {clipped} of {fft_size} values clamped to 16 bits.")
+            print(f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S.%f')[:-3] : <20}{' - ' : ^3}{'Spectrum' : ^20}")
+            print("-"*50)
+            if bins.dtype == SPECTRUM_PEAK_DTYPE:
+                peaks = [f"{peak['bin']}: {peak['magnitude']}" for peak in bins if peak['magnitude'] > 0]
+            else:
+                # Strongest bins first, as the full spectrum doesn't fit on a line
+                strongest = np.argsort(bins[1:])[::-1][:8] + 1
+                peaks = [f"{k}: {bins[k]}" for k in strongest]
+            print(f"{'Channel ' : <10}{channel_index : ^5}FFT size = {fft_size}, bin : magnitude = {', '.join(peaks)}")
+            print("")
+
+    # Print a block of event records, the channel of a record is the index of the value in the frame
+    def _events_received(self, records: np.ndarray, channels: list):
+        for record in records:
+            channel = int(record['channel'])
+            channel_index = channels[channel] if channel < len(channels) else channel
+            polarity = EVENT_POLARITY_NAMES.get(int(record['polarity']), record['polarity'])
+            print(f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S.%f')[:-3] : <20}{' - ' : ^3}{'Event' : ^20}")
+            print("-"*50)
+            print(f"{'Channel ' : <10}{channel_index : ^5}{polarity}, start = {record['start_timestamp_us']} us, duration = {record['duration_us']} us, peak = {record['peak_value']} after {record['peak_offset_us']} us")
+            print("")
+
+    # Print the runtime counters of the device, the histograms are summarised by their count, range and mean
+    def _stats_received(self, stats):
+        print(f"{datetime.datetime.now().strftime('%Y-%m-%d %H:%M:%S') : <20}{' - ' : ^3}{'Stats' : ^20}")
+        print("-"*50)
+        print(f"{'Uptime' : <28}{stats.uptime_us / 1e6:.3f} s")
+        print(f"{'Core 0 / 1 load' : <28}{stats.core0_load_permille / 10:.1f} % / {stats.core1_load_permille / 10:.1f} % over {stats.interval_us / 1e3:.1f} ms")
+        print(f"{'Free heap' : <28}{stats.free_heap_bytes} bytes, at least {stats.min_free_heap_bytes} bytes")
+        print(f"{'Sampling' : <28}{f'every {stats.sampling_period_us} us' if stats.sampling else 'stopped'}")
+        print(f"{'Frames sampled' : <28}{stats.frames_sampled}")
+        print(f"{'Dropped frames' : <28}{stats.dropped_frames}, {stats.dropped_output_frames} after the decimator")
+        print(f"{'Late samples' : <28}{stats.late_samples}")
+        print(f"{'ADC overruns' : <28}{stats.adc_overruns}")
+        print(f"{'Egress stalls' : <28}{stats.egress_stalls}, {stats.egress_partial_writes} partial writes")
+        print(f"{'Egress ring high water' : <28}{stats.egress_ring_high_water} / {stats.egress_ring_size} blocks")
+        print(f"{'Decimator ring high water' : <28}{stats.decimator_ring_high_water} / {stats.decimator_ring_size} blocks")
+        for name, histogram in (("Sample interval", stats.sample_interval_us), ("Sampler ISR duration", stats.sampler_isr_duration_us)):
+            if histogram.count == 0:
+                print(f"{name : <28}no samples")
+                continue
+            print(f"{name : <28}{histogram.count} samples, min = {histogram.min} us, mean = {histogram.sum / histogram.count:.1f} us, max = {histogram.max} us")
+            # The first and the last bins also hold what falls below and above the histogram
+            for i, count in enumerate(histogram.bins):
+                if count > 0:
+                    bin_start = histogram.origin + i * histogram.bin_width
+                    marker = ' ' if 0 < i < len(histogram.bins) - 1 else '*'
+                    print(f"{'' : <28}{bin_start : >8} us {marker}{count : >10}")
+        if len(stats.tasks) > 0:
+            print(f"{'Task' : <16}{'Core' : >6}{'Prio' : >6}{'Run time us' : >14}{'Load %' : >8}{'Stack words' : >12}")
+            for task in stats.tasks:
+                core = {1: "0", 2: "1"}.get(task.core_affinity, "any")
+                print(f"{task.name : <16}{core : >6}{task.priority : >6}{task.run_time_us : >14}{task.load_permille / 10 : >8.1f}{task.stack_high_water_mark : >12}")
+        print("")
+
     def _msg_received(self, msg):
         logger.debug(f"Type of message : {type(msg)}")
         logger.debug(f"Received msg : {msg}")
@@ -106,8 +370,47 @@ class IngressProtocol(asyncio.BufferedProtocol):
             payload = msg.WhichOneof('payload')
             if payload == 'ack_set_periodic_sampler_msg':
                 if (msg.ack_set_periodic_sampler_msg.ack):
+                    # The stream arrives on the data port, see UsbConnectCommand
                     logger.info(f"Set periodic sampler message acknowledged by device. Receiving datastream...")
-                    self.streaming = True
+                else:
+                    logger.error(f"Set periodic sampler message rejected by device, the sampling period is not positive, or longer than the decimation output period or the aggregation window, or a burst capture is pending.")
+            elif payload == 'ack_set_decimator_msg':
+                if (msg.ack_set_decimator_msg.ack):
+                    logger.info(f"Set decimator message acknowledged by device, it applies from the next periodic sampling.")
+                else:
+                    logger.error(f"Set decimator message rejected by device, the output period is too short.")
+            elif payload == 'ack_set_aggregator_msg':
+                if (msg.ack_set_aggregator_msg.ack):
+                    logger.info(f"Set aggregator message acknowledged by device, it applies from the next periodic sampling.")
+                else:
+                    logger.error(f"Set aggregator message rejected by device, the window is too short.")
+            elif payload == 'ack_set_spectrum_msg':
+                if (msg.ack_set_spectrum_msg.ack):
+                    logger.info(f"Set spectrum message acknowledged by device, it applies from the next periodic sampling.")
+                else:
+                    logger.error(f"Set spectrum message rejected by device, the FFT size or the number of peaks is invalid.")
+            elif payload == 'ack_set_event_detector_msg':
+                if (msg.ack_set_event_detector_msg.ack):
+                    logger.info(f"Set event detector message acknowledged by device, it applies from the next periodic sampling.")
+                else:
+                    logger.error(f"Set event detector message rejected by device, the polarity is unknown or the threshold of the 'absolute' polarity is negative.")
+            elif payload == 'ack_set_capture_msg':
+                if (msg.ack_set_capture_msg.ack):
+                    logger.info(f"Set capture message acknowledged by device, it applies from the next periodic sampling.")
+            elif payload == 'ack_execute_burst_capture_msg':
+                if (msg.ack_execute_burst_capture_msg.ack):
+                    logger.info(f"Burst capture message acknowledged by device, the frames follow on the data port once captured.")
+                else:
+                    logger.error(f"Burst capture rejected by device, the periodic sampler or another burst capture is running.")
+            elif payload == 'capture_info_msg':
+                # Sent in-band ahead of a captured window, whose frames are numbered from 0
+                info = msg.capture_info_msg
+                self.capture_info = info
+                if info.HasField('duration_us'):
+                    # A burst capture, the frames come as fast as the ADC is read out
+                    logger.info(f"Burst capture : {info.num_of_frames} frames in {info.duration_us} micro-seconds, {info.num_of_frames / info.duration_us * 1e3:.1f} kSPS.")
+                else:
+                    logger.info(f"Capture triggered with value {info.trigger_value} : {info.num_of_frames} frames, trigger at frame {info.trigger_frame_index}, sampling period = {info.sampling_period_us} micro-seconds.")
             elif payload == 'one_off_sampler_data_msg':
                 logger.debug(f"One off sampler data message received from device.")
                 logger.debug(f"Sensor value 0 = {msg.one_off_sampler_data_msg.sensor_val_0}")
@@ -132,10 +435,29 @@ class IngressProtocol(asyncio.BufferedProtocol):
                 print("")
 
 
-            # elif payload == 'ack_stop_periodic_sampler_msg':
-            #     if (msg.ack_stop_periodic_sampler_msg.ack):
-            #         logger.info(f"Stop periodic sampler message acknowledged by device. Stop receiving datastream...")
-            #         self.streaming = False
+            elif payload == 'sample_batch_msg':
+                # The batch describes its own frame layout, so all of its frames are decoded at once
+                batch = msg.sample_batch_msg
+                frame_format = FRAME_FORMAT_NAMES.get(batch.frame_format, "int32")
+                channels = frame_layout_channels(frame_format, batch.channel_mask)
+                frames = decode_sample_frames(batch.samples, frame_format, len(channels))
+                logger.debug(f"Sample batch : {len(frames)} frames from frame {batch.first_frame_index}, sampling period = {batch.sampling_period_us} micro-seconds.")
+                self._check_frame_index(batch.first_frame_index, len(frames))
+                self._samples_received(frames, channels, batch.start_timestamp_us)
+            elif payload == 'stats_msg':
+                self._stats_received(msg.stats_msg)
+            elif payload == 'device_time_msg':
+                # Reply to a GetDeviceTime request of the latency harness
+                if self.latency_monitor is not None:
+                    self.latency_monitor.clock.reply(msg.device_time_msg.request_id, msg.device_time_msg.device_time_us, self.arrival_us)
+                else:
+                    logger.debug(f"Device time {msg.device_time_msg.device_time_us} us, no latency measurement running.")
+            elif payload == 'ack_stop_periodic_sampler_msg':
+                # The device only acknowledges once the rest of the stream and the EOS frame have been sent
+                if (msg.ack_stop_periodic_sampler_msg.ack):
+                    logger.info(f"Stop periodic sampler message acknowledged by device. Stop receiving datastream...")
+                else:
+                    logger.error(f"Stop periodic sampler message rejected by device, a burst capture is running, it ends by itself.")
             else:
                 logger.error(f"Unknown payload '{payload}'")
         except Exception as e:
@@ -0,0 +1,45 @@
+import struct
+import numpy as np
+
+# Compressed blocks of sample frames, see device_src/lib/sample_codec/sample_codec.h
+# Number of frames, number of channels and value size, little-endian
+SAMPLE_CODEC_HEADER = struct.Struct("<HBB")
+
+# Decode a compressed block into an array with a row per frame and a column per channel, the same as the
+# frames decoded from a raw block, i.e. uint16 values for 2 bytes values and int32 values for 4 bytes values
+# Each channel is decoded in one go, the deltas are unpacked with numpy and summed up with a cumulative sum
+def decode_sample_codec_block(data) -> np.ndarray:
+    data = memoryview(data).cast("B")
+    num_of_frames, num_of_channels, value_size = SAMPLE_CODEC_HEADER.unpack_from(data, 0)
+    if value_size not in (2, 4):
+        raise ValueError(f"Invalid value size {value_size} in compressed block.")
+    value_bits = 8 * value_size
+    value_mask = (1 << value_bits) - 1
+    num_of_deltas = num_of_frames - 1
+    values = np.empty((num_of_frames, num_of_channels), dtype=np.int64)
+    offset = SAMPLE_CODEC_HEADER.size
+    for channel in range(num_of_channels):
+        first = int.from_bytes(data[offset:offset + value_size], "little")
+        width = data[offset + value_size]
+        offset += value_size + 1
+        if width > value_bits:
+            raise ValueError(f"Invalid bit width {width} in compressed block.")
+        packed_size = (num_of_deltas * width + 7) // 8
+        if offset + packed_size > len(data):
+            raise ValueError("Truncated compressed block.")
+        if width == 0:
+            zigzag = np.zeros(num_of_deltas, dtype=np.uint64)
+        else:
+            # Least significant bit first, one row of width bits per delta
+            bits = np.unpackbits(np.frombuffer(data, dtype=np.uint8, count=packed_size, offset=offset), bitorder="little")
+            bits = bits[:num_of_deltas * width].reshape(num_of_deltas, width).astype(np.uint64)
+            zigzag = bits @ (np.uint64(1) << np.arange(width, dtype=np.uint64))
+        offset += packed_size
+        deltas = (zigzag >> np.uint64(1)).astype(np.int64) ^ -(zigzag & np.uint64(1)).astype(np.int64)
+        values[0, channel] = first
+        np.cumsum(deltas, out=values[1:, channel])
+        values[1:, channel] += first
+    values &= value_mask
+    if value_size == 2:
+        return values.astype("<u2")
+    return values.astype(np.uint32).view("<i4")
@@ -0,0 +1,104 @@
+import binascii
+import logging
+import struct
+from typing import Callable
+
+logger = logging.getLogger(__name__)
+
+# Frames of the sample stream, see device_src/lib/stream_frame/stream_frame.h
+# Sync bytes, then type, payload length, sequence and timestamp, all little-endian
+STREAM_FRAME_SYNC = b"\xa5\x5a"
+STREAM_FRAME_HEADER = struct.Struct("<2sBHII")
+STREAM_FRAME_CRC = struct.Struct("<H")
+STREAM_FRAME_OVERHEAD = STREAM_FRAME_HEADER.size + STREAM_FRAME_CRC.size
+# A longer length field is treated as corruption
+STREAM_FRAME_MAX_PAYLOAD_SIZE = 4096
+
+STREAM_FRAME_TYPE_DATA = 0x01
+STREAM_FRAME_TYPE_MESSAGE = 0x02
+STREAM_FRAME_TYPE_EOS = 0x03
+STREAM_FRAME_TYPE_DELTA = 0x04
+STREAM_FRAME_TYPE_AGGREGATE = 0x05
+STREAM_FRAME_TYPE_SPECTRUM = 0x06
+STREAM_FRAME_TYPE_EVENT = 0x07
+
+# CRC-16/CCITT-FALSE over everything but the sync bytes and the CRC itself, binascii.crc_hqx() implements
+# the same polynomial, so only the initial value has to be given
+def stream_frame_crc16(data) -> int:
+    return binascii.crc_hqx(data, 0xFFFF)
+
+# Build a frame the way the device does, for replaying or simulating a stream on the host
+def encode_stream_frame(frame_type: int, sequence: int, timestamp_us: int, payload: bytes = b"") -> bytes:
+    header = STREAM_FRAME_HEADER.pack(STREAM_FRAME_SYNC, frame_type, len(payload), sequence & 0xFFFFFFFF, timestamp_us & 0xFFFFFFFF)
+    body = header[len(STREAM_FRAME_SYNC):] + payload
+    return header + payload + STREAM_FRAME_CRC.pack(stream_frame_crc16(body))
+
+# Incremental parser of the sample stream
+# Bytes can be fed in chunks of any size, e.g. as split or merged by USB, every complete frame with a valid CRC
+# is handed to frame_callback(frame_type, sequence, timestamp_us, payload) as soon as its last byte arrives
+# The payload is a memoryview into the parser buffer, it is only valid during the callback, so it has to be
+# copied if it is kept
+# After corrupted or lost bytes the parser drops one byte at a time until it finds the next valid frame
+# The callback may call stop() to leave the bytes after the current frame unparsed in the buffer, e.g. when
+# the stream ends and messages follow
+class StreamFrameParser:
+    def __init__(self, frame_callback: Callable[[int, int, int, memoryview], None]):
+        self.frame_callback = frame_callback
+        self.buffer = bytearray()
+        self.stop_requested = False
+        # Counters for diagnosing the link
+        self.frames_received = 0
+        self.crc_errors = 0
+        self.skipped_bytes = 0
+
+    def reset(self) -> None:
+        self.buffer = bytearray()
+
+    def stop(self) -> None:
+        self.stop_requested = True
+
+    def feed(self, data: bytes) -> None:
+        self.buffer.extend(data)
+        offset = 0
+        buffer_length = len(self.buffer)
+        view = memoryview(self.buffer)
+        self.stop_requested = False
+        try:
+            while not self.stop_requested:
+                sync_offset = self.buffer.find(STREAM_FRAME_SYNC, offset)
+                if sync_offset < 0:
+                    # Keep a trailing first sync byte, the second one may be in the next chunk
+                    keep = 1 if buffer_length > offset and self.buffer[-1] == STREAM_FRAME_SYNC[0] else 0
+                    self.skipped_bytes += buffer_length - keep - offset
+                    offset = buffer_length - keep
+                    break
+                self.skipped_bytes += sync_offset - offset
+                offset = sync_offset
+                if buffer_length - offset < STREAM_FRAME_HEADER.size:
+                    break
+                _, frame_type, payload_size, sequence, timestamp_us = STREAM_FRAME_HEADER.unpack_from(self.buffer, offset)
+                if payload_size > STREAM_FRAME_MAX_PAYLOAD_SIZE:
+                    # Not a real frame, look for the next sync bytes
+                    offset += 1
+                    self.skipped_bytes += 1
+                    continue
+                crc_offset = offset + STREAM_FRAME_HEADER.size + payload_size
+                if buffer_length < crc_offset + STREAM_FRAME_CRC.size:
+                    break
+                (crc,) = STREAM_FRAME_CRC.unpack_from(self.buffer, crc_offset)
+                if crc != stream_frame_crc16(view[offset + len(STREAM_FRAME_SYNC):crc_offset]):
+                    self.crc_errors += 1
+                    offset += 1
+                    self.skipped_bytes += 1
+                    continue
+                self.frames_received += 1
+                payload = view[offset + STREAM_FRAME_HEADER.size:crc_offset]
+                try:
+                    self.frame_callback(frame_type, sequence, timestamp_us, payload)
+                finally:
+                    payload.release()
+                offset = crc_offset + STREAM_FRAME_CRC.size
+        finally:
+            view.release()
+            # Only the unparsed tail is kept
+            del self.buffer[:offset]
@@ -0,0 +1,148 @@
+import logging
+import time
+import numpy as np
+
+logger = logging.getLogger(__name__)
+
+# Test pattern streamed by the device in place of the sensors, see device_src/lib/sensor_manager/sensor_manager.h
+# Every int32 frame holds the sample counter, which starts from 0 with every stream, the state of a 32-bit Galois
+# LFSR advanced once per sample, then zeros, packed int16 frames hold the same bytes, cut to 16 bytes
+TEST_PATTERN_LFSR_TAPS = 0x80200003
+TEST_PATTERN_LFSR_SEED = 0xACE1ACE1
+TEST_PATTERN_NUM_OF_VALUES = 2
+
+# Most ranges of missing samples remembered for telling samples arriving late from duplicates
+MAX_MISSING_RANGES = 1024
+
+# Advance the LFSR by one sample, on a single state or elementwise on an array of uint32 states
+def lfsr_step(state):
+    return (state >> 1) ^ ((state & 1) * TEST_PATTERN_LFSR_TAPS)
+
+# The step is linear over GF(2), so it is a 32x32 bit matrix, stored as the images of the 32 basis vectors
+def _matrix_apply(matrix: list, state: int) -> int:
+    result = 0
+    bit = 0
+    while state:
+        if state & 1:
+            result ^= matrix[bit]
+        state >>= 1
+        bit += 1
+    return result
+
+def _matrix_multiply(a: list, b: list) -> list:
+    return [_matrix_apply(a, column) for column in b]
+
+_LFSR_STEP_MATRIX = [lfsr_step(1 << bit) for bit in range(32)]
+
+# State of the LFSR num_of_steps samples after state, by squaring the step matrix, so it takes the same time
+# whatever the number of steps
+def lfsr_advance(state: int, num_of_steps: int) -> int:
+    matrix = _LFSR_STEP_MATRIX
+    while num_of_steps:
+        if num_of_steps & 1:
+            state = _matrix_apply(matrix, state)
+        num_of_steps >>= 1
+        if num_of_steps:
+            matrix = _matrix_multiply(matrix, matrix)
+    return state
+
+# Check the test pattern as it arrives, block by block of int32 frames
+# A frame is corrupt if its LFSR state doesn't belong to its counter or anything follows them but zeros, the
+# order is checked on the counters of the other frames : a counter past the expected one means missing samples,
+# a counter before it a sample arriving late if it was missing, or a duplicate otherwise
+class TestPatternVerifier:
+    def __init__(self):
+        self.reset()
+
+    def reset(self) -> None:
+        self.expected_counter = 0
+        self.received = 0
+        self.missing = 0
+        self.duplicates = 0
+        self.out_of_order = 0
+        self.corrupt = 0
+        # Ranges [first, last) of missing counters, oldest first
+        self.missing_ranges = []
+        self.first_block_time = None
+        self.last_block_time = None
+
+    def check(self, frames: np.ndarray) -> None:
+        now = time.monotonic()
+        if self.first_block_time is None:
+            self.first_block_time = now
+        self.last_block_time = now
+        if len(frames) == 0:
+            return
+        self.received += len(frames)
+        # Packed int16 frames hold the first half of the bytes of the int32 frames
+        if frames.ndim == 2 and frames.dtype.itemsize == 2 and frames.shape[1] % 2 == 0:
+            frames = np.ascontiguousarray(frames).view("<i4")
+        if frames.ndim != 2 or frames.shape[1] < TEST_PATTERN_NUM_OF_VALUES or frames.dtype.itemsize != 4:
+            logger.error(f"Test pattern : frames of shape {frames.shape} and type {frames.dtype} aren't int32 frames.")
+            self.corrupt += len(frames)
+            return
+        values = frames.view(np.uint32).astype(np.int64)
+        counters = values[:, 0]
+        states = values[:, 1]
+
+        # A frame following on from the previous one in the block is as valid as that one, as the step is a
+        # bijection, so only the first frame of each run is checked against its counter
+        follows = (counters[1:] == ((counters[:-1] + 1) & 0xFFFFFFFF)) & (states[1:] == lfsr_step(states[:-1]))
+        run_starts = np.flatnonzero(np.concatenate(([True], ~follows)))
+        run_valid = np.array([lfsr_advance(TEST_PATTERN_LFSR_SEED, int(counters[i])) == int(states[i]) for i in run_starts])
+        valid = run_valid[np.cumsum(np.concatenate(([True], ~follows))) - 1]
+        valid &= ~np.any(values[:, TEST_PATTERN_NUM_OF_VALUES:] != 0, axis=1)
+        num_of_corrupt = len(frames) - int(np.count_nonzero(valid))
+        if num_of_corrupt > 0:
+            first_corrupt = int(np.flatnonzero(~valid)[0])
+            logger.warning(f"Test pattern : {num_of_corrupt} corrupt frames, the first one is {frames[first_corrupt].tolist()}.")
+            self.corrupt += num_of_corrupt
+        counters = counters[valid]
+        if len(counters) == 0:
+            return
+
+        # Fast path, the block carries on exactly where the last one stopped
+        if counters[0] == self.expected_counter and len(run_starts) == 1 and num_of_corrupt == 0:
+            self.expected_counter = (int(counters[-1]) + 1) & 0xFFFFFFFF
+            return
+        for counter in counters.tolist():
+            self._check_counter(counter)
+
+    def _check_counter(self, counter: int) -> None:
+        # Distances modulo 2^32, as the counter wraps around after ~2 days at 25 kHz
+        ahead = (counter - self.expected_counter) & 0xFFFFFFFF
+        if ahead == 0:
+            self.expected_counter = (counter + 1) & 0xFFFFFFFF
+        elif ahead < 0x80000000:
+            logger.warning(f"Test pattern : {ahead} samples missing before sample {counter}.")
+            self.missing += ahead
+            self.missing_ranges.append([self.expected_counter, counter])
+            del self.missing_ranges[:-MAX_MISSING_RANGES]
+            self.expected_counter = (counter + 1) & 0xFFFFFFFF
+        else:
+            for i, (first, last) in enumerate(self.missing_ranges):
+                if ((counter - first) & 0xFFFFFFFF) < ((last - first) & 0xFFFFFFFF):
+                    # Only counted as missing until now, the range is split around it in place, so that the oldest
+                    # ranges stay first
+                    self.missing -= 1
+                    self.out_of_order += 1
+                    self.missing_ranges[i:i + 1] = [r for r in ([first, counter], [(counter + 1) & 0xFFFFFFFF, last]) if r[0] != r[1]]
+                    return
+            self.duplicates += 1
+
+    # The device tells how many samples it has produced once the stream ends, the ones after the last sample
+    # received are missing as well
+    def finish(self, num_of_samples_produced: int) -> None:
+        tail = (num_of_samples_produced - self.expected_counter) & 0xFFFFFFFF
+        if 0 < tail < 0x80000000:
+            self.missing += tail
+            self.expected_counter = num_of_samples_produced & 0xFFFFFFFF
+
+    def passed(self) -> bool:
+        return self.received > 0 and self.missing == 0 and self.duplicates == 0 and self.out_of_order == 0 and self.corrupt == 0
+
+    def summary(self) -> str:
+        duration = (self.last_block_time - self.first_block_time) if self.first_block_time is not None else 0.0
+        rate = f", {self.received / duration:.0f} samples/s" if duration > 0 else ""
+        return (f"Test pattern {'passed' if self.passed() else 'FAILED'} : {self.received} samples received{rate}, {self.missing} missing, "
+                f"{self.duplicates} duplicates, {self.out_of_order} out of order, {self.corrupt} corrupt.")
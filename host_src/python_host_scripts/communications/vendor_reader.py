@@ -0,0 +1,148 @@
+import argparse
+import asyncio
+import logging
+import struct
+import threading
+import time
+from typing import Callable, Optional
+
+logger = logging.getLogger(__name__)
+
+# USB ids of the data logger, see device_src/usb_descriptors.c
+# The product id is 0x4000 plus the number of interfaces per enabled class, CDC from bit 0 and VENDOR from bit 4
+USB_VID = 0xCafe
+USB_PID = 0x4000 | (2 << 0) | (1 << 4)
+
+# Interface class of the vendor interface
+USB_CLASS_VENDOR_SPECIFIC = 0xFF
+
+# Each chunk in a recorded endpoint trace is prefixed with its length as a little-endian uint32
+TRACE_CHUNK_HEADER = struct.Struct("<I")
+
+# Reads the sample stream from the bulk IN endpoint of the vendor interface with libusb (through pyusb)
+# Reading happens in a background thread, every chunk is handed to data_callback on the asyncio event loop
+class VendorBulkReader:
+    def __init__(self, loop: asyncio.AbstractEventLoop, data_callback: Callable[[bytes], None], read_size: int = 16384, timeout_ms: int = 100, record_path: Optional[str] = None):
+        self.loop = loop
+        self.data_callback = data_callback
+        # Large reads let libusb queue many 64 bytes packets per transfer, which is what keeps the endpoint busy
+        self.read_size = read_size
+        self.timeout_ms = timeout_ms
+        self.record_path = record_path
+        self.device = None
+        self.interface_number = None
+        self.endpoint_in = None
+        self.thread = None
+        self.stop_event = threading.Event()
+        self.bytes_received = 0
+        self.start_time = None
+
+    def start(self) -> None:
+        # Imported here so that a recorded trace can be replayed without pyusb installed
+        import usb.core
+        import usb.util
+
+        self.device = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+        if self.device is None:
+            raise ValueError(f"Data logger with VID = {USB_VID:#06x} and PID = {USB_PID:#06x} not found.")
+        configuration = self.device.get_active_configuration()
+        interface = usb.util.find_descriptor(configuration, bInterfaceClass=USB_CLASS_VENDOR_SPECIFIC)
+        if interface is None:
+            raise ValueError("Vendor interface not found on the data logger.")
+        self.endpoint_in = usb.util.find_descriptor(interface, custom_match=lambda ep: usb.util.endpoint_direction(ep.bEndpointAddress) == usb.util.ENDPOINT_IN)
+        if self.endpoint_in is None:
+            raise ValueError("Bulk IN endpoint not found on the vendor interface.")
+        self.interface_number = interface.bInterfaceNumber
+        # The CDC interfaces stay with the kernel driver, only the vendor interface is claimed
+        usb.util.claim_interface(self.device, self.interface_number)
+        logger.debug(f"Claimed vendor interface {self.interface_number}, bulk IN endpoint {self.endpoint_in.bEndpointAddress:#04x}.")
+
+        self.stop_event.clear()
+        self.bytes_received = 0
+        self.start_time = time.monotonic()
+        self.thread = threading.Thread(target=self._run, name="vendor_bulk_reader", daemon=True)
+        self.thread.start()
+
+    def stop(self) -> None:
+        if self.thread is None:
+            return
+        self.stop_event.set()
+        self.thread.join()
+        self.thread = None
+        import usb.util
+        usb.util.release_interface(self.device, self.interface_number)
+        usb.util.dispose_resources(self.device)
+        logger.info(f"Vendor bulk reader stopped : {self.bytes_received} bytes received at {self.throughput_mbps():.2f} Mbps.")
+
+    def throughput_mbps(self) -> float:
+        if self.start_time is None:
+            return 0.0
+        elapsed = time.monotonic() - self.start_time
+        return (self.bytes_received * 8 / elapsed / 1e6) if elapsed > 0 else 0.0
+
+    def _run(self) -> None:
+        import usb.core
+
+        record_file = open(self.record_path, "wb") if self.record_path else None
+        try:
+            while not self.stop_event.is_set():
+                try:
+                    data = bytes(self.endpoint_in.read(self.read_size, timeout=self.timeout_ms))
+                except usb.core.USBTimeoutError:
+                    continue
+                except usb.core.USBError as e:
+                    logger.error(f"Bulk IN read failed : {e}")
+                    break
+                self.bytes_received += len(data)
+                if record_file is not None:
+                    record_file.write(TRACE_CHUNK_HEADER.pack(len(data)))
+                    record_file.write(data)
+                self.loop.call_soon_threadsafe(self.data_callback, data)
+        finally:
+            if record_file is not None:
+                record_file.close()
+
+# Replays an endpoint trace recorded by VendorBulkReader, chunk by chunk, with the same read boundaries
+# It stands in for the device when verifying the host side on Linux without hardware
+def replay_trace(trace_path: str, data_callback: Callable[[bytes], None]) -> int:
+    bytes_replayed = 0
+    with open(trace_path, "rb") as trace_file:
+        while True:
+            header = trace_file.read(TRACE_CHUNK_HEADER.size)
+            if len(header) < TRACE_CHUNK_HEADER.size:
+                break
+            (chunk_length,) = TRACE_CHUNK_HEADER.unpack(header)
+            chunk = trace_file.read(chunk_length)
+            if len(chunk) < chunk_length:
+                logger.error("Truncated chunk at the end of the trace.")
+                break
+            data_callback(chunk)
+            bytes_replayed += chunk_length
+    return bytes_replayed
+
+# Stand-alone throughput check of the vendor bulk endpoint, the periodic sampler has to be started with
+# '--data_interface vendor' from the CLI first
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Read the sample stream from the vendor bulk IN endpoint and report the throughput.")
+    parser.add_argument("--duration", type=float, default=10.0, help="Time to read for in seconds.")
+    parser.add_argument("--record", type=str, default=None, help="Record the endpoint trace into this file.")
+    parser.add_argument("--replay", type=str, default=None, help="Replay a recorded endpoint trace instead of reading from the device.")
+    args = parser.parse_args()
+
+    if args.replay:
+        start_time = time.monotonic()
+        bytes_replayed = replay_trace(args.replay, lambda data: None)
+        print(f"Replayed {bytes_replayed} bytes in {time.monotonic() - start_time:.3f} seconds.")
+        return
+
+    async def read_for_duration():
+        reader = VendorBulkReader(asyncio.get_running_loop(), lambda data: None, record_path=args.record)
+        reader.start()
+        await asyncio.sleep(args.duration)
+        reader.stop()
+        print(f"Received {reader.bytes_received} bytes, throughput = {reader.throughput_mbps():.2f} Mbps.")
+
+    asyncio.run(read_for_duration())
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,299 @@
+"""Throughput benchmark of the egress path of device_main
+
+Streams the test pattern of device_main for every combination of frames per block, frame format, egress ring
+depth and sampling period in turn, through the same sample blocks, spsc_ring, encode_egress_block() and
+egress_write_all() as any other stream, and checks it with the test pattern verifier as it arrives on the data
+port. Each configuration is stopped with its end of stream frame, then the counters of the device are read with a
+stats query and merged with what the host received, e.g.
+    python egress_benchmark.py /dev/cu.usbmodem1201 /dev/cu.usbmodem1203 --frames_per_block 1 16 --csv results.csv
+It runs against the host-native build as well, on its pseudo-terminals, see device_src/posix. An axis left out
+takes the default values below. With --baseline, the results are compared with those of an earlier run saved with
+--json, and the script exits with 1 if a configuration delivers less than it did.
+"""
+import argparse
+import asyncio
+import csv
+import json
+import logging
+import sys
+import time
+
+import numpy as np
+import serial_asyncio
+
+import main_pb2
+from message_handler.message_handler import decode_varint, prepare_set_periodic_sampler_msg, prepare_stop_periodic_sampler_msg, prepare_get_stats_msg
+from communications.stream_frame import StreamFrameParser, STREAM_FRAME_OVERHEAD, STREAM_FRAME_TYPE_DATA, STREAM_FRAME_TYPE_EOS
+from communications.test_pattern import TestPatternVerifier
+
+logger = logging.getLogger(__name__)
+
+# Time the device has to answer a message
+REPLY_TIMEOUT_S = 2.0
+
+# Time from the stop to the end of stream frame, as the device sends the rest of the stream first
+EOS_TIMEOUT_S = 5.0
+
+# Default sweep, the egress ring of device_main holds 8 blocks, see EGRESS_RING_NUM_OF_BLOCKS
+DEFAULT_FRAMES_PER_BLOCK = [1, 16, 64]
+DEFAULT_FRAME_FORMATS = ["int32", "packed16"]
+DEFAULT_RING_DEPTHS = [2, 4, 8]
+DEFAULT_SAMPLING_PERIODS_US = [20, 50, 200, 1000]
+
+# Bytes per frame of the test pattern, eight values of either size
+FRAME_SIZES = {"int32": 32, "packed16": 16}
+
+# Columns of the results, the configuration first, then what the device counted, then what the host received
+CONFIG_FIELDS = ["config_index", "frames_per_block", "frame_format", "ring_depth", "sampling_period_us"]
+DEVICE_FIELDS = ["frames_produced", "dropped_frames", "late_samples", "egress_stalls", "egress_partial_writes",
+                 "egress_ring_high_water", "egress_ring_size"]
+HOST_FIELDS = ["sampling_duration_us", "total_duration_us", "bytes_received", "frames_received", "frames_missing",
+               "duplicates", "out_of_order", "frames_corrupt", "crc_errors", "skipped_bytes", "eos_received"]
+RATE_FIELDS = ["delivery_rate", "source_mbps", "throughput_mbps"]
+RESULT_FIELDS = CONFIG_FIELDS + DEVICE_FIELDS + HOST_FIELDS + RATE_FIELDS
+
+# Receives the test pattern on the data port, a stream per configuration, up to its end of stream frame
+class EgressStreamProtocol(asyncio.Protocol):
+    def __init__(self):
+        self.transport = None
+        self.stream_parser = StreamFrameParser(self._stream_frame_received)
+        self.start_stream(FRAME_SIZES["int32"])
+
+    # Count the next stream, the test pattern restarts with every stream
+    def start_stream(self, frame_size: int) -> None:
+        self.frame_size = frame_size
+        self.verifier = TestPatternVerifier()
+        self.bytes_received = 0
+        self.unexpected_frames = 0
+        self.frames_produced = None
+        self.eos_time = None
+        self.eos_received = asyncio.Event()
+        # The parser counts from the last stream on
+        self.stream_parser.crc_errors = 0
+        self.stream_parser.skipped_bytes = 0
+
+    def connection_made(self, transport):
+        self.transport = transport
+        logger.debug("Data port connected.")
+
+    def connection_lost(self, exc):
+        logger.debug("Data port disconnected.")
+
+    def data_received(self, data):
+        self.stream_parser.feed(data)
+
+    def _stream_frame_received(self, frame_type: int, sequence: int, timestamp_us: int, payload: memoryview) -> None:
+        self.bytes_received += len(payload) + STREAM_FRAME_OVERHEAD
+        if frame_type == STREAM_FRAME_TYPE_DATA and len(payload) % self.frame_size == 0:
+            # Packed frames hold the counter and the LFSR state as well, in their first 8 bytes
+            self.verifier.check(np.frombuffer(bytes(payload), dtype="<i4").reshape(-1, self.frame_size // 4))
+        elif frame_type == STREAM_FRAME_TYPE_EOS:
+            # The sequence of the EOS frame is the number of frames produced, dropped ones included
+            self.frames_produced = sequence
+            self.verifier.finish(sequence)
+            self.eos_time = time.monotonic()
+            self.eos_received.set()
+        else:
+            logger.warning(f"Unexpected stream frame of type {frame_type} and {len(payload)} bytes.")
+            self.unexpected_frames += 1
+
+# Decodes the messages of the control port, delimited with their length as a varint
+class EgressControlProtocol(asyncio.Protocol):
+    def __init__(self):
+        self.transport = None
+        self.buffer = bytearray()
+        self.messages = asyncio.Queue()
+
+    def connection_made(self, transport):
+        self.transport = transport
+        logger.debug("Control port connected.")
+
+    def connection_lost(self, exc):
+        logger.debug("Control port disconnected.")
+
+    def data_received(self, data):
+        self.buffer.extend(data)
+        while True:
+            msg_length, varint_size = decode_varint(self.buffer)
+            if msg_length is None or len(self.buffer) < varint_size + msg_length:
+                return
+            msg = main_pb2.DeviceToHostMessage()
+            try:
+                msg.ParseFromString(bytes(self.buffer[varint_size:varint_size + msg_length]))
+                self.messages.put_nowait(msg)
+            except Exception:
+                logger.exception("Failed to decode a DeviceToHostMessage.")
+            del self.buffer[:varint_size + msg_length]
+
+    # Wait for the next message with the given payload, e.g. skipping the reply to a configuration given up on
+    async def expect(self, payload: str, timeout: float = REPLY_TIMEOUT_S):
+        loop = asyncio.get_running_loop()
+        deadline = loop.time() + timeout
+        while True:
+            remaining = deadline - loop.time()
+            try:
+                msg = await asyncio.wait_for(self.messages.get(), max(remaining, 0.0))
+            except asyncio.TimeoutError:
+                return None
+            if msg.WhichOneof("payload") == payload:
+                return getattr(msg, payload)
+            logger.debug(f"Skipping '{msg.WhichOneof('payload')}' while waiting for '{payload}'.")
+
+# Every combination of the axes, the last one varies fastest
+def sweep_configs(args: argparse.Namespace) -> list:
+    configs = []
+    for frames_per_block in args.frames_per_block:
+        for frame_format in args.frame_formats:
+            for ring_depth in args.ring_depths:
+                for sampling_period_us in args.sampling_periods_us:
+                    configs.append({"config_index": len(configs), "frames_per_block": frames_per_block, "frame_format": frame_format,
+                                    "ring_depth": ring_depth, "sampling_period_us": sampling_period_us})
+    return configs
+
+# Merge the configuration with what the device reported of it and what the host received of it
+def merge_result(config: dict, stats, data: EgressStreamProtocol, start_time: float, stop_time: float) -> dict:
+    verifier = data.verifier
+    row = dict(config)
+    frames_produced = data.frames_produced if data.frames_produced is not None else (stats.frames_sampled if stats is not None else 0)
+    for field in DEVICE_FIELDS[1:]:
+        row[field] = getattr(stats, field) if stats is not None else 0
+    end_time = data.eos_time if data.eos_time is not None else stop_time
+    sampling_duration_us = int((stop_time - start_time) * 1e6)
+    total_duration_us = int((end_time - start_time) * 1e6)
+    row.update({
+        "frames_produced": frames_produced,
+        "sampling_duration_us": sampling_duration_us,
+        "total_duration_us": total_duration_us,
+        "bytes_received": data.bytes_received,
+        "frames_received": verifier.received,
+        "frames_missing": verifier.missing,
+        "duplicates": verifier.duplicates,
+        "out_of_order": verifier.out_of_order,
+        "frames_corrupt": verifier.corrupt,
+        "crc_errors": data.stream_parser.crc_errors,
+        "skipped_bytes": data.stream_parser.skipped_bytes,
+        "eos_received": data.eos_time is not None,
+        # Frames produced by the sampler, dropped ones included, against the intact ones which reached the host
+        "delivery_rate": round(100.0 * (verifier.received - verifier.corrupt - verifier.duplicates) / frames_produced, 2) if frames_produced else 0.0,
+        "source_mbps": round(8.0 * frames_produced * FRAME_SIZES[config["frame_format"]] / sampling_duration_us, 4) if sampling_duration_us else 0.0,
+        "throughput_mbps": round(8.0 * data.bytes_received / total_duration_us, 4) if total_duration_us else 0.0,
+    })
+    return row
+
+# Stream a configuration for duration_ms, stop it and read the counters of the device, None if it is rejected
+async def run_config(config: dict, duration_ms: int, control: EgressControlProtocol, control_transport, data: EgressStreamProtocol):
+    data.start_stream(FRAME_SIZES[config["frame_format"]])
+    msg = prepare_set_periodic_sampler_msg(sampling_period=config["sampling_period_us"], frames_per_block=config["frames_per_block"],
+                                           frame_format=config["frame_format"], test_pattern=True, egress_ring_depth=config["ring_depth"])
+    if msg is None:
+        return None
+    control_transport.write(msg)
+    ack = await control.expect("ack_set_periodic_sampler_msg")
+    start_time = time.monotonic()
+    if ack is None or not ack.ack:
+        logger.error(f"Configuration {config} rejected.")
+        return None
+    await asyncio.sleep(duration_ms / 1000.0)
+
+    control_transport.write(prepare_stop_periodic_sampler_msg())
+    stop_time = time.monotonic()
+    try:
+        await asyncio.wait_for(data.eos_received.wait(), EOS_TIMEOUT_S)
+    except asyncio.TimeoutError:
+        logger.warning(f"No end of stream for configuration {config['config_index']} within {EOS_TIMEOUT_S:.1f} s of the stop.")
+    if await control.expect("ack_stop_periodic_sampler_msg", EOS_TIMEOUT_S) is None:
+        logger.warning(f"No stop acknowledgement for configuration {config['config_index']}.")
+    # The counters stay as the stream left them until the next one starts
+    control_transport.write(prepare_get_stats_msg())
+    stats = await control.expect("stats_msg")
+    if stats is None:
+        logger.warning(f"No stats for configuration {config['config_index']}.")
+    return merge_result(config, stats, data, start_time, stop_time)
+
+async def run_benchmark(args: argparse.Namespace) -> list:
+    loop = asyncio.get_running_loop()
+    control_transport, control = await serial_asyncio.create_serial_connection(loop, EgressControlProtocol, args.port, baudrate=115200)
+    data_transport, data = await serial_asyncio.create_serial_connection(loop, EgressStreamProtocol, args.data_port, baudrate=115200)
+    try:
+        configs = sweep_configs(args)
+        results = []
+        for config in configs:
+            row = await run_config(config, args.duration_ms, control, control_transport, data)
+            if row is None:
+                continue
+            results.append(row)
+            print(f"[{config['config_index'] + 1}/{len(configs)}] frames_per_block={row['frames_per_block']} frame_format={row['frame_format']} "
+                  f"ring_depth={row['ring_depth']} sampling_period_us={row['sampling_period_us']} : "
+                  f"delivery rate {row['delivery_rate']:.2f} %, {row['throughput_mbps']:.4f} Mbps of {row['source_mbps']:.4f} Mbps, "
+                  f"{row['dropped_frames']} dropped, ring high water {row['egress_ring_high_water']}/{row['egress_ring_size']}")
+        return results
+    finally:
+        control_transport.close()
+        data_transport.close()
+
+def write_csv(path: str, results: list) -> None:
+    with open(path, "w", newline="") as csv_file:
+        writer = csv.DictWriter(csv_file, fieldnames=RESULT_FIELDS)
+        writer.writeheader()
+        writer.writerows(results)
+
+def write_json(path: str, results: list) -> None:
+    with open(path, "w") as json_file:
+        json.dump(results, json_file, indent=2)
+
+def config_key(row: dict) -> tuple:
+    return tuple(row[field] for field in CONFIG_FIELDS[1:])
+
+# Find the configurations which deliver less than in the baseline, beyond the tolerance in percent, only the
+# configurations of both runs are compared
+def compare_with_baseline(results: list, baseline: list, tolerance: float) -> list:
+    baseline_rows = {config_key(row): row for row in baseline}
+    regressions = []
+    for row in results:
+        baseline_row = baseline_rows.get(config_key(row))
+        if baseline_row is None:
+            continue
+        for field in ("delivery_rate", "throughput_mbps"):
+            if row[field] < baseline_row[field] * (1.0 - tolerance / 100.0):
+                regressions.append(f"Configuration {config_key(row)} : {field} = {row[field]} against {baseline_row[field]} in the baseline.")
+    return regressions
+
+def get_argument_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Measure the throughput of the egress path of device_main with the test pattern.")
+    parser.add_argument("port", type=str, help="USB port of the device which carries the messages, i.e. the 1st CDC port. E.g. '/dev/cu.usbmodem1201'.")
+    parser.add_argument("data_port", type=str, help="USB port of the device which carries the stream, i.e. the 2nd CDC port. E.g. '/dev/cu.usbmodem1203'.")
+    parser.add_argument("--duration_ms", type=int, default=1000, help="Time each configuration is sampled for.")
+    parser.add_argument("--frames_per_block", type=int, nargs="+", default=DEFAULT_FRAMES_PER_BLOCK, help="Frames batched into a block, the device also caps a block at 1 KB.")
+    parser.add_argument("--frame_formats", type=str, nargs="+", choices=list(FRAME_SIZES), default=DEFAULT_FRAME_FORMATS, help="Layouts of the frames, 32 bytes for 'int32', 16 for 'packed16'.")
+    parser.add_argument("--ring_depths", type=int, nargs="+", default=DEFAULT_RING_DEPTHS, help="Blocks of the egress ring the stream may fill, up to the size of the ring.")
+    parser.add_argument("--sampling_periods_us", type=int, nargs="+", default=DEFAULT_SAMPLING_PERIODS_US, help="Periods of the frames.")
+    parser.add_argument("--csv", type=str, default=None, help="Write the results to a CSV file.")
+    parser.add_argument("--json", type=str, default=None, help="Write the results to a JSON file, which can be used as a baseline.")
+    parser.add_argument("--baseline", type=str, default=None, help="JSON results of an earlier run to compare with.")
+    parser.add_argument("--tolerance", type=float, default=5.0, help="Drop in delivery rate or throughput against the baseline tolerated, in percent.")
+    return parser
+
+def main() -> int:
+    logging.basicConfig(level=logging.INFO, format="%(levelname)s : %(message)s")
+    args = get_argument_parser().parse_args()
+
+    results = asyncio.run(run_benchmark(args))
+    if args.csv is not None:
+        write_csv(args.csv, results)
+    if args.json is not None:
+        write_json(args.json, results)
+    if not results:
+        print("No results received.")
+        return 1
+    if args.baseline is not None:
+        with open(args.baseline) as baseline_file:
+            regressions = compare_with_baseline(results, json.load(baseline_file), args.tolerance)
+        for regression in regressions:
+            print(regression)
+        if regressions:
+            return 1
+        print("No regression against the baseline.")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,12 +1,11 @@
 # -*- coding: utf-8 -*-
 # Generated by the protocol buffer compiler.  DO NOT EDIT!
 # source: main.proto
-# Protobuf Python Version: 4.25.2
 """Generated protocol buffer code."""
+from google.protobuf.internal import builder as _builder
 from google.protobuf import descriptor as _descriptor
 from google.protobuf import descriptor_pool as _descriptor_pool
 from google.protobuf import symbol_database as _symbol_database
-from google.protobuf.internal import builder as _builder
 # @@protoc_insertion_point(imports)
 
 _sym_db = _symbol_database.Default()
@@ -15,29 +14,85 @@ _sym_db = _symbol_database.Default()
 import nanopb_pb2 as nanopb__pb2
 
 
-DESCRIPTOR = _descriptor_pool.Default().AddSerializedFile(b'\n\nmain.proto\x1a\x0cnanopb.proto\"4\n\x19SetPeriodicSamplerMessage\x12\x17\n\x0fsampling_period\x18\x01 \x02(\x05\"3\n\x1aStopPeriodicSamplerMessage\x12\x15\n\rstop_sampling\x18\x01 \x02(\x08\"?\n\x1b\x45xecuteOneOffSamplerMessage\x12 \n\x18\x65xecute_one_off_sampling\x18\x01 \x02(\x08\"\xef\x01\n\x13HostToDeviceMessage\x12>\n\x18set_periodic_sampler_msg\x18\x01 \x01(\x0b\x32\x1a.SetPeriodicSamplerMessageH\x00\x12@\n\x19stop_periodic_sampler_msg\x18\x02 \x01(\x0b\x32\x1b.StopPeriodicSamplerMessageH\x00\x12\x43\n\x1b\x65xecute_one_off_sampler_msg\x18\x03 \x01(\x0b\x32\x1c.ExecuteOneOffSamplerMessageH\x00:\x06\x92?\x03\xb0\x01\x01\x42\t\n\x07payload\"+\n\x1c\x41\x63kSetPeriodicSamplerMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\",\n\x1d\x41\x63kStopPeriodicSamplerMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\"\xca\x01\n\x18OneOffSamplerDataMessage\x12\x14\n\x0csensor_val_0\x18\x01 \x02(\x05\x12\x14\n\x0csensor_val_1\x18\x02 \x02(\x05\x12\x14\n\x0csensor_val_2\x18\x03 \x02(\x05\x12\x14\n\x0csensor_val_3\x18\x04 \x02(\x05\x12\x14\n\x0csensor_val_4\x18\x05 \x02(\x05\x12\x14\n\x0csensor_val_5\x18\x06 \x02(\x05\x12\x14\n\x0csensor_val_6\x18\x07 \x02(\x05\x12\x14\n\x0csensor_val_7\x18\x08 \x02(\x05\"\xef\x01\n\x13\x44\x65viceToHostMessage\x12G\n\x1d\x61\x63k_stop_periodic_sampler_msg\x18\x01 \x01(\x0b\x32\x1e.AckStopPeriodicSamplerMessageH\x00\x12\x45\n\x1c\x61\x63k_set_periodic_sampler_msg\x18\x02 \x01(\x0b\x32\x1d.AckSetPeriodicSamplerMessageH\x00\x12=\n\x18one_off_sampler_data_msg\x18\x03 \x01(\x0b\x32\x19.OneOffSamplerDataMessageH\x00\x42\t\n\x07payload')
+DESCRIPTOR = _descriptor_pool.Default().AddSerializedFile(b'\n\nmain.proto\x1a\x0cnanopb.proto\"\x96\x03\n\x19SetPeriodicSamplerMessage\x12\x17\n\x0fsampling_period\x18\x01 \x02(\x05\x12<\n\x0esampling_clock\x18\x02 \x01(\x0e\x32\x0e.SamplingClock:\x14SAMPLING_CLOCK_TIMER\x12\x1b\n\x10\x66rames_per_block\x18\x03 \x01(\r:\x01\x31\x12\x36\n\x0c\x66rame_format\x18\x04 \x01(\x0e\x32\x0c.FrameFormat:\x12\x46RAME_FORMAT_INT32\x12\x17\n\x0c\x63hannel_mask\x18\x05 \x01(\r:\x01\x30\x12:\n\x0e\x64\x61ta_interface\x18\x06 \x01(\x0e\x32\x0e.DataInterface:\x12\x44\x41TA_INTERFACE_CDC\x12=\n\x0fstream_encoding\x18\x07 \x01(\x0e\x32\x0f.StreamEncoding:\x13STREAM_ENCODING_RAW\x12\x1b\n\x0ctest_pattern\x18\x08 \x01(\x08:\x05\x66\x61lse\x12\x1c\n\x11\x65gress_ring_depth\x18\t \x01(\r:\x01\x30\"3\n\x1aStopPeriodicSamplerMessage\x12\x15\n\rstop_sampling\x18\x01 \x02(\x08\"?\n\x1b\x45xecuteOneOffSamplerMessage\x12 \n\x18\x65xecute_one_off_sampling\x18\x01 \x02(\x08\"/\n\x13SetDecimatorMessage\x12\x18\n\x10output_period_us\x18\x01 \x02(\r\"\x9a\x01\n\x11SetCaptureMessage\x12 \n\x07trigger\x18\x01 \x02(\x0e\x32\x0f.CaptureTrigger\x12\x17\n\x0ftrigger_channel\x18\x02 \x02(\r\x12\x11\n\tthreshold\x18\x03 \x02(\x11\x12\x1a\n\x12pre_trigger_frames\x18\x04 \x02(\r\x12\x1b\n\x13post_trigger_frames\x18\x05 \x02(\r\"I\n\x1a\x45xecuteBurstCaptureMessage\x12\x15\n\rnum_of_frames\x18\x01 \x02(\r\x12\x14\n\x0c\x63hannel_mask\x18\x02 \x02(\r\")\n\x14SetAggregatorMessage\x12\x11\n\twindow_us\x18\x01 \x02(\r\"<\n\x12SetSpectrumMessage\x12\x10\n\x08\x66\x66t_size\x18\x01 \x02(\r\x12\x14\n\x0cnum_of_peaks\x18\x02 \x02(\r\"x\n\x17SetEventDetectorMessage\x12\x14\n\x0c\x63hannel_mask\x18\x01 \x02(\r\x12 \n\x08polarity\x18\x02 \x02(\x0e\x32\x0e.EventPolarity\x12\x11\n\tthreshold\x18\x03 \x02(\x11\x12\x12\n\nhysteresis\x18\x04 \x02(\r\"(\n\x0fGetStatsMessage\x12\x15\n\rinclude_tasks\x18\x01 \x02(\x08\"*\n\x14GetDeviceTimeMessage\x12\x12\n\nrequest_id\x18\x01 \x02(\r\"\x96\x05\n\x13HostToDeviceMessage\x12>\n\x18set_periodic_sampler_msg\x18\x01 \x01(\x0b\x32\x1a.SetPeriodicSamplerMessageH\x00\x12@\n\x19stop_periodic_sampler_msg\x18\x02 \x01(\x0b\x32\x1b.StopPeriodicSamplerMessageH\x00\x12\x43\n\x1b\x65xecute_one_off_sampler_msg\x18\x03 \x01(\x0b\x32\x1c.ExecuteOneOffSamplerMessageH\x00\x12\x31\n\x11set_decimator_msg\x18\x04 \x01(\x0b\x32\x14.SetDecimatorMessageH\x00\x12-\n\x0fset_capture_msg\x18\x05 \x01(\x0b\x32\x12.SetCaptureMessageH\x00\x12@\n\x19\x65xecute_burst_capture_msg\x18\x06 \x01(\x0b\x32\x1b.ExecuteBurstCaptureMessageH\x00\x12\x33\n\x12set_aggregator_msg\x18\x07 \x01(\x0b\x32\x15.SetAggregatorMessageH\x00\x12/\n\x10set_spectrum_msg\x18\x08 \x01(\x0b\x32\x13.SetSpectrumMessageH\x00\x12:\n\x16set_event_detector_msg\x18\t \x01(\x0b\x32\x18.SetEventDetectorMessageH\x00\x12)\n\rget_stats_msg\x18\n \x01(\x0b\x32\x10.GetStatsMessageH\x00\x12\x34\n\x13get_device_time_msg\x18\x0b \x01(\x0b\x32\x15.GetDeviceTimeMessageH\x00:\x06\x92?\x03\xb0\x01\x01\x42\t\n\x07payload\"+\n\x1c\x41\x63kSetPeriodicSamplerMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\"%\n\x16\x41\x63kSetDecimatorMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\"#\n\x14\x41\x63kSetCaptureMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\",\n\x1d\x41\x63kExecuteBurstCaptureMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\"&\n\x17\x41\x63kSetAggregatorMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\"$\n\x15\x41\x63kSetSpectrumMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\")\n\x1a\x41\x63kSetEventDetectorMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\",\n\x1d\x41\x63kStopPeriodicSamplerMessage\x12\x0b\n\x03\x61\x63k\x18\x01 \x02(\x08\"\xca\x01\n\x18OneOffSamplerDataMessage\x12\x14\n\x0csensor_val_0\x18\x01 \x02(\x05\x12\x14\n\x0csensor_val_1\x18\x02 \x02(\x05\x12\x14\n\x0csensor_val_2\x18\x03 \x02(\x05\x12\x14\n\x0csensor_val_3\x18\x04 \x02(\x05\x12\x14\n\x0csensor_val_4\x18\x05 \x02(\x05\x12\x14\n\x0csensor_val_5\x18\x06 \x02(\x05\x12\x14\n\x0csensor_val_6\x18\x07 \x02(\x05\x12\x14\n\x0csensor_val_7\x18\x08 \x02(\x05\"\xb2\x01\n\x12SampleBatchMessage\x12\x1a\n\x12start_timestamp_us\x18\x01 \x02(\r\x12\x1a\n\x12sampling_period_us\x18\x02 \x02(\r\x12\x14\n\x0c\x63hannel_mask\x18\x03 \x02(\r\x12\"\n\x0c\x66rame_format\x18\x04 \x02(\x0e\x32\x0c.FrameFormat\x12\x19\n\x11\x66irst_frame_index\x18\x05 \x02(\r\x12\x0f\n\x07samples\x18\x06 \x02(\x0c\"\xae\x01\n\x12\x43\x61ptureInfoMessage\x12\x1b\n\x13trigger_frame_index\x18\x01 \x02(\r\x12\x15\n\rnum_of_frames\x18\x02 \x02(\r\x12\x1c\n\x14trigger_timestamp_us\x18\x03 \x02(\r\x12\x1a\n\x12sampling_period_us\x18\x04 \x02(\r\x12\x15\n\rtrigger_value\x18\x05 \x02(\x11\x12\x13\n\x0b\x64uration_us\x18\x06 \x01(\r\"}\n\x10HistogramMessage\x12\x0e\n\x06origin\x18\x01 \x02(\r\x12\x11\n\tbin_width\x18\x02 \x02(\r\x12\r\n\x05\x63ount\x18\x03 \x02(\r\x12\x0b\n\x03min\x18\x04 \x02(\r\x12\x0b\n\x03max\x18\x05 \x02(\r\x12\x0b\n\x03sum\x18\x06 \x02(\x04\x12\x10\n\x04\x62ins\x18\x07 \x03(\rB\x02\x10\x01\"\x9b\x01\n\x10TaskStatsMessage\x12\x13\n\x04name\x18\x01 \x02(\tB\x05\x92?\x02\x08\x10\x12\x15\n\rcore_affinity\x18\x02 \x02(\r\x12\x10\n\x08priority\x18\x03 \x02(\r\x12\x13\n\x0brun_time_us\x18\x04 \x02(\x04\x12\x15\n\rload_permille\x18\x05 \x02(\r\x12\x1d\n\x15stack_high_water_mark\x18\x06 \x02(\r\"\x84\x05\n\x0cStatsMessage\x12\x11\n\tuptime_us\x18\x01 \x02(\x04\x12\x13\n\x0binterval_us\x18\x02 \x02(\r\x12\x1b\n\x13\x63ore0_load_permille\x18\x03 \x02(\r\x12\x1b\n\x13\x63ore1_load_permille\x18\x04 \x02(\r\x12\x17\n\x0f\x66ree_heap_bytes\x18\x05 \x02(\r\x12\x1b\n\x13min_free_heap_bytes\x18\x06 \x02(\r\x12\x10\n\x08sampling\x18\x07 \x02(\x08\x12\x1a\n\x12sampling_period_us\x18\x08 \x02(\r\x12\x16\n\x0e\x66rames_sampled\x18\t \x02(\r\x12\x16\n\x0e\x64ropped_frames\x18\n \x02(\r\x12\x1d\n\x15\x64ropped_output_frames\x18\x0b \x02(\r\x12\x14\n\x0clate_samples\x18\x0c \x02(\r\x12\x14\n\x0c\x61\x64\x63_overruns\x18\r \x02(\r\x12\x15\n\regress_stalls\x18\x0e \x02(\r\x12\x1d\n\x15\x65gress_partial_writes\x18\x0f \x02(\r\x12\x1e\n\x16\x65gress_ring_high_water\x18\x10 \x02(\r\x12\x18\n\x10\x65gress_ring_size\x18\x11 \x02(\r\x12!\n\x19\x64\x65\x63imator_ring_high_water\x18\x12 \x02(\r\x12\x1b\n\x13\x64\x65\x63imator_ring_size\x18\x13 \x02(\r\x12-\n\x12sample_interval_us\x18\x14 \x02(\x0b\x32\x11.HistogramMessage\x12\x32\n\x17sampler_isr_duration_us\x18\x15 \x02(\x0b\x32\x11.HistogramMessage\x12 \n\x05tasks\x18\x16 \x03(\x0b\x32\x11.TaskStatsMessage\"?\n\x11\x44\x65viceTimeMessage\x12\x12\n\nrequest_id\x18\x01 \x02(\r\x12\x16\n\x0e\x64\x65vice_time_us\x18\x02 \x02(\x04\"\x94\x06\n\x13\x44\x65viceToHostMessage\x12G\n\x1d\x61\x63k_stop_periodic_sampler_msg\x18\x01 \x01(\x0b\x32\x1e.AckStopPeriodicSamplerMessageH\x00\x12\x45\n\x1c\x61\x63k_set_periodic_sampler_msg\x18\x02 \x01(\x0b\x32\x1d.AckSetPeriodicSamplerMessageH\x00\x12=\n\x18one_off_sampler_data_msg\x18\x03 \x01(\x0b\x32\x19.OneOffSamplerDataMessageH\x00\x12/\n\x10sample_batch_msg\x18\x04 \x01(\x0b\x32\x13.SampleBatchMessageH\x00\x12\x38\n\x15\x61\x63k_set_decimator_msg\x18\x05 \x01(\x0b\x32\x17.AckSetDecimatorMessageH\x00\x12\x34\n\x13\x61\x63k_set_capture_msg\x18\x06 \x01(\x0b\x32\x15.AckSetCaptureMessageH\x00\x12/\n\x10\x63\x61pture_info_msg\x18\x07 \x01(\x0b\x32\x13.CaptureInfoMessageH\x00\x12G\n\x1d\x61\x63k_execute_burst_capture_msg\x18\x08 \x01(\x0b\x32\x1e.AckExecuteBurstCaptureMessageH\x00\x12:\n\x16\x61\x63k_set_aggregator_msg\x18\t \x01(\x0b\x32\x18.AckSetAggregatorMessageH\x00\x12\x36\n\x14\x61\x63k_set_spectrum_msg\x18\n \x01(\x0b\x32\x16.AckSetSpectrumMessageH\x00\x12\x41\n\x1a\x61\x63k_set_event_detector_msg\x18\x0b \x01(\x0b\x32\x1b.AckSetEventDetectorMessageH\x00\x12\"\n\tstats_msg\x18\x0c \x01(\x0b\x32\r.StatsMessageH\x00\x12-\n\x0f\x64\x65vice_time_msg\x18\r \x01(\x0b\x32\x12.DeviceTimeMessageH\x00\x42\t\n\x07payload*Y\n\rSamplingClock\x12\x18\n\x14SAMPLING_CLOCK_TIMER\x10\x00\x12\x16\n\x12SAMPLING_CLOCK_PWM\x10\x01\x12\x16\n\x12SAMPLING_CLOCK_PIO\x10\x02*D\n\x0b\x46rameFormat\x12\x16\n\x12\x46RAME_FORMAT_INT32\x10\x00\x12\x1d\n\x19\x46RAME_FORMAT_PACKED_INT16\x10\x01*B\n\rDataInterface\x12\x16\n\x12\x44\x41TA_INTERFACE_CDC\x10\x00\x12\x19\n\x15\x44\x41TA_INTERFACE_VENDOR\x10\x01*f\n\x0eStreamEncoding\x12\x17\n\x13STREAM_ENCODING_RAW\x10\x00\x12 \n\x1cSTREAM_ENCODING_SAMPLE_BATCH\x10\x01\x12\x19\n\x15STREAM_ENCODING_DELTA\x10\x02*~\n\x0e\x43\x61ptureTrigger\x12\x18\n\x14\x43\x41PTURE_TRIGGER_NONE\x10\x00\x12\x1a\n\x16\x43\x41PTURE_TRIGGER_RISING\x10\x01\x12\x1b\n\x17\x43\x41PTURE_TRIGGER_FALLING\x10\x02\x12\x19\n\x15\x43\x41PTURE_TRIGGER_SLOPE\x10\x03*y\n\rEventPolarity\x12\x17\n\x13\x45VENT_POLARITY_NONE\x10\x00\x12\x18\n\x14\x45VENT_POLARITY_ABOVE\x10\x01\x12\x18\n\x14\x45VENT_POLARITY_BELOW\x10\x02\x12\x1b\n\x17\x45VENT_POLARITY_ABSOLUTE\x10\x03')
 
-_globals = globals()
-_builder.BuildMessageAndEnumDescriptors(DESCRIPTOR, _globals)
-_builder.BuildTopDescriptorsAndMessages(DESCRIPTOR, 'main_pb2', _globals)
+_builder.BuildMessageAndEnumDescriptors(DESCRIPTOR, globals())
+_builder.BuildTopDescriptorsAndMessages(DESCRIPTOR, 'main_pb2', globals())
 if _descriptor._USE_C_DESCRIPTORS == False:
+
   DESCRIPTOR._options = None
-  _globals['_HOSTTODEVICEMESSAGE']._options = None
-  _globals['_HOSTTODEVICEMESSAGE']._serialized_options = b'\222?\003\260\001\001'
-  _globals['_SETPERIODICSAMPLERMESSAGE']._serialized_start=28
-  _globals['_SETPERIODICSAMPLERMESSAGE']._serialized_end=80
-  _globals['_STOPPERIODICSAMPLERMESSAGE']._serialized_start=82
-  _globals['_STOPPERIODICSAMPLERMESSAGE']._serialized_end=133
-  _globals['_EXECUTEONEOFFSAMPLERMESSAGE']._serialized_start=135
-  _globals['_EXECUTEONEOFFSAMPLERMESSAGE']._serialized_end=198
-  _globals['_HOSTTODEVICEMESSAGE']._serialized_start=201
-  _globals['_HOSTTODEVICEMESSAGE']._serialized_end=440
-  _globals['_ACKSETPERIODICSAMPLERMESSAGE']._serialized_start=442
-  _globals['_ACKSETPERIODICSAMPLERMESSAGE']._serialized_end=485
-  _globals['_ACKSTOPPERIODICSAMPLERMESSAGE']._serialized_start=487
-  _globals['_ACKSTOPPERIODICSAMPLERMESSAGE']._serialized_end=531
-  _globals['_ONEOFFSAMPLERDATAMESSAGE']._serialized_start=534
-  _globals['_ONEOFFSAMPLERDATAMESSAGE']._serialized_end=736
-  _globals['_DEVICETOHOSTMESSAGE']._serialized_start=739
-  _globals['_DEVICETOHOSTMESSAGE']._serialized_end=978
+  _HOSTTODEVICEMESSAGE._options = None
+  _HOSTTODEVICEMESSAGE._serialized_options = b'\222?\003\260\001\001'
+  _HISTOGRAMMESSAGE.fields_by_name['bins']._options = None
+  _HISTOGRAMMESSAGE.fields_by_name['bins']._serialized_options = b'\020\001'
+  _TASKSTATSMESSAGE.fields_by_name['name']._options = None
+  _TASKSTATSMESSAGE.fields_by_name['name']._serialized_options = b'\222?\002\010\020'
+  _SAMPLINGCLOCK._serialized_start=4499
+  _SAMPLINGCLOCK._serialized_end=4588
+  _FRAMEFORMAT._serialized_start=4590
+  _FRAMEFORMAT._serialized_end=4658
+  _DATAINTERFACE._serialized_start=4660
+  _DATAINTERFACE._serialized_end=4726
+  _STREAMENCODING._serialized_start=4728
+  _STREAMENCODING._serialized_end=4830
+  _CAPTURETRIGGER._serialized_start=4832
+  _CAPTURETRIGGER._serialized_end=4958
+  _EVENTPOLARITY._serialized_start=4960
+  _EVENTPOLARITY._serialized_end=5081
+  _SETPERIODICSAMPLERMESSAGE._serialized_start=29
+  _SETPERIODICSAMPLERMESSAGE._serialized_end=435
+  _STOPPERIODICSAMPLERMESSAGE._serialized_start=437
+  _STOPPERIODICSAMPLERMESSAGE._serialized_end=488
+  _EXECUTEONEOFFSAMPLERMESSAGE._serialized_start=490
+  _EXECUTEONEOFFSAMPLERMESSAGE._serialized_end=553
+  _SETDECIMATORMESSAGE._serialized_start=555
+  _SETDECIMATORMESSAGE._serialized_end=602
+  _SETCAPTUREMESSAGE._serialized_start=605
+  _SETCAPTUREMESSAGE._serialized_end=759
+  _EXECUTEBURSTCAPTUREMESSAGE._serialized_start=761
+  _EXECUTEBURSTCAPTUREMESSAGE._serialized_end=834
+  _SETAGGREGATORMESSAGE._serialized_start=836
+  _SETAGGREGATORMESSAGE._serialized_end=877
+  _SETSPECTRUMMESSAGE._serialized_start=879
+  _SETSPECTRUMMESSAGE._serialized_end=939
+  _SETEVENTDETECTORMESSAGE._serialized_start=941
+  _SETEVENTDETECTORMESSAGE._serialized_end=1061
+  _GETSTATSMESSAGE._serialized_start=1063
+  _GETSTATSMESSAGE._serialized_end=1103
+  _GETDEVICETIMEMESSAGE._serialized_start=1105
+  _GETDEVICETIMEMESSAGE._serialized_end=1147
+  _HOSTTODEVICEMESSAGE._serialized_start=1150
+  _HOSTTODEVICEMESSAGE._serialized_end=1812
+  _ACKSETPERIODICSAMPLERMESSAGE._serialized_start=1814
+  _ACKSETPERIODICSAMPLERMESSAGE._serialized_end=1857
+  _ACKSETDECIMATORMESSAGE._serialized_start=1859
+  _ACKSETDECIMATORMESSAGE._serialized_end=1896
+  _ACKSETCAPTUREMESSAGE._serialized_start=1898
+  _ACKSETCAPTUREMESSAGE._serialized_end=1933
+  _ACKEXECUTEBURSTCAPTUREMESSAGE._serialized_start=1935
+  _ACKEXECUTEBURSTCAPTUREMESSAGE._serialized_end=1979
+  _ACKSETAGGREGATORMESSAGE._serialized_start=1981
+  _ACKSETAGGREGATORMESSAGE._serialized_end=2019
+  _ACKSETSPECTRUMMESSAGE._serialized_start=2021
+  _ACKSETSPECTRUMMESSAGE._serialized_end=2057
+  _ACKSETEVENTDETECTORMESSAGE._serialized_start=2059
+  _ACKSETEVENTDETECTORMESSAGE._serialized_end=2100
+  _ACKSTOPPERIODICSAMPLERMESSAGE._serialized_start=2102
+  _ACKSTOPPERIODICSAMPLERMESSAGE._serialized_end=2146
+  _ONEOFFSAMPLERDATAMESSAGE._serialized_start=2149
+  _ONEOFFSAMPLERDATAMESSAGE._serialized_end=2351
+  _SAMPLEBATCHMESSAGE._serialized_start=2354
+  _SAMPLEBATCHMESSAGE._serialized_end=2532
+  _CAPTUREINFOMESSAGE._serialized_start=2535
+  _CAPTUREINFOMESSAGE._serialized_end=2709
+  _HISTOGRAMMESSAGE._serialized_start=2711
+  _HISTOGRAMMESSAGE._serialized_end=2836
+  _TASKSTATSMESSAGE._serialized_start=2839
+  _TASKSTATSMESSAGE._serialized_end=2994
+  _STATSMESSAGE._serialized_start=2997
+  _STATSMESSAGE._serialized_end=3641
+  _DEVICETIMEMESSAGE._serialized_start=3643
+  _DEVICETIMEMESSAGE._serialized_end=3706
+  _DEVICETOHOSTMESSAGE._serialized_start=3709
+  _DEVICETOHOSTMESSAGE._serialized_end=4497
 # @@protoc_insertion_point(module_scope)
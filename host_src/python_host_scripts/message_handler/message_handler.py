@@ -4,15 +4,43 @@ import main_pb2
 
 logger = logging.getLogger(__name__)
 
+# Maximum length of a host to device message, i.e. the size of recv_buf in cdc_ingress_task_c0()
+MAX_MSG_LENGTH = 256
+
+# Longest varint of a uint32
+MAX_VARINT_SIZE = 5
+
+# Encode an unsigned value as a protobuf varint, 7 bits per byte with the least significant group first
+def encode_varint(value: int) -> bytes:
+    encoded = bytearray()
+    while value > 0x7F:
+        encoded.append((value & 0x7F) | 0x80)
+        value >>= 7
+    encoded.append(value)
+    return bytes(encoded)
+
+# Decode the varint at the start of data, returns the value and the number of bytes it takes
+# or (None, 0) when data ends before the varint does
+def decode_varint(data) -> tuple:
+    value = 0
+    for i in range(min(len(data), MAX_VARINT_SIZE)):
+        value |= (data[i] & 0x7F) << (7 * i)
+        if not (data[i] & 0x80):
+            return value, i + 1
+    if len(data) >= MAX_VARINT_SIZE:
+        raise ValueError(f"Varint longer than {MAX_VARINT_SIZE} bytes.")
+    return None, 0
+
+# Messages are delimited with their length as a varint, the same as pb_encode_ex(..., PB_ENCODE_DELIMITED)
 def prepend_msg_length(serialised_msg: bytes) -> bytes:
     try:
         msg_length = len(serialised_msg)
-        if msg_length > 256:
-            raise ValueError(f"msg_length = {msg_length} which can't be stored as a byte. Please reduce the message size.")
+        if msg_length > MAX_MSG_LENGTH:
+            raise ValueError(f"msg_length = {msg_length} which is longer than the device can receive ({MAX_MSG_LENGTH} bytes). Please reduce the message size.")
 
         logger.debug(f"Length of serialised_msg = {msg_length}")
-        logger.debug(f"Length of serialised_msg in bytes = {msg_length.to_bytes()} bytes")
-        return msg_length.to_bytes() + serialised_msg
+        logger.debug(f"Length of serialised_msg in bytes = {encode_varint(msg_length)} bytes")
+        return encode_varint(msg_length) + serialised_msg
 
     except ValueError as e:
         logger.exception("ValueError occurred.")
@@ -20,17 +48,235 @@ def prepend_msg_length(serialised_msg: bytes) -> bytes:
     except Exception as e:
         logger.exception("Exception occurred.")
 
-def prepare_set_periodic_sampler_msg(sampling_period: int) -> main_pb2.HostToDeviceMessage:
+SAMPLING_CLOCKS = {
+    "timer": main_pb2.SAMPLING_CLOCK_TIMER,
+    "pwm": main_pb2.SAMPLING_CLOCK_PWM,
+    "pio": main_pb2.SAMPLING_CLOCK_PIO,
+}
+
+FRAME_FORMATS = {
+    "int32": main_pb2.FRAME_FORMAT_INT32,
+    "packed16": main_pb2.FRAME_FORMAT_PACKED_INT16,
+}
+
+DATA_INTERFACES = {
+    "cdc": main_pb2.DATA_INTERFACE_CDC,
+    "vendor": main_pb2.DATA_INTERFACE_VENDOR,
+}
+
+STREAM_ENCODINGS = {
+    "raw": main_pb2.STREAM_ENCODING_RAW,
+    "sample_batch": main_pb2.STREAM_ENCODING_SAMPLE_BATCH,
+    "delta": main_pb2.STREAM_ENCODING_DELTA,
+}
+
+# Maximum number of frames the device batches into a block
+MAX_FRAMES_PER_BLOCK = 256
+
+# Minimum sampling period when streaming, and when capturing into device memory, which doesn't depend on the USB throughput
+MIN_SAMPLING_PERIOD = 20
+MIN_CAPTURE_SAMPLING_PERIOD = 2
+
+def prepare_set_periodic_sampler_msg(sampling_period: int, sampling_clock: str = "timer", frames_per_block: int = 1, frame_format: str = "int32", channel_mask: int = 0, data_interface: str = "cdc", stream_encoding: str = "raw", capture: bool = False, test_pattern: bool = False, egress_ring_depth: int = 0) -> main_pb2.HostToDeviceMessage:
     try:
+        min_sampling_period = MIN_CAPTURE_SAMPLING_PERIOD if capture else MIN_SAMPLING_PERIOD
         if (sampling_period < 0):
             logger.error(f"Sampling period can't be a negative value.")
             raise ValueError("Sampling period can't be a negative value.")
-        elif (sampling_period < 20):
-            logger.error(f"The minimum sampling period is 20 micro-seconds. Please use a bigger value.")
-            raise Exception("The minimum sampling period is 20 micro-seconds. Please use a bigger value.")
-        logger.debug(f"Preparing set_periodic_sampler_msg with sampling_period = {sampling_period} micro-seconds.")
+        elif (sampling_period < min_sampling_period):
+            logger.error(f"The minimum sampling period is {min_sampling_period} micro-seconds. Please use a bigger value.")
+            raise Exception(f"The minimum sampling period is {min_sampling_period} micro-seconds. Please use a bigger value.")
+        if sampling_clock not in SAMPLING_CLOCKS:
+            logger.error(f"Unknown sampling clock '{sampling_clock}'.")
+            raise ValueError(f"Unknown sampling clock '{sampling_clock}'. Valid values : {list(SAMPLING_CLOCKS)}.")
+        if not (1 <= frames_per_block <= MAX_FRAMES_PER_BLOCK):
+            logger.error(f"frames_per_block has to be between 1 and {MAX_FRAMES_PER_BLOCK}.")
+            raise ValueError(f"frames_per_block has to be between 1 and {MAX_FRAMES_PER_BLOCK}.")
+        if frame_format not in FRAME_FORMATS:
+            logger.error(f"Unknown frame format '{frame_format}'.")
+            raise ValueError(f"Unknown frame format '{frame_format}'. Valid values : {list(FRAME_FORMATS)}.")
+        if not (0 <= channel_mask <= 0xFF):
+            logger.error(f"channel_mask has to fit into 8 bits.")
+            raise ValueError(f"channel_mask has to fit into 8 bits.")
+        if frame_format == "packed16" and channel_mask == 0 and not test_pattern:
+            logger.error(f"The 'packed16' frame format needs an explicit channel_mask.")
+            raise ValueError(f"The 'packed16' frame format needs an explicit channel_mask.")
+        if data_interface not in DATA_INTERFACES:
+            logger.error(f"Unknown data interface '{data_interface}'.")
+            raise ValueError(f"Unknown data interface '{data_interface}'. Valid values : {list(DATA_INTERFACES)}.")
+        if stream_encoding not in STREAM_ENCODINGS:
+            logger.error(f"Unknown stream encoding '{stream_encoding}'.")
+            raise ValueError(f"Unknown stream encoding '{stream_encoding}'. Valid values : {list(STREAM_ENCODINGS)}.")
+        if egress_ring_depth < 0:
+            logger.error(f"egress_ring_depth can't be a negative value.")
+            raise ValueError("egress_ring_depth can't be a negative value.")
+        logger.debug(f"Preparing set_periodic_sampler_msg with data_interface = '{data_interface}' and stream_encoding = '{stream_encoding}'.")
+        logger.debug(f"Preparing set_periodic_sampler_msg with sampling_period = {sampling_period} micro-seconds, sampling_clock = '{sampling_clock}', frames_per_block = {frames_per_block}, frame_format = '{frame_format}' and channel_mask = {channel_mask:#04x}.")
         msg = main_pb2.HostToDeviceMessage()
         msg.set_periodic_sampler_msg.sampling_period = sampling_period
+        msg.set_periodic_sampler_msg.sampling_clock = SAMPLING_CLOCKS[sampling_clock]
+        msg.set_periodic_sampler_msg.frames_per_block = frames_per_block
+        msg.set_periodic_sampler_msg.frame_format = FRAME_FORMATS[frame_format]
+        msg.set_periodic_sampler_msg.channel_mask = channel_mask
+        msg.set_periodic_sampler_msg.data_interface = DATA_INTERFACES[data_interface]
+        msg.set_periodic_sampler_msg.stream_encoding = STREAM_ENCODINGS[stream_encoding]
+        if test_pattern:
+            msg.set_periodic_sampler_msg.test_pattern = True
+        if egress_ring_depth > 0:
+            msg.set_periodic_sampler_msg.egress_ring_depth = egress_ring_depth
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except ValueError as e:
+        logger.exception("ValueError occurred.")
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
+# Largest ratio between the output period and the sampling period the device decimates by
+MAX_DECIMATION_RATIO = 256
+
+def prepare_set_decimator_msg(output_period: int) -> main_pb2.HostToDeviceMessage:
+    try:
+        if (output_period < 0):
+            logger.error(f"Output period can't be a negative value.")
+            raise ValueError("Output period can't be a negative value.")
+        logger.debug(f"Preparing set_decimator_msg with output_period = {output_period} micro-seconds.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.set_decimator_msg.output_period_us = output_period
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except ValueError as e:
+        logger.exception("ValueError occurred.")
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
+CAPTURE_TRIGGERS = {
+    "none": main_pb2.CAPTURE_TRIGGER_NONE,
+    "rising": main_pb2.CAPTURE_TRIGGER_RISING,
+    "falling": main_pb2.CAPTURE_TRIGGER_FALLING,
+    "slope": main_pb2.CAPTURE_TRIGGER_SLOPE,
+}
+
+def prepare_set_capture_msg(trigger: str, trigger_channel: int = 0, threshold: int = 0, pre_trigger_frames: int = 0, post_trigger_frames: int = 1) -> main_pb2.HostToDeviceMessage:
+    try:
+        if trigger not in CAPTURE_TRIGGERS:
+            logger.error(f"Unknown capture trigger '{trigger}'.")
+            raise ValueError(f"Unknown capture trigger '{trigger}'. Valid values : {list(CAPTURE_TRIGGERS)}.")
+        if not (0 <= trigger_channel < 8):
+            logger.error(f"trigger_channel has to be between 0 and 7.")
+            raise ValueError(f"trigger_channel has to be between 0 and 7.")
+        if pre_trigger_frames < 0 or post_trigger_frames < 1:
+            logger.error(f"The capture needs at least one post-trigger frame and no negative number of pre-trigger frames.")
+            raise ValueError(f"The capture needs at least one post-trigger frame and no negative number of pre-trigger frames.")
+        logger.debug(f"Preparing set_capture_msg with trigger = '{trigger}' on value {trigger_channel}, threshold = {threshold}, {pre_trigger_frames} pre-trigger and {post_trigger_frames} post-trigger frames.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.set_capture_msg.trigger = CAPTURE_TRIGGERS[trigger]
+        msg.set_capture_msg.trigger_channel = trigger_channel
+        msg.set_capture_msg.threshold = threshold
+        msg.set_capture_msg.pre_trigger_frames = pre_trigger_frames
+        msg.set_capture_msg.post_trigger_frames = post_trigger_frames
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except ValueError as e:
+        logger.exception("ValueError occurred.")
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
+def prepare_execute_burst_capture_msg(num_of_frames: int, channel_mask: int = 0) -> main_pb2.HostToDeviceMessage:
+    try:
+        if num_of_frames < 1:
+            logger.error(f"A burst capture needs at least one frame.")
+            raise ValueError(f"A burst capture needs at least one frame.")
+        if not (0 <= channel_mask <= 0xFF):
+            logger.error(f"channel_mask has to fit into 8 bits.")
+            raise ValueError(f"channel_mask has to fit into 8 bits.")
+        logger.debug(f"Preparing execute_burst_capture_msg with num_of_frames = {num_of_frames} and channel_mask = {channel_mask:#04x}.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.execute_burst_capture_msg.num_of_frames = num_of_frames
+        msg.execute_burst_capture_msg.channel_mask = channel_mask
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except ValueError as e:
+        logger.exception("ValueError occurred.")
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
+def prepare_set_aggregator_msg(window: int) -> main_pb2.HostToDeviceMessage:
+    try:
+        if (window < 0):
+            logger.error(f"Window length can't be a negative value.")
+            raise ValueError("Window length can't be a negative value.")
+        logger.debug(f"Preparing set_aggregator_msg with window = {window} micro-seconds.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.set_aggregator_msg.window_us = window
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except ValueError as e:
+        logger.exception("ValueError occurred.")
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
+# FFT sizes and number of peaks per record the device supports, see device_src/lib/spectrum/spectrum.h
+SPECTRUM_FFT_SIZES = [16, 32, 64, 128, 256, 512]
+MAX_SPECTRUM_PEAKS = 32
+
+def prepare_set_spectrum_msg(fft_size: int, num_of_peaks: int = 0) -> main_pb2.HostToDeviceMessage:
+    try:
+        if (fft_size != 0 and fft_size not in SPECTRUM_FFT_SIZES):
+            logger.error(f"Invalid FFT size {fft_size}.")
+            raise ValueError(f"Invalid FFT size {fft_size}. Valid values : 0 or {SPECTRUM_FFT_SIZES}.")
+        if (num_of_peaks < 0 or num_of_peaks > MAX_SPECTRUM_PEAKS):
+            logger.error(f"Number of peaks {num_of_peaks} out of range.")
+            raise ValueError(f"Number of peaks must be from 0 to {MAX_SPECTRUM_PEAKS}.")
+        logger.debug(f"Preparing set_spectrum_msg with fft_size = {fft_size} and num_of_peaks = {num_of_peaks}.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.set_spectrum_msg.fft_size = fft_size
+        msg.set_spectrum_msg.num_of_peaks = num_of_peaks
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except ValueError as e:
+        logger.exception("ValueError occurred.")
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
+EVENT_POLARITIES = {
+    "none": main_pb2.EVENT_POLARITY_NONE,
+    "above": main_pb2.EVENT_POLARITY_ABOVE,
+    "below": main_pb2.EVENT_POLARITY_BELOW,
+    "absolute": main_pb2.EVENT_POLARITY_ABSOLUTE,
+}
+
+def prepare_set_event_detector_msg(channel_mask: int, polarity: str, threshold: int = 0, hysteresis: int = 0) -> main_pb2.HostToDeviceMessage:
+    try:
+        if polarity not in EVENT_POLARITIES:
+            logger.error(f"Unknown event polarity '{polarity}'.")
+            raise ValueError(f"Unknown event polarity '{polarity}'. Valid values : {list(EVENT_POLARITIES)}.")
+        if not (0 <= channel_mask <= 0xFF):
+            logger.error(f"channel_mask has to fit into 8 bits.")
+            raise ValueError(f"channel_mask has to fit into 8 bits.")
+        if hysteresis < 0:
+            logger.error(f"Hysteresis can't be a negative value.")
+            raise ValueError("Hysteresis can't be a negative value.")
+        if polarity == "absolute" and threshold < 0:
+            logger.error(f"The threshold of the 'absolute' polarity can't be a negative value.")
+            raise ValueError("The threshold of the 'absolute' polarity can't be a negative value.")
+        logger.debug(f"Preparing set_event_detector_msg with channel_mask = {channel_mask:#04x}, polarity = '{polarity}', threshold = {threshold} and hysteresis = {hysteresis}.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.set_event_detector_msg.channel_mask = channel_mask
+        msg.set_event_detector_msg.polarity = EVENT_POLARITIES[polarity]
+        msg.set_event_detector_msg.threshold = threshold
+        msg.set_event_detector_msg.hysteresis = hysteresis
         msg = prepend_msg_length(msg.SerializeToString())
         return msg
 
@@ -40,6 +286,28 @@ def prepare_set_periodic_sampler_msg(sampling_period: int) -> main_pb2.HostToDev
     except Exception as e:
         logger.exception("Exception occurred.")
 
+def prepare_get_stats_msg(include_tasks: bool = False) -> main_pb2.HostToDeviceMessage:
+    try:
+        logger.debug(f"Preparing get_stats_msg with include_tasks = {include_tasks}.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.get_stats_msg.include_tasks = include_tasks
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
+def prepare_get_device_time_msg(request_id: int) -> main_pb2.HostToDeviceMessage:
+    try:
+        logger.debug(f"Preparing get_device_time_msg with request_id = {request_id}.")
+        msg = main_pb2.HostToDeviceMessage()
+        msg.get_device_time_msg.request_id = request_id
+        msg = prepend_msg_length(msg.SerializeToString())
+        return msg
+
+    except Exception as e:
+        logger.exception("Exception occurred.")
+
 def prepare_stop_periodic_sampler_msg() -> main_pb2.HostToDeviceMessage:
     try:
         logger.debug(f"Preparing stop_periodic_sampler_msg.")
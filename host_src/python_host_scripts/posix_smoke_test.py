@@ -0,0 +1,212 @@
+"""Smoke test of the host-native build of device_main, see device_src/posix
+
+Runs a short session over the pseudo-terminals of device_main_posix : a device time request, a one-off sampling,
+then a few seconds of periodic sampling of the test pattern, which has to arrive on the data port in order and
+intact up to its end of stream frame, the stop, a second of int32 frames of the simulated ADC, whose bipolar
+sine has to come out signed, a second of the test pattern on the vendor interface, whose end of stream frame is
+a short tail the firmware has to flush, and a stats query. device_src/posix/smoke_test.sh builds the
+firmware, starts it and runs this script, e.g.
+    python posix_smoke_test.py /tmp/das_control /tmp/das_data
+The script exits with 1 as soon as a step fails.
+"""
+import argparse
+import asyncio
+import logging
+import sys
+
+import numpy as np
+import serial_asyncio
+
+import main_pb2
+from message_handler.message_handler import decode_varint, prepare_get_device_time_msg, prepare_execute_one_off_sampler_msg, prepare_set_periodic_sampler_msg, prepare_stop_periodic_sampler_msg, prepare_get_stats_msg
+from communications.stream_frame import StreamFrameParser, STREAM_FRAME_TYPE_DATA, STREAM_FRAME_TYPE_EOS
+from communications.test_pattern import TestPatternVerifier
+
+logger = logging.getLogger(__name__)
+
+# Time the device has to answer a message, the POSIX port runs the tasks on a single core, a tick at a time
+REPLY_TIMEOUT_S = 2.0
+
+# Time from the stop to the end of stream frame, as the device sends the rest of the stream first
+EOS_TIMEOUT_S = 5.0
+
+# The sampler runs in a task which wakes every tick on the POSIX port, so a period of a tick or more
+SAMPLING_PERIOD_US = 1000
+FRAMES_PER_BLOCK = 16
+
+# Frames of the test pattern are eight int32 values
+FRAME_VALUES = 8
+
+# Amplitude in codes of the sine on channel 0 of the simulated ADC, smoke_test.sh sets it in DAS_ADC_WAVEFORMS
+ADC_SINE_AMPLITUDE = 20000
+ADC_DURATION_S = 1.0
+
+VENDOR_DURATION_S = 1.0
+
+# Receives a stream on the data port, up to its end of stream frame, the test pattern goes through the verifier
+# and any other int32 frames are kept
+class SmokeStreamProtocol(asyncio.Protocol):
+    def __init__(self):
+        self.transport = None
+        self.stream_parser = StreamFrameParser(self._stream_frame_received)
+        self.start_stream(test_pattern=True)
+
+    def start_stream(self, test_pattern: bool) -> None:
+        self.verifier = TestPatternVerifier() if test_pattern else None
+        self.frames = []
+        self.unexpected_frames = 0
+        self.eos_received = asyncio.Event()
+
+    def connection_made(self, transport):
+        self.transport = transport
+        logger.debug("Data port connected.")
+
+    def connection_lost(self, exc):
+        logger.debug("Data port disconnected.")
+
+    def data_received(self, data):
+        self.stream_parser.feed(data)
+
+    def _stream_frame_received(self, frame_type: int, sequence: int, timestamp_us: int, payload: memoryview) -> None:
+        if frame_type == STREAM_FRAME_TYPE_DATA and len(payload) % (4 * FRAME_VALUES) == 0:
+            frames = np.frombuffer(bytes(payload), dtype="<i4").reshape(-1, FRAME_VALUES)
+            if self.verifier is not None:
+                self.verifier.check(frames)
+            else:
+                self.frames.append(frames)
+        elif frame_type == STREAM_FRAME_TYPE_EOS:
+            # The sequence of the EOS frame is the number of frames produced
+            if self.verifier is not None:
+                self.verifier.finish(sequence)
+            self.eos_received.set()
+        else:
+            logger.warning(f"Unexpected stream frame of type {frame_type} and {len(payload)} bytes.")
+            self.unexpected_frames += 1
+
+# Decodes the messages of the control port, delimited with their length as a varint
+class SmokeControlProtocol(asyncio.Protocol):
+    def __init__(self):
+        self.transport = None
+        self.buffer = bytearray()
+        self.messages = asyncio.Queue()
+
+    def connection_made(self, transport):
+        self.transport = transport
+        logger.debug("Control port connected.")
+
+    def connection_lost(self, exc):
+        logger.debug("Control port disconnected.")
+
+    def data_received(self, data):
+        self.buffer.extend(data)
+        while True:
+            msg_length, varint_size = decode_varint(self.buffer)
+            if msg_length is None or len(self.buffer) < varint_size + msg_length:
+                return
+            msg = main_pb2.DeviceToHostMessage()
+            try:
+                msg.ParseFromString(bytes(self.buffer[varint_size:varint_size + msg_length]))
+                self.messages.put_nowait(msg)
+            except Exception:
+                logger.exception("Failed to decode a DeviceToHostMessage.")
+            del self.buffer[:varint_size + msg_length]
+
+    # Wait for the next message, which has to carry the given payload
+    async def expect(self, payload: str, timeout: float = REPLY_TIMEOUT_S):
+        try:
+            msg = await asyncio.wait_for(self.messages.get(), timeout)
+        except asyncio.TimeoutError:
+            raise AssertionError(f"No '{payload}' within {timeout:.1f} s.")
+        if msg.WhichOneof("payload") != payload:
+            raise AssertionError(f"Expected '{payload}', received '{msg.WhichOneof('payload')}'.")
+        return getattr(msg, payload)
+
+# Stop the periodic sampler and wait for the end of the stream and the ack, which comes once the EOS frame is out
+async def stop_stream(control: SmokeControlProtocol, control_transport, data: SmokeStreamProtocol) -> None:
+    control_transport.write(prepare_stop_periodic_sampler_msg())
+    try:
+        await asyncio.wait_for(data.eos_received.wait(), EOS_TIMEOUT_S)
+    except asyncio.TimeoutError:
+        raise AssertionError(f"No end of stream frame within {EOS_TIMEOUT_S:.1f} s of the stop.")
+    ack = await control.expect("ack_stop_periodic_sampler_msg", EOS_TIMEOUT_S)
+    assert ack.ack, "Stop periodic sampler message rejected."
+    assert data.unexpected_frames == 0, f"{data.unexpected_frames} unexpected stream frames."
+
+async def run_smoke_test(args: argparse.Namespace) -> None:
+    loop = asyncio.get_running_loop()
+    control_transport, control = await serial_asyncio.create_serial_connection(loop, SmokeControlProtocol, args.port, baudrate=115200)
+    data_transport, data = await serial_asyncio.create_serial_connection(loop, SmokeStreamProtocol, args.data_port, baudrate=115200)
+    try:
+        control_transport.write(prepare_get_device_time_msg(request_id=7))
+        device_time = await control.expect("device_time_msg")
+        assert device_time.request_id == 7, f"Device time reply to request {device_time.request_id} instead of 7."
+        print(f"Device time : {device_time.device_time_us} us")
+
+        control_transport.write(prepare_execute_one_off_sampler_msg())
+        await control.expect("one_off_sampler_data_msg")
+        print("One-off sampling : done")
+
+        control_transport.write(prepare_set_periodic_sampler_msg(sampling_period=SAMPLING_PERIOD_US, frames_per_block=FRAMES_PER_BLOCK, test_pattern=True))
+        ack = await control.expect("ack_set_periodic_sampler_msg")
+        assert ack.ack, "Set periodic sampler message rejected."
+        await asyncio.sleep(args.duration_s)
+
+        await stop_stream(control, control_transport, data)
+        print(data.verifier.summary())
+        assert data.verifier.passed(), "The test pattern didn't arrive intact."
+        # A block every FRAMES_PER_BLOCK periods, allowing for the timing of the POSIX port
+        min_frames = int(args.duration_s * 1e6 / SAMPLING_PERIOD_US) // 4
+        assert data.verifier.received >= min_frames, f"{data.verifier.received} frames in {args.duration_s} s, expected at least {min_frames}."
+
+        # The two's complement codes of the ADC come out sign extended in int32 frames, a negative code read as
+        # unsigned would be above the amplitude
+        data.start_stream(test_pattern=False)
+        control_transport.write(prepare_set_periodic_sampler_msg(sampling_period=SAMPLING_PERIOD_US, frames_per_block=FRAMES_PER_BLOCK, frame_format="int32", channel_mask=0x01))
+        ack = await control.expect("ack_set_periodic_sampler_msg")
+        assert ack.ack, "Set periodic sampler message rejected."
+        await asyncio.sleep(ADC_DURATION_S)
+        await stop_stream(control, control_transport, data)
+        assert data.frames, "No ADC frames."
+        values = np.concatenate(data.frames)[:, 0]
+        print(f"ADC channel 0 : {len(values)} values from {values.min()} to {values.max()}")
+        assert values.min() < 0 < values.max(), "The ADC sine isn't bipolar in the int32 frames."
+        assert np.abs(values).max() <= ADC_SINE_AMPLITUDE, f"ADC value beyond the amplitude of {ADC_SINE_AMPLITUDE}, a code isn't sign extended."
+
+        # The vendor interface goes out through the data port in the host-native build, its end of stream frame
+        # is shorter than a packet, so it only arrives if the firmware flushes it
+        data.start_stream(test_pattern=True)
+        control_transport.write(prepare_set_periodic_sampler_msg(sampling_period=SAMPLING_PERIOD_US, frames_per_block=FRAMES_PER_BLOCK, data_interface="vendor", test_pattern=True))
+        ack = await control.expect("ack_set_periodic_sampler_msg")
+        assert ack.ack, "Set periodic sampler message rejected."
+        await asyncio.sleep(VENDOR_DURATION_S)
+        await stop_stream(control, control_transport, data)
+        print(f"Vendor interface : {data.verifier.summary()}")
+        assert data.verifier.passed(), "The test pattern didn't arrive intact on the vendor interface."
+
+        control_transport.write(prepare_get_stats_msg())
+        stats = await control.expect("stats_msg")
+        print(f"Stats : received, over {stats.interval_us} us")
+    finally:
+        control_transport.close()
+        data_transport.close()
+
+def get_argument_parser() -> argparse.ArgumentParser:
+    parser = argparse.ArgumentParser(description="Smoke test of device_main_posix over its pseudo-terminals, see device_src/posix.")
+    parser.add_argument("port", type=str, help="Control port of device_main_posix, '/tmp/das_control' unless it has been moved.")
+    parser.add_argument("data_port", type=str, help="Data port of device_main_posix, '/tmp/das_data' unless it has been moved.")
+    parser.add_argument("--duration_s", type=float, default=3.0, help="Time the test pattern is streamed for.")
+    return parser
+
+def main() -> int:
+    logging.basicConfig(level=logging.INFO, format="%(levelname)s : %(message)s")
+    args = get_argument_parser().parse_args()
+    try:
+        asyncio.run(run_smoke_test(args))
+    except AssertionError as e:
+        print(f"Smoke test FAILED : {e}")
+        return 1
+    print("Smoke test passed.")
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
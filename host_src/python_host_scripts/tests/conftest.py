@@ -0,0 +1,5 @@
+import os
+import sys
+
+# The host scripts import their modules from python_host_scripts, as when started with 'python main.py'
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
@@ -0,0 +1,89 @@
+import numpy as np
+import pytest
+import main_pb2
+from communications.protocol import IngressProtocol
+from communications.stream_frame import encode_stream_frame, STREAM_FRAME_TYPE_DATA, STREAM_FRAME_TYPE_MESSAGE, STREAM_FRAME_TYPE_EOS
+
+# IngressProtocol which keeps the blocks of frames instead of printing them
+class RecordingProtocol(IngressProtocol):
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.blocks = []
+
+    def _samples_received(self, frames, channels, timestamp_us):
+        self.blocks.append((frames.copy(), list(channels), timestamp_us))
+
+# Size of the sample blocks of the device, SAMPLE_BLOCK_MAX_BYTES
+SAMPLE_BLOCK_MAX_BYTES = 1024
+
+# The stream upload_capture() sends on the data port : the CaptureInfoMessage in-band, the window as data frames
+# numbered from 0 in full blocks, whose timestamps are worked out from the trigger frame, then EOS
+def capture_stream(window: np.ndarray, info) -> bytes:
+    frames_per_block = SAMPLE_BLOCK_MAX_BYTES // window[0].nbytes
+    msg = main_pb2.DeviceToHostMessage()
+    msg.capture_info_msg.CopyFrom(info)
+    stream = encode_stream_frame(STREAM_FRAME_TYPE_MESSAGE, 0, info.trigger_timestamp_us, msg.SerializeToString())
+    for first in range(0, len(window), frames_per_block):
+        timestamp_us = (info.trigger_timestamp_us + (first - info.trigger_frame_index) * info.sampling_period_us) & 0xFFFFFFFF
+        block = window[first:first + frames_per_block]
+        stream += encode_stream_frame(STREAM_FRAME_TYPE_DATA, first, timestamp_us, block.tobytes())
+    return stream + encode_stream_frame(STREAM_FRAME_TYPE_EOS, len(window), 0)
+
+@pytest.mark.parametrize("trigger_timestamp_us", [5_000_000, 100])
+def test_triggered_capture(trigger_timestamp_us):
+    # A rising edge on channel 2 of int32 frames, 300 frames before it and 200 from it on
+    pre, post, period = 300, 200, 5
+    window = np.zeros((pre + post, 8), dtype="<i4")
+    window[:, 0] = np.arange(pre + post)
+    window[pre:, 2] = 20000
+    info = main_pb2.CaptureInfoMessage(trigger_frame_index=pre, num_of_frames=pre + post,
+                                       trigger_timestamp_us=trigger_timestamp_us, sampling_period_us=period,
+                                       trigger_value=20000)
+    protocol = RecordingProtocol(stream_only=True)
+    protocol.data_received(capture_stream(window, info))
+
+    assert protocol.capture_info == info
+    assert not protocol.capture_info.HasField("duration_us")
+    frames = np.concatenate([block[0] for block in protocol.blocks])
+    assert np.array_equal(frames, window)
+    assert frames[protocol.capture_info.trigger_frame_index, 2] == protocol.capture_info.trigger_value
+    # The frames ahead of the trigger are timestamped before it, modulo 2^32 like the device time
+    assert len(protocol.blocks) == 16
+    assert protocol.blocks[0][2] == (trigger_timestamp_us - pre * period) & 0xFFFFFFFF
+    assert protocol.blocks[1][2] == (trigger_timestamp_us + (32 - pre) * period) & 0xFFFFFFFF
+    assert protocol.lost_frames == 0
+    # Ready for the next stream
+    assert protocol.expected_sequence is None and protocol.streaming
+
+def test_burst_capture():
+    # Packed 16-bit frames of channels 0, 3 and 5, the trigger is the first frame and the device reports the
+    # time the whole burst took
+    window = (np.arange(3 * 1000, dtype="<u2") * 7).reshape(1000, 3)
+    info = main_pb2.CaptureInfoMessage(trigger_frame_index=0, num_of_frames=1000, trigger_timestamp_us=1234,
+                                       sampling_period_us=4, trigger_value=0, duration_us=4100)
+    protocol = RecordingProtocol(stream_only=True)
+    protocol.set_frame_layout("packed16", 0b101001)
+    protocol.data_received(capture_stream(window, info))
+
+    assert protocol.capture_info.duration_us == 4100
+    assert all(block[1] == [0, 3, 5] for block in protocol.blocks)
+    assert [block[2] for block in protocol.blocks] == [1234 + first * 4 for first in range(0, 1000, 170)]
+    assert np.array_equal(np.concatenate([block[0] for block in protocol.blocks]), window)
+    assert protocol.lost_frames == 0
+
+def test_capture_cut_short(caplog):
+    # The host stopped reading during the upload, the device ends the stream without the rest of the window,
+    # the EOS frame still counts every frame of it
+    window = np.arange(8 * 100, dtype="<i4").reshape(100, 8)
+    info = main_pb2.CaptureInfoMessage(trigger_frame_index=50, num_of_frames=100, trigger_timestamp_us=1000,
+                                       sampling_period_us=10, trigger_value=400)
+    stream = capture_stream(window, info)
+    last_block = encode_stream_frame(STREAM_FRAME_TYPE_DATA, 96, 1000 + 46 * 10, window[96:].tobytes())
+    eos = encode_stream_frame(STREAM_FRAME_TYPE_EOS, 100, 0)
+    assert stream.endswith(last_block + eos)
+    protocol = RecordingProtocol(stream_only=True)
+    with caplog.at_level("INFO"):
+        protocol.data_received(stream[:-len(last_block + eos)] + eos)
+    assert sum(len(block[0]) for block in protocol.blocks) == 96
+    assert protocol.capture_info.num_of_frames == 100
+    assert "100 data frames produced, 4 lost" in caplog.text
@@ -0,0 +1,123 @@
+import re
+import numpy as np
+import pytest
+import communications.latency as latency
+from communications.latency import ClockOffsetEstimator, LatencyMonitor, MIN_DRIFT_SPAN_US
+
+# Device clock of the tests, ahead of the host by OFFSET_US at host time 0 and running DRIFT_PPM fast, its low 32
+# bits wrap around 300 ms later
+OFFSET_US = (1 << 32) - 300_000
+DRIFT_PPM = 25.0
+
+def device_clock_us(host_us: float) -> float:
+    return OFFSET_US + host_us * (1 + DRIFT_PPM * 1e-6)
+
+# Send a request at sent_us and answer it, the device stamps the reply up_us after the request is sent and
+# the host receives it down_us after that
+def exchange(clock: ClockOffsetEstimator, monkeypatch, sent_us: int, up_us: int, down_us: int) -> None:
+    monkeypatch.setattr(latency, "host_time_us", lambda: sent_us)
+    request_id = clock.request()
+    clock.reply(request_id, round(device_clock_us(sent_us + up_us)), sent_us + up_us + down_us)
+
+def test_best_round_trip_of_burst(monkeypatch):
+    clock = ClockOffsetEstimator()
+    # Only the 100 us round trip, symmetric, gives the offset exactly, the others are off by half their asymmetry
+    exchange(clock, monkeypatch, 1000, 100, 400)
+    exchange(clock, monkeypatch, 2000, 50, 50)
+    exchange(clock, monkeypatch, 3000, 250, 50)
+    assert not clock.synchronised()
+    assert clock.end_burst()
+    assert clock.synchronised()
+    assert clock.replies == 3
+    host_mid_us, offset_us, round_trip_us = clock.bursts[0]
+    assert (host_mid_us, round_trip_us) == (2050, 100)
+    assert offset_us == pytest.approx(device_clock_us(2050) - 2050, abs=1)
+    assert clock.uncertainty_us() == 50
+    # Bursts closer than MIN_DRIFT_SPAN_US give no drift, the best round trip of all sets the offset
+    assert clock.drift_ppm() == 0.0
+    assert float(clock.offset_us(500_000)) == pytest.approx(offset_us)
+
+def test_unanswered_requests(monkeypatch):
+    clock = ClockOffsetEstimator()
+    monkeypatch.setattr(latency, "host_time_us", lambda: 0)
+    request_id = clock.request()
+    # An empty burst isn't kept, its pending requests are given up on
+    assert not clock.end_burst()
+    clock.reply(request_id, 123, 456)
+    assert clock.replies == 0 and not clock.synchronised()
+    with pytest.raises(ValueError):
+        clock.offset_us(0)
+
+def test_drift_fit(monkeypatch):
+    clock = ClockOffsetEstimator()
+    # Three bursts 5 s apart, each with an asymmetric round trip around a symmetric one
+    for burst_us in (0, 5_000_000, 10_000_000):
+        exchange(clock, monkeypatch, burst_us + 1000, 300, 20)
+        exchange(clock, monkeypatch, burst_us + 2000, 40, 40)
+        exchange(clock, monkeypatch, burst_us + 3000, 20, 300)
+        assert clock.end_burst()
+    assert len(clock.bursts) == 3
+    assert 10_000_000 > MIN_DRIFT_SPAN_US
+    assert clock.drift_ppm() == pytest.approx(DRIFT_PPM, abs=0.1)
+    assert clock.uncertainty_us() == 40
+    for host_us in (0, 7_500_000, 20_000_000):
+        assert float(clock.device_time_us(host_us)) == pytest.approx(device_clock_us(host_us), abs=2)
+
+# Clock whose offset is exactly OFFSET_US, with no drift
+def synchronised_clock(monkeypatch) -> ClockOffsetEstimator:
+    clock = ClockOffsetEstimator()
+    monkeypatch.setattr(latency, "host_time_us", lambda: 1000)
+    request_id = clock.request()
+    clock.reply(request_id, OFFSET_US + 1100, 1200)
+    assert clock.end_burst()
+    return clock
+
+def test_latency_across_timestamp_wrap(monkeypatch):
+    monitor = LatencyMonitor(synchronised_clock(monkeypatch))
+    # Blocks of 16 frames every 1600 us, which arrive 1500 us after their first frame was sampled, the 32-bit
+    # device timestamps wrap around meanwhile
+    for i in range(400):
+        arrival_us = 10_000 + i * 1600
+        monitor.record(arrival_us, (OFFSET_US + arrival_us - 1500) & 0xFFFFFFFF, 16)
+    timestamps_us = np.array(monitor.timestamp_us)
+    assert (np.diff(timestamps_us) < 0).any()
+    assert np.array_equal(monitor.latencies_us(), np.full(400, 1500))
+    assert monitor.frame_period_us() == 100.0
+    assert monitor.interarrival_jitter_us() == 0.0
+
+def test_negative_latency(monkeypatch):
+    monitor = LatencyMonitor(synchronised_clock(monkeypatch))
+    # A timestamp ahead of the device time at arrival comes out negative, not as ~2^32
+    monitor.record(5000, (OFFSET_US + 5200) & 0xFFFFFFFF, 1)
+    assert monitor.latencies_us().tolist() == [-200]
+
+def test_interarrival_jitter(monkeypatch):
+    monitor = LatencyMonitor(synchronised_clock(monkeypatch))
+    # Blocks sampled 1000 us apart, each arriving 100 us late or early in turn, so every transit differs from
+    # the previous one by 200 us, and J += (|D| - J) / 16 of RFC 3550 converges on it
+    num_of_blocks = 50
+    for i in range(num_of_blocks):
+        timestamp_us = 1_000_000 + i * 1000
+        monitor.record(timestamp_us - OFFSET_US + 2000 + (100 if i % 2 else -100), timestamp_us, 10)
+    expected_us = 200 * (1 - (15 / 16) ** (num_of_blocks - 1))
+    assert monitor.interarrival_jitter_us() == pytest.approx(expected_us)
+    # The latencies themselves only take two values
+    assert sorted(set(monitor.latencies_us().tolist())) == [1900, 2100]
+
+def test_report_histogram(monkeypatch):
+    monitor = LatencyMonitor(synchronised_clock(monkeypatch))
+    # 10 blocks at 1000 us, 5 at 1250 us and 1 at 1980 us of latency
+    latencies_us = [1000] * 10 + [1250] * 5 + [1980]
+    for i, latency_us in enumerate(latencies_us):
+        arrival_us = 100_000 + i * 320
+        monitor.record(arrival_us, (OFFSET_US + arrival_us - latency_us) & 0xFFFFFFFF, 32)
+    report = monitor.report(bin_us=100)
+    assert "16 blocks of 512 frames, frame period = 10.0 us." in report
+    assert "100 us bins" in report
+    bins = {int(m.group(1)): int(m.group(2)) for m in re.finditer(r"^\s+(-?\d+) us\s+(\d+) #+$", report, re.MULTILINE)}
+    assert bins == {1000: 10, 1200: 5, 1900: 1}
+    # The newest frame of a block of 32 waited 31 frame periods less
+    assert "Latency, newest frame" in report and "min = 690 us" in report
+    assert "negative latencies" not in report
+    # About 20 bins when the width isn't given, 980 us of span gives 50 us bins
+    assert "50 us bins" in monitor.report()
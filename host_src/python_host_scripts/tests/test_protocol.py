@@ -0,0 +1,121 @@
+import random
+import struct
+import numpy as np
+import pytest
+import main_pb2
+from communications.protocol import IngressProtocol, decode_spectrum_records
+from communications.stream_frame import encode_stream_frame, STREAM_FRAME_TYPE_DATA, STREAM_FRAME_TYPE_MESSAGE, STREAM_FRAME_TYPE_EOS
+from message_handler.message_handler import encode_varint, decode_varint, prepend_msg_length, prepare_get_stats_msg
+
+# IngressProtocol which keeps the blocks of frames instead of printing them
+class RecordingProtocol(IngressProtocol):
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.blocks = []
+
+    def _samples_received(self, frames, channels, timestamp_us):
+        self.blocks.append((frames.copy(), list(channels), timestamp_us))
+
+def sample_batch_msg(frames: np.ndarray, channel_mask: int, frame_format, first_frame_index: int, timestamp_us: int) -> bytes:
+    msg = main_pb2.DeviceToHostMessage()
+    batch = msg.sample_batch_msg
+    batch.start_timestamp_us = timestamp_us
+    batch.sampling_period_us = 100
+    batch.channel_mask = channel_mask
+    batch.frame_format = frame_format
+    batch.first_frame_index = first_frame_index
+    batch.samples = frames.tobytes()
+    return msg.SerializeToString()
+
+# Delimited the way the device sends its messages on the control port, which may be longer than the host ones
+def delimit(msg: bytes) -> bytes:
+    return encode_varint(len(msg)) + msg
+
+def feed_in_chunks(protocol, data: bytes, seed: int):
+    rng = random.Random(seed)
+    offset = 0
+    while offset < len(data):
+        size = rng.randrange(1, 40)
+        protocol.data_received(data[offset:offset + size])
+        offset += size
+
+@pytest.mark.parametrize("value", [0, 1, 127, 128, 300, 16383, 16384, 2**32 - 1])
+def test_varint_round_trip(value):
+    encoded = encode_varint(value)
+    assert decode_varint(encoded + b"\xff") == (value, len(encoded))
+    # Incomplete, and longer than a uint32 can be
+    assert decode_varint(encoded[:-1]) == (None, 0)
+    with pytest.raises(ValueError):
+        decode_varint(b"\x80" * 5)
+
+def test_host_messages_are_delimited():
+    msg = prepare_get_stats_msg(include_tasks=True)
+    length, length_size = decode_varint(msg)
+    parsed = main_pb2.HostToDeviceMessage()
+    parsed.ParseFromString(msg[length_size:])
+    assert length_size + length == len(msg)
+    assert parsed.get_stats_msg.include_tasks
+    # Longer than the receive buffer of the device
+    assert prepend_msg_length(bytes(300)) is None
+
+@pytest.mark.parametrize("seed", range(3))
+def test_sample_batches_over_the_control_port(seed):
+    # Messages longer than 127 bytes take a two byte length
+    packed = np.arange(3 * 40, dtype="<u2").reshape(40, 3)
+    int32 = np.arange(-8 * 5, 0, dtype="<i4").reshape(5, 8)
+    stream = (delimit(sample_batch_msg(packed, 0b10010010, main_pb2.FRAME_FORMAT_PACKED_INT16, 0, 1000)) +
+              delimit(sample_batch_msg(int32, 0, main_pb2.FRAME_FORMAT_INT32, 40, 5000)))
+    protocol = RecordingProtocol()
+    feed_in_chunks(protocol, stream, seed)
+    assert len(protocol.blocks) == 2
+    frames, channels, timestamp_us = protocol.blocks[0]
+    assert np.array_equal(frames, packed) and channels == [1, 4, 7] and timestamp_us == 1000
+    frames, channels, timestamp_us = protocol.blocks[1]
+    assert np.array_equal(frames, int32) and channels == list(range(8)) and timestamp_us == 5000
+    assert (protocol.lost_frames, protocol.expected_sequence, len(protocol.buffer)) == (0, 45, 0)
+
+def test_sample_batches_in_the_stream():
+    frames = np.arange(16 * 2, dtype="<u2").reshape(16, 2)
+    protocol = RecordingProtocol(stream_only=True)
+    stream = b"".join(encode_stream_frame(STREAM_FRAME_TYPE_MESSAGE, 0, 0, sample_batch_msg(frames, 0b11, main_pb2.FRAME_FORMAT_PACKED_INT16, index, index * 100))
+                      for index in (0, 16, 48))
+    protocol.data_received(stream)
+    assert [block[2] for block in protocol.blocks] == [0, 1600, 4800]
+    assert (protocol.lost_frames, protocol.expected_sequence) == (16, 64)
+    # The counters start over with the next stream
+    protocol.data_received(encode_stream_frame(STREAM_FRAME_TYPE_EOS, 64, 0))
+    assert protocol.expected_sequence is None and protocol.lost_frames == 0
+    assert protocol.streaming
+
+def test_messages_after_the_end_of_stream():
+    # The control port streams until the EOS frame, then the acknowledgement of the stop follows
+    ack = main_pb2.DeviceToHostMessage()
+    ack.ack_stop_periodic_sampler_msg.ack = True
+    protocol = RecordingProtocol()
+    protocol.streaming = True
+    frames = np.arange(8, dtype="<i4").reshape(1, 8)
+    protocol.data_received(encode_stream_frame(STREAM_FRAME_TYPE_DATA, 0, 7, frames.tobytes()) +
+                           encode_stream_frame(STREAM_FRAME_TYPE_EOS, 1, 0) +
+                           delimit(ack.SerializeToString()))
+    assert len(protocol.blocks) == 1
+    assert not protocol.streaming
+    assert len(protocol.buffer) == 0
+
+def test_gap_in_the_frame_indices():
+    protocol = RecordingProtocol(stream_only=True)
+    protocol.set_frame_layout("packed16", 0b1)
+    frames = np.zeros((4, 1), dtype="<u2")
+    protocol.data_received(encode_stream_frame(STREAM_FRAME_TYPE_DATA, 0, 0, frames.tobytes()) +
+                           encode_stream_frame(STREAM_FRAME_TYPE_DATA, 10, 0, frames.tobytes()))
+    assert (protocol.lost_frames, protocol.expected_sequence) == (6, 14)
+
+def test_spectrum_records():
+    # A record of all the bins, then one of 2 peaks, each with the count of values clamped to 16 bits
+    full = struct.pack("<HBBH", 16, 0, 0, 0) + np.arange(9, dtype="<u2").tobytes()
+    peaks = struct.pack("<HBBH", 16, 1, 2, 5) + struct.pack("<HHHH", 3, 400, 7, 100)
+    records = decode_spectrum_records(full + peaks)
+    assert [(channel, fft_size, clipped) for channel, fft_size, _, clipped in records] == [(0, 16, 0), (1, 16, 5)]
+    assert records[0][2].tolist() == list(range(9))
+    assert records[1][2]["bin"].tolist() == [3, 7] and records[1][2]["magnitude"].tolist() == [400, 100]
+    with pytest.raises(ValueError):
+        decode_spectrum_records(full + peaks[:-2])
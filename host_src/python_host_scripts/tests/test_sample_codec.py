@@ -0,0 +1,84 @@
+import struct
+import numpy as np
+import pytest
+from communications.sample_codec import decode_sample_codec_block, SAMPLE_CODEC_HEADER
+
+# The block the device compresses four frames of two 16-bit channels into, see tests/test_sample_codec.c
+GOLDEN_FRAMES = np.array([[1000, 0xFFFF], [1001, 1], [999, 0], [1002, 0xFFFE]], dtype="<u2")
+GOLDEN_BLOCK = bytes([0x04, 0x00, 0x02, 0x02, 0xE8, 0x03, 0x03, 0x9A, 0x01, 0xFF, 0xFF, 0x03, 0xCC, 0x00])
+
+# Encoder written from the format in device_src/lib/sample_codec/sample_codec.h, one bit at a time
+def encode_reference(frames: np.ndarray) -> bytes:
+    value_size = frames.dtype.itemsize
+    value_bits = 8 * value_size
+    mask = (1 << value_bits) - 1
+    num_of_frames, num_of_channels = frames.shape
+    block = bytearray(SAMPLE_CODEC_HEADER.pack(num_of_frames, num_of_channels, value_size))
+    for channel in range(num_of_channels):
+        values = [int(value) & mask for value in frames[:, channel].view(f"<u{value_size}")]
+        zigzags = []
+        for previous, value in zip(values, values[1:]):
+            delta = (value - previous) & mask
+            if delta >> (value_bits - 1):
+                delta -= 1 << value_bits
+            zigzags.append(2 * delta if delta >= 0 else -2 * delta - 1)
+        width = max(zigzags, default=0).bit_length()
+        packed = sum(zigzag << (i * width) for i, zigzag in enumerate(zigzags))
+        block += values[0].to_bytes(value_size, "little") + bytes([width])
+        block += packed.to_bytes((len(zigzags) * width + 7) // 8, "little")
+    return bytes(block)
+
+def test_golden_block():
+    assert encode_reference(GOLDEN_FRAMES) == GOLDEN_BLOCK
+    decoded = decode_sample_codec_block(GOLDEN_BLOCK)
+    assert decoded.dtype == np.dtype("<u2")
+    assert np.array_equal(decoded, GOLDEN_FRAMES)
+
+@pytest.mark.parametrize("dtype", ["<u2", "<i4"])
+@pytest.mark.parametrize("noise_bits", [0, 1, 5, 12, 16, 31])
+def test_round_trip(dtype, noise_bits):
+    rng = np.random.default_rng(noise_bits)
+    value_bits = 8 * np.dtype(dtype).itemsize
+    noise_bits = min(noise_bits, value_bits)
+    ramp = np.arange(300, dtype=np.int64)[:, None] * np.arange(8, dtype=np.int64)[None, :]
+    noise = rng.integers(0, 1 << noise_bits, size=ramp.shape, dtype=np.int64) if noise_bits else 0
+    frames = ((ramp + noise) & ((1 << value_bits) - 1)).astype(np.uint64).astype(f"<u{value_bits // 8}").view(dtype)
+    assert np.array_equal(decode_sample_codec_block(encode_reference(frames)), frames)
+
+def test_extremes():
+    frames = np.array([[-2**31], [2**31 - 1], [0], [-2**31], [-1], [2**31 - 1]], dtype="<i4")
+    block = encode_reference(frames)
+    assert block[SAMPLE_CODEC_HEADER.size + 4] == 32
+    assert np.array_equal(decode_sample_codec_block(block), frames)
+
+def test_single_frame():
+    frames = np.array([[7, 8, 9]], dtype="<u2")
+    assert np.array_equal(decode_sample_codec_block(encode_reference(frames)), frames)
+
+def test_invalid_blocks():
+    with pytest.raises(ValueError):
+        decode_sample_codec_block(bytes([0x04, 0x00, 0x02, 0x03]) + GOLDEN_BLOCK[4:])
+    with pytest.raises(ValueError):
+        decode_sample_codec_block(GOLDEN_BLOCK[:-1])
+    wide = bytearray(GOLDEN_BLOCK)
+    wide[6] = 17
+    with pytest.raises(ValueError):
+        decode_sample_codec_block(bytes(wide))
+
+# Compressed and raw blocks mixed in one stream, as the device sends a block raw when it doesn't get smaller
+def test_ingress_protocol_decodes_compressed_stream():
+    from communications.protocol import IngressProtocol
+    from communications.stream_frame import encode_stream_frame, STREAM_FRAME_TYPE_DATA, STREAM_FRAME_TYPE_DELTA
+
+    received = []
+    protocol = IngressProtocol(stream_only=True)
+    protocol.set_frame_layout("packed16", 0b11)
+    protocol._samples_received = lambda frames, channels, timestamp_us: received.append(frames.copy())
+    raw = np.array([[1, 2], [3, 4]], dtype="<u2")
+    protocol.data_received(encode_stream_frame(STREAM_FRAME_TYPE_DELTA, 0, 0, GOLDEN_BLOCK) +
+                           encode_stream_frame(STREAM_FRAME_TYPE_DATA, 4, 0, raw.tobytes()))
+    assert len(received) == 2
+    assert np.array_equal(received[0], GOLDEN_FRAMES)
+    assert np.array_equal(received[1], raw)
+    assert (protocol.compressed_blocks, protocol.lost_frames, protocol.expected_sequence) == (1, 0, 6)
+    assert (protocol.encoded_bytes, protocol.decoded_bytes) == (len(GOLDEN_BLOCK) + raw.nbytes, GOLDEN_FRAMES.nbytes + raw.nbytes)
@@ -0,0 +1,85 @@
+import random
+import pytest
+from communications.stream_frame import StreamFrameParser, encode_stream_frame, stream_frame_crc16, STREAM_FRAME_TYPE_DATA, STREAM_FRAME_TYPE_EOS, STREAM_FRAME_MAX_PAYLOAD_SIZE, STREAM_FRAME_OVERHEAD
+
+# The data frame built by the device in tests/test_stream_frame.c
+GOLDEN_FRAME = bytes([0xA5, 0x5A, 0x01, 0x03, 0x00, 0x04, 0x03, 0x02, 0x01, 0x0D, 0x0C, 0x0B, 0x0A, 0x11, 0x22, 0x33, 0xC8, 0x0B])
+
+class Collector:
+    def __init__(self):
+        self.frames = []
+
+    def __call__(self, frame_type, sequence, timestamp_us, payload):
+        self.frames.append((frame_type, sequence, timestamp_us, bytes(payload)))
+
+def make_frames(num_of_frames, seed=1):
+    rng = random.Random(seed)
+    frames = []
+    for i in range(num_of_frames):
+        payload = bytes(rng.randrange(256) for _ in range(rng.randrange(0, 300)))
+        frames.append((STREAM_FRAME_TYPE_DATA, i * 16, i * 1600, payload))
+    return frames
+
+def test_crc_check_value():
+    assert stream_frame_crc16(b"123456789") == 0x29B1
+
+def test_encode_matches_device():
+    assert encode_stream_frame(STREAM_FRAME_TYPE_DATA, 0x01020304, 0x0A0B0C0D, bytes([0x11, 0x22, 0x33])) == GOLDEN_FRAME
+    assert len(encode_stream_frame(STREAM_FRAME_TYPE_EOS, 0, 0)) == STREAM_FRAME_OVERHEAD
+
+@pytest.mark.parametrize("seed", range(5))
+def test_parse_any_chunking(seed):
+    frames = make_frames(50)
+    stream = b"".join(encode_stream_frame(*frame) for frame in frames)
+    collector = Collector()
+    parser = StreamFrameParser(collector)
+    rng = random.Random(seed)
+    offset = 0
+    while offset < len(stream):
+        size = rng.choice([1, 2, 7, 64, 512, 4096])
+        parser.feed(stream[offset:offset + size])
+        offset += size
+    assert collector.frames == frames
+    assert (parser.crc_errors, parser.skipped_bytes, len(parser.buffer)) == (0, 0, 0)
+
+def test_resynchronise_after_corruption():
+    frames = make_frames(10)
+    encoded = [bytearray(encode_stream_frame(*frame)) for frame in frames]
+    # A flipped payload bit, garbage between two frames, and a frame cut short
+    encoded[3][-4] ^= 0x10
+    encoded[5] = bytearray(b"\x00\xa5\x13\x37") + encoded[5]
+    encoded[7] = encoded[7][:len(encoded[7]) // 2]
+    collector = Collector()
+    parser = StreamFrameParser(collector)
+    parser.feed(b"".join(encoded))
+    expected = [frame for i, frame in enumerate(frames) if i not in (3, 7)]
+    assert collector.frames == expected
+    assert parser.crc_errors >= 1
+    assert parser.skipped_bytes >= len(encoded[3]) + 4 + len(encoded[7])
+
+def test_oversized_length_is_skipped():
+    bogus = b"\xa5\x5a\x01" + (STREAM_FRAME_MAX_PAYLOAD_SIZE + 1).to_bytes(2, "little") + bytes(8)
+    frame = (STREAM_FRAME_TYPE_DATA, 7, 8, b"abc")
+    collector = Collector()
+    parser = StreamFrameParser(collector)
+    parser.feed(bogus + encode_stream_frame(*frame))
+    assert collector.frames == [frame]
+
+def test_split_sync_bytes():
+    collector = Collector()
+    parser = StreamFrameParser(collector)
+    parser.feed(b"\x00" + GOLDEN_FRAME[:1])
+    parser.feed(GOLDEN_FRAME[1:])
+    assert collector.frames == [(STREAM_FRAME_TYPE_DATA, 0x01020304, 0x0A0B0C0D, bytes([0x11, 0x22, 0x33]))]
+    assert parser.skipped_bytes == 1
+
+def test_stop_leaves_the_rest_unparsed():
+    trailer = b"\x05message"
+    parser = None
+    def stop_at_eos(frame_type, sequence, timestamp_us, payload):
+        if frame_type == STREAM_FRAME_TYPE_EOS:
+            parser.stop()
+    parser = StreamFrameParser(stop_at_eos)
+    parser.feed(GOLDEN_FRAME + encode_stream_frame(STREAM_FRAME_TYPE_EOS, 16, 0) + trailer)
+    assert bytes(parser.buffer) == trailer
+    assert parser.frames_received == 2
@@ -0,0 +1,111 @@
+import numpy as np
+import communications.test_pattern as test_pattern
+# Imported under another name, pytest would collect it as a test class otherwise
+from communications.test_pattern import TestPatternVerifier as PatternVerifier, lfsr_step, lfsr_advance, TEST_PATTERN_LFSR_SEED
+
+# int32 frames of the test pattern from sample first on, as the device streams them : the counter, the LFSR
+# state, then zeros
+def pattern_frames(first: int, num_of_frames: int) -> np.ndarray:
+    frames = np.zeros((num_of_frames, 8), dtype=np.uint32)
+    state = lfsr_advance(TEST_PATTERN_LFSR_SEED, first)
+    for i in range(num_of_frames):
+        frames[i, 0] = first + i
+        frames[i, 1] = state
+        state = lfsr_step(state)
+    return frames.view("<i4")
+
+# Feed the frames in blocks, the way the device sends them
+def feed(verifier: PatternVerifier, frames: np.ndarray, frames_per_block: int = 16) -> None:
+    for first in range(0, len(frames), frames_per_block):
+        verifier.check(frames[first:first + frames_per_block])
+
+def test_lfsr_advance():
+    state = TEST_PATTERN_LFSR_SEED
+    for _ in range(1000):
+        state = lfsr_step(state)
+    assert lfsr_advance(TEST_PATTERN_LFSR_SEED, 1000) == state
+    assert lfsr_advance(TEST_PATTERN_LFSR_SEED, 0) == TEST_PATTERN_LFSR_SEED
+
+def test_intact_stream():
+    verifier = PatternVerifier()
+    feed(verifier, pattern_frames(0, 1000))
+    verifier.finish(1000)
+    assert verifier.passed()
+    assert verifier.received == 1000
+    assert (verifier.missing, verifier.duplicates, verifier.out_of_order, verifier.corrupt) == (0, 0, 0, 0)
+
+def test_packed_int16_frames():
+    # Packed int16 frames carry the first 16 bytes of the int32 frames, i.e. eight int16 values
+    frames = pattern_frames(0, 500)
+    packed = np.ascontiguousarray(frames[:, :4]).view("<i2")
+    assert packed.shape == (500, 8)
+    verifier = PatternVerifier()
+    feed(verifier, packed)
+    verifier.finish(500)
+    assert verifier.passed()
+
+def test_gaps_and_tail():
+    frames = pattern_frames(0, 1000)
+    verifier = PatternVerifier()
+    feed(verifier, np.concatenate((frames[:100], frames[110:500], frames[503:990])))
+    assert verifier.missing == 13
+    assert verifier.missing_ranges == [[100, 110], [500, 503]]
+    # The last 10 samples never arrived, the end of stream frame tells they were produced
+    verifier.finish(1000)
+    assert verifier.missing == 23
+    assert not verifier.passed()
+    assert (verifier.duplicates, verifier.out_of_order, verifier.corrupt) == (0, 0, 0)
+
+def test_reordering():
+    # The block of samples 32 to 47 arrives after the next one
+    frames = pattern_frames(0, 128)
+    verifier = PatternVerifier()
+    feed(verifier, np.concatenate((frames[:32], frames[48:64], frames[32:48], frames[64:])))
+    verifier.finish(128)
+    assert verifier.missing == 0
+    assert verifier.out_of_order == 16
+    assert verifier.missing_ranges == []
+    assert verifier.duplicates == 0 and verifier.corrupt == 0
+    assert not verifier.passed()
+
+def test_duplicates():
+    frames = pattern_frames(0, 128)
+    verifier = PatternVerifier()
+    feed(verifier, np.concatenate((frames[:64], frames[48:64], frames[64:], frames[127:])))
+    verifier.finish(128)
+    assert verifier.duplicates == 17
+    assert verifier.missing == 0 and verifier.out_of_order == 0 and verifier.corrupt == 0
+    assert not verifier.passed()
+
+def test_corruption():
+    frames = pattern_frames(0, 64).copy()
+    # A flipped bit in the LFSR state, the frames following it are still valid on their own counters
+    frames[10, 1] ^= 0x100
+    # Anything but zeros after the counter and the state
+    frames[40, 7] = 1
+    verifier = PatternVerifier()
+    feed(verifier, frames)
+    verifier.finish(64)
+    assert verifier.corrupt == 2
+    # The samples of the corrupt frames are missing as well
+    assert verifier.missing == 2
+    assert verifier.missing_ranges == [[10, 11], [40, 41]]
+    assert verifier.duplicates == 0 and verifier.out_of_order == 0
+
+def test_split_ranges_stay_in_order(monkeypatch):
+    monkeypatch.setattr(test_pattern, "MAX_MISSING_RANGES", 3)
+    frames = pattern_frames(0, 100)
+    verifier = PatternVerifier()
+    # Ranges [10, 20), [30, 40) and [50, 60) go missing, then sample 15 arrives late
+    feed(verifier, np.concatenate((frames[:10], frames[20:30], frames[40:50], frames[60:70])))
+    feed(verifier, frames[15:16])
+    assert verifier.missing_ranges == [[10, 15], [16, 20], [30, 40], [50, 60]]
+    # A fourth gap trims the oldest ranges, the newest still tell samples arriving late from duplicates
+    feed(verifier, frames[80:])
+    assert verifier.missing_ranges == [[30, 40], [50, 60], [70, 80]]
+    feed(verifier, frames[55:56])
+    assert verifier.out_of_order == 2
+    assert verifier.duplicates == 0
+    # Nothing is remembered of [10, 15) any more, a sample from it is taken for a duplicate
+    feed(verifier, frames[12:13])
+    assert verifier.duplicates == 1
@@ -0,0 +1,55 @@
+import os
+import numpy as np
+from communications.protocol import IngressProtocol
+from communications.test_pattern import lfsr_advance, TEST_PATTERN_LFSR_SEED
+from communications.vendor_reader import replay_trace, TRACE_CHUNK_HEADER
+
+# Endpoint trace in the format VendorBulkReader records : 100 frames of the test pattern in blocks of 32 int32
+# frames, timestamped every 50 us from 0xFFFFF000, across the wrap around of the device time, then EOS
+# It is split into reads of whole 64 bytes packets like libusb returns them, the last read ends with a short packet
+TRACE_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "data", "vendor_trace.bin")
+TRACE_READ_SIZES = [64, 512, 1024, 64, 640, 971]
+TRACE_NUM_OF_FRAMES = 100
+
+# IngressProtocol which keeps the blocks of frames instead of printing them
+class RecordingProtocol(IngressProtocol):
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.blocks = []
+
+    def _samples_received(self, frames, channels, timestamp_us):
+        self.blocks.append((frames.copy(), list(channels), timestamp_us))
+
+def test_replay_keeps_the_read_boundaries():
+    chunks = []
+    bytes_replayed = replay_trace(TRACE_PATH, chunks.append)
+    assert [len(chunk) for chunk in chunks] == TRACE_READ_SIZES
+    assert bytes_replayed == sum(TRACE_READ_SIZES)
+    assert os.path.getsize(TRACE_PATH) == bytes_replayed + len(TRACE_READ_SIZES) * TRACE_CHUNK_HEADER.size
+
+def test_replayed_frames():
+    protocol = RecordingProtocol(stream_only=True)
+    replay_trace(TRACE_PATH, protocol.data_received)
+
+    # Counter and LFSR state of every sample, zeros after them
+    frames = np.concatenate([block[0] for block in protocol.blocks]).view(np.uint32)
+    assert frames.shape == (TRACE_NUM_OF_FRAMES, 8)
+    assert np.array_equal(frames[:, 0], np.arange(TRACE_NUM_OF_FRAMES))
+    assert [int(state) for state in frames[:, 1]] == [lfsr_advance(TEST_PATTERN_LFSR_SEED, i) for i in range(TRACE_NUM_OF_FRAMES)]
+    assert not frames[:, 2:].any()
+    assert all(block[1] == list(range(8)) for block in protocol.blocks)
+    assert [block[2] for block in protocol.blocks] == [(0xFFFFF000 + first * 50) & 0xFFFFFFFF for first in range(0, TRACE_NUM_OF_FRAMES, 32)]
+    # Ended by EOS without anything lost
+    assert protocol.lost_frames == 0 and protocol.expected_sequence is None
+    assert (protocol.stream_parser.crc_errors, protocol.stream_parser.skipped_bytes) == (0, 0)
+
+def test_truncated_trace(tmp_path, caplog):
+    # The recording was cut in the middle of the last read, the reads before it are still replayed
+    with open(TRACE_PATH, "rb") as trace_file:
+        trace = trace_file.read()
+    truncated_path = tmp_path / "truncated.bin"
+    truncated_path.write_bytes(trace[:-100])
+    chunks = []
+    assert replay_trace(str(truncated_path), chunks.append) == sum(TRACE_READ_SIZES[:-1])
+    assert len(chunks) == len(TRACE_READ_SIZES) - 1
+    assert "Truncated chunk" in caplog.text
@@ -0,0 +1,433 @@
+#!/usr/bin/env python3
+# Generate fixed-layout encoders and decoders for the fixed-shape messages of a proto file
+#
+# pb_encode()/pb_decode() walk the field descriptors of a message and go through a callback per field, which
+# costs ~100 us per message on the RP2040. The messages exchanged with the host are mostly a handful of
+# scalar fields, so this script turns each of them into straight-line code with the tags precomputed, working
+# on the structs generated by nanopb and producing the same bytes on the wire as nanopb.
+#
+# A message is fixed-shape when it is either
+#   - flat : every field is a required or optional scalar of a type listed in SCALAR_TYPES, or
+#   - a wrapper : every field belongs to a single oneof and is a message, e.g. DeviceToHostMessage, only the
+#     members which are flat messages are handled, the encoder returns 0 and the decoder fails for the others
+# Other messages are skipped and have to be encoded with nanopb.
+#
+# For each fixed-shape message <Msg> the generated <name>.fixed.h declares
+#   <Msg>_FIXED_MAX_SIZE, <Msg>_FIXED_DELIMITED_MAX_SIZE   worst case encoded sizes
+#   size_t <Msg>_encode_fixed(uint8_t* buf, const <Msg>* msg)
+#   size_t <Msg>_encode_fixed_delimited(uint8_t* buf, const <Msg>* msg)   same as PB_ENCODE_DELIMITED
+#   bool <Msg>_decode_fixed(const uint8_t* buf, size_t size, <Msg>* msg)
+#
+# Usage : generate_fixed_codec.py [-I include_dir] [--output-dir dir] main.proto
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+from google.protobuf import descriptor_pb2
+
+FieldDescriptorProto = descriptor_pb2.FieldDescriptorProto
+
+# Supported scalar types : (maximum encoded size of the value, wire type)
+SCALAR_TYPES = {
+    FieldDescriptorProto.TYPE_INT32: (10, 0),     # Negative values are sign-extended to 64 bits
+    FieldDescriptorProto.TYPE_ENUM: (10, 0),
+    FieldDescriptorProto.TYPE_UINT32: (5, 0),
+    FieldDescriptorProto.TYPE_UINT64: (10, 0),
+    FieldDescriptorProto.TYPE_SINT32: (5, 0),
+    FieldDescriptorProto.TYPE_BOOL: (1, 0),
+    FieldDescriptorProto.TYPE_FIXED32: (4, 5),
+    FieldDescriptorProto.TYPE_SFIXED32: (4, 5),
+    FieldDescriptorProto.TYPE_FLOAT: (4, 5),
+}
+
+# Submessages and delimited messages get a single byte length prefix, which bounds their size
+MAX_ONE_BYTE_LENGTH = 127
+
+def varint_bytes(value: int) -> list:
+    out = []
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+    return out
+
+def tag_bytes(field_number: int, wire_type: int) -> list:
+    return varint_bytes((field_number << 3) | wire_type)
+
+def type_name(field) -> str:
+    # Only top-level types without a package are supported, which is all main.proto uses
+    return field.type_name.lstrip(".")
+
+class FixedMessage:
+    def __init__(self, descriptor):
+        self.descriptor = descriptor
+        self.name = descriptor.name
+
+    def max_size(self) -> int:
+        raise NotImplementedError
+
+class FlatMessage(FixedMessage):
+    def __init__(self, descriptor):
+        super().__init__(descriptor)
+        # nanopb encodes the fields in the order of their numbers
+        self.fields = sorted(descriptor.field, key=lambda f: f.number)
+
+    def max_size(self) -> int:
+        return sum(len(tag_bytes(f.number, SCALAR_TYPES[f.type][1])) + SCALAR_TYPES[f.type][0] for f in self.fields)
+
+class WrapperMessage(FixedMessage):
+    def __init__(self, descriptor, oneof_name: str, members: list):
+        super().__init__(descriptor)
+        self.oneof_name = oneof_name
+        # (field, FlatMessage) pairs, the FlatMessage is None for members which aren't fixed-shape
+        self.members = members
+
+    def max_size(self) -> int:
+        return max(len(tag_bytes(f.number, 2)) + 1 + sub.max_size() for f, sub in self.members if sub is not None)
+
+def classify(file_descriptor) -> tuple:
+    flat = {}
+    skipped = []
+    for m in file_descriptor.message_type:
+        if m.nested_type or m.oneof_decl:
+            continue
+        if all(f.label != FieldDescriptorProto.LABEL_REPEATED and f.type in SCALAR_TYPES for f in m.field):
+            message = FlatMessage(m)
+            if message.max_size() <= MAX_ONE_BYTE_LENGTH:
+                flat[m.name] = message
+                continue
+        skipped.append(m.name)
+    fixed = []
+    for m in file_descriptor.message_type:
+        if m.name in flat:
+            fixed.append(flat[m.name])
+            continue
+        if m.name in skipped:
+            continue
+        if len(m.oneof_decl) == 1 and all(f.HasField("oneof_index") and f.type == FieldDescriptorProto.TYPE_MESSAGE for f in m.field) and \
+           any(type_name(f) in flat for f in m.field):
+            message = WrapperMessage(m, m.oneof_decl[0].name, [(f, flat.get(type_name(f))) for f in sorted(m.field, key=lambda f: f.number)])
+            if message.max_size() <= MAX_ONE_BYTE_LENGTH:
+                fixed.append(message)
+                continue
+        skipped.append(m.name)
+    # Keep the declaration order of the proto file for the skipped messages
+    skipped = [m.name for m in file_descriptor.message_type if m.name in skipped]
+    return fixed, skipped
+
+# Encoding
+def encode_scalar_lines(field, access: str, indent: str) -> list:
+    tag = tag_bytes(field.number, SCALAR_TYPES[field.type][1])
+    lines = [f"{indent}// {field.name} = {field.number}"]
+    lines += [f"{indent}*p++ = 0x{b:02X};" for b in tag]
+    t = field.type
+    if t in (FieldDescriptorProto.TYPE_INT32, FieldDescriptorProto.TYPE_ENUM):
+        lines.append(f"{indent}p = fixed_put_varint_int32(p, (int32_t) {access});")
+    elif t == FieldDescriptorProto.TYPE_UINT32:
+        lines.append(f"{indent}p = fixed_put_varint32(p, {access});")
+    elif t == FieldDescriptorProto.TYPE_UINT64:
+        lines.append(f"{indent}p = fixed_put_varint64(p, {access});")
+    elif t == FieldDescriptorProto.TYPE_SINT32:
+        lines.append(f"{indent}p = fixed_put_varint32(p, fixed_zigzag32({access}));")
+    elif t == FieldDescriptorProto.TYPE_BOOL:
+        lines.append(f"{indent}*p++ = {access} ? 1U : 0U;")
+    elif t == FieldDescriptorProto.TYPE_FLOAT:
+        lines.append(f"{indent}p = fixed_put_float(p, {access});")
+    else:
+        lines.append(f"{indent}p = fixed_put_fixed32(p, (uint32_t) {access});")
+    return lines
+
+def gen_flat_encoder(message: FlatMessage) -> list:
+    lines = [f"size_t {message.name}_encode_fixed(uint8_t* buf, const {message.name}* msg)", "{", "  uint8_t* p = buf;"]
+    for f in message.fields:
+        if f.label == FieldDescriptorProto.LABEL_OPTIONAL:
+            lines.append(f"  if (msg->has_{f.name})")
+            lines.append("  {")
+            lines += encode_scalar_lines(f, f"msg->{f.name}", "    ")
+            lines.append("  }")
+        else:
+            lines += encode_scalar_lines(f, f"msg->{f.name}", "  ")
+    lines += ["  return (size_t) (p - buf);", "}"]
+    return lines
+
+def gen_wrapper_encoder(message: WrapperMessage) -> list:
+    lines = [f"size_t {message.name}_encode_fixed(uint8_t* buf, const {message.name}* msg)", "{", "  uint8_t* p = buf;",
+             f"  switch (msg->which_{message.oneof_name})", "  {"]
+    for f, sub in message.members:
+        lines.append(f"    case {message.name}_{f.name}_tag:")
+        if sub is None:
+            lines += [f"      // {type_name(f)} isn't fixed-shape, it has to be encoded with nanopb", "      return 0;"]
+            continue
+        lines += [f"      *p++ = 0x{b:02X};" for b in tag_bytes(f.number, 2)]
+        lines.append(f"      // The submessage is at most {sub.max_size()} bytes, so its length takes a single byte")
+        lines.append(f"      p[0] = (uint8_t) {sub.name}_encode_fixed(&p[1], &msg->{message.oneof_name}.{f.name});")
+        lines.append("      p += 1U + p[0];")
+        lines.append("      break;")
+    lines += ["    default:", "      // Nothing selected in the oneof", "      break;", "  }", "  return (size_t) (p - buf);", "}"]
+    return lines
+
+def gen_delimited_encoder(message: FixedMessage) -> list:
+    return [f"size_t {message.name}_encode_fixed_delimited(uint8_t* buf, const {message.name}* msg)", "{",
+            f"  // The message is at most {message.max_size()} bytes, so its length takes a single byte",
+            f"  buf[0] = (uint8_t) {message.name}_encode_fixed(&buf[1], msg);",
+            "  return 1U + buf[0];", "}"]
+
+# Decoding
+def decode_scalar_lines(field, access: str, indent: str) -> list:
+    t = field.type
+    lines = []
+    if SCALAR_TYPES[t][1] == 0:
+        lines.append(f"{indent}if (!fixed_get_varint(&p, end, &value)) return false;")
+        if t in (FieldDescriptorProto.TYPE_INT32, FieldDescriptorProto.TYPE_ENUM):
+            if t == FieldDescriptorProto.TYPE_INT32:
+                lines.append(f"{indent}{access} = (int32_t) (uint32_t) value;")
+            else:
+                lines.append(f"{indent}{access} = ({type_name(field)}) (int32_t) (uint32_t) value;")
+        elif t == FieldDescriptorProto.TYPE_UINT32:
+            lines.append(f"{indent}{access} = (uint32_t) value;")
+        elif t == FieldDescriptorProto.TYPE_UINT64:
+            lines.append(f"{indent}{access} = value;")
+        elif t == FieldDescriptorProto.TYPE_SINT32:
+            lines.append(f"{indent}{access} = fixed_unzigzag32((uint32_t) value);")
+        else:
+            lines.append(f"{indent}{access} = (value != 0U);")
+    else:
+        lines.append(f"{indent}if (end - p < 4) return false;")
+        if t == FieldDescriptorProto.TYPE_FLOAT:
+            lines.append(f"{indent}{access} = fixed_get_float(p);")
+        elif t == FieldDescriptorProto.TYPE_SFIXED32:
+            lines.append(f"{indent}{access} = (int32_t) fixed_get_fixed32(p);")
+        else:
+            lines.append(f"{indent}{access} = fixed_get_fixed32(p);")
+        lines.append(f"{indent}p += 4;")
+    return lines
+
+def gen_flat_decoder(message: FlatMessage) -> list:
+    required = [f for f in message.fields if f.label == FieldDescriptorProto.LABEL_REQUIRED]
+    lines = [f"bool {message.name}_decode_fixed(const uint8_t* buf, size_t size, {message.name}* msg)", "{",
+             f"  {message.name} decoded = {message.name}_init_default;",
+             "  const uint8_t* p = buf;", "  const uint8_t* end = buf + size;", "  uint64_t value;"]
+    if required:
+        lines.append("  uint32_t required_fields = 0;")
+    lines += ["  while (p < end)", "  {", "    uint64_t tag;", "    if (!fixed_get_varint(&p, end, &tag)) return false;", "    switch (tag)", "    {"]
+    for f in message.fields:
+        wire_type = SCALAR_TYPES[f.type][1]
+        lines.append(f"      case 0x{(f.number << 3) | wire_type:X}U: // {f.name}")
+        lines += decode_scalar_lines(f, f"decoded.{f.name}", "        ")
+        if f.label == FieldDescriptorProto.LABEL_OPTIONAL:
+            lines.append(f"        decoded.has_{f.name} = true;")
+        else:
+            lines.append(f"        required_fields |= 1UL << {required.index(f)};")
+        lines.append("        break;")
+    lines += ["      default:", "        if (!fixed_skip_field(&p, end, (uint32_t) tag)) return false;", "        break;", "    }", "  }"]
+    if required:
+        lines += [f"  // Same as nanopb, a message without all of its required fields is rejected",
+                  f"  if (required_fields != 0x{(1 << len(required)) - 1:X}UL) return false;"]
+    lines += ["  *msg = decoded;", "  return true;", "}"]
+    return lines
+
+def gen_wrapper_decoder(message: WrapperMessage) -> list:
+    lines = [f"bool {message.name}_decode_fixed(const uint8_t* buf, size_t size, {message.name}* msg)", "{",
+             "  const uint8_t* p = buf;", "  const uint8_t* end = buf + size;", f"  msg->which_{message.oneof_name} = 0;",
+             "  while (p < end)", "  {", "    uint64_t tag;", "    uint64_t length;", "    if (!fixed_get_varint(&p, end, &tag)) return false;", "    switch (tag)", "    {"]
+    for f, sub in message.members:
+        lines.append(f"      case 0x{(f.number << 3) | 2:X}U: // {f.name}")
+        if sub is None:
+            lines += [f"        // {type_name(f)} isn't fixed-shape, it has to be decoded with nanopb", "        return false;"]
+            continue
+        lines.append("        if (!fixed_get_varint(&p, end, &length) || length > (uint64_t) (end - p)) return false;")
+        lines.append(f"        if (!{sub.name}_decode_fixed(p, (size_t) length, &msg->{message.oneof_name}.{f.name})) return false;")
+        lines.append(f"        msg->which_{message.oneof_name} = {message.name}_{f.name}_tag;")
+        lines.append("        p += length;")
+        lines.append("        break;")
+    lines += ["      default:", "        if (!fixed_skip_field(&p, end, (uint32_t) tag)) return false;", "        break;", "    }", "  }", "  return true;", "}"]
+    return lines
+
+C_HELPERS = r"""
+static inline uint8_t* fixed_put_varint32(uint8_t* p, uint32_t value)
+{
+  while (value >= 0x80U)
+  {
+    *p++ = (uint8_t) (value | 0x80U);
+    value >>= 7;
+  }
+  *p++ = (uint8_t) value;
+  return p;
+}
+
+// 64-bit arithmetic only until the rest of the value fits in 32 bits, e.g. never for a time_us_64() below 71 minutes
+static inline uint8_t* fixed_put_varint64(uint8_t* p, uint64_t value)
+{
+  while (value > 0xFFFFFFFFU)
+  {
+    *p++ = (uint8_t) (value | 0x80U);
+    value >>= 7;
+  }
+  return fixed_put_varint32(p, (uint32_t) value);
+}
+
+// Negative values are sign-extended to 64 bits and take 10 bytes, as they do with nanopb, the upper
+// bytes are constant so no 64-bit arithmetic is needed
+static inline uint8_t* fixed_put_varint_int32(uint8_t* p, int32_t value)
+{
+  if (value >= 0)
+  {
+    return fixed_put_varint32(p, (uint32_t) value);
+  }
+  uint32_t bits = (uint32_t) value;
+  p[0] = (uint8_t) (bits | 0x80U);
+  p[1] = (uint8_t) ((bits >> 7) | 0x80U);
+  p[2] = (uint8_t) ((bits >> 14) | 0x80U);
+  p[3] = (uint8_t) ((bits >> 21) | 0x80U);
+  p[4] = (uint8_t) ((bits >> 28) | 0xF0U);
+  p[5] = 0xFFU;
+  p[6] = 0xFFU;
+  p[7] = 0xFFU;
+  p[8] = 0xFFU;
+  p[9] = 0x01U;
+  return p + 10;
+}
+
+static inline uint32_t fixed_zigzag32(int32_t value)
+{
+  return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static inline int32_t fixed_unzigzag32(uint32_t value)
+{
+  return (int32_t) ((value >> 1) ^ (0U - (value & 1U)));
+}
+
+static inline uint8_t* fixed_put_fixed32(uint8_t* p, uint32_t value)
+{
+  p[0] = (uint8_t) value;
+  p[1] = (uint8_t) (value >> 8);
+  p[2] = (uint8_t) (value >> 16);
+  p[3] = (uint8_t) (value >> 24);
+  return p + 4;
+}
+
+static inline uint8_t* fixed_put_float(uint8_t* p, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return fixed_put_fixed32(p, bits);
+}
+
+static inline uint32_t fixed_get_fixed32(const uint8_t* p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline float fixed_get_float(const uint8_t* p)
+{
+  uint32_t bits = fixed_get_fixed32(p);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static inline bool fixed_get_varint(const uint8_t** p, const uint8_t* end, uint64_t* value)
+{
+  uint64_t result = 0;
+  for (uint32_t shift = 0; shift < 70U && *p < end; shift += 7U)
+  {
+    uint8_t byte = *(*p)++;
+    result |= (uint64_t) (byte & 0x7FU) << shift;
+    if ((byte & 0x80U) == 0U)
+    {
+      *value = result;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Skip a field which isn't part of the message, e.g. added by a newer host
+static inline bool fixed_skip_field(const uint8_t** p, const uint8_t* end, uint32_t tag)
+{
+  uint64_t value;
+  switch (tag & 7U)
+  {
+    case 0:
+      return fixed_get_varint(p, end, &value);
+    case 1:
+      if (end - *p < 8) return false;
+      *p += 8;
+      return true;
+    case 2:
+      if (!fixed_get_varint(p, end, &value) || value > (uint64_t) (end - *p)) return false;
+      *p += value;
+      return true;
+    case 5:
+      if (end - *p < 4) return false;
+      *p += 4;
+      return true;
+    default:
+      return false;
+  }
+}
+"""
+
+def generate(file_descriptor, base_name: str) -> tuple:
+    fixed, skipped = classify(file_descriptor)
+    guard = f"{base_name.upper()}_FIXED_H"
+    pb_header = f"{base_name}.pb.h"
+    header = [f"/* Generated by generate_fixed_codec.py from {file_descriptor.name}, do not edit */",
+              f"#ifndef {guard}", f"#define {guard}", "", "#include <stdint.h>", "#include <stdbool.h>", "#include <stddef.h>", "",
+              f"#include <{pb_header}>", "",
+              "/* Fixed-layout encoders and decoders, the output of the encoders is identical to pb_encode()",
+              " * and pb_encode_ex(..., PB_ENCODE_DELIMITED). The encoders don't check the buffer size, buf has to",
+              " * hold at least <Msg>_FIXED_MAX_SIZE or <Msg>_FIXED_DELIMITED_MAX_SIZE bytes. The decoders don't",
+              " * invoke nanopb callbacks, e.g. submsg_callback. Oneof members which aren't fixed-shape make the",
+              " * encoders return 0 and the decoders return false.", " */"]
+    if skipped:
+        header.append(f"/* Not fixed-shape, use nanopb : {', '.join(skipped)} */")
+    header.append("")
+    for m in fixed:
+        header += [f"#define {m.name}_FIXED_MAX_SIZE  {m.max_size()}",
+                   f"#define {m.name}_FIXED_DELIMITED_MAX_SIZE  {1 + m.max_size()}",
+                   f"size_t {m.name}_encode_fixed(uint8_t* buf, const {m.name}* msg);",
+                   f"size_t {m.name}_encode_fixed_delimited(uint8_t* buf, const {m.name}* msg);",
+                   f"bool {m.name}_decode_fixed(const uint8_t* buf, size_t size, {m.name}* msg);", ""]
+    header += [f"#endif /* {guard} */", ""]
+
+    source = [f"/* Generated by generate_fixed_codec.py from {file_descriptor.name}, do not edit */",
+              f'#include "{base_name}.fixed.h"', "", "#include <string.h>", C_HELPERS]
+    for m in fixed:
+        if isinstance(m, FlatMessage):
+            source += gen_flat_encoder(m) + [""] + gen_flat_decoder(m)
+        else:
+            source += gen_wrapper_encoder(m) + [""] + gen_wrapper_decoder(m)
+        source += [""] + gen_delimited_encoder(m) + [""]
+    return "\n".join(header), "\n".join(source)
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Generate fixed-layout encoders and decoders for the fixed-shape messages of a proto file.")
+    parser.add_argument("proto", type=str, help="The proto file.")
+    parser.add_argument("-I", "--include", action="append", default=[], help="Import search path, passed on to protoc.")
+    parser.add_argument("--output-dir", type=str, default=".", help="Directory for <name>.fixed.h and <name>.fixed.c.")
+    parser.add_argument("--protoc", type=str, default="protoc", help="The protoc executable.")
+    args = parser.parse_args()
+
+    include_dirs = args.include or [os.path.dirname(os.path.abspath(args.proto))]
+    with tempfile.TemporaryDirectory() as tmp_dir:
+        descriptor_path = os.path.join(tmp_dir, "descriptor.pb")
+        subprocess.run([args.protoc] + [f"-I{d}" for d in include_dirs] + [f"--descriptor_set_out={descriptor_path}", args.proto], check=True)
+        with open(descriptor_path, "rb") as descriptor_file:
+            descriptor_set = descriptor_pb2.FileDescriptorSet.FromString(descriptor_file.read())
+
+    file_descriptor = descriptor_set.file[-1]
+    base_name = os.path.splitext(os.path.basename(args.proto))[0]
+    header, source = generate(file_descriptor, base_name)
+    os.makedirs(args.output_dir, exist_ok=True)
+    with open(os.path.join(args.output_dir, f"{base_name}.fixed.h"), "w") as header_file:
+        header_file.write(header)
+    with open(os.path.join(args.output_dir, f"{base_name}.fixed.c"), "w") as source_file:
+        source_file.write(source)
+
+if __name__ == "__main__":
+    sys.exit(main())
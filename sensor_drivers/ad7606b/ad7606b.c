@@ -1,9 +1,41 @@
 #include "ad7606b.h"
+#include "ad7606b_pio.h"
 #include "board_config.h"
 #include <pico/cyw43_arch.h>
 #include <pico/stdlib.h>
 #include <hardware/gpio.h>
 #include <hardware/spi.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/pwm.h>
+#include <hardware/clocks.h>
+
+// DMA channels used in the DMA readout mode, -1 if they have not been claimed
+static int dma_rx_chan = -1;
+static int dma_tx_chan = -1;
+
+// Ping-pong frame buffers, one is filled by the RX DMA while the other is handed to the frame callback
+static uint16_t dma_frame_buf[2][AD7606B_NUM_OF_CHAN];
+// Index of the frame buffer which the RX DMA is currently writing into
+static volatile uint8_t dma_frame_idx = 0;
+// Word clocked out by the TX DMA, the AD7606B ignores DOUT during readout
+static const uint16_t dma_tx_dummy = 0;
+// Number of words read out per conversion
+static uint8_t dma_num_of_words = AD7606B_NUM_OF_CHAN;
+// Callback invoked once a frame has been read out
+static volatile ad7606b_frame_cb dma_frame_cb = NULL;
+// Number of conversions dropped because the previous readout was still in progress
+static volatile uint32_t dma_overruns = 0;
+// Whether the DMA readout mode is active
+static bool dma_active = false;
+// The most recent frame read out in the DMA readout mode
+static const uint16_t* volatile dma_latest_frame = NULL;
+// Timestamps of the falling edge of BUSY for the frame being read out and the frame handed over
+static volatile uint32_t dma_busy_timestamp_us = 0;
+static volatile uint32_t dma_frame_timestamp_us = 0;
+
+// Backend used by ad7606b_sample()
+static enum ad7606bBackend sample_backend = AD7606B_BACKEND_BLOCKING;
 
 void ad7606b_init(void)
 {
@@ -55,20 +87,248 @@ void ad7606b_convert(void)
   __asm volatile ("nop\n");
 }
 
+void ad7606b_set_backend(enum ad7606bBackend backend)
+{
+  sample_backend = backend;
+}
+
+enum ad7606bBackend ad7606b_get_backend(void)
+{
+  return sample_backend;
+}
+
 void ad7606b_sample(int32_t* dest_buf, uint8_t* elementsTransferred, uint8_t active_adc_chan)
 {
   uint16_t adc_data [8];
+
+  // Use the latest frame from a running backend rather than competing with it for the ADC
+  const uint16_t* latest_frame = NULL;
+  if (sample_backend == AD7606B_BACKEND_DMA && dma_active)
+  {
+    latest_frame = dma_latest_frame;
+  }else if (sample_backend == AD7606B_BACKEND_PIO && ad7606b_pio_is_active())
+  {
+    latest_frame = ad7606b_pio_get_latest_frame();
+  }
+  if (latest_frame != NULL)
+  {
+    for (int i=0; i<active_adc_chan; i++)
+    {
+      dest_buf[*elementsTransferred] = (int32_t) (int16_t) latest_frame[i];
+      (*elementsTransferred)++;
+    }
+    return;
+  }
+
+  // Only the active channels are read out
+  ad7606b_read_frame(adc_data, active_adc_chan);
+
+  // The codes are two's complement, sign extend them into the int32_t destination buffer, only convert active adc channels
+  for (int i=0; i<active_adc_chan; i++)
+  {
+    dest_buf[*elementsTransferred] = (int32_t) (int16_t) adc_data[i];
+    (*elementsTransferred)++;
+  }
+}
+
+void ad7606b_read_frame(uint16_t* frame, uint8_t num_of_words)
+{
+  if (num_of_words > AD7606B_NUM_OF_CHAN)
+  {
+    num_of_words = AD7606B_NUM_OF_CHAN;
+  }
   ad7606b_convert();
   // Wait if the ADC is busy
   while (gpio_get(ADC_BUSY_PIN));
-  // Read 8 16-bits in a blocking manner, this reads all 8 channels even though
-  // some channels are not active
-  spi_read16_blocking(ADC_SPI_CHANNEL, 0, adc_data, 8);
+  // Read the requested channels in a blocking manner, the readout stops after the last one
+  spi_read16_blocking(ADC_SPI_CHANNEL, 0, frame, num_of_words);
+}
 
-  // Convert uint16_t to store in int32_t destination buffer, only convert active adc channels
-  for (int i=0; i<active_adc_chan; i++)
+uint8_t ad7606b_mask_to_num_of_words(uint8_t channel_mask)
+{
+  uint8_t num_of_words = 0;
+  while (channel_mask != 0)
   {
-    dest_buf[*elementsTransferred] = (int32_t) adc_data[i];
-    (*elementsTransferred)++;
+    channel_mask >>= 1;
+    num_of_words++;
+  }
+  return num_of_words;
+}
+
+void ad7606b_dma_init(void)
+{
+  if (dma_rx_chan >= 0)
+  {
+    return;
+  }
+  dma_rx_chan = dma_claim_unused_channel(true);
+  dma_tx_chan = dma_claim_unused_channel(true);
+
+  // TX channel keeps writing the same dummy word into the SPI data register to generate SCLK
+  dma_channel_config tx_config = dma_channel_get_default_config(dma_tx_chan);
+  channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_16);
+  channel_config_set_read_increment(&tx_config, false);
+  channel_config_set_write_increment(&tx_config, false);
+  channel_config_set_dreq(&tx_config, spi_get_dreq(ADC_SPI_CHANNEL, true));
+  dma_channel_configure(dma_tx_chan, &tx_config, &spi_get_hw(ADC_SPI_CHANNEL)->dr, &dma_tx_dummy, AD7606B_NUM_OF_CHAN, false);
+
+  // RX channel drains the SPI data register into the active frame buffer
+  dma_channel_config rx_config = dma_channel_get_default_config(dma_rx_chan);
+  channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_16);
+  channel_config_set_read_increment(&rx_config, false);
+  channel_config_set_write_increment(&rx_config, true);
+  channel_config_set_dreq(&rx_config, spi_get_dreq(ADC_SPI_CHANNEL, false));
+  dma_channel_configure(dma_rx_chan, &rx_config, dma_frame_buf[0], &spi_get_hw(ADC_SPI_CHANNEL)->dr, AD7606B_NUM_OF_CHAN, false);
+}
+
+// Invoked on the falling edge of BUSY, the conversion results are ready to be read out
+static void __not_in_flash_func(ad7606b_busy_irq_handler)(void)
+{
+  if (!(gpio_get_irq_event_mask(ADC_BUSY_PIN) & GPIO_IRQ_EDGE_FALL))
+  {
+    return;
+  }
+  gpio_acknowledge_irq(ADC_BUSY_PIN, GPIO_IRQ_EDGE_FALL);
+  uint32_t busy_timestamp_us = time_us_32();
+
+  // The previous frame is still being read out, drop this conversion
+  if (dma_channel_is_busy(dma_rx_chan))
+  {
+    dma_overruns++;
+    return;
+  }
+
+  dma_busy_timestamp_us = busy_timestamp_us;
+  // Re-arm both channels, the RX channel writes into the current ping-pong buffer
+  dma_channel_set_read_addr(dma_tx_chan, &dma_tx_dummy, false);
+  dma_channel_set_trans_count(dma_tx_chan, dma_num_of_words, false);
+  dma_channel_set_write_addr(dma_rx_chan, dma_frame_buf[dma_frame_idx], false);
+  dma_channel_set_trans_count(dma_rx_chan, dma_num_of_words, false);
+  // Start RX and TX together so that no received word is missed
+  dma_start_channel_mask((1U << dma_rx_chan) | (1U << dma_tx_chan));
+}
+
+// Invoked when the RX DMA has written the last word of a frame
+static void __not_in_flash_func(ad7606b_dma_irq_handler)(void)
+{
+  if (!dma_irqn_get_channel_status(AD7606B_DMA_IRQ_IDX, dma_rx_chan))
+  {
+    return;
+  }
+  dma_irqn_acknowledge_channel(AD7606B_DMA_IRQ_IDX, dma_rx_chan);
+
+  // Swap the ping-pong buffers before handing the filled one over
+  const uint16_t* frame = dma_frame_buf[dma_frame_idx];
+  dma_frame_idx ^= 1U;
+  dma_latest_frame = frame;
+  dma_frame_timestamp_us = dma_busy_timestamp_us;
+
+  ad7606b_frame_cb frame_cb = dma_frame_cb;
+  if (frame_cb != NULL)
+  {
+    frame_cb(frame, dma_num_of_words);
+  }
+}
+
+bool ad7606b_dma_start(ad7606b_frame_cb frame_cb, uint8_t num_of_words)
+{
+  if (dma_rx_chan < 0 || num_of_words == 0 || num_of_words > AD7606B_NUM_OF_CHAN)
+  {
+    return false;
+  }
+
+  dma_frame_cb = frame_cb;
+  dma_num_of_words = num_of_words;
+  dma_overruns = 0;
+  dma_frame_idx = 0;
+  dma_latest_frame = NULL;
+
+  if (!dma_active)
+  {
+    // Completion interrupt of the RX channel
+    dma_irqn_set_channel_enabled(AD7606B_DMA_IRQ_IDX, dma_rx_chan, true);
+    irq_add_shared_handler(DMA_IRQ_0 + AD7606B_DMA_IRQ_IDX, ad7606b_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0 + AD7606B_DMA_IRQ_IDX, true);
+
+    // Falling edge of BUSY starts the readout
+    gpio_add_raw_irq_handler(ADC_BUSY_PIN, ad7606b_busy_irq_handler);
+    gpio_acknowledge_irq(ADC_BUSY_PIN, GPIO_IRQ_EDGE_FALL);
+    gpio_set_irq_enabled(ADC_BUSY_PIN, GPIO_IRQ_EDGE_FALL, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    dma_active = true;
+  }
+  return true;
+}
+
+void ad7606b_dma_stop(void)
+{
+  if (!dma_active)
+  {
+    return;
+  }
+  gpio_set_irq_enabled(ADC_BUSY_PIN, GPIO_IRQ_EDGE_FALL, false);
+  gpio_remove_raw_irq_handler(ADC_BUSY_PIN, ad7606b_busy_irq_handler);
+
+  // Let any readout in progress finish before the completion interrupt is removed
+  dma_channel_wait_for_finish_blocking(dma_rx_chan);
+  dma_irqn_set_channel_enabled(AD7606B_DMA_IRQ_IDX, dma_rx_chan, false);
+  dma_irqn_acknowledge_channel(AD7606B_DMA_IRQ_IDX, dma_rx_chan);
+  irq_remove_handler(DMA_IRQ_0 + AD7606B_DMA_IRQ_IDX, ad7606b_dma_irq_handler);
+
+  dma_frame_cb = NULL;
+  dma_active = false;
+}
+
+uint32_t ad7606b_dma_get_overruns(void)
+{
+  return dma_overruns;
+}
+
+uint32_t ad7606b_pwm_start(uint32_t period_us)
+{
+  uint slice = pwm_gpio_to_slice_num(ADC_CONVST_PIN);
+  uint32_t sys_hz = clock_get_hz(clk_sys);
+  uint64_t period_cycles = ((uint64_t) period_us * sys_hz) / 1000000U;
+
+  // Use the smallest integer divider which fits the period into the 16-bit counter
+  uint64_t clkdiv = (period_cycles + 0xFFFFU) / 0x10000U;
+  if (clkdiv == 0 || clkdiv > 255)
+  {
+    return 0;
+  }
+  uint32_t wrap = (uint32_t)(period_cycles / clkdiv) - 1;
+  uint32_t pwm_hz = sys_hz / (uint32_t) clkdiv;
+  uint32_t level = (uint32_t)(((uint64_t) AD7606B_CONVST_PULSE_NS * pwm_hz + 999999999U) / 1000000000U);
+  if (level == 0)
+  {
+    level = 1;
+  }
+
+  pwm_config config = pwm_get_default_config();
+  pwm_config_set_clkdiv_int(&config, (uint32_t) clkdiv);
+  pwm_config_set_wrap(&config, wrap);
+  pwm_init(slice, &config, false);
+  pwm_set_gpio_level(ADC_CONVST_PIN, level);
+  gpio_set_function(ADC_CONVST_PIN, GPIO_FUNC_PWM);
+  pwm_set_enabled(slice, true);
+
+  return (uint32_t)(((uint64_t)(wrap + 1) * clkdiv * 1000000000ULL) / sys_hz);
+}
+
+void ad7606b_pwm_stop(void)
+{
+  pwm_set_enabled(pwm_gpio_to_slice_num(ADC_CONVST_PIN), false);
+  // Hand CONVST back to software in its idle state
+  gpio_init(ADC_CONVST_PIN);
+  gpio_set_dir(ADC_CONVST_PIN, GPIO_OUT);
+  gpio_put(ADC_CONVST_PIN, 0);
+}
+
+uint32_t ad7606b_get_frame_timestamp_us(void)
+{
+  if (sample_backend == AD7606B_BACKEND_PIO)
+  {
+    return ad7606b_pio_get_frame_timestamp_us();
   }
+  return dma_frame_timestamp_us;
 }
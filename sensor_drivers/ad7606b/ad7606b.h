@@ -2,10 +2,31 @@
 #define AD7606B_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define ADC_SPI_CHANNEL      spi1
 #define SPI1_SCLK_FREQ       16*1000*1000  // Frequency of SCLK for AD7606B
 #define ADC_SPI_DATA_BITS    16            // The number of data bits for each SPI transfer
+#define AD7606B_NUM_OF_CHAN  8             // The number of analogue input channels on the AD7606B
+#define AD7606B_DMA_IRQ_IDX  1             // The DMA IRQ line (DMA_IRQ_0 or DMA_IRQ_1) used for readout completion
+#define AD7606B_CONV_TIME_NS 4000          // Nominal conversion time with oversampling ratio of 4
+#define AD7606B_CONVST_PULSE_NS 50         // Width of the CONVST pulse generated by the PWM sampling clock
+
+// Backends used to acquire samples from the ADC
+enum ad7606bBackend
+{
+  AD7606B_BACKEND_BLOCKING, // Convert and read out on the CPU, BUSY is polled
+  AD7606B_BACKEND_DMA,      // Conversions started on the CPU, read out with DMA on the falling edge of BUSY
+  AD7606B_BACKEND_PIO       // Conversions and read out both owned by a PIO state machine, drained with DMA
+};
+
+/**
+ * @brief Callback invoked in interrupt context once a frame has been read out from the ADC
+ *
+ * @param frame The pointer to the frame, which holds one 16-bit word per channel read out
+ * @param num_of_words The number of words in the frame
+ */
+typedef void (*ad7606b_frame_cb)(const uint16_t* frame, uint8_t num_of_words);
 
 
 // Function prototypes
@@ -24,15 +45,109 @@ void ad7606b_reset(void);
  */
 void ad7606b_convert(void);
 
+/**
+ * @brief Select the backend used by ad7606b_sample()
+ *
+ * @param backend The backend to use, the DMA and PIO backends still have to be started with
+ * ad7606b_dma_start() or ad7606b_pio_start()
+ */
+void ad7606b_set_backend(enum ad7606bBackend backend);
+
+/**
+ * @brief Get the backend used by ad7606b_sample()
+ */
+enum ad7606bBackend ad7606b_get_backend(void);
+
 /**
  * @brief Sample from the ADC, which includes the conversion and read out
  *
+ * With the blocking backend, or when the selected backend is not running, a conversion is
+ * started and read out in a blocking manner. Otherwise the most recent frame read out by the
+ * running DMA or PIO backend is returned without touching the ADC. The two's complement codes
+ * are sign extended.
+ *
  * @param dest_buf The pointer to the starting address of the destination buffer
  * @param elementsTransferred The number of existing elements in the destination buffer, the correct starting address to populate from will be calculated
  * @param active_adc_chan The number of active adc channels
  */
 void ad7606b_sample(int32_t* dest_buf, uint8_t* elementsTransferred, uint8_t active_adc_chan);
 
+/**
+ * @brief Start a conversion and read out the first num_of_words channels in a blocking manner
+ *
+ * The readout stops after the last requested channel, the remaining channels are not clocked out.
+ *
+ * @param frame The pointer to the frame, which receives one 16-bit word per channel
+ * @param num_of_words The number of channels to read out, at most AD7606B_NUM_OF_CHAN
+ */
+void ad7606b_read_frame(uint16_t* frame, uint8_t num_of_words);
+
+/**
+ * @brief Get the number of words which have to be read out to cover every channel in a channel mask
+ *
+ * @param channel_mask The bitmask of active channels, bit n = channel n
+ * @return The index of the last active channel plus one, 0 if no channel is active
+ */
+uint8_t ad7606b_mask_to_num_of_words(uint8_t channel_mask);
+
+/**
+ * @brief Claim the DMA channels used to read out the ADC without CPU involvement, only needs to be called once
+ */
+void ad7606b_dma_init(void);
+
+/**
+ * @brief Start the DMA readout mode on the calling core
+ *
+ * Once started, every falling edge of BUSY kicks off a SPI RX DMA (paired with a TX DMA
+ * which clocks out dummy words) into one of two ping-pong frame buffers. frame_cb is called
+ * from the DMA completion interrupt with the frame that has just been filled, so the caller
+ * only has to start conversions with ad7606b_convert(). The interrupts are registered on the
+ * calling core, so this has to be called from the core which starts the conversions.
+ *
+ * @param frame_cb The callback to invoke once a frame has been read out
+ * @param num_of_words The number of channels to read out per conversion, at most AD7606B_NUM_OF_CHAN
+ * @return true if the DMA readout mode has been started
+ */
+bool ad7606b_dma_start(ad7606b_frame_cb frame_cb, uint8_t num_of_words);
+
+/**
+ * @brief Stop the DMA readout mode, it has to be called from the core which started it
+ */
+void ad7606b_dma_stop(void);
+
+/**
+ * @brief Drive CONVST from a PWM slice so that conversions are paced in hardware
+ *
+ * Used together with ad7606b_dma_start(), every PWM period starts a conversion and its falling
+ * edge of BUSY starts the DMA readout, so no software timer is involved in the data path.
+ *
+ * @param period_us The sampling period in micro-seconds
+ * @return The sampling period achieved by the PWM slice in nano-seconds, 0 if the period can't be generated
+ */
+uint32_t ad7606b_pwm_start(uint32_t period_us);
+
+/**
+ * @brief Stop driving CONVST from the PWM slice and hand it back to software
+ */
+void ad7606b_pwm_stop(void);
+
+/**
+ * @brief Get the timestamp of the frame most recently handed to an ad7606b_frame_cb
+ *
+ * It is the falling edge of BUSY with the DMA backend, and the end of the readout with the PIO backend.
+ * It is meant to be called from within the frame callback.
+ *
+ * @return The timestamp in micro-seconds, from time_us_32()
+ */
+uint32_t ad7606b_get_frame_timestamp_us(void);
+
+/**
+ * @brief Get the number of conversions which finished while the previous readout was still in progress
+ *
+ * @return The number of dropped frames since ad7606b_dma_start()
+ */
+uint32_t ad7606b_dma_get_overruns(void);
+
 
 #endif /* AD7606B_h */
 
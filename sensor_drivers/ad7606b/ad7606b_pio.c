@@ -0,0 +1,263 @@
+#include "ad7606b_pio.h"
+#include "board_config.h"
+#include <pico/stdlib.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/clocks.h>
+
+#include "ad7606b_acq.pio.h"
+
+// CS and SCLK are driven with side-set, so they have to be consecutive pins
+_Static_assert(SPI1_SCK_PIN == SPI1_CS_PIN + 1, "SPI1_SCK_PIN has to follow SPI1_CS_PIN for the PIO side-set");
+
+// PIO block and state machine running the acquisition program
+static PIO acq_pio = NULL;
+static uint acq_sm = 0;
+static uint acq_offset = 0;
+
+// The data channel drains the RX FIFO a frame at a time and chains to the control channel, which writes the
+// address of the next frame buffer into the write address trigger of the data channel, so the DMA moves on to
+// the other ping-pong buffer however late the interrupt is
+static int acq_data_chan = -1;
+static int acq_ctrl_chan = -1;
+static uint16_t acq_frame_buf[2][AD7606B_NUM_OF_CHAN];
+// Write addresses read by the control channel in a ring, alternating between the ping-pong buffers, where the
+// control channel is in the ring counts the frames, so a late interrupt knows how many it has missed
+#define ACQ_ADDR_RING_BITS   8
+#define ACQ_NUM_OF_ADDRS     ((1U << ACQ_ADDR_RING_BITS) / sizeof(uint32_t))
+static uint32_t acq_write_addrs[ACQ_NUM_OF_ADDRS] __attribute__((aligned(1U << ACQ_ADDR_RING_BITS)));
+// Index in the ring of the frame most recently handed to the callback
+static uint32_t acq_last_frame_idx = 0;
+// The most recently completed frame
+static const uint16_t* volatile acq_latest_frame = NULL;
+
+static uint8_t acq_num_of_words = AD7606B_NUM_OF_CHAN;
+static volatile ad7606b_frame_cb acq_frame_cb = NULL;
+static volatile uint32_t acq_stalls = 0;
+static volatile uint32_t acq_missed_frames = 0;
+static volatile uint32_t acq_frame_timestamp_us = 0;
+static uint32_t acq_period_ns = 0;
+static bool acq_active = false;
+
+// Invoked when the data channel has filled a frame buffer
+static void __not_in_flash_func(ad7606b_pio_dma_irq_handler)(void)
+{
+  uint32_t timestamp_us = time_us_32();
+  if (!dma_irqn_get_channel_status(AD7606B_DMA_IRQ_IDX, acq_data_chan))
+  {
+    return;
+  }
+  dma_irqn_acknowledge_channel(AD7606B_DMA_IRQ_IDX, acq_data_chan);
+
+  // The control channel has already pointed the data channel at the buffer after the completed one, it only
+  // takes a few cycles after the completion, far less than the interrupt entry
+  uint32_t next_idx = (dma_hw->ch[acq_ctrl_chan].read_addr - (uint32_t) (uintptr_t) acq_write_addrs) / sizeof(uint32_t);
+  uint32_t frame_idx = (next_idx - 2U) % ACQ_NUM_OF_ADDRS;
+  // A frame completed since the acknowledge has already been handed out, its interrupt is still pending
+  if (frame_idx == acq_last_frame_idx)
+  {
+    return;
+  }
+  // Only the most recent frame is handed out when the interrupt comes more than a frame late
+  acq_missed_frames += (frame_idx - acq_last_frame_idx - 1U) % ACQ_NUM_OF_ADDRS;
+  acq_last_frame_idx = frame_idx;
+
+  // An RX stall means a conversion has been held back as the FIFO was not drained in time
+  uint32_t stall_mask = 1U << (PIO_FDEBUG_RXSTALL_LSB + acq_sm);
+  if (acq_pio->fdebug & stall_mask)
+  {
+    acq_pio->fdebug = stall_mask;
+    acq_stalls++;
+  }
+
+  const uint16_t* frame = acq_frame_buf[frame_idx % 2U];
+  acq_latest_frame = frame;
+  acq_frame_timestamp_us = timestamp_us;
+  ad7606b_frame_cb frame_cb = acq_frame_cb;
+  if (frame_cb != NULL)
+  {
+    frame_cb(frame, acq_num_of_words);
+  }
+}
+
+bool ad7606b_pio_init(PIO pio)
+{
+  if (acq_pio != NULL)
+  {
+    return true;
+  }
+  if (!pio_can_add_program(pio, &ad7606b_acq_program))
+  {
+    return false;
+  }
+  int sm = pio_claim_unused_sm(pio, false);
+  if (sm < 0)
+  {
+    return false;
+  }
+  acq_sm = (uint) sm;
+  acq_offset = pio_add_program(pio, &ad7606b_acq_program);
+  acq_pio = pio;
+
+  acq_data_chan = dma_claim_unused_channel(true);
+  acq_ctrl_chan = dma_claim_unused_channel(true);
+  for (uint32_t i = 0; i < ACQ_NUM_OF_ADDRS; i++)
+  {
+    acq_write_addrs[i] = (uint32_t) (uintptr_t) acq_frame_buf[i % 2U];
+  }
+
+  // The data channel drains the RX FIFO into a frame buffer, then has the control channel restart it
+  dma_channel_config data_config = dma_channel_get_default_config(acq_data_chan);
+  channel_config_set_transfer_data_size(&data_config, DMA_SIZE_16);
+  channel_config_set_read_increment(&data_config, false);
+  channel_config_set_write_increment(&data_config, true);
+  channel_config_set_dreq(&data_config, pio_get_dreq(acq_pio, acq_sm, false));
+  channel_config_set_chain_to(&data_config, acq_ctrl_chan);
+  dma_channel_configure(acq_data_chan, &data_config, acq_frame_buf[0], &acq_pio->rxf[acq_sm], AD7606B_NUM_OF_CHAN, false);
+
+  // The control channel writes the next address of the ring into the write address trigger of the data channel,
+  // which reloads its transfer count as it is triggered
+  dma_channel_config ctrl_config = dma_channel_get_default_config(acq_ctrl_chan);
+  channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+  channel_config_set_read_increment(&ctrl_config, true);
+  channel_config_set_write_increment(&ctrl_config, false);
+  channel_config_set_ring(&ctrl_config, false, ACQ_ADDR_RING_BITS);
+  dma_channel_configure(acq_ctrl_chan, &ctrl_config, &dma_hw->ch[acq_data_chan].al2_write_addr_trig, &acq_write_addrs[1], 1, false);
+  return true;
+}
+
+bool ad7606b_pio_start(ad7606b_frame_cb frame_cb, uint8_t num_of_words, uint32_t period_us)
+{
+  if (acq_pio == NULL || acq_active || num_of_words == 0 || num_of_words > AD7606B_NUM_OF_CHAN)
+  {
+    return false;
+  }
+
+  // Run the state machine at twice SCLK, as each bit takes two cycles
+  uint32_t sys_hz = clock_get_hz(clk_sys);
+  uint32_t clkdiv = (sys_hz + 2 * SPI1_SCLK_FREQ - 1) / (2 * SPI1_SCLK_FREQ);
+  // Integer divider only, a fractional divider adds a cycle of jitter to every edge
+  uint32_t sm_hz = sys_hz / clkdiv;
+
+  // Work out the idle delay which makes up the rest of the sampling period
+  uint32_t bits = (uint32_t) num_of_words * ADC_SPI_DATA_BITS;
+  uint64_t period_cycles = ((uint64_t) period_us * sm_hz) / 1000000U;
+  uint64_t busy_cycles = ((uint64_t) AD7606B_CONV_TIME_NS * sm_hz) / 1000000000U;
+  uint64_t used_cycles = AD7606B_ACQ_FIXED_CYCLES + busy_cycles + bits * AD7606B_ACQ_CYCLES_PER_BIT;
+  uint32_t delay = (period_cycles > used_cycles) ? (uint32_t)(period_cycles - used_cycles) : 0;
+  acq_period_ns = (uint32_t)(((used_cycles + delay) * 1000000000ULL) / sm_hz);
+
+  acq_frame_cb = frame_cb;
+  acq_num_of_words = num_of_words;
+  acq_latest_frame = NULL;
+  acq_stalls = 0;
+  acq_missed_frames = 0;
+
+  // Hand CONVST, CS and SCLK over to the PIO, keeping CS high and the rest low
+  uint32_t out_mask = (1U << ADC_CONVST_PIN) | (1U << SPI1_CS_PIN) | (1U << SPI1_SCK_PIN);
+  pio_sm_set_pins_with_mask(acq_pio, acq_sm, (1U << SPI1_CS_PIN), out_mask);
+  pio_sm_set_pindirs_with_mask(acq_pio, acq_sm, out_mask, out_mask);
+  pio_gpio_init(acq_pio, ADC_CONVST_PIN);
+  pio_gpio_init(acq_pio, SPI1_CS_PIN);
+  pio_gpio_init(acq_pio, SPI1_SCK_PIN);
+
+  pio_sm_config config = ad7606b_acq_program_get_default_config(acq_offset);
+  sm_config_set_set_pins(&config, ADC_CONVST_PIN, 1);
+  sm_config_set_sideset_pins(&config, SPI1_CS_PIN);
+  sm_config_set_in_pins(&config, SPI1_RX_PIN);
+  sm_config_set_jmp_pin(&config, ADC_BUSY_PIN);
+  // Shift in MSB first, push every 16 bits so each channel is one FIFO entry
+  sm_config_set_in_shift(&config, false, true, ADC_SPI_DATA_BITS);
+  sm_config_set_clkdiv_int_frac(&config, clkdiv, 0);
+  pio_sm_init(acq_pio, acq_sm, acq_offset, &config);
+
+  // Preload Y with the bit count and OSR with the idle delay through the TX FIFO,
+  // the side-set value keeps CS high while the instructions are executed
+  uint32_t side_idle = pio_encode_sideset(2, 0b01);
+  pio_sm_put_blocking(acq_pio, acq_sm, bits - 1);
+  pio_sm_exec(acq_pio, acq_sm, pio_encode_pull(false, true) | side_idle);
+  pio_sm_exec(acq_pio, acq_sm, pio_encode_out(pio_y, 32) | side_idle);
+  pio_sm_put_blocking(acq_pio, acq_sm, delay);
+  pio_sm_exec(acq_pio, acq_sm, pio_encode_pull(false, true) | side_idle);
+  // The TX FIFO is not needed any more, join it to the RX FIFO for more slack on the DMA
+  hw_set_bits(&acq_pio->sm[acq_sm].shiftctrl, PIO_SM0_SHIFTCTRL_FJOIN_RX_BITS);
+
+  // The data channel starts with the first buffer and the control channel with the address of the second one,
+  // only the data channel raises the interrupt
+  dma_channel_set_read_addr(acq_ctrl_chan, &acq_write_addrs[1], false);
+  dma_channel_set_write_addr(acq_data_chan, acq_frame_buf[0], false);
+  dma_channel_set_trans_count(acq_data_chan, num_of_words, false);
+  acq_last_frame_idx = ACQ_NUM_OF_ADDRS - 1U;
+  dma_irqn_acknowledge_channel(AD7606B_DMA_IRQ_IDX, acq_data_chan);
+  dma_irqn_set_channel_enabled(AD7606B_DMA_IRQ_IDX, acq_data_chan, true);
+  irq_add_shared_handler(DMA_IRQ_0 + AD7606B_DMA_IRQ_IDX, ad7606b_pio_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+  irq_set_enabled(DMA_IRQ_0 + AD7606B_DMA_IRQ_IDX, true);
+  dma_channel_start(acq_data_chan);
+
+  acq_pio->fdebug = 1U << (PIO_FDEBUG_RXSTALL_LSB + acq_sm);
+  pio_sm_set_enabled(acq_pio, acq_sm, true);
+  acq_active = true;
+  return true;
+}
+
+void ad7606b_pio_stop(void)
+{
+  if (!acq_active)
+  {
+    return;
+  }
+  pio_sm_set_enabled(acq_pio, acq_sm, false);
+
+  // Abort both chained channels at once, aborting them one by one may let the chain trigger the other
+  uint32_t chan_mask = (1U << acq_data_chan) | (1U << acq_ctrl_chan);
+  dma_irqn_set_channel_enabled(AD7606B_DMA_IRQ_IDX, acq_data_chan, false);
+  dma_hw->abort = chan_mask;
+  while (dma_hw->abort & chan_mask)
+  {
+    tight_loop_contents();
+  }
+  dma_irqn_acknowledge_channel(AD7606B_DMA_IRQ_IDX, acq_data_chan);
+  irq_remove_handler(DMA_IRQ_0 + AD7606B_DMA_IRQ_IDX, ad7606b_pio_dma_irq_handler);
+  pio_sm_clear_fifos(acq_pio, acq_sm);
+
+  // Hand the pins back to the SPI peripheral and CONVST back to software
+  gpio_set_function(SPI1_CS_PIN, GPIO_FUNC_SPI);
+  gpio_set_function(SPI1_SCK_PIN, GPIO_FUNC_SPI);
+  gpio_init(ADC_CONVST_PIN);
+  gpio_set_dir(ADC_CONVST_PIN, GPIO_OUT);
+  gpio_put(ADC_CONVST_PIN, 0);
+
+  acq_frame_cb = NULL;
+  acq_active = false;
+}
+
+bool ad7606b_pio_is_active(void)
+{
+  return acq_active;
+}
+
+const uint16_t* ad7606b_pio_get_latest_frame(void)
+{
+  return acq_latest_frame;
+}
+
+uint32_t ad7606b_pio_get_frame_timestamp_us(void)
+{
+  return acq_frame_timestamp_us;
+}
+
+uint32_t ad7606b_pio_get_period_ns(void)
+{
+  return acq_period_ns;
+}
+
+uint32_t ad7606b_pio_get_stalls(void)
+{
+  return acq_stalls;
+}
+
+uint32_t ad7606b_pio_get_missed_frames(void)
+{
+  return acq_missed_frames;
+}
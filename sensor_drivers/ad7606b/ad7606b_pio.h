@@ -0,0 +1,83 @@
+#ifndef AD7606B_PIO_H
+#define AD7606B_PIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <hardware/pio.h>
+
+#include "ad7606b.h"
+
+// Function prototypes
+/**
+ * @brief Load the acquisition program into a PIO block and claim a state machine and two DMA channels, only needs to be called once
+ *
+ * @param pio The PIO block to load the program into, e.g. pio1 as pio0 is used by the CYW43 driver
+ * @return true if the program has been loaded and the resources claimed
+ */
+bool ad7606b_pio_init(PIO pio);
+
+/**
+ * @brief Start the PIO acquisition backend on the calling core
+ *
+ * The state machine generates CONVST at a fixed period, waits on BUSY, clocks out the
+ * requested channels and pushes one 16-bit word per channel into its RX FIFO. A DMA channel
+ * drains the FIFO into ping-pong frame buffers, and a second DMA channel points it at the other
+ * buffer after every frame, so acquisition runs without CPU involvement however late the
+ * interrupt is; frame_cb is called from the DMA completion interrupt with the latest frame.
+ * The CONVST cadence is counted in state machine cycles from the end of the previous
+ * readout, so it depends on the conversion time of the ADC but not on interrupt latency.
+ *
+ * @param frame_cb The callback to invoke once a frame has been read out
+ * @param num_of_words The number of channels to read out per conversion, at most AD7606B_NUM_OF_CHAN
+ * @param period_us The sampling period in micro-seconds, it is clamped to the fastest achievable period
+ * @return true if the state machine has been started
+ */
+bool ad7606b_pio_start(ad7606b_frame_cb frame_cb, uint8_t num_of_words, uint32_t period_us);
+
+/**
+ * @brief Stop the PIO acquisition backend and hand the pins back to the SPI peripheral
+ */
+void ad7606b_pio_stop(void);
+
+/**
+ * @brief Whether the PIO acquisition backend is running
+ */
+bool ad7606b_pio_is_active(void);
+
+/**
+ * @brief Get the most recent frame read out by the PIO acquisition backend
+ *
+ * @return A pointer to the frame, or NULL if no frame has been read out since ad7606b_pio_start()
+ */
+const uint16_t* ad7606b_pio_get_latest_frame(void);
+
+/**
+ * @brief Get the timestamp of the frame most recently handed to the frame callback
+ *
+ * @return The time at which the DMA completed the frame in micro-seconds, from time_us_32()
+ */
+uint32_t ad7606b_pio_get_frame_timestamp_us(void);
+
+/**
+ * @brief Get the sampling period achieved by the state machine
+ *
+ * @return The sampling period in nano-seconds, based on the nominal conversion time
+ */
+uint32_t ad7606b_pio_get_period_ns(void);
+
+/**
+ * @brief Get the number of times the state machine stalled because the RX FIFO was full
+ *
+ * @return The number of stalls since ad7606b_pio_start(), each stall delays a conversion
+ */
+uint32_t ad7606b_pio_get_stalls(void);
+
+/**
+ * @brief Get the number of frames which were not handed to the frame callback as the DMA completion
+ * interrupt came more than a frame late
+ *
+ * @return The number of missed frames since ad7606b_pio_start(), counted up to 62 per interrupt
+ */
+uint32_t ad7606b_pio_get_missed_frames(void);
+
+#endif /* AD7606B_PIO_H */
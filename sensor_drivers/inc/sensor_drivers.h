@@ -2,5 +2,6 @@
 #define DRIVERS_H
 
 #include "ad7606b.h"
+#include "ad7606b_pio.h"
 
 #endif /* DRIVERS_H */
\ No newline at end of file
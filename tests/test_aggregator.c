@@ -0,0 +1,158 @@
+#include "aggregator.h"
+#include "test_check.h"
+
+#include <math.h>
+
+#define MAX_WINDOW  4096U
+#define SCALE       (1 << AGGREGATOR_FRACTION_BITS)
+
+static struct aggregator aggregator;
+static int32_t frames[MAX_WINDOW][AGGREGATOR_MAX_CHANNELS];
+
+static uint32_t lcg_state = 1;
+
+static uint32_t lcg_next(void)
+{
+  lcg_state = lcg_state * 1664525U + 1013904223U;
+  return lcg_state;
+}
+
+// Push a window of frames, checking that only the last one completes it
+static void push_window(uint32_t window_frames, uint8_t num_of_channels, struct aggregatorStats* output)
+{
+  CHECK(aggregator_init(&aggregator, window_frames, num_of_channels));
+  for (uint32_t i = 0; i < window_frames; i++)
+  {
+    CHECK_EQ(aggregator_push(&aggregator, frames[i], output), i + 1U == window_frames);
+  }
+}
+
+// Check a record against the statistics of the window in double precision, the mean and RMS have
+// AGGREGATOR_FRACTION_BITS fractional bits and are rounded towards zero
+static void check_against_double(uint32_t window_frames, uint8_t num_of_channels, const struct aggregatorStats* output)
+{
+  for (uint8_t c = 0; c < num_of_channels; c++)
+  {
+    int32_t min = INT32_MAX;
+    int32_t max = INT32_MIN;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    for (uint32_t i = 0; i < window_frames; i++)
+    {
+      int32_t value = frames[i][c];
+      min = (value < min) ? value : min;
+      max = (value > max) ? value : max;
+      sum += value;
+      sum_sq += (double) value * value;
+    }
+    // Saturated to the range of the record
+    double mean = fmax(fmin(sum / window_frames * SCALE, INT32_MAX), INT32_MIN);
+    double rms = fmin(sqrt(sum_sq / window_frames) * SCALE, UINT32_MAX);
+    CHECK_EQ(output[c].min, min);
+    CHECK_EQ(output[c].max, max);
+    CHECK(fabs((double) output[c].mean - mean) <= 1.0);
+    CHECK(fabs((double) output[c].rms - rms) <= 1.0 + rms * 1e-12);
+  }
+}
+
+static void test_invalid_arguments(void)
+{
+  CHECK(!aggregator_init(&aggregator, 0, 1));
+  CHECK(!aggregator_init(&aggregator, 10, 0));
+  CHECK(!aggregator_init(&aggregator, 10, AGGREGATOR_MAX_CHANNELS + 1U));
+  CHECK(aggregator_init(&aggregator, 1, 1));
+  CHECK(aggregator_init(&aggregator, AGGREGATOR_MAX_WINDOW, AGGREGATOR_MAX_CHANNELS));
+}
+
+// Random windows of ADC codes and of values up to 24 bits, with offsets of either sign
+static void test_random_windows(void)
+{
+  const uint32_t windows[] = {1, 2, 7, 100, 1000, MAX_WINDOW};
+  const uint32_t value_bits[] = {4, 16, 24};
+  struct aggregatorStats output[AGGREGATOR_MAX_CHANNELS];
+  for (uint32_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++)
+  {
+    for (uint32_t b = 0; b < sizeof(value_bits) / sizeof(value_bits[0]); b++)
+    {
+      for (uint32_t i = 0; i < windows[w]; i++)
+      {
+        for (uint8_t c = 0; c < AGGREGATOR_MAX_CHANNELS; c++)
+        {
+          int32_t offset = ((int32_t) c - 4) * (1 << (value_bits[b] - 3U));
+          frames[i][c] = offset + (int32_t) (lcg_next() >> (32U - value_bits[b])) - (1 << (value_bits[b] - 1U));
+        }
+      }
+      push_window(windows[w], AGGREGATOR_MAX_CHANNELS, output);
+      check_against_double(windows[w], AGGREGATOR_MAX_CHANNELS, output);
+    }
+  }
+}
+
+// The next frame after a record starts a new window, nothing is carried over
+static void test_consecutive_windows(void)
+{
+  struct aggregatorStats output[2];
+  CHECK(aggregator_init(&aggregator, 4, 2));
+  const int32_t first[2] = {1000, -1000};
+  const int32_t second[2] = {-3, 5};
+  for (uint32_t i = 0; i < 4U; i++)
+  {
+    CHECK_EQ(aggregator_push(&aggregator, first, output), i == 3U);
+  }
+  CHECK_EQ(output[0].mean, 1000 * SCALE);
+  CHECK_EQ(output[1].rms, 1000U * SCALE);
+  for (uint32_t i = 0; i < 4U; i++)
+  {
+    CHECK_EQ(aggregator_push(&aggregator, second, output), i == 3U);
+  }
+  CHECK_EQ(output[0].min, -3);
+  CHECK_EQ(output[0].max, -3);
+  CHECK_EQ(output[0].mean, -3 * SCALE);
+  CHECK_EQ(output[0].rms, 3U * SCALE);
+  CHECK_EQ(output[1].rms, 5U * SCALE);
+}
+
+// Full scale int32 values, whose squares overflow a 64-bit sum after four frames, the RMS saturates instead
+// of wrapping around to a small value, the mean and RMS which don't fit with the fractional bits saturate too
+static void test_int32_extremes(void)
+{
+  struct aggregatorStats output[3];
+  for (uint32_t i = 0; i < 64U; i++)
+  {
+    frames[i][0] = INT32_MIN;
+    frames[i][1] = (i % 2U) ? INT32_MAX : INT32_MIN;
+    // Just below the largest RMS a record holds
+    frames[i][2] = (1 << 24) - 1;
+  }
+  for (uint32_t window_frames = 1; window_frames <= 64U; window_frames *= 2U)
+  {
+    push_window(window_frames, 3, output);
+    CHECK_EQ(output[0].min, INT32_MIN);
+    CHECK_EQ(output[0].max, INT32_MIN);
+    CHECK_EQ(output[0].mean, INT32_MIN);
+    CHECK_EQ(output[0].rms, UINT32_MAX);
+    CHECK_EQ(output[1].rms, UINT32_MAX);
+    CHECK_EQ(output[1].mean, (window_frames == 1U) ? INT32_MIN : -SCALE / 2);
+    CHECK_EQ(output[2].mean, INT32_MAX);
+    CHECK_EQ(output[2].rms, (uint32_t) ((1 << 24) - 1) * SCALE);
+  }
+
+  // A long window of values whose sum of squares reaches 2^62 without saturating, the RMS is still exact
+  CHECK(aggregator_init(&aggregator, 1U << 20, 1));
+  const int32_t value[1] = {-(1 << 21)};
+  for (uint32_t i = 0; i < (1U << 20) - 1U; i++)
+  {
+    aggregator_push(&aggregator, value, output);
+  }
+  CHECK(aggregator_push(&aggregator, value, output));
+  CHECK_EQ(output[0].rms, (uint32_t) (1 << 21) * SCALE);
+}
+
+int main(void)
+{
+  test_invalid_arguments();
+  test_random_windows();
+  test_consecutive_windows();
+  test_int32_extremes();
+  return TEST_RESULT();
+}
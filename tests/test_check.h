@@ -0,0 +1,38 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <stdio.h>
+
+/*
+ * Minimal checks for the host unit tests, a failed check is printed with its location and the test goes on,
+ * so that one run shows every failure, TEST_RESULT() is what main() returns to ctest.
+ */
+static int test_failures = 0;
+
+#define CHECK(cond) \
+  do \
+  { \
+    if (!(cond)) \
+    { \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      test_failures++; \
+    } \
+  } while (0)
+
+// Same as CHECK() for two integers, printing both values on failure
+#define CHECK_EQ(a, b) \
+  do \
+  { \
+    long long check_a = (long long) (a); \
+    long long check_b = (long long) (b); \
+    if (check_a != check_b) \
+    { \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", __FILE__, __LINE__, #a, #b, check_a, check_b); \
+      test_failures++; \
+    } \
+  } while (0)
+
+#define TEST_RESULT() \
+  ((test_failures == 0) ? (printf("PASSED\n"), 0) : (printf("FAILED : %d checks\n", test_failures), 1))
+
+#endif /* TEST_CHECK_H */
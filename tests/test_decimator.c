@@ -0,0 +1,159 @@
+#include "decimator.h"
+#include "test_check.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define PI  3.14159265358979323846
+
+// Output frames the filter chain takes to settle after a step, the FIR delay line plus the CIC
+#define SETTLING_OUTPUTS  (DECIMATOR_FIR_NUM_OF_TAPS + DECIMATOR_CIC_ORDER)
+
+static struct decimator decimator;
+
+// Push num_of_inputs frames of a constant value on every channel, returns the number of outputs and
+// leaves the last one in output
+static uint32_t push_constant(int32_t value, uint32_t num_of_inputs, int32_t* output)
+{
+  int32_t input[DECIMATOR_MAX_CHANNELS];
+  for (uint8_t c = 0; c < DECIMATOR_MAX_CHANNELS; c++)
+  {
+    input[c] = value;
+  }
+  uint32_t num_of_outputs = 0;
+  for (uint32_t i = 0; i < num_of_inputs; i++)
+  {
+    num_of_outputs += decimator_push(&decimator, input, output) ? 1U : 0U;
+  }
+  return num_of_outputs;
+}
+
+// Peak output amplitude of a sine of the given input frequency, as a fraction of the input rate, once the
+// filter chain has settled
+static double sine_gain(uint32_t ratio, double frequency, double amplitude)
+{
+  CHECK(decimator_init(&decimator, ratio, 1));
+  double peak = 0.0;
+  uint32_t num_of_outputs = 0;
+  for (uint32_t i = 0; num_of_outputs < 4U * SETTLING_OUTPUTS + 64U; i++)
+  {
+    int32_t input = (int32_t) lround(amplitude * sin(2.0 * PI * frequency * (double) i));
+    int32_t output;
+    if (decimator_push(&decimator, &input, &output))
+    {
+      num_of_outputs++;
+      if (num_of_outputs > SETTLING_OUTPUTS && fabs((double) output) > peak)
+      {
+        peak = fabs((double) output);
+      }
+    }
+  }
+  return peak / amplitude;
+}
+
+static void test_invalid_arguments(void)
+{
+  CHECK(!decimator_init(&decimator, 0, 1));
+  CHECK(!decimator_init(&decimator, 1, 1));
+  CHECK(!decimator_init(&decimator, DECIMATOR_FIR_RATIO + 1U, 1));
+  CHECK(!decimator_init(&decimator, DECIMATOR_MAX_RATIO + DECIMATOR_FIR_RATIO, 1));
+  CHECK(!decimator_init(&decimator, 8, 0));
+  CHECK(!decimator_init(&decimator, 8, DECIMATOR_MAX_CHANNELS + 1U));
+  CHECK(decimator_init(&decimator, DECIMATOR_FIR_RATIO, 1));
+  CHECK(decimator_init(&decimator, DECIMATOR_MAX_RATIO, DECIMATOR_MAX_CHANNELS));
+}
+
+// An output frame every ratio input frames, from the first ratio on
+static void test_output_rate(void)
+{
+  const uint32_t ratios[] = {DECIMATOR_FIR_RATIO, 6, 8, 100, DECIMATOR_MAX_RATIO};
+  for (uint32_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++)
+  {
+    CHECK(decimator_init(&decimator, ratios[r], 3));
+    int32_t input[3] = {1, 2, 3};
+    int32_t output[3];
+    for (uint32_t i = 1; i <= 10U * ratios[r]; i++)
+    {
+      CHECK_EQ(decimator_push(&decimator, input, output), (i % ratios[r]) == 0U);
+    }
+  }
+}
+
+// A constant input comes out unchanged once settled, in the units of the input, up to full scale where the
+// CIC integrators wrap around
+static void test_dc_gain(void)
+{
+  const int32_t values[] = {0, 1, -1, 1000, -32768, 32767, 1 << 23, INT32_MAX, INT32_MIN};
+  const uint32_t ratios[] = {DECIMATOR_FIR_RATIO, 8, 10, 64, DECIMATOR_MAX_RATIO};
+  for (uint32_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++)
+  {
+    for (uint32_t v = 0; v < sizeof(values) / sizeof(values[0]); v++)
+    {
+      CHECK(decimator_init(&decimator, ratios[r], DECIMATOR_MAX_CHANNELS));
+      int32_t output[DECIMATOR_MAX_CHANNELS];
+      CHECK_EQ(push_constant(values[v], SETTLING_OUTPUTS * ratios[r], output), SETTLING_OUTPUTS);
+      for (uint8_t c = 0; c < DECIMATOR_MAX_CHANNELS; c++)
+      {
+        // The Q15 taps sum to 1 to within rounding
+        CHECK(llabs((long long) output[c] - values[v]) <= 1 + llabs((long long) values[v]) / 16384);
+      }
+    }
+  }
+}
+
+// A step settles to the new value, the filter has no memory of the previous one after that
+static void test_step(void)
+{
+  int32_t output[DECIMATOR_MAX_CHANNELS];
+  CHECK(decimator_init(&decimator, 16, 2));
+  push_constant(-100000, SETTLING_OUTPUTS * 16U, output);
+  CHECK(abs(output[0] + 100000) <= 8);
+  push_constant(250000, SETTLING_OUTPUTS * 16U, output);
+  CHECK(abs(output[0] - 250000) <= 16);
+  CHECK_EQ(output[0], output[1]);
+}
+
+// The channels are filtered separately
+static void test_channels(void)
+{
+  CHECK(decimator_init(&decimator, 4, 3));
+  int32_t input[3] = {-5000, 0, 70000};
+  int32_t output[3] = {0};
+  for (uint32_t i = 0; i < SETTLING_OUTPUTS * 4U; i++)
+  {
+    decimator_push(&decimator, input, output);
+  }
+  CHECK(abs(output[0] + 5000) <= 1);
+  CHECK_EQ(output[1], 0);
+  CHECK(abs(output[2] - 70000) <= 5);
+}
+
+// The passband is flat to 0.4 times the output rate, and what would alias onto the low end of the
+// passband is attenuated
+static void test_frequency_response(void)
+{
+  const uint32_t ratio = 16;
+  const double amplitude = 1e6;
+  double output_rate = 1.0 / ratio;
+  for (double f = 0.05; f <= 0.4; f += 0.05)
+  {
+    double gain = sine_gain(ratio, f * output_rate, amplitude);
+    CHECK(gain > 0.89 && gain < 1.12);
+  }
+  // Half the input rate is where the CIC has a zero of every order
+  CHECK(sine_gain(ratio, 0.5, amplitude) < 1e-3);
+  // Aliases onto 0.1 times the output rate, from the FIR stopband and the CIC nulls
+  CHECK(sine_gain(ratio, 0.9 * output_rate, amplitude) < 0.01);
+  CHECK(sine_gain(ratio, 2.1 * output_rate, amplitude) < 0.01);
+}
+
+int main(void)
+{
+  test_invalid_arguments();
+  test_output_rate();
+  test_dc_gain();
+  test_step();
+  test_channels();
+  test_frequency_response();
+  return TEST_RESULT();
+}
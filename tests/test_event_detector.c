@@ -0,0 +1,137 @@
+#include "event_detector.h"
+#include "test_check.h"
+
+#define PERIOD_US  10U
+
+static struct eventDetector detector;
+static struct eventRecord records[EVENT_DETECTOR_MAX_CHANNELS];
+
+// Push a single channel trace starting at the given device time, returns the number of records, the last
+// ones are left in records
+static uint32_t push_trace(const int32_t* values, uint32_t num_of_values, uint32_t start_us)
+{
+  uint32_t num_of_records = 0;
+  for (uint32_t i = 0; i < num_of_values; i++)
+  {
+    uint8_t n = event_detector_push(&detector, &values[i], start_us + i * PERIOD_US, &records[num_of_records]);
+    num_of_records += n;
+  }
+  return num_of_records;
+}
+
+static void test_invalid_arguments(void)
+{
+  CHECK(!event_detector_init(&detector, 0));
+  CHECK(!event_detector_init(&detector, EVENT_DETECTOR_MAX_CHANNELS + 1U));
+  CHECK(event_detector_init(&detector, 2));
+  CHECK(!event_detector_enabled(&detector));
+  CHECK(!event_detector_set_channel(&detector, 2, EVENT_POLARITY_ABOVE, 0, 0));
+  CHECK(!event_detector_set_channel(&detector, 0, EVENT_POLARITY_ABSOLUTE + 1U, 0, 0));
+  CHECK(!event_detector_set_channel(&detector, 0, EVENT_POLARITY_ABSOLUTE, -1, 0));
+  CHECK(!event_detector_enabled(&detector));
+  CHECK(event_detector_set_channel(&detector, 1, EVENT_POLARITY_BELOW, -1, 0));
+  CHECK(event_detector_enabled(&detector));
+  CHECK(event_detector_set_channel(&detector, 1, EVENT_POLARITY_NONE, 0, 0));
+  CHECK(!event_detector_enabled(&detector));
+}
+
+// Noise around the threshold doesn't split an event up, it only ends once back past the hysteresis
+static void test_above_with_hysteresis(void)
+{
+  CHECK(event_detector_init(&detector, 1));
+  CHECK(event_detector_set_channel(&detector, 0, EVENT_POLARITY_ABOVE, 100, 20));
+  const int32_t trace[] = {0, 100, 101, 150, 95, 130, 81, 80, 79, 0, 120, 0};
+  CHECK_EQ(push_trace(trace, 9, 1000), 1);
+  CHECK_EQ(records[0].start_timestamp_us, 1000 + 2 * PERIOD_US);
+  CHECK_EQ(records[0].duration_us, 6 * PERIOD_US);
+  CHECK_EQ(records[0].peak_value, 150);
+  CHECK_EQ(records[0].peak_offset_us, PERIOD_US);
+  CHECK_EQ(records[0].channel, 0);
+  CHECK_EQ(records[0].polarity, EVENT_POLARITY_ABOVE);
+  CHECK_EQ(records[0].reserved, 0);
+  // The next event starts over
+  CHECK_EQ(push_trace(&trace[9], 3, 2000), 1);
+  CHECK_EQ(records[0].start_timestamp_us, 2000 + PERIOD_US);
+  CHECK_EQ(records[0].peak_value, 120);
+  CHECK_EQ(records[0].peak_offset_us, 0);
+}
+
+static void test_below(void)
+{
+  CHECK(event_detector_init(&detector, 1));
+  CHECK(event_detector_set_channel(&detector, 0, EVENT_POLARITY_BELOW, -50, 10));
+  const int32_t trace[] = {0, -50, -51, -300, -45, -40, -39};
+  CHECK_EQ(push_trace(trace, 7, 0), 1);
+  CHECK_EQ(records[0].start_timestamp_us, 2 * PERIOD_US);
+  CHECK_EQ(records[0].duration_us, 4 * PERIOD_US);
+  CHECK_EQ(records[0].peak_value, -300);
+  CHECK_EQ(records[0].polarity, EVENT_POLARITY_BELOW);
+}
+
+// Overload in both directions, the peak keeps its sign
+static void test_absolute(void)
+{
+  CHECK(event_detector_init(&detector, 1));
+  CHECK(event_detector_set_channel(&detector, 0, EVENT_POLARITY_ABSOLUTE, 1000, 100));
+  const int32_t trace[] = {0, 1001, -2000, 1500, 899, 0, -1200, 0};
+  CHECK_EQ(push_trace(trace, 8, 0), 2);
+  CHECK_EQ(records[0].peak_value, -2000);
+  CHECK_EQ(records[0].peak_offset_us, PERIOD_US);
+  CHECK_EQ(records[0].duration_us, 3 * PERIOD_US);
+  CHECK_EQ(records[1].peak_value, -1200);
+}
+
+// Full scale values and hysteresis don't overflow, and the durations are right across the wrap around of
+// the device time
+static void test_extremes(void)
+{
+  CHECK(event_detector_init(&detector, 3));
+  // The magnitude of INT32_MIN, and events which a hysteresis past the int32 range never lets end
+  CHECK(event_detector_set_channel(&detector, 0, EVENT_POLARITY_ABSOLUTE, INT32_MAX, UINT32_MAX));
+  CHECK(event_detector_set_channel(&detector, 1, EVENT_POLARITY_BELOW, INT32_MIN + 1, UINT32_MAX));
+  // Only ends on INT32_MIN, which is back by more than the hysteresis
+  CHECK(event_detector_set_channel(&detector, 2, EVENT_POLARITY_ABOVE, 0, INT32_MAX));
+  const int32_t frames[4][3] = {{INT32_MIN, INT32_MIN, 1}, {0, INT32_MAX, INT32_MAX}, {INT32_MAX, 0, INT32_MIN + 1}, {0, INT32_MAX, INT32_MIN}};
+  uint32_t start_us = UINT32_MAX - PERIOD_US + 1U;
+  for (uint32_t i = 0; i < 3U; i++)
+  {
+    CHECK_EQ(event_detector_push(&detector, frames[i], start_us + i * PERIOD_US, records), 0);
+  }
+  CHECK_EQ(event_detector_push(&detector, frames[3], start_us + 3U * PERIOD_US, records), 1);
+  CHECK_EQ(records[0].channel, 2);
+  CHECK_EQ(records[0].start_timestamp_us, start_us);
+  CHECK_EQ(records[0].duration_us, 3U * PERIOD_US);
+  CHECK_EQ(records[0].peak_value, INT32_MAX);
+  CHECK_EQ(records[0].peak_offset_us, PERIOD_US);
+  CHECK(detector.channels[0].in_event && detector.channels[0].peak_value == INT32_MIN);
+  CHECK(detector.channels[1].in_event && detector.channels[1].peak_value == INT32_MIN);
+}
+
+// Events of several channels ending with the same frame each get a record, ignored channels never do, and
+// setting a channel up again drops its event in progress
+static void test_channels(void)
+{
+  CHECK(event_detector_init(&detector, 4));
+  CHECK(event_detector_set_channel(&detector, 0, EVENT_POLARITY_ABOVE, 10, 0));
+  CHECK(event_detector_set_channel(&detector, 2, EVENT_POLARITY_BELOW, -10, 0));
+  CHECK(event_detector_set_channel(&detector, 3, EVENT_POLARITY_ABOVE, 10, 0));
+  const int32_t in_event[4] = {20, 1000, -20, 20};
+  const int32_t quiet[4] = {0, 1000, 0, 0};
+  CHECK_EQ(event_detector_push(&detector, in_event, 100, records), 0);
+  CHECK(event_detector_set_channel(&detector, 3, EVENT_POLARITY_ABOVE, 10, 0));
+  CHECK_EQ(event_detector_push(&detector, quiet, 110, records), 2);
+  CHECK_EQ(records[0].channel, 0);
+  CHECK_EQ(records[1].channel, 2);
+  CHECK_EQ(records[1].peak_value, -20);
+}
+
+int main(void)
+{
+  test_invalid_arguments();
+  test_above_with_hysteresis();
+  test_below();
+  test_absolute();
+  test_extremes();
+  test_channels();
+  return TEST_RESULT();
+}
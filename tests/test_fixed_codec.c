@@ -0,0 +1,319 @@
+#include "test_check.h"
+
+#include <string.h>
+
+#include <pb_encode.h>
+#include <pb_decode.h>
+#include <main.pb.h>
+#include <main.fixed.h>
+
+// Random messages of every payload which the fixed codec handles
+#define NUM_OF_MESSAGES  2000U
+
+// Larger than either message encodes to with nanopb, so a fixed codec which stops short of it shows up as a
+// difference rather than as an encoding error
+#define BUF_SIZE  256U
+
+static uint32_t lcg_state = 1;
+
+static uint32_t lcg_next(void)
+{
+  lcg_state = lcg_state * 1664525U + 1013904223U;
+  return lcg_state;
+}
+
+// A quarter of the values are at the edges of the varint lengths or of the range, the others are spread
+// over every length
+static uint32_t random_uint32(void)
+{
+  static const uint32_t edges[] = {0, 1, 127, 128, 16383, 16384, 0x7FFFFFFFU, 0x80000000U, UINT32_MAX};
+  uint32_t r = lcg_next();
+  if ((r & 3U) == 0U)
+  {
+    return edges[(r >> 2) % (sizeof(edges) / sizeof(edges[0]))];
+  }
+  return lcg_next() >> (lcg_next() % 32U);
+}
+
+static int32_t random_int32(void)
+{
+  return (int32_t) random_uint32();
+}
+
+// The device time since boot, up to the edges of 64 bits
+static uint64_t random_uint64(void)
+{
+  static const uint64_t edges[] = {0, 0xFFFFFFFFULL, 0x100000000ULL, 0x7FFFFFFFFFFFFFFFULL, 0x8000000000000000ULL, UINT64_MAX};
+  uint32_t r = lcg_next();
+  if ((r & 3U) == 0U)
+  {
+    return edges[(r >> 2) % (sizeof(edges) / sizeof(edges[0]))];
+  }
+  return (((uint64_t) lcg_next() << 32) | lcg_next()) >> (lcg_next() % 64U);
+}
+
+static bool random_bool(void)
+{
+  return (lcg_next() >> 31) != 0U;
+}
+
+// An enum value of the proto file or, now and then, one the receiver doesn't know, negative ones included
+static int32_t random_enum(int32_t num_of_values)
+{
+  uint32_t r = lcg_next();
+  return ((r & 15U) == 0U) ? random_int32() : (int32_t) ((r >> 4) % (uint32_t) num_of_values);
+}
+
+static void fill_host_to_device(HostToDeviceMessage* msg, pb_size_t which_payload)
+{
+  *msg = (HostToDeviceMessage) HostToDeviceMessage_init_zero;
+  msg->which_payload = which_payload;
+  switch (which_payload)
+  {
+    case HostToDeviceMessage_set_periodic_sampler_msg_tag:
+    {
+      SetPeriodicSamplerMessage* set = &msg->payload.set_periodic_sampler_msg;
+      set->sampling_period = random_int32();
+      set->has_sampling_clock = random_bool();
+      set->sampling_clock = (SamplingClock) random_enum(3);
+      set->has_frames_per_block = random_bool();
+      set->frames_per_block = random_uint32();
+      set->has_frame_format = random_bool();
+      set->frame_format = (FrameFormat) random_enum(2);
+      set->has_channel_mask = random_bool();
+      set->channel_mask = random_uint32();
+      set->has_data_interface = random_bool();
+      set->data_interface = (DataInterface) random_enum(2);
+      set->has_stream_encoding = random_bool();
+      set->stream_encoding = (StreamEncoding) random_enum(3);
+      set->has_test_pattern = random_bool();
+      set->test_pattern = random_bool();
+      break;
+    }
+    case HostToDeviceMessage_stop_periodic_sampler_msg_tag:
+      msg->payload.stop_periodic_sampler_msg.stop_sampling = random_bool();
+      break;
+    case HostToDeviceMessage_execute_one_off_sampler_msg_tag:
+      msg->payload.execute_one_off_sampler_msg.execute_one_off_sampling = random_bool();
+      break;
+    case HostToDeviceMessage_set_decimator_msg_tag:
+      msg->payload.set_decimator_msg.output_period_us = random_uint32();
+      break;
+    case HostToDeviceMessage_set_capture_msg_tag:
+    {
+      SetCaptureMessage* set = &msg->payload.set_capture_msg;
+      set->trigger = (CaptureTrigger) random_enum(4);
+      set->trigger_channel = random_uint32();
+      set->threshold = random_int32();
+      set->pre_trigger_frames = random_uint32();
+      set->post_trigger_frames = random_uint32();
+      break;
+    }
+    case HostToDeviceMessage_execute_burst_capture_msg_tag:
+      msg->payload.execute_burst_capture_msg.num_of_frames = random_uint32();
+      msg->payload.execute_burst_capture_msg.channel_mask = random_uint32();
+      break;
+    case HostToDeviceMessage_set_aggregator_msg_tag:
+      msg->payload.set_aggregator_msg.window_us = random_uint32();
+      break;
+    case HostToDeviceMessage_set_spectrum_msg_tag:
+      msg->payload.set_spectrum_msg.fft_size = random_uint32();
+      msg->payload.set_spectrum_msg.num_of_peaks = random_uint32();
+      break;
+    case HostToDeviceMessage_set_event_detector_msg_tag:
+    {
+      SetEventDetectorMessage* set = &msg->payload.set_event_detector_msg;
+      set->channel_mask = random_uint32();
+      set->polarity = (EventPolarity) random_enum(4);
+      set->threshold = random_int32();
+      set->hysteresis = random_uint32();
+      break;
+    }
+    case HostToDeviceMessage_get_stats_msg_tag:
+      msg->payload.get_stats_msg.include_tasks = random_bool();
+      break;
+    case HostToDeviceMessage_get_device_time_msg_tag:
+      msg->payload.get_device_time_msg.request_id = random_uint32();
+      break;
+    default:
+      break;
+  }
+}
+
+static void fill_device_to_host(DeviceToHostMessage* msg, pb_size_t which_payload)
+{
+  *msg = (DeviceToHostMessage) DeviceToHostMessage_init_zero;
+  msg->which_payload = which_payload;
+  switch (which_payload)
+  {
+    case DeviceToHostMessage_ack_stop_periodic_sampler_msg_tag:
+      msg->payload.ack_stop_periodic_sampler_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_ack_set_periodic_sampler_msg_tag:
+      msg->payload.ack_set_periodic_sampler_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_one_off_sampler_data_msg_tag:
+    {
+      OneOffSamplerDataMessage* data = &msg->payload.one_off_sampler_data_msg;
+      *data = (OneOffSamplerDataMessage) {random_int32(), random_int32(), random_int32(), random_int32(),
+                                          random_int32(), random_int32(), random_int32(), random_int32()};
+      break;
+    }
+    case DeviceToHostMessage_ack_set_decimator_msg_tag:
+      msg->payload.ack_set_decimator_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_ack_set_capture_msg_tag:
+      msg->payload.ack_set_capture_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_capture_info_msg_tag:
+    {
+      CaptureInfoMessage* info = &msg->payload.capture_info_msg;
+      info->trigger_frame_index = random_uint32();
+      info->num_of_frames = random_uint32();
+      info->trigger_timestamp_us = random_uint32();
+      info->sampling_period_us = random_uint32();
+      info->trigger_value = random_int32();
+      info->has_duration_us = random_bool();
+      info->duration_us = random_uint32();
+      break;
+    }
+    case DeviceToHostMessage_ack_execute_burst_capture_msg_tag:
+      msg->payload.ack_execute_burst_capture_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_ack_set_aggregator_msg_tag:
+      msg->payload.ack_set_aggregator_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_ack_set_spectrum_msg_tag:
+      msg->payload.ack_set_spectrum_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_ack_set_event_detector_msg_tag:
+      msg->payload.ack_set_event_detector_msg.ack = random_bool();
+      break;
+    case DeviceToHostMessage_device_time_msg_tag:
+      msg->payload.device_time_msg.request_id = random_uint32();
+      msg->payload.device_time_msg.device_time_us = random_uint64();
+      break;
+    default:
+      break;
+  }
+}
+
+// Encode a message with nanopb, as it is when sent, returns its size or 0 on failure
+static size_t pb_encode_buf(uint8_t* buf, const pb_msgdesc_t* fields, const void* msg, bool delimited)
+{
+  pb_ostream_t stream = pb_ostream_from_buffer(buf, BUF_SIZE);
+  bool status = delimited ? pb_encode_ex(&stream, fields, msg, PB_ENCODE_DELIMITED) : pb_encode(&stream, fields, msg);
+  CHECK(status);
+  return status ? stream.bytes_written : 0U;
+}
+
+// The fixed encoders give the bytes of nanopb, and both decoders give back the message, which is compared by
+// encoding it again with nanopb, as the structs have padding which neither decoder initialises
+static void test_host_to_device(void)
+{
+  static const pb_size_t payloads[] = {
+    HostToDeviceMessage_set_periodic_sampler_msg_tag, HostToDeviceMessage_stop_periodic_sampler_msg_tag,
+    HostToDeviceMessage_execute_one_off_sampler_msg_tag, HostToDeviceMessage_set_decimator_msg_tag,
+    HostToDeviceMessage_set_capture_msg_tag, HostToDeviceMessage_execute_burst_capture_msg_tag,
+    HostToDeviceMessage_set_aggregator_msg_tag, HostToDeviceMessage_set_spectrum_msg_tag,
+    HostToDeviceMessage_set_event_detector_msg_tag, HostToDeviceMessage_get_stats_msg_tag,
+    HostToDeviceMessage_get_device_time_msg_tag,
+  };
+  for (uint32_t i = 0; i < NUM_OF_MESSAGES; i++)
+  {
+    HostToDeviceMessage msg;
+    fill_host_to_device(&msg, payloads[i % (sizeof(payloads) / sizeof(payloads[0]))]);
+    uint8_t pb_buf[BUF_SIZE];
+    uint8_t fixed_buf[BUF_SIZE];
+    size_t size = pb_encode_buf(pb_buf, HostToDeviceMessage_fields, &msg, false);
+    CHECK(size <= HostToDeviceMessage_FIXED_MAX_SIZE);
+    CHECK_EQ(HostToDeviceMessage_encode_fixed(fixed_buf, &msg), size);
+    CHECK(memcmp(pb_buf, fixed_buf, size) == 0);
+
+    HostToDeviceMessage fixed_decoded = HostToDeviceMessage_init_zero;
+    HostToDeviceMessage pb_decoded = HostToDeviceMessage_init_zero;
+    CHECK(HostToDeviceMessage_decode_fixed(pb_buf, size, &fixed_decoded));
+    pb_istream_t stream = pb_istream_from_buffer(pb_buf, size);
+    CHECK(pb_decode(&stream, HostToDeviceMessage_fields, &pb_decoded));
+    CHECK_EQ(fixed_decoded.which_payload, msg.which_payload);
+    CHECK_EQ(pb_encode_buf(fixed_buf, HostToDeviceMessage_fields, &fixed_decoded, false), size);
+    CHECK(memcmp(pb_buf, fixed_buf, size) == 0);
+    CHECK_EQ(pb_encode_buf(fixed_buf, HostToDeviceMessage_fields, &pb_decoded, false), size);
+    CHECK(memcmp(pb_buf, fixed_buf, size) == 0);
+  }
+}
+
+// The same for the messages of the device, delimited as they are sent on the control port
+static void test_device_to_host(void)
+{
+  static const pb_size_t payloads[] = {
+    DeviceToHostMessage_ack_stop_periodic_sampler_msg_tag, DeviceToHostMessage_ack_set_periodic_sampler_msg_tag,
+    DeviceToHostMessage_one_off_sampler_data_msg_tag, DeviceToHostMessage_ack_set_decimator_msg_tag,
+    DeviceToHostMessage_ack_set_capture_msg_tag, DeviceToHostMessage_capture_info_msg_tag,
+    DeviceToHostMessage_ack_execute_burst_capture_msg_tag, DeviceToHostMessage_ack_set_aggregator_msg_tag,
+    DeviceToHostMessage_ack_set_spectrum_msg_tag, DeviceToHostMessage_ack_set_event_detector_msg_tag,
+    DeviceToHostMessage_device_time_msg_tag,
+  };
+  for (uint32_t i = 0; i < NUM_OF_MESSAGES; i++)
+  {
+    DeviceToHostMessage msg;
+    fill_device_to_host(&msg, payloads[i % (sizeof(payloads) / sizeof(payloads[0]))]);
+    uint8_t pb_buf[BUF_SIZE];
+    uint8_t fixed_buf[BUF_SIZE];
+    size_t size = pb_encode_buf(pb_buf, DeviceToHostMessage_fields, &msg, true);
+    CHECK(size <= DeviceToHostMessage_FIXED_DELIMITED_MAX_SIZE);
+    CHECK_EQ(DeviceToHostMessage_encode_fixed_delimited(fixed_buf, &msg), size);
+    CHECK(memcmp(pb_buf, fixed_buf, size) == 0);
+    // Without the length in front
+    CHECK_EQ(DeviceToHostMessage_encode_fixed(fixed_buf, &msg), size - 1U);
+    CHECK(memcmp(&pb_buf[1], fixed_buf, size - 1U) == 0);
+
+    DeviceToHostMessage fixed_decoded = DeviceToHostMessage_init_zero;
+    DeviceToHostMessage pb_decoded = DeviceToHostMessage_init_zero;
+    CHECK(DeviceToHostMessage_decode_fixed(&pb_buf[1], size - 1U, &fixed_decoded));
+    pb_istream_t stream = pb_istream_from_buffer(pb_buf, size);
+    CHECK(pb_decode_ex(&stream, DeviceToHostMessage_fields, &pb_decoded, PB_DECODE_DELIMITED));
+    CHECK_EQ(fixed_decoded.which_payload, msg.which_payload);
+    CHECK_EQ(pb_encode_buf(fixed_buf, DeviceToHostMessage_fields, &fixed_decoded, true), size);
+    CHECK(memcmp(pb_buf, fixed_buf, size) == 0);
+    CHECK_EQ(pb_encode_buf(fixed_buf, DeviceToHostMessage_fields, &pb_decoded, true), size);
+    CHECK(memcmp(pb_buf, fixed_buf, size) == 0);
+  }
+}
+
+// The fixed decoders reject what nanopb rejects : a missing required field, a truncated varint, and a payload
+// they don't handle, the others are skipped like unknown fields
+static void test_invalid_input(void)
+{
+  SetCaptureMessage capture;
+  // trigger and trigger_channel only
+  const uint8_t missing_required[] = {0x08, 0x01, 0x10, 0x02};
+  CHECK(!SetCaptureMessage_decode_fixed(missing_required, sizeof(missing_required), &capture));
+  pb_istream_t stream = pb_istream_from_buffer(missing_required, sizeof(missing_required));
+  CHECK(!pb_decode(&stream, SetCaptureMessage_fields, &capture));
+
+  DeviceTimeMessage device_time;
+  // device_time_us cut short after 9 of its 10 bytes
+  const uint8_t truncated[] = {0x08, 0x01, 0x10, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  CHECK(!DeviceTimeMessage_decode_fixed(truncated, sizeof(truncated), &device_time));
+  stream = pb_istream_from_buffer(truncated, sizeof(truncated));
+  CHECK(!pb_decode(&stream, DeviceTimeMessage_fields, &device_time));
+
+  // A sample batch, and an unknown field 15 in front of a device time
+  DeviceToHostMessage msg;
+  const uint8_t sample_batch[] = {0x22, 0x00};
+  CHECK(!DeviceToHostMessage_decode_fixed(sample_batch, sizeof(sample_batch), &msg));
+  const uint8_t unknown_field[] = {0x78, 0x05, 0x6A, 0x04, 0x08, 0x07, 0x10, 0x2A};
+  CHECK(DeviceToHostMessage_decode_fixed(unknown_field, sizeof(unknown_field), &msg));
+  CHECK_EQ(msg.which_payload, DeviceToHostMessage_device_time_msg_tag);
+  CHECK_EQ(msg.payload.device_time_msg.request_id, 7);
+  CHECK_EQ(msg.payload.device_time_msg.device_time_us, 42);
+}
+
+int main(void)
+{
+  test_host_to_device();
+  test_device_to_host();
+  test_invalid_input();
+  return TEST_RESULT();
+}
@@ -0,0 +1,155 @@
+#include "sample_codec.h"
+#include "test_check.h"
+
+#include <string.h>
+
+#define MAX_FRAMES    512U
+#define MAX_CHANNELS  8U
+
+// Four frames of two 16-bit channels, the second one wrapping around, and the block the host expects for them,
+// the same bytes are checked against the Python decoder in host_src/python_host_scripts/tests/test_sample_codec.py
+static const uint16_t golden_frames[4][2] = {{1000, 0xFFFF}, {1001, 1}, {999, 0}, {1002, 0xFFFE}};
+static const uint8_t golden_block[] =
+{
+  0x04, 0x00, 0x02, 0x02,   // 4 frames, 2 channels of 2 bytes
+  0xE8, 0x03, 0x03,         // 1000, 3 bits
+  0x9A, 0x01,               // +1, -2, +3
+  0xFF, 0xFF, 0x03,         // 0xFFFF, 3 bits
+  0xCC, 0x00,               // +2, -1, -2
+};
+
+static uint8_t frames[MAX_FRAMES * MAX_CHANNELS * 4U];
+static uint8_t decoded[MAX_FRAMES * MAX_CHANNELS * 4U];
+static uint8_t block[SAMPLE_CODEC_HEADER_SIZE + MAX_CHANNELS * (5U + MAX_FRAMES * 4U)];
+
+static uint32_t lcg_state = 1;
+
+static uint32_t lcg_next(void)
+{
+  lcg_state = lcg_state * 1664525U + 1013904223U;
+  return lcg_state;
+}
+
+// Decoder written from the format in sample_codec.h, returns the number of bytes read, 0 if the block is invalid
+static uint32_t reference_decode(uint8_t* dst, const uint8_t* src, uint32_t src_size)
+{
+  if (src_size < SAMPLE_CODEC_HEADER_SIZE)
+  {
+    return 0;
+  }
+  uint32_t num_of_frames = (uint32_t) src[0] | ((uint32_t) src[1] << 8);
+  uint32_t num_of_channels = src[2];
+  uint32_t value_size = src[3];
+  uint32_t frame_size = num_of_channels * value_size;
+  uint32_t offset = SAMPLE_CODEC_HEADER_SIZE;
+  for (uint32_t channel = 0; channel < num_of_channels; channel++)
+  {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < value_size; i++)
+    {
+      value |= (uint32_t) src[offset + i] << (8U * i);
+    }
+    uint32_t width = src[offset + value_size];
+    offset += value_size + 1U;
+    uint64_t bit_offset = (uint64_t) offset * 8U;
+    for (uint32_t frame = 0; frame < num_of_frames; frame++)
+    {
+      if (frame > 0U)
+      {
+        uint32_t zigzag = 0;
+        for (uint32_t bit = 0; bit < width; bit++, bit_offset++)
+        {
+          zigzag |= (uint32_t) ((src[bit_offset / 8U] >> (bit_offset % 8U)) & 1U) << bit;
+        }
+        value += (zigzag >> 1) ^ (0U - (zigzag & 1U));
+      }
+      for (uint32_t i = 0; i < value_size; i++)
+      {
+        dst[frame * frame_size + channel * value_size + i] = (uint8_t) (value >> (8U * i));
+      }
+    }
+    offset += ((num_of_frames - 1U) * width + 7U) / 8U;
+  }
+  return (offset <= src_size) ? offset : 0U;
+}
+
+static void check_round_trip(uint32_t num_of_frames, uint8_t num_of_channels, uint8_t value_size)
+{
+  uint32_t frames_size = num_of_frames * num_of_channels * value_size;
+  uint32_t size = sample_codec_encode(block, sizeof(block), frames, num_of_frames, num_of_channels, value_size);
+  CHECK(size > 0U);
+  CHECK_EQ(reference_decode(decoded, block, size), size);
+  CHECK(memcmp(decoded, frames, frames_size) == 0);
+}
+
+static void test_golden_block(void)
+{
+  uint8_t out[64];
+  uint32_t size = sample_codec_encode(out, sizeof(out), (const uint8_t*) golden_frames, 4, 2, 2);
+  CHECK_EQ(size, sizeof(golden_block));
+  CHECK(memcmp(out, golden_block, sizeof(golden_block)) == 0);
+}
+
+static void test_signals(void)
+{
+  // A constant channel takes no delta bits
+  memset(frames, 0x5A, sizeof(frames));
+  uint32_t size = sample_codec_encode(block, sizeof(block), frames, 256, 8, 4);
+  CHECK_EQ(size, SAMPLE_CODEC_HEADER_SIZE + 8U * (4U + 1U));
+  check_round_trip(256, 8, 4);
+
+  // Slow ramps, noise of a few bits and full scale noise, in both value sizes
+  for (uint8_t value_size = 2; value_size <= 4U; value_size += 2U)
+  {
+    for (uint32_t noise_bits = 0; noise_bits <= 8U * value_size; noise_bits += 3U)
+    {
+      for (uint32_t frame = 0; frame < MAX_FRAMES; frame++)
+      {
+        for (uint32_t channel = 0; channel < MAX_CHANNELS; channel++)
+        {
+          uint32_t noise = (noise_bits == 0U) ? 0U : (lcg_next() >> (32U - (noise_bits > 32U ? 32U : noise_bits)));
+          uint32_t value = frame * channel + noise;
+          for (uint32_t i = 0; i < value_size; i++)
+          {
+            frames[(frame * MAX_CHANNELS + channel) * value_size + i] = (uint8_t) (value >> (8U * i));
+          }
+        }
+      }
+      check_round_trip(MAX_FRAMES, MAX_CHANNELS, value_size);
+    }
+  }
+
+  // Extremes next to each other, the largest deltas there are
+  const int32_t extremes[] = {INT32_MIN, INT32_MAX, 0, INT32_MIN, -1, INT32_MAX};
+  memcpy(frames, extremes, sizeof(extremes));
+  check_round_trip(6, 1, 4);
+  CHECK_EQ(block[SAMPLE_CODEC_HEADER_SIZE + 4U], 32);
+
+  // A single frame has no deltas
+  check_round_trip(1, 3, 2);
+}
+
+static void test_invalid_arguments(void)
+{
+  CHECK_EQ(sample_codec_encode(block, sizeof(block), frames, 0, 1, 2), 0);
+  CHECK_EQ(sample_codec_encode(block, sizeof(block), frames, UINT16_MAX + 1U, 1, 2), 0);
+  CHECK_EQ(sample_codec_encode(block, sizeof(block), frames, 4, 0, 2), 0);
+  CHECK_EQ(sample_codec_encode(block, sizeof(block), frames, 4, 1, 3), 0);
+  CHECK_EQ(sample_codec_encode(block, SAMPLE_CODEC_HEADER_SIZE - 1U, frames, 4, 1, 2), 0);
+
+  // Gives up as soon as the block doesn't fit, without writing past dst_size
+  uint8_t out[sizeof(golden_block) + 1U];
+  memset(out, 0xEE, sizeof(out));
+  CHECK_EQ(sample_codec_encode(out, sizeof(golden_block) - 1U, (const uint8_t*) golden_frames, 4, 2, 2), 0);
+  CHECK_EQ(out[sizeof(golden_block) - 1U], 0xEE);
+  CHECK_EQ(sample_codec_encode(out, sizeof(golden_block), (const uint8_t*) golden_frames, 4, 2, 2), sizeof(golden_block));
+  CHECK_EQ(out[sizeof(golden_block)], 0xEE);
+}
+
+int main(void)
+{
+  test_golden_block();
+  test_signals();
+  test_invalid_arguments();
+  return TEST_RESULT();
+}
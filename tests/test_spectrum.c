@@ -0,0 +1,208 @@
+#include "spectrum.h"
+#include "test_check.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI  3.14159265358979323846
+
+// Largest difference to the magnitudes in double precision, in LSBs, from the rounding of the Q15 twiddles
+// and of the halving at every stage
+#define MAX_ERROR  6.0
+
+static struct spectrum spectrum;
+static int32_t frames[SPECTRUM_MAX_SIZE][SPECTRUM_MAX_CHANNELS];
+static uint8_t record[SPECTRUM_RECORD_MAX_SIZE];
+
+static uint32_t lcg_state = 1;
+
+static uint32_t lcg_next(void)
+{
+  lcg_state = lcg_state * 1664525U + 1013904223U;
+  return lcg_state;
+}
+
+static uint16_t get_uint16(const uint8_t* buffer)
+{
+  return (uint16_t) (buffer[0] | (buffer[1] << 8));
+}
+
+// Push a window of frames, checking that only the last one completes it
+static void push_window(uint32_t fft_size, uint8_t num_of_channels, uint8_t num_of_peaks)
+{
+  CHECK(spectrum_init(&spectrum, fft_size, num_of_channels, num_of_peaks));
+  for (uint32_t i = 0; i < fft_size; i++)
+  {
+    CHECK_EQ(spectrum_push(&spectrum, frames[i]), i + 1U == fft_size);
+  }
+}
+
+// Magnitude of bin k of the Hann windowed values of a channel divided by fft_size, in double precision, with
+// the values clamped to 16 bits like spectrum_push() does
+static double reference_magnitude(uint32_t fft_size, uint8_t channel, uint32_t k)
+{
+  double re = 0.0;
+  double im = 0.0;
+  for (uint32_t n = 0; n < fft_size; n++)
+  {
+    int32_t value = frames[n][channel];
+    value = (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : value);
+    double windowed = value * 0.5 * (1.0 - cos(2.0 * PI * n / fft_size));
+    re += windowed * cos(2.0 * PI * k * n / fft_size);
+    im -= windowed * sin(2.0 * PI * k * n / fft_size);
+  }
+  return sqrt(re * re + im * im) / fft_size;
+}
+
+// Check every bin of every channel against the reference, returns the largest error
+static double check_all_bins(uint32_t fft_size, uint8_t num_of_channels)
+{
+  double max_error = 0.0;
+  for (uint8_t c = 0; c < num_of_channels; c++)
+  {
+    uint32_t size = spectrum_record(&spectrum, c, record);
+    CHECK_EQ(size, SPECTRUM_RECORD_HEADER_SIZE + (fft_size / 2U + 1U) * 2U);
+    CHECK_EQ(get_uint16(record), fft_size);
+    CHECK_EQ(record[2], c);
+    CHECK_EQ(record[3], 0);
+    for (uint32_t k = 0; k <= fft_size / 2U; k++)
+    {
+      double error = fabs(get_uint16(&record[SPECTRUM_RECORD_HEADER_SIZE + 2U * k]) - reference_magnitude(fft_size, c, k));
+      max_error = (error > max_error) ? error : max_error;
+    }
+  }
+  CHECK(max_error <= MAX_ERROR);
+  return max_error;
+}
+
+static void test_invalid_arguments(void)
+{
+  CHECK(!spectrum_init(&spectrum, SPECTRUM_MIN_SIZE / 2U, 1, 0));
+  CHECK(!spectrum_init(&spectrum, 48, 1, 0));
+  CHECK(!spectrum_init(&spectrum, SPECTRUM_MAX_SIZE * 2U, 1, 0));
+  CHECK(!spectrum_init(&spectrum, 64, 0, 0));
+  CHECK(!spectrum_init(&spectrum, 64, SPECTRUM_MAX_CHANNELS + 1U, 0));
+  CHECK(!spectrum_init(&spectrum, 64, 1, SPECTRUM_MAX_PEAKS + 1U));
+  CHECK(spectrum_init(&spectrum, SPECTRUM_MIN_SIZE, 1, SPECTRUM_MAX_PEAKS));
+  CHECK(spectrum_init(&spectrum, SPECTRUM_MAX_SIZE, SPECTRUM_MAX_CHANNELS, 0));
+}
+
+// Full scale noise, sines and values beyond 16 bits at every size, the last channels hold the extremes
+static void test_against_double(void)
+{
+  for (uint32_t fft_size = SPECTRUM_MIN_SIZE; fft_size <= SPECTRUM_MAX_SIZE; fft_size *= 2U)
+  {
+    for (uint32_t n = 0; n < fft_size; n++)
+    {
+      frames[n][0] = (int16_t) lcg_next();
+      frames[n][1] = (int32_t) (lcg_next() >> 20) - 2048;
+      frames[n][2] = (int32_t) lround(30000.0 * sin(2.0 * PI * 3.0 * n / fft_size));
+      frames[n][3] = (int32_t) lround(12000.0 * sin(2.0 * PI * 5.3 * n / fft_size) + 500.0);
+      frames[n][4] = -1000;
+      frames[n][5] = (n % 2U) ? INT16_MAX : INT16_MIN;
+      frames[n][6] = (n % 2U) ? INT32_MAX : INT32_MIN;
+      frames[n][7] = (int32_t) lcg_next();
+    }
+    push_window(fft_size, SPECTRUM_MAX_CHANNELS, 0);
+    double max_error = check_all_bins(fft_size, SPECTRUM_MAX_CHANNELS);
+    printf("fft_size = %u, largest error = %.2f LSB\n", fft_size, max_error);
+  }
+}
+
+// A sine of amplitude A in the middle of bin k peaks there at about A / 4, and comes first of the peaks
+static void test_peaks(void)
+{
+  const uint32_t fft_size = 256;
+  for (uint32_t n = 0; n < fft_size; n++)
+  {
+    frames[n][0] = (int32_t) lround(16000.0 * sin(2.0 * PI * 20.0 * n / fft_size) + 4000.0 * sin(2.0 * PI * 71.0 * n / fft_size));
+    // Only DC, which isn't a peak, the local maxima above it are rounding noise
+    frames[n][1] = 5000;
+  }
+  push_window(fft_size, 2, 4);
+  uint32_t size = spectrum_record(&spectrum, 0, record);
+  CHECK_EQ(size, SPECTRUM_RECORD_HEADER_SIZE + 4U * 4U);
+  CHECK_EQ(record[3], 4);
+  const uint8_t* peaks = &record[SPECTRUM_RECORD_HEADER_SIZE];
+  CHECK_EQ(get_uint16(&peaks[0]), 20);
+  CHECK(abs(get_uint16(&peaks[2]) - 4000) <= 4);
+  CHECK_EQ(get_uint16(&peaks[4]), 71);
+  CHECK(abs(get_uint16(&peaks[6]) - 1000) <= 4);
+  // The rest are rounding noise, well below either sine
+  CHECK(get_uint16(&peaks[10]) < 8U && get_uint16(&peaks[14]) < 8U);
+
+  size = spectrum_record(&spectrum, 1, record);
+  CHECK_EQ(size, SPECTRUM_RECORD_HEADER_SIZE + 4U * 4U);
+  for (uint32_t i = SPECTRUM_RECORD_HEADER_SIZE; i < size; i += 4U)
+  {
+    uint16_t bin = get_uint16(&record[i]);
+    uint16_t magnitude = get_uint16(&record[i + 2U]);
+    // Unused pairs are 0, and bin 1 is on the slope of DC
+    CHECK((bin == 0U) ? (magnitude == 0U) : (bin > 1U && magnitude <= MAX_ERROR));
+  }
+}
+
+// The next frame after a complete window starts a new one
+static void test_consecutive_windows(void)
+{
+  CHECK(spectrum_init(&spectrum, 16, 1, 0));
+  const int32_t high[1] = {8000};
+  const int32_t low[1] = {-100};
+  for (uint32_t i = 0; i < 16U; i++)
+  {
+    CHECK_EQ(spectrum_push(&spectrum, high), i == 15U);
+  }
+  spectrum_record(&spectrum, 0, record);
+  CHECK(abs(get_uint16(&record[SPECTRUM_RECORD_HEADER_SIZE]) - 4000) <= 4);
+  for (uint32_t i = 0; i < 16U; i++)
+  {
+    CHECK_EQ(spectrum_push(&spectrum, low), i == 15U);
+  }
+  spectrum_record(&spectrum, 0, record);
+  CHECK(abs(get_uint16(&record[SPECTRUM_RECORD_HEADER_SIZE]) - 50) <= 4);
+}
+
+// Values beyond 16 bits are counted per channel and window in the record, rather than clamped silently
+static void test_clipped(void)
+{
+  const uint32_t fft_size = 16;
+  for (uint32_t n = 0; n < fft_size; n++)
+  {
+    // Full scale int16 values aren't clipped, only those beyond
+    frames[n][0] = (n % 2U) ? INT16_MAX : INT16_MIN;
+    frames[n][1] = (n < 3U) ? INT16_MAX + 1 : ((n < 5U) ? INT16_MIN - 1 : 0);
+    frames[n][2] = (n % 2U) ? INT32_MAX : INT32_MIN;
+  }
+  push_window(fft_size, 3, 0);
+  const uint16_t expected[3] = {0, 5, 16};
+  for (uint8_t c = 0; c < 3U; c++)
+  {
+    CHECK_EQ(spectrum_record(&spectrum, c, record), SPECTRUM_RECORD_HEADER_SIZE + (fft_size / 2U + 1U) * 2U);
+    CHECK_EQ(get_uint16(&record[4]), expected[c]);
+  }
+  // The count restarts with the next window
+  for (uint32_t n = 0; n < fft_size; n++)
+  {
+    frames[n][1] = 100;
+    frames[n][2] = (n == 7U) ? -70000 : 0;
+  }
+  for (uint32_t i = 0; i < fft_size; i++)
+  {
+    CHECK_EQ(spectrum_push(&spectrum, frames[i]), i + 1U == fft_size);
+  }
+  spectrum_record(&spectrum, 1, record);
+  CHECK_EQ(get_uint16(&record[4]), 0);
+  spectrum_record(&spectrum, 2, record);
+  CHECK_EQ(get_uint16(&record[4]), 1);
+}
+
+int main(void)
+{
+  test_invalid_arguments();
+  test_against_double();
+  test_peaks();
+  test_consecutive_windows();
+  test_clipped();
+  return TEST_RESULT();
+}
@@ -0,0 +1,239 @@
+#include "spsc_ring.h"
+#include "test_check.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Same shape as the egress ring of device_main, a few blocks of a few hundred bytes
+#define SLOT_SIZE     512U
+#define NUM_OF_SLOTS  8U
+#define SLOT_WORDS    (SLOT_SIZE / sizeof(uint32_t))
+
+// Slots passed through the ring by the stress test, and the throughput it has to reach, in slots per second
+// The device needs about 1000 slots/s at 15 kHz with 16 frames per block, the default floor leaves a wide
+// margin for a loaded CI machine, both can be given on the command line
+#define DEFAULT_NUM_OF_TRANSFERS  2000000U
+#define DEFAULT_MIN_SLOTS_PER_S   100000.0
+
+static uint8_t storage[SLOT_SIZE * NUM_OF_SLOTS];
+
+// Contents of the slot carrying the given sequence number, every word depends on it so that a slot read
+// before the producer finished it or after it was reused shows up
+static uint32_t pattern_word(uint32_t sequence, uint32_t word)
+{
+  return (sequence * 2654435761U) ^ (word * 40503U);
+}
+
+static void fill_slot(uint32_t* slot, uint32_t sequence)
+{
+  slot[0] = sequence;
+  for (uint32_t i = 1; i < SLOT_WORDS; i++)
+  {
+    slot[i] = pattern_word(sequence, i);
+  }
+}
+
+static bool slot_is_intact(const uint32_t* slot, uint32_t sequence)
+{
+  for (uint32_t i = 1; i < SLOT_WORDS; i++)
+  {
+    if (slot[i] != pattern_word(sequence, i))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void test_single_thread(void)
+{
+  struct spscRing ring;
+  CHECK(!spsc_ring_init(&ring, storage, SLOT_SIZE, 0));
+  CHECK(!spsc_ring_init(&ring, storage, SLOT_SIZE, 6));
+  CHECK(spsc_ring_init(&ring, storage, SLOT_SIZE, NUM_OF_SLOTS));
+
+  CHECK(spsc_ring_peek(&ring) == NULL);
+  CHECK_EQ(spsc_ring_count(&ring), 0);
+
+  // Reserving again before committing returns the same slot
+  void* slot = spsc_ring_reserve(&ring);
+  CHECK(slot != NULL);
+  CHECK(spsc_ring_reserve(&ring) == slot);
+  CHECK(spsc_ring_peek(&ring) == NULL);
+
+  for (uint32_t i = 0; i < NUM_OF_SLOTS; i++)
+  {
+    uint32_t* reserved = spsc_ring_reserve(&ring);
+    CHECK(reserved != NULL);
+    if (reserved != NULL)
+    {
+      fill_slot(reserved, i);
+      spsc_ring_commit(&ring);
+    }
+  }
+  CHECK(spsc_ring_reserve(&ring) == NULL);
+  CHECK_EQ(spsc_ring_count(&ring), NUM_OF_SLOTS);
+
+  for (uint32_t i = 0; i < NUM_OF_SLOTS / 2U; i++)
+  {
+    const uint32_t* peeked = spsc_ring_peek(&ring);
+    CHECK(peeked != NULL);
+    if (peeked != NULL)
+    {
+      CHECK_EQ(peeked[0], i);
+      CHECK(slot_is_intact(peeked, i));
+      spsc_ring_release(&ring);
+    }
+  }
+  CHECK_EQ(spsc_ring_count(&ring), NUM_OF_SLOTS / 2U);
+
+  spsc_ring_discard(&ring);
+  CHECK_EQ(spsc_ring_count(&ring), 0);
+  CHECK(spsc_ring_peek(&ring) == NULL);
+  CHECK(spsc_ring_reserve(&ring) != NULL);
+}
+
+// The indices are free running, they wrap around after 2^32 slots on the device
+static void test_index_wrap(void)
+{
+  struct spscRing ring;
+  CHECK(spsc_ring_init(&ring, storage, SLOT_SIZE, NUM_OF_SLOTS));
+  atomic_store(&ring.head, UINT32_MAX - 3U);
+  atomic_store(&ring.tail, UINT32_MAX - 3U);
+
+  uint32_t next_read = 0;
+  for (uint32_t i = 0; i < 4U * NUM_OF_SLOTS; i++)
+  {
+    uint32_t* reserved = spsc_ring_reserve(&ring);
+    CHECK(reserved != NULL);
+    if (reserved == NULL)
+    {
+      return;
+    }
+    fill_slot(reserved, i);
+    spsc_ring_commit(&ring);
+    if (spsc_ring_count(&ring) == NUM_OF_SLOTS)
+    {
+      CHECK(spsc_ring_reserve(&ring) == NULL);
+      while (spsc_ring_count(&ring) > 1U)
+      {
+        const uint32_t* peeked = spsc_ring_peek(&ring);
+        CHECK_EQ(peeked[0], next_read);
+        CHECK(slot_is_intact(peeked, next_read));
+        spsc_ring_release(&ring);
+        next_read++;
+      }
+    }
+  }
+}
+
+struct stressContext
+{
+  struct spscRing ring;
+  uint32_t num_of_transfers;
+  // Every so many slots the consumer stops for a while, so the producer also finds the ring full
+  uint32_t consumer_pause_every;
+  uint32_t producer_full;
+  uint32_t consumer_empty;
+  uint32_t out_of_order;
+  uint32_t corrupt;
+};
+
+static void* producer_thread(void* arg)
+{
+  struct stressContext* context = arg;
+  for (uint32_t sequence = 0; sequence < context->num_of_transfers; sequence++)
+  {
+    uint32_t* slot;
+    while ((slot = spsc_ring_reserve(&context->ring)) == NULL)
+    {
+      context->producer_full++;
+      sched_yield();
+    }
+    fill_slot(slot, sequence);
+    spsc_ring_commit(&context->ring);
+  }
+  return NULL;
+}
+
+static void* consumer_thread(void* arg)
+{
+  struct stressContext* context = arg;
+  for (uint32_t expected = 0; expected < context->num_of_transfers; expected++)
+  {
+    const uint32_t* slot;
+    while ((slot = spsc_ring_peek(&context->ring)) == NULL)
+    {
+      context->consumer_empty++;
+      sched_yield();
+    }
+    if (slot[0] != expected)
+    {
+      // Count it once and follow the producer from there
+      context->out_of_order++;
+      expected = slot[0];
+    }
+    if (!slot_is_intact(slot, slot[0]))
+    {
+      context->corrupt++;
+    }
+    spsc_ring_release(&context->ring);
+    if (context->consumer_pause_every != 0U && (expected % context->consumer_pause_every) == 0U)
+    {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+static double seconds_since(const struct timespec* start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static void test_stress(uint32_t num_of_transfers, uint32_t consumer_pause_every, double min_slots_per_s)
+{
+  static struct stressContext context;
+  memset(&context, 0, sizeof(context));
+  CHECK(spsc_ring_init(&context.ring, storage, SLOT_SIZE, NUM_OF_SLOTS));
+  context.num_of_transfers = num_of_transfers;
+  context.consumer_pause_every = consumer_pause_every;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_t producer;
+  pthread_t consumer;
+  CHECK(pthread_create(&consumer, NULL, consumer_thread, &context) == 0);
+  CHECK(pthread_create(&producer, NULL, producer_thread, &context) == 0);
+  pthread_join(producer, NULL);
+  pthread_join(consumer, NULL);
+  double duration_s = seconds_since(&start);
+
+  double slots_per_s = (double) num_of_transfers / duration_s;
+  printf("%u slots of %u bytes in %.3f s, %.0f slots/s, %.1f MB/s, ring full %u times, empty %u times\n",
+         num_of_transfers, SLOT_SIZE, duration_s, slots_per_s, slots_per_s * SLOT_SIZE * 1e-6,
+         context.producer_full, context.consumer_empty);
+  CHECK_EQ(context.out_of_order, 0);
+  CHECK_EQ(context.corrupt, 0);
+  CHECK_EQ(spsc_ring_count(&context.ring), 0);
+  CHECK(slots_per_s >= min_slots_per_s);
+}
+
+// Usage : test_spsc_ring [num_of_transfers] [min_slots_per_s]
+int main(int argc, char** argv)
+{
+  uint32_t num_of_transfers = (argc > 1) ? (uint32_t) strtoul(argv[1], NULL, 0) : DEFAULT_NUM_OF_TRANSFERS;
+  double min_slots_per_s = (argc > 2) ? strtod(argv[2], NULL) : DEFAULT_MIN_SLOTS_PER_S;
+
+  test_single_thread();
+  test_index_wrap();
+  // As fast as both sides go, then with a consumer which falls behind now and then
+  test_stress(num_of_transfers, 0, min_slots_per_s);
+  test_stress(num_of_transfers / 4U, 64, min_slots_per_s / 4.0);
+  return TEST_RESULT();
+}
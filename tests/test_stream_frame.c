@@ -0,0 +1,111 @@
+#include "stream_frame.h"
+#include "test_check.h"
+
+#include <string.h>
+
+// A data frame as the host expects it, the same bytes are checked against the Python parser in
+// host_src/python_host_scripts/tests/test_stream_frame.py
+static const uint8_t golden_payload[] = {0x11, 0x22, 0x33};
+static const uint8_t golden_frame[] =
+{
+  0xA5, 0x5A,               // sync
+  0x01,                     // STREAM_FRAME_TYPE_DATA
+  0x03, 0x00,               // length
+  0x04, 0x03, 0x02, 0x01,   // sequence 0x01020304
+  0x0D, 0x0C, 0x0B, 0x0A,   // timestamp 0x0A0B0C0D
+  0x11, 0x22, 0x33,         // payload
+  0xC8, 0x0B,               // CRC 0x0BC8
+};
+
+// Bit by bit CRC-16/CCITT-FALSE, to check the table of stream_frame.c against
+static uint16_t reference_crc16(const uint8_t* buf, uint32_t size)
+{
+  uint16_t crc = 0xFFFFU;
+  for (uint32_t i = 0; i < size; i++)
+  {
+    crc ^= (uint16_t) (buf[i] << 8);
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000U) ? (uint16_t) ((crc << 1) ^ 0x1021U) : (uint16_t) (crc << 1);
+    }
+  }
+  return crc;
+}
+
+static void test_crc16(void)
+{
+  // Check value of CRC-16/CCITT-FALSE
+  const uint8_t check[] = "123456789";
+  CHECK_EQ(stream_frame_crc16(0xFFFFU, check, 9), 0x29B1);
+
+  uint8_t buf[512];
+  uint32_t state = 1;
+  for (uint32_t i = 0; i < sizeof(buf); i++)
+  {
+    state = state * 1103515245U + 12345U;
+    buf[i] = (uint8_t) (state >> 16);
+  }
+  CHECK_EQ(stream_frame_crc16(0xFFFFU, buf, sizeof(buf)), reference_crc16(buf, sizeof(buf)));
+  // Updated over several pieces, the way a frame is sealed
+  uint16_t crc = stream_frame_crc16(0xFFFFU, buf, 100);
+  crc = stream_frame_crc16(crc, &buf[100], sizeof(buf) - 100U);
+  CHECK_EQ(crc, reference_crc16(buf, sizeof(buf)));
+}
+
+static void test_encode(void)
+{
+  uint8_t frame[64];
+  memset(frame, 0xEE, sizeof(frame));
+  uint32_t size = stream_frame_encode(frame, sizeof(frame), STREAM_FRAME_TYPE_DATA, 0x01020304U, 0x0A0B0C0DU,
+                                      golden_payload, sizeof(golden_payload));
+  CHECK_EQ(size, sizeof(golden_frame));
+  CHECK(memcmp(frame, golden_frame, sizeof(golden_frame)) == 0);
+  // Nothing written past the frame
+  CHECK_EQ(frame[sizeof(golden_frame)], 0xEE);
+
+  // Header first, payload in place, then the CRC, as the sampler and the egress task do
+  uint8_t in_place[64];
+  stream_frame_write_header(in_place, STREAM_FRAME_TYPE_DATA, sizeof(golden_payload), 0x01020304U, 0x0A0B0C0DU);
+  memcpy(&in_place[STREAM_FRAME_HEADER_SIZE], golden_payload, sizeof(golden_payload));
+  CHECK_EQ(stream_frame_seal(in_place), sizeof(golden_frame));
+  CHECK(memcmp(in_place, golden_frame, sizeof(golden_frame)) == 0);
+}
+
+static void test_buffer_size(void)
+{
+  uint8_t frame[STREAM_FRAME_OVERHEAD + 3U];
+  CHECK_EQ(stream_frame_encode(frame, sizeof(frame) - 1U, STREAM_FRAME_TYPE_DATA, 0, 0, golden_payload, 3), 0);
+  CHECK_EQ(stream_frame_encode(frame, sizeof(frame), STREAM_FRAME_TYPE_DATA, 0, 0, golden_payload, 3), sizeof(frame));
+
+  // An end of stream frame has no payload
+  CHECK_EQ(stream_frame_encode(frame, STREAM_FRAME_OVERHEAD, STREAM_FRAME_TYPE_EOS, 1234, 5678, NULL, 0), STREAM_FRAME_OVERHEAD);
+  CHECK_EQ(frame[2], STREAM_FRAME_TYPE_EOS);
+  CHECK_EQ(frame[3] | (frame[4] << 8), 0);
+  uint16_t crc = (uint16_t) (frame[STREAM_FRAME_HEADER_SIZE] | (frame[STREAM_FRAME_HEADER_SIZE + 1U] << 8));
+  CHECK_EQ(crc, reference_crc16(&frame[2], STREAM_FRAME_HEADER_SIZE - 2U));
+}
+
+static void test_max_payload(void)
+{
+  static uint8_t payload[STREAM_FRAME_MAX_PAYLOAD_SIZE];
+  static uint8_t frame[STREAM_FRAME_OVERHEAD + STREAM_FRAME_MAX_PAYLOAD_SIZE];
+  for (uint32_t i = 0; i < sizeof(payload); i++)
+  {
+    payload[i] = (uint8_t) i;
+  }
+  uint32_t size = stream_frame_encode(frame, sizeof(frame), STREAM_FRAME_TYPE_DELTA, UINT32_MAX, UINT32_MAX, payload, sizeof(payload));
+  CHECK_EQ(size, sizeof(frame));
+  CHECK_EQ(frame[3] | (frame[4] << 8), STREAM_FRAME_MAX_PAYLOAD_SIZE);
+  CHECK(memcmp(&frame[STREAM_FRAME_HEADER_SIZE], payload, sizeof(payload)) == 0);
+  uint16_t crc = (uint16_t) (frame[size - 2U] | (frame[size - 1U] << 8));
+  CHECK_EQ(crc, reference_crc16(&frame[2], size - 4U));
+}
+
+int main(void)
+{
+  test_crc16();
+  test_encode();
+  test_buffer_size();
+  test_max_payload();
+  return TEST_RESULT();
+}